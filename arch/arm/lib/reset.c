@@ -22,6 +22,7 @@
  */
 
 #include <common.h>
+#include <mmc.h>
 
 __weak void reset_misc(void)
 {
@@ -35,6 +36,8 @@ int do_reset(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 
 	disable_interrupts();
 
+	/* An eMMC may lose what is in its cache when it is reset */
+	mmc_flush_all_caches();
 	reset_misc();
 	reset_cpu(0);
 
@@ -11,7 +11,7 @@
 
 /* Used by drivers/spi/sandbox_spi.c and arch/sandbox/include/asm/state.h */
 #ifndef CONFIG_SANDBOX_SPI_MAX_BUS
-#define CONFIG_SANDBOX_SPI_MAX_BUS 1
+#define CONFIG_SANDBOX_SPI_MAX_BUS 2
 #endif
 #ifndef CONFIG_SANDBOX_SPI_MAX_CS
 #define CONFIG_SANDBOX_SPI_MAX_CS 10
@@ -14,4 +14,14 @@ void sandbox_eth_disable_response(int index, bool disable);
 
 void sandbox_eth_skip_timeout(void);
 
+int sandbox_eth_arp_requests(void);
+
+int sandbox_eth_tftp_add(const char *name, const void *data, int len);
+
+void sandbox_eth_tftp_reset(void);
+
+int sandbox_eth_tftp_requests(const char *name);
+
+void sandbox_eth_tftp_max_pending(int max);
+
 #endif /* __ETH_H */
@@ -79,4 +79,92 @@ long sandbox_i2c_rtc_get_set_base_time(struct udevice *dev, long base_time);
 
 int sandbox_usb_keyb_add_string(struct udevice *dev, const char *str);
 
+/**
+ * sandbox_flash_get_max_queued() - get the UAS queue depth reached
+ *
+ * @dev:	USB flash stick emulator
+ * @return largest number of UAS commands the host had queued at once
+ */
+int sandbox_flash_get_max_queued(struct udevice *dev);
+
+/**
+ * sandbox_flash_get_queued() - get the number of UAS commands queued now
+ *
+ * @dev:	USB flash stick emulator
+ * @return number of UAS commands received and not yet finished
+ */
+int sandbox_flash_get_queued(struct udevice *dev);
+
+/**
+ * sandbox_flash_uas_fail() - make a read of the UAS status pipe fail
+ *
+ * @dev:	USB flash stick emulator
+ * @ius:	Number of status IUs to send before the failing read
+ */
+void sandbox_flash_uas_fail(struct udevice *dev, int ius);
+
+/**
+ * struct sandbox_sdhci_stats - what the emulated SDHCI controller has done
+ *
+ * @cmds:	Commands run
+ * @data_cmds:	Commands which transferred data
+ * @sdma_cmds:	Data commands which used SDMA
+ * @adma_cmds:	Data commands which used ADMA2
+ * @adma_descs:	ADMA2 data descriptors processed
+ * @tunings:	Tuning blocks read
+ * @sd_speed:	Bus speed function the SD card last switched to
+ * @hs_timing:	HS_TIMING of the eMMC
+ * @bus_width:	BUS_WIDTH of the eMMC
+ * @stop_cmds:	STOP_TRANSMISSION commands received
+ * @set_count_cmds: SET_BLOCK_COUNT commands received
+ * @cache_flushes: eMMC cache flushes
+ * @ext_csd_reads: EXT_CSD reads from the eMMC
+ */
+struct sandbox_sdhci_stats {
+	int cmds;
+	int data_cmds;
+	int sdma_cmds;
+	int adma_cmds;
+	int adma_descs;
+	int tunings;
+	int sd_speed;
+	int hs_timing;
+	int bus_width;
+	int stop_cmds;
+	int set_count_cmds;
+	int cache_flushes;
+	int ext_csd_reads;
+};
+
+/**
+ * sandbox_sdhci_get_stats() - get statistics of the emulated SDHCI controller
+ *
+ * @dev:	SDHCI device
+ * @stats:	Returns the statistics since probe or the last reset
+ */
+void sandbox_sdhci_get_stats(struct udevice *dev,
+			     struct sandbox_sdhci_stats *stats);
+
+/**
+ * sandbox_sdhci_reset_stats() - reset statistics of the emulated controller
+ *
+ * @dev:	SDHCI device
+ */
+void sandbox_sdhci_reset_stats(struct udevice *dev);
+
+/* How the emulated SD card fails to switch to 1.8V signalling */
+enum {
+	SB_SDHCI_S18_OK,	/* it does not fail */
+	SB_SDHCI_S18_NO_CMD,	/* it does not answer CMD11 */
+	SB_SDHCI_S18_DAT_LOW,	/* it holds DAT[3:0] low after switching */
+};
+
+/**
+ * sandbox_sdhci_s18_fail() - make the emulated SD card fail to switch to 1.8V
+ *
+ * @dev:	SDHCI device
+ * @fail:	SB_SDHCI_S18_...
+ */
+void sandbox_sdhci_s18_fail(struct udevice *dev, int fail);
+
 #endif
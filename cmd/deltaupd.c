@@ -0,0 +1,32 @@
+/*
+ * Command for applying block-level delta updates
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <update_delta.h>
+
+static int do_deltaupd(cmd_tbl_t *cmdtp, int flag, int argc,
+		       char * const argv[])
+{
+	ulong addr;
+
+	if (argc != 6)
+		return CMD_RET_USAGE;
+
+	addr = simple_strtoul(argv[1], NULL, 16);
+	if (update_delta_fit(addr, argv[2], argv[3], argv[4], argv[5]))
+		return CMD_RET_FAILURE;
+
+	return CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD(deltaupd, 6, 0, do_deltaupd,
+	"apply a block-level delta update from a FIT image",
+	"<addr> <image> <interface> <src-dev[:part]> <dst-dev[:part]>\n"
+	"\t- apply the delta in FIT image <image> at <addr>, reading the\n"
+	"\t  source partition and writing the target partition. An update\n"
+	"\t  which was interrupted carries on where it stopped."
+);
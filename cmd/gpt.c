@@ -22,6 +22,7 @@
 #include <linux/compat.h>
 #include <linux/sizes.h>
 #include <stdlib.h>
+#include <mmc.h>
 
 static LIST_HEAD(disk_partitions);
 
@@ -859,6 +860,11 @@ static int do_gpt(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 		return CMD_RET_USAGE;
 	}
 
+	/* Make sure the table is on the flash, not in an eMMC's cache */
+	if (IS_ENABLED(CONFIG_MMC_CACHE) && !ret &&
+	    blk_dev_desc->if_type == IF_TYPE_MMC)
+		ret = mmc_flush_cache(find_mmc_device(blk_dev_desc->devnum));
+
 	if (ret) {
 		printf("error!\n");
 		return CMD_RET_FAILURE;
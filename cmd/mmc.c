@@ -323,6 +323,9 @@ static int do_mmc_write(cmd_tbl_t *cmdtp, int flag,
 		return CMD_RET_FAILURE;
 	}
 	n = blk_dwrite(mmc_get_blk_desc(mmc), blk, cnt, addr);
+	/* Don't report blocks still in the card's cache as written */
+	if (mmc_flush_cache(mmc))
+		n = 0;
 	printf("%d blocks written: %s\n", n, (n == cnt) ? "OK" : "ERROR");
 
 	return (n == cnt) ? CMD_RET_SUCCESS : CMD_RET_FAILURE;
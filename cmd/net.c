@@ -11,6 +11,8 @@
 #include <common.h>
 #include <command.h>
 #include <net.h>
+#include <net/mdist.h>
+#include <net6.h>
 
 static int netboot_common(enum proto_t, cmd_tbl_t *, int, char * const []);
 
@@ -41,6 +43,27 @@ U_BOOT_CMD(
 	"[loadAddress] [[hostIPaddr:]bootfilename]"
 );
 
+#ifdef CONFIG_IPV6
+static int do_tftpb6(cmd_tbl_t *cmdtp, int flag, int argc,
+		     char * const argv[])
+{
+	int ret;
+
+	net_use_ip6 = true;
+	ret = do_tftpb(cmdtp, flag, argc, argv);
+	net_use_ip6 = false;
+
+	return ret;
+}
+
+U_BOOT_CMD(
+	tftpboot6,	3,	1,	do_tftpb6,
+	"boot image via network using TFTP over IPv6",
+	"[loadAddress] [bootfilename]\n"
+	"    - the server is taken from 'serverip6'"
+);
+#endif
+
 #ifdef CONFIG_CMD_TFTPPUT
 static int do_tftpput(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
@@ -281,6 +304,58 @@ U_BOOT_CMD(
 );
 #endif
 
+#if defined(CONFIG_CMD_PING6)
+static int do_ping6(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	if (argc < 2)
+		return CMD_RET_USAGE;
+
+	if (string_to_ip6(argv[1], &net_ping_ip6, NULL) ||
+	    ip6_is_unspecified(&net_ping_ip6))
+		return CMD_RET_USAGE;
+
+	if (net_loop(PING6) < 0) {
+		printf("ping6 failed; host %s is not alive\n", argv[1]);
+		return CMD_RET_FAILURE;
+	}
+
+	printf("host %s is alive\n", argv[1]);
+
+	return CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD(
+	ping6,	2,	1,	do_ping6,
+	"send ICMPv6 ECHO_REQUEST to network host",
+	"pingAddress"
+);
+#endif
+
+#ifdef CONFIG_IPV6
+static int do_slaac(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	char tmp[64];
+
+	if (net_loop(SLAAC) < 0)
+		return CMD_RET_FAILURE;
+
+	sprintf(tmp, "%pI6/%u", &net_ip6, net_prefix_length);
+	env_set("ip6addr", tmp);
+	if (!ip6_is_unspecified(&net_gateway6)) {
+		sprintf(tmp, "%pI6", &net_gateway6);
+		env_set("gatewayip6", tmp);
+	}
+
+	return CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD(
+	slaac,	1,	1,	do_slaac,
+	"configure IPv6 from router advertisements",
+	""
+);
+#endif
+
 #if defined(CONFIG_CMD_CDP)
 
 static void cdp_update_env(void)
@@ -442,3 +517,73 @@ U_BOOT_CMD(
 );
 
 #endif  /* CONFIG_CMD_LINK_LOCAL */
+
+#if defined(CONFIG_CMD_MDIST)
+static int do_mdist(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	enum proto_t proto;
+	bool multicast;
+	int group_arg;
+
+	if (argc < 2)
+		return CMD_RET_USAGE;
+
+	if (!strcmp(argv[1], "send")) {
+		if (argc < 4 || argc > 5)
+			return CMD_RET_USAGE;
+		mdist_send_addr = simple_strtoul(argv[2], NULL, 16);
+		mdist_send_size = simple_strtoul(argv[3], NULL, 16);
+		if (!mdist_send_size)
+			return CMD_RET_USAGE;
+		if (mdist_send_size > MDIST_FILE_SIZE_MAX) {
+			printf("Image too large, limit is %lu bytes\n",
+			       (ulong)MDIST_FILE_SIZE_MAX);
+			return CMD_RET_FAILURE;
+		}
+		mdist_rounds = env_get_ulong("mdistrounds", 10, 3);
+		proto = MDISTSEND;
+		group_arg = 4;
+	} else if (!strcmp(argv[1], "recv")) {
+		if (argc > 4)
+			return CMD_RET_USAGE;
+		if (argc > 2)
+			load_addr = simple_strtoul(argv[2], NULL, 16);
+		proto = MDISTRECV;
+		group_arg = 3;
+	} else {
+		return CMD_RET_USAGE;
+	}
+
+	if (argc > group_arg)
+		mdist_group_ip = string_to_ip(argv[group_arg]);
+	else
+		mdist_group_ip.s_addr = 0xffffffff;
+
+	multicast = (ntohl(mdist_group_ip.s_addr) & 0xf0000000) == 0xe0000000;
+	if (!multicast && mdist_group_ip.s_addr != 0xffffffff) {
+		printf("%s is neither multicast nor broadcast\n",
+		       argv[group_arg]);
+		return CMD_RET_USAGE;
+	}
+#ifndef CONFIG_MCAST_TFTP
+	if (multicast && proto == MDISTRECV) {
+		puts("Multicast receive not supported\n");
+		return CMD_RET_FAILURE;
+	}
+#endif
+
+	if (net_loop(proto) < 0)
+		return CMD_RET_FAILURE;
+
+	return CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD(
+	mdist,	5,	1,	do_mdist,
+	"distribute an image to many devices at once",
+	"send addr size [group] - send image at addr to group\n"
+	"    (repeated $mdistrounds times, default 3)\n"
+	"mdist recv [addr [group]] - receive an image sent to group\n"
+	"    group is a multicast address, default is broadcast"
+);
+#endif  /* CONFIG_CMD_MDIST */
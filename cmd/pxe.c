@@ -14,6 +14,9 @@
 #include <errno.h>
 #include <linux/list.h>
 #include <fs.h>
+#include <net.h>
+#include <net/tftp.h>
+#include <u-boot/crc.h>
 #include <asm/io.h>
 
 #include "menu.h"
@@ -351,6 +354,80 @@ static int pxe_ipaddr_paths(cmd_tbl_t *cmdtp, unsigned long pxefile_addr_r)
 	return -ENOENT;
 }
 
+#ifdef CONFIG_CMD_PXE_PARALLEL
+/*
+ * Adds a file in the 'pxelinux.cfg' folder to the names tftp_probe_start()
+ * looks for. 'prefix' is the bootfile path, as get_relfile would prepend.
+ */
+static void pxe_probe_add(char paths[][MAX_TFTP_PATH_LEN + 1],
+			  const char *prefix, const char *file)
+{
+	int i = tftp_probe_count;
+
+	if (i >= TFTP_PROBE_MAX)
+		return;
+
+	if (strlen(prefix) + strlen(PXELINUX_DIR) + strlen(file) >
+	    MAX_TFTP_PATH_LEN) {
+		printf("path (%s%s) too long, skipping\n",
+		       PXELINUX_DIR, file);
+		return;
+	}
+
+	sprintf(paths[i], "%s" PXELINUX_DIR "%s", prefix, file);
+	tftp_probe_names[i] = paths[i];
+	tftp_probe_count++;
+}
+
+/*
+ * Looks for all the pxe files that pxe_uuid_path, pxe_mac_path,
+ * pxe_ipaddr_paths and pxe_default_paths name at once, then retrieves the
+ * first one in that order that the server has.
+ *
+ * Returns 1 on success or < 0 on error.
+ */
+static int pxe_probe_paths(cmd_tbl_t *cmdtp, unsigned long pxefile_addr_r)
+{
+	static char paths[TFTP_PROBE_MAX][MAX_TFTP_PATH_LEN + 1];
+	char prefix[MAX_TFTP_PATH_LEN + 1];
+	char mac_str[21];
+	char ip_addr[9];
+	char *uuid_str;
+	int mask_pos, err, i;
+
+	err = get_bootfile_path(PXELINUX_DIR, prefix, sizeof(prefix));
+
+	if (err < 0)
+		return err;
+
+	tftp_probe_count = 0;
+
+	uuid_str = from_env("pxeuuid");
+	if (uuid_str)
+		pxe_probe_add(paths, prefix, uuid_str);
+
+	if (format_mac_pxe(mac_str, sizeof(mac_str)) > 0)
+		pxe_probe_add(paths, prefix, mac_str);
+
+	sprintf(ip_addr, "%08X", ntohl(net_ip.s_addr));
+
+	for (mask_pos = 7; mask_pos >= 0;  mask_pos--) {
+		pxe_probe_add(paths, prefix, ip_addr);
+		ip_addr[mask_pos] = '\0';
+	}
+
+	for (i = 0; pxe_default_paths[i]; i++)
+		pxe_probe_add(paths, prefix, pxe_default_paths[i]);
+
+	if (net_loop(TFTPPROBE) < 0 || tftp_probe_found < 0)
+		return -ENOENT;
+
+	/* Fetch it the usual way, without the bootfile path again */
+	return get_pxe_file(cmdtp, paths[tftp_probe_found] + strlen(prefix),
+			    pxefile_addr_r);
+}
+#endif
+
 /*
  * Entry point for the 'pxe get' command.
  * This Follows pxelinux's rules to download a config file from a tftp server.
@@ -387,6 +464,16 @@ do_pxe_get(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 	if (err < 0)
 		return 1;
 
+#ifdef CONFIG_CMD_PXE_PARALLEL
+	if (pxe_probe_paths(cmdtp, pxefile_addr_r) > 0) {
+		printf("Config file found\n");
+		return 0;
+	}
+
+	/* The server or a firewall may have dropped some of the requests */
+	printf("Trying the config files one at a time\n");
+#endif
+
 	/*
 	 * Keep trying paths until we successfully get a file we're looking
 	 * for.
@@ -494,6 +581,7 @@ struct pxe_label {
  *          interrupted.  If 1, always prompt for a choice regardless of
  *          timeout.
  * labels - a list of labels defined for the menu.
+ * includes - the number of files included while parsing the menu.
  */
 struct pxe_menu {
 	char *title;
@@ -501,6 +589,7 @@ struct pxe_menu {
 	int timeout;
 	int prompt;
 	struct list_head labels;
+	int includes;
 };
 
 /*
@@ -1103,6 +1192,7 @@ static int handle_include(cmd_tbl_t *cmdtp, char **c, unsigned long base,
 		return err;
 	}
 
+	cfg->includes++;
 	buf = map_sysmem(base, 0);
 	ret = parse_pxefile_top(cmdtp, buf, base, cfg, nest_level);
 	unmap_sysmem(buf);
@@ -1558,6 +1648,59 @@ static void handle_pxe_menu(cmd_tbl_t *cmdtp, struct pxe_menu *cfg)
 }
 
 #ifdef CONFIG_CMD_NET
+#ifdef CONFIG_CMD_PXE_MENU_CACHE
+/*
+ * The menu parsed by the last 'pxe boot', kept with the address, size and
+ * CRC32 of its config file so that it can be reused while the same file is
+ * booted again. A menu which includes other files is never reused, since
+ * those may have changed on the server without the config file changing.
+ */
+static struct pxe_menu *cached_menu;
+static unsigned long cached_menu_addr;
+static size_t cached_menu_size;
+static u32 cached_menu_crc;
+
+/*
+ * Returns the pxe_menu for the file at menucfg, parsing it unless it is the
+ * one cached. The result must not be destroyed by the caller.
+ */
+static struct pxe_menu *get_cached_pxefile(cmd_tbl_t *cmdtp,
+					   unsigned long menucfg)
+{
+	struct list_head *pos;
+	struct pxe_label *label;
+	size_t size;
+	char *buf;
+	u32 crc;
+
+	buf = map_sysmem(menucfg, 0);
+	size = strlen(buf);
+	crc = crc32(0, (const unsigned char *)buf, size);
+	unmap_sysmem(buf);
+
+	if (cached_menu && !cached_menu->includes &&
+	    cached_menu_addr == menucfg && cached_menu_size == size &&
+	    cached_menu_crc == crc) {
+		list_for_each(pos, &cached_menu->labels) {
+			label = list_entry(pos, struct pxe_label, list);
+			label->attempted = 0;
+		}
+
+		return cached_menu;
+	}
+
+	if (cached_menu)
+		destroy_pxe_menu(cached_menu);
+
+	cached_menu = parse_pxefile(cmdtp, menucfg);
+	cached_menu_addr = menucfg;
+	cached_menu_size = size;
+	cached_menu_crc = crc;
+
+	return cached_menu;
+}
+#endif
+
 /*
  * Boots a system using a pxe file
  *
@@ -1588,7 +1731,11 @@ do_pxe_boot(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 		return 1;
 	}
 
+#ifdef CONFIG_CMD_PXE_MENU_CACHE
+	cfg = get_cached_pxefile(cmdtp, pxefile_addr_r);
+#else
 	cfg = parse_pxefile(cmdtp, pxefile_addr_r);
+#endif
 
 	if (cfg == NULL) {
 		printf("Error parsing config file\n");
@@ -1597,7 +1744,9 @@ do_pxe_boot(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 
 	handle_pxe_menu(cmdtp, cfg);
 
+#ifndef CONFIG_CMD_PXE_MENU_CACHE
 	destroy_pxe_menu(cfg);
+#endif
 
 	copy_filename(net_boot_file_name, "", sizeof(net_boot_file_name));
 
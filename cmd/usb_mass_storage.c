@@ -12,6 +12,7 @@
 #include <command.h>
 #include <console.h>
 #include <g_dnl.h>
+#include <mmc.h>
 #include <part.h>
 #include <usb.h>
 #include <usb_mass_storage.h>
@@ -41,6 +42,8 @@ static void ums_fini(void)
 {
 	int i;
 
+	/* The host may have written to an eMMC */
+	mmc_flush_all_caches();
 	for (i = 0; i < ums_count; i++)
 		free((void *)ums[i].name);
 	free(ums);
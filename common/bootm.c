@@ -22,6 +22,7 @@
 #if defined(CONFIG_CMD_USB)
 #include <usb.h>
 #endif
+#include <mmc.h>
 #else
 #include "mkimage.h"
 #endif
@@ -512,6 +513,8 @@ ulong bootm_disable_interrupts(void)
 	 */
 	usb_stop();
 #endif
+	/* The OS knows nothing of what is left in an eMMC's cache */
+	mmc_flush_all_caches();
 	return iflag;
 }
 
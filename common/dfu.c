@@ -17,6 +17,7 @@
 #include <console.h>
 #include <g_dnl.h>
 #include <usb.h>
+#include <mmc.h>
 #include <net.h>
 
 int run_usb_dnl_gadget(int usbctrl_index, char *usb_dnl_gadget)
@@ -80,12 +81,15 @@ int run_usb_dnl_gadget(int usbctrl_index, char *usb_dnl_gadget)
 			}
 		}
 
+		dfu_write_background();
+
 		WATCHDOG_RESET();
 		usb_gadget_handle_interrupts(usbctrl_index);
 	}
 exit:
 	g_dnl_unregister();
 	board_usb_cleanup(usbctrl_index, USB_INIT_DEVICE);
+	mmc_flush_all_caches();
 
 	if (dfu_reset)
 		do_reset(NULL, 0, 0, NULL);
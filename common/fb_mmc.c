@@ -7,6 +7,7 @@
 #include <config.h>
 #include <common.h>
 #include <blk.h>
+#include <errno.h>
 #include <fastboot.h>
 #include <fb_mmc.h>
 #include <image-sparse.h>
@@ -72,6 +73,34 @@ static lbaint_t fb_mmc_sparse_reserve(struct sparse_storage *info,
 	return blkcnt;
 }
 
+static lbaint_t fb_mmc_sparse_erase(struct sparse_storage *info,
+		lbaint_t blk, lbaint_t blkcnt)
+{
+	struct fb_mmc_sparse *sparse = info->priv;
+	struct blk_desc *dev_desc = sparse->dev_desc;
+
+	return blk_derase(dev_desc, blk, blkcnt);
+}
+
+/* Erase rather than write fills which match what erased blocks read as */
+static void fb_mmc_sparse_setup_erase(struct blk_desc *dev_desc,
+				      struct sparse_storage *sparse)
+{
+	struct mmc *mmc;
+
+	sparse->erase = NULL;
+	if (!IS_ENABLED(CONFIG_FASTBOOT_FLASH_SPARSE_ERASE))
+		return;
+
+	mmc = find_mmc_device(dev_desc->devnum);
+	if (!mmc || mmc->erased_byte < 0 ||
+	    mmc->erase_grp_size * 512 % sparse->blksz)
+		return;
+	sparse->erase = fb_mmc_sparse_erase;
+	sparse->erase_grp = mmc->erase_grp_size * 512 / sparse->blksz;
+	sparse->erased_val = mmc->erased_byte * 0x01010101;
+}
+
 static void write_raw_image(struct blk_desc *dev_desc, disk_partition_t *info,
 		const char *part_name, void *buffer,
 		unsigned int download_bytes)
@@ -260,8 +289,8 @@ static int fb_mmc_update_zimage(struct blk_desc *dev_desc,
 }
 #endif
 
-void fb_mmc_flash_write(const char *cmd, void *download_buffer,
-			unsigned int download_bytes)
+static void fb_mmc_flash(const char *cmd, void *download_buffer,
+			 unsigned int download_bytes)
 {
 	struct blk_desc *dev_desc;
 	disk_partition_t info;
@@ -338,6 +367,7 @@ void fb_mmc_flash_write(const char *cmd, void *download_buffer,
 		sparse.size = info.size;
 		sparse.write = fb_mmc_sparse_write;
 		sparse.reserve = fb_mmc_sparse_reserve;
+		fb_mmc_sparse_setup_erase(dev_desc, &sparse);
 
 		printf("Flashing sparse image at offset " LBAFU "\n",
 		       sparse.start);
@@ -351,6 +381,98 @@ void fb_mmc_flash_write(const char *cmd, void *download_buffer,
 	}
 }
 
+void fb_mmc_flash_write(const char *cmd, void *download_buffer,
+			unsigned int download_bytes)
+{
+	struct mmc *mmc;
+
+	fb_mmc_flash(cmd, download_buffer, download_bytes);
+
+	/* The host must not be told OKAY while the image is in the cache */
+	mmc = find_mmc_device(CONFIG_FASTBOOT_FLASH_MMC_DEV);
+	if (mmc && mmc_flush_cache(mmc))
+		fastboot_fail("flushing eMMC cache failed");
+}
+
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+static struct {
+	struct fb_mmc_sparse sparse_priv;
+	struct sparse_storage sparse;
+	struct sparse_stream ss;
+	char part_name[PART_NAME_LEN];
+} fb_mmc_stream;
+
+int fb_mmc_stream_start(const char *cmd)
+{
+	struct blk_desc *dev_desc;
+	disk_partition_t info;
+
+	dev_desc = blk_get_dev("mmc", CONFIG_FASTBOOT_FLASH_MMC_DEV);
+	if (!dev_desc || dev_desc->type == DEV_TYPE_UNKNOWN) {
+		pr_err("invalid mmc device\n");
+		fastboot_fail("invalid mmc device");
+		return -ENODEV;
+	}
+
+	if (part_get_info_by_name_or_alias(dev_desc, cmd, &info) < 0) {
+		pr_err("cannot find partition: '%s'\n", cmd);
+		fastboot_fail("cannot find partition");
+		return -ENOENT;
+	}
+
+	/* Drop any stream which never got its download */
+	fb_mmc_stream_abort();
+
+	fb_mmc_stream.sparse_priv.dev_desc = dev_desc;
+	fb_mmc_stream.sparse.blksz = info.blksz;
+	fb_mmc_stream.sparse.start = info.start;
+	fb_mmc_stream.sparse.size = info.size;
+	fb_mmc_stream.sparse.write = fb_mmc_sparse_write;
+	fb_mmc_stream.sparse.reserve = fb_mmc_sparse_reserve;
+	fb_mmc_sparse_setup_erase(dev_desc, &fb_mmc_stream.sparse);
+	fb_mmc_stream.sparse.priv = &fb_mmc_stream.sparse_priv;
+	strlcpy(fb_mmc_stream.part_name, cmd, sizeof(fb_mmc_stream.part_name));
+
+	if (sparse_stream_start(&fb_mmc_stream.ss, &fb_mmc_stream.sparse)) {
+		fastboot_fail("Malloc failed for sparse image buffer");
+		return -ENOMEM;
+	}
+
+	printf("Streaming next download to offset " LBAFU "\n", info.start);
+	fastboot_okay("");
+
+	return 0;
+}
+
+int fb_mmc_stream_write(const void *data, unsigned int len)
+{
+	return sparse_stream_write(&fb_mmc_stream.ss, data, len);
+}
+
+int fb_mmc_stream_finish(void)
+{
+	struct mmc *mmc;
+
+	if (sparse_stream_finish(&fb_mmc_stream.ss, fb_mmc_stream.part_name))
+		return -EIO;
+
+	/* The host must not be told OKAY while the image is in the cache */
+	mmc = find_mmc_device(CONFIG_FASTBOOT_FLASH_MMC_DEV);
+	if (mmc && mmc_flush_cache(mmc)) {
+		fastboot_fail("flushing eMMC cache failed");
+		return -EIO;
+	}
+
+	return 0;
+}
+
+void fb_mmc_stream_abort(void)
+{
+	free(fb_mmc_stream.ss.buf);
+	fb_mmc_stream.ss.buf = NULL;
+}
+#endif
+
 void fb_mmc_erase(const char *cmd)
 {
 	int ret;
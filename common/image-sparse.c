@@ -36,6 +36,7 @@
 
 #include <config.h>
 #include <common.h>
+#include <errno.h>
 #include <image-sparse.h>
 #include <div64.h>
 #include <malloc.h>
@@ -49,40 +50,171 @@
 #define CONFIG_FASTBOOT_FLASH_FILLBUF_SIZE (1024 * 512)
 #endif
 
-void write_sparse_image(
-		struct sparse_storage *info, const char *part_name,
-		void *data, unsigned sz)
+enum sparse_stream_state {
+	SPARSE_STREAM_FILE_HDR,		/* collecting the file header */
+	SPARSE_STREAM_CHUNK_HDR,	/* collecting a chunk header */
+	SPARSE_STREAM_FILL_VAL,		/* collecting the value of a fill */
+	SPARSE_STREAM_DATA,		/* writing raw data */
+	SPARSE_STREAM_DONE,		/* all chunks done */
+};
+
+static int sparse_stream_fail(struct sparse_stream *ss, const char *err)
 {
-	lbaint_t blk;
-	lbaint_t blkcnt;
-	lbaint_t blks;
-	uint32_t bytes_written = 0;
-	unsigned int chunk;
-	unsigned int offset;
-	unsigned int chunk_data_sz;
-	uint32_t *fill_buf = NULL;
-	uint32_t fill_val;
-	sparse_header_t *sparse_header;
-	chunk_header_t *chunk_header;
-	uint32_t total_blocks = 0;
-	int fill_buf_num_blks;
-	int i;
-	int j;
+	printf("%s: %s\n", __func__, err);
+	ss->err = err;
+
+	return -EIO;
+}
+
+static void sparse_stream_want(struct sparse_stream *ss, int state,
+			       unsigned int size)
+{
+	ss->state = state;
+	ss->hdr_len = 0;
+	ss->hdr_size = size;
+}
 
-	fill_buf_num_blks = CONFIG_FASTBOOT_FLASH_FILLBUF_SIZE / info->blksz;
+static int sparse_stream_check_size(struct sparse_stream *ss, lbaint_t blk,
+				    lbaint_t blkcnt)
+{
+	struct sparse_storage *info = ss->info;
 
-	/* Read and skip over sparse image header */
-	sparse_header = (sparse_header_t *)data;
+	if (blk + blkcnt > info->start + info->size)
+		return sparse_stream_fail(ss,
+					  "Request would exceed partition size!");
 
-	data += sparse_header->file_hdr_sz;
-	if (sparse_header->file_hdr_sz > sizeof(sparse_header_t)) {
-		/*
-		 * Skip the remaining bytes in a header that is longer than
-		 * we expected.
-		 */
-		data += (sparse_header->file_hdr_sz - sizeof(sparse_header_t));
+	return 0;
+}
+
+/* Write whole blocks at ss->blk, padding out a partial last block */
+static int sparse_stream_put(struct sparse_stream *ss, void *data,
+			     unsigned int len)
+{
+	struct sparse_storage *info = ss->info;
+	lbaint_t blkcnt, blks;
+
+	blkcnt = DIV_ROUND_UP(len, info->blksz);
+	if (sparse_stream_check_size(ss, ss->blk, blkcnt))
+		return -EIO;
+
+	if (len % info->blksz)
+		memset(data + len, '\0', blkcnt * info->blksz - len);
+	blks = info->write(info, ss->blk, blkcnt, data);
+	/* blks might be > blkcnt (eg. NAND bad-blocks) */
+	if (blks < blkcnt) {
+		printf("%s: %s" LBAFU " [" LBAFU "]\n", __func__,
+		       "Write failed, block #", ss->blk, blks);
+		return sparse_stream_fail(ss, "flash write failure");
+	}
+	ss->blk += blks;
+	ss->bytes_written += blkcnt * info->blksz;
+
+	return 0;
+}
+
+/*
+ * Find the whole erase groups within @blkcnt blocks at @blk, returning the
+ * number of blocks before them in *headp and their number in *countp
+ */
+static void sparse_stream_erase_span(struct sparse_stream *ss, lbaint_t blk,
+				     lbaint_t blkcnt, lbaint_t *headp,
+				     lbaint_t *countp)
+{
+	u32 grp = ss->info->erase_grp;
+	lbaint_t head, count = 0;
+	u32 rem;
+
+	div_u64_rem(blk, grp, &rem);
+	head = rem ? grp - rem : 0;
+	if (head < blkcnt) {
+		div_u64_rem(blkcnt - head, grp, &rem);
+		count = blkcnt - head - rem;
 	}
+	*headp = count ? head : blkcnt;
+	*countp = count;
+}
+
+static int sparse_stream_erase(struct sparse_stream *ss, lbaint_t blk,
+			       lbaint_t blkcnt)
+{
+	struct sparse_storage *info = ss->info;
 
+	if (!blkcnt)
+		return 0;
+	if (info->erase(info, blk, blkcnt) != blkcnt) {
+		printf("%s: %s" LBAFU " [" LBAFU "]\n", __func__,
+		       "Erase failed, block #", blk, blkcnt);
+		return sparse_stream_fail(ss, "flash erase failure");
+	}
+	ss->bytes_erased += blkcnt * info->blksz;
+
+	return 0;
+}
+
+static int sparse_stream_flush(struct sparse_stream *ss)
+{
+	int ret;
+
+	if (!ss->buf_len)
+		return 0;
+	ret = sparse_stream_put(ss, ss->buf, ss->buf_len);
+	ss->buf_len = 0;
+
+	return ret;
+}
+
+/* Take raw data, returning the number of bytes used */
+static unsigned int sparse_stream_data(struct sparse_stream *ss,
+				       const u8 *data, unsigned int len)
+{
+	unsigned int n;
+
+	if (len > ss->data_left)
+		len = ss->data_left;
+
+	/* Write straight from the caller if there is a buffer's worth */
+	if (!ss->buf_len && len >= ss->buf_size) {
+		n = len - len % ss->info->blksz;
+		if (sparse_stream_put(ss, (void *)data, n))
+			return len;
+	} else {
+		n = min(len, ss->buf_size - ss->buf_len);
+		memcpy(ss->buf + ss->buf_len, data, n);
+		ss->buf_len += n;
+		if (ss->buf_len == ss->buf_size && sparse_stream_flush(ss))
+			return len;
+	}
+	ss->data_left -= n;
+
+	return n;
+}
+
+static void sparse_stream_next_chunk(struct sparse_stream *ss)
+{
+	if (++ss->chunk == ss->sparse_header.total_chunks)
+		ss->state = SPARSE_STREAM_DONE;
+	else
+		sparse_stream_want(ss, SPARSE_STREAM_CHUNK_HDR,
+				   sizeof(chunk_header_t));
+}
+
+static int sparse_stream_file_hdr(struct sparse_stream *ss)
+{
+	sparse_header_t *sparse_header = &ss->sparse_header;
+	unsigned int offset;
+
+	if (!is_sparse_image(ss->hdr)) {
+		/* Write it as it is, starting with the bytes we have */
+		ss->raw_image = true;
+		ss->state = SPARSE_STREAM_DATA;
+		ss->data_left = ~0U;
+		memcpy(ss->buf, ss->hdr, ss->hdr_len);
+		ss->buf_len = ss->hdr_len;
+		puts("Flashing Raw Image\n");
+		return 0;
+	}
+
+	memcpy(sparse_header, ss->hdr, sizeof(*sparse_header));
 	debug("=== Sparse Image Header ===\n");
 	debug("magic: 0x%x\n", sparse_header->magic);
 	debug("major_version: 0x%x\n", sparse_header->major_version);
@@ -93,172 +225,294 @@ void write_sparse_image(
 	debug("total_blks: %d\n", sparse_header->total_blks);
 	debug("total_chunks: %d\n", sparse_header->total_chunks);
 
+	if (sparse_header->file_hdr_sz < sizeof(sparse_header_t) ||
+	    sparse_header->chunk_hdr_sz < sizeof(chunk_header_t))
+		return sparse_stream_fail(ss, "sparse image header issue");
+
 	/*
 	 * Verify that the sparse block size is a multiple of our
 	 * storage backend block size
 	 */
-	div_u64_rem(sparse_header->blk_sz, info->blksz, &offset);
-	if (offset) {
+	div_u64_rem(sparse_header->blk_sz, ss->info->blksz, &offset);
+	if (!sparse_header->blk_sz || offset) {
 		printf("%s: Sparse image block size issue [%u]\n",
 		       __func__, sparse_header->blk_sz);
-		fastboot_fail("sparse image block size issue");
-		return;
+		return sparse_stream_fail(ss, "sparse image block size issue");
 	}
 
 	puts("Flashing Sparse Image\n");
 
-	/* Start processing chunks */
-	blk = info->start;
-	for (chunk = 0; chunk < sparse_header->total_chunks; chunk++) {
-		/* Read and skip over chunk header */
-		chunk_header = (chunk_header_t *)data;
-		data += sizeof(chunk_header_t);
-
-		if (chunk_header->chunk_type != CHUNK_TYPE_RAW) {
-			debug("=== Chunk Header ===\n");
-			debug("chunk_type: 0x%x\n", chunk_header->chunk_type);
-			debug("chunk_data_sz: 0x%x\n", chunk_header->chunk_sz);
-			debug("total_size: 0x%x\n", chunk_header->total_sz);
-		}
+	/* Skip the remaining bytes in a header that is longer than expected */
+	ss->skip = sparse_header->file_hdr_sz - sizeof(sparse_header_t);
+	if (sparse_header->total_chunks)
+		sparse_stream_want(ss, SPARSE_STREAM_CHUNK_HDR,
+				   sizeof(chunk_header_t));
+	else
+		ss->state = SPARSE_STREAM_DONE;
 
-		if (sparse_header->chunk_hdr_sz > sizeof(chunk_header_t)) {
-			/*
-			 * Skip the remaining bytes in a header that is longer
-			 * than we expected.
-			 */
-			data += (sparse_header->chunk_hdr_sz -
-				 sizeof(chunk_header_t));
-		}
+	return 0;
+}
 
-		chunk_data_sz = sparse_header->blk_sz * chunk_header->chunk_sz;
-		blkcnt = chunk_data_sz / info->blksz;
-		switch (chunk_header->chunk_type) {
-		case CHUNK_TYPE_RAW:
-			if (chunk_header->total_sz !=
-			    (sparse_header->chunk_hdr_sz + chunk_data_sz)) {
-				fastboot_fail(
+static int sparse_stream_chunk_hdr(struct sparse_stream *ss)
+{
+	sparse_header_t *sparse_header = &ss->sparse_header;
+	chunk_header_t *chunk_header = &ss->chunk_header;
+	struct sparse_storage *info = ss->info;
+	u32 chunk_data_sz;
+	lbaint_t blkcnt;
+
+	memcpy(chunk_header, ss->hdr, sizeof(*chunk_header));
+	if (chunk_header->chunk_type != CHUNK_TYPE_RAW) {
+		debug("=== Chunk Header ===\n");
+		debug("chunk_type: 0x%x\n", chunk_header->chunk_type);
+		debug("chunk_data_sz: 0x%x\n", chunk_header->chunk_sz);
+		debug("total_size: 0x%x\n", chunk_header->total_sz);
+	}
+
+	/* Skip the remaining bytes in a header that is longer than expected */
+	ss->skip = sparse_header->chunk_hdr_sz - sizeof(chunk_header_t);
+
+	chunk_data_sz = sparse_header->blk_sz * chunk_header->chunk_sz;
+	blkcnt = chunk_data_sz / info->blksz;
+	switch (chunk_header->chunk_type) {
+	case CHUNK_TYPE_RAW:
+		if (chunk_header->total_sz !=
+		    (sparse_header->chunk_hdr_sz + chunk_data_sz))
+			return sparse_stream_fail(ss,
 					"Bogus chunk size for chunk type Raw");
-				return;
-			}
-
-			if (blk + blkcnt > info->start + info->size) {
-				printf(
-				    "%s: Request would exceed partition size!\n",
-				    __func__);
-				fastboot_fail(
-				    "Request would exceed partition size!");
-				return;
-			}
-
-			blks = info->write(info, blk, blkcnt, data);
-			/* blks might be > blkcnt (eg. NAND bad-blocks) */
-			if (blks < blkcnt) {
-				printf("%s: %s" LBAFU " [" LBAFU "]\n",
-				       __func__, "Write failed, block #",
-				       blk, blks);
-				fastboot_fail(
-					      "flash write failure");
-				return;
-			}
-			blk += blks;
-			bytes_written += blkcnt * info->blksz;
-			total_blocks += chunk_header->chunk_sz;
-			data += chunk_data_sz;
-			break;
+		if (sparse_stream_check_size(ss, ss->blk +
+					     ss->buf_len / info->blksz, blkcnt))
+			return -EIO;
+		ss->total_blocks += chunk_header->chunk_sz;
+		ss->data_left = chunk_data_sz;
+		if (chunk_data_sz)
+			ss->state = SPARSE_STREAM_DATA;
+		else
+			sparse_stream_next_chunk(ss);
+		break;
 
-		case CHUNK_TYPE_FILL:
-			if (chunk_header->total_sz !=
-			    (sparse_header->chunk_hdr_sz + sizeof(uint32_t))) {
-				fastboot_fail(
+	case CHUNK_TYPE_FILL:
+		if (chunk_header->total_sz !=
+		    (sparse_header->chunk_hdr_sz + sizeof(uint32_t)))
+			return sparse_stream_fail(ss,
 					"Bogus chunk size for chunk type FILL");
-				return;
-			}
-
-			fill_buf = (uint32_t *)
-				   memalign(ARCH_DMA_MINALIGN,
-					    ROUNDUP(
-						info->blksz * fill_buf_num_blks,
-						ARCH_DMA_MINALIGN));
-			if (!fill_buf) {
-				fastboot_fail(
-					"Malloc failed for: CHUNK_TYPE_FILL");
-				return;
-			}
-
-			fill_val = *(uint32_t *)data;
-			data = (char *)data + sizeof(uint32_t);
-
-			for (i = 0;
-			     i < (info->blksz * fill_buf_num_blks /
-				  sizeof(fill_val));
-			     i++)
-				fill_buf[i] = fill_val;
-
-			if (blk + blkcnt > info->start + info->size) {
-				printf(
-				    "%s: Request would exceed partition size!\n",
-				    __func__);
-				fastboot_fail(
-				    "Request would exceed partition size!");
-				return;
-			}
-
-			for (i = 0; i < blkcnt;) {
-				j = blkcnt - i;
-				if (j > fill_buf_num_blks)
-					j = fill_buf_num_blks;
-				blks = info->write(info, blk, j, fill_buf);
-				/* blks might be > j (eg. NAND bad-blocks) */
-				if (blks < j) {
-					printf("%s: %s " LBAFU " [%d]\n",
-					       __func__,
-					       "Write failed, block #",
-					       blk, j);
-					fastboot_fail(
-						      "flash write failure");
-					free(fill_buf);
-					return;
-				}
-				blk += blks;
-				i += j;
-			}
-			bytes_written += blkcnt * info->blksz;
-			total_blocks += chunk_data_sz / sparse_header->blk_sz;
-			free(fill_buf);
-			break;
+		sparse_stream_want(ss, SPARSE_STREAM_FILL_VAL,
+				   sizeof(uint32_t));
+		break;
 
-		case CHUNK_TYPE_DONT_CARE:
-			blk += info->reserve(info, blk, blkcnt);
-			total_blocks += chunk_header->chunk_sz;
-			break;
+	case CHUNK_TYPE_DONT_CARE:
+		/*
+		 * Never erase these: an image split by the host marks the
+		 * parts written by its other pieces as don't-care
+		 */
+		if (sparse_stream_flush(ss))
+			return -EIO;
+		ss->blk += info->reserve(info, ss->blk, blkcnt);
+		ss->total_blocks += chunk_header->chunk_sz;
+		sparse_stream_next_chunk(ss);
+		break;
 
-		case CHUNK_TYPE_CRC32:
-			if (chunk_header->total_sz !=
-			    sparse_header->chunk_hdr_sz) {
-				fastboot_fail(
-					"Bogus chunk size for chunk type Dont Care");
-				return;
-			}
-			total_blocks += chunk_header->chunk_sz;
-			data += chunk_data_sz;
-			break;
+	case CHUNK_TYPE_CRC32:
+		if (chunk_header->total_sz < sparse_header->chunk_hdr_sz)
+			return sparse_stream_fail(ss,
+				"Bogus chunk size for chunk type CRC32");
+		ss->skip += chunk_header->total_sz -
+			    sparse_header->chunk_hdr_sz;
+		ss->total_blocks += chunk_header->chunk_sz;
+		sparse_stream_next_chunk(ss);
+		break;
+
+	default:
+		printf("%s: Unknown chunk type: %x\n", __func__,
+		       chunk_header->chunk_type);
+		return sparse_stream_fail(ss, "Unknown chunk type");
+	}
+
+	return 0;
+}
+
+/* Write @blkcnt blocks from the fill pattern in ss->buf */
+static int sparse_stream_fill_blocks(struct sparse_stream *ss,
+				     lbaint_t blkcnt)
+{
+	struct sparse_storage *info = ss->info;
+	int fill_buf_num_blks = ss->buf_size / info->blksz;
+	lbaint_t blks, i, j;
+
+	for (i = 0; i < blkcnt;) {
+		j = blkcnt - i;
+		if (j > fill_buf_num_blks)
+			j = fill_buf_num_blks;
+		blks = info->write(info, ss->blk, j, ss->buf);
+		/* blks might be > j (eg. NAND bad-blocks) */
+		if (blks < j) {
+			printf("%s: %s " LBAFU " [" LBAFU "]\n", __func__,
+			       "Write failed, block #", ss->blk, j);
+			return sparse_stream_fail(ss, "flash write failure");
+		}
+		ss->blk += blks;
+		i += j;
+	}
+
+	return 0;
+}
+
+static int sparse_stream_fill(struct sparse_stream *ss)
+{
+	struct sparse_storage *info = ss->info;
+	lbaint_t blkcnt, head, count, i;
+	uint32_t *fill_buf = ss->buf;
+	uint32_t fill_val;
+
+	blkcnt = ss->sparse_header.blk_sz * ss->chunk_header.chunk_sz /
+		 info->blksz;
+	if (sparse_stream_flush(ss) ||
+	    sparse_stream_check_size(ss, ss->blk, blkcnt))
+		return -EIO;
+
+	memcpy(&fill_val, ss->hdr, sizeof(fill_val));
+	for (i = 0; i < ss->buf_size / sizeof(fill_val); i++)
+		fill_buf[i] = fill_val;
+
+	/* Erase the whole erase groups if that gives the same contents */
+	head = blkcnt;
+	count = 0;
+	if (info->erase && fill_val == info->erased_val)
+		sparse_stream_erase_span(ss, ss->blk, blkcnt, &head, &count);
+	if (sparse_stream_fill_blocks(ss, head) ||
+	    sparse_stream_erase(ss, ss->blk, count))
+		return -EIO;
+	ss->blk += count;
+	if (sparse_stream_fill_blocks(ss, blkcnt - head - count))
+		return -EIO;
+	ss->bytes_written += blkcnt * info->blksz;
+	ss->total_blocks += ss->chunk_header.chunk_sz;
+	sparse_stream_next_chunk(ss);
+
+	return 0;
+}
+
+int sparse_stream_start(struct sparse_stream *ss, struct sparse_storage *info)
+{
+	memset(ss, '\0', sizeof(*ss));
+	ss->info = info;
+	ss->blk = info->start;
+	ss->buf_size = CONFIG_FASTBOOT_FLASH_FILLBUF_SIZE;
+	ss->buf_size -= ss->buf_size % info->blksz;
+	if (!ss->buf_size)
+		ss->buf_size = info->blksz;
+	ss->buf = memalign(ARCH_DMA_MINALIGN,
+			   ROUNDUP(ss->buf_size, ARCH_DMA_MINALIGN));
+	if (!ss->buf)
+		return -ENOMEM;
+	sparse_stream_want(ss, SPARSE_STREAM_FILE_HDR, sizeof(sparse_header_t));
+
+	return 0;
+}
+
+int sparse_stream_write(struct sparse_stream *ss, const void *data,
+			unsigned int len)
+{
+	const u8 *ptr = data;
+	unsigned int n;
+	int ret = 0;
+
+	while (len && !ss->err) {
+		if (ss->skip) {
+			n = min(len, ss->skip);
+			ss->skip -= n;
+			ptr += n;
+			len -= n;
+			continue;
+		}
 
+		switch (ss->state) {
+		case SPARSE_STREAM_FILE_HDR:
+		case SPARSE_STREAM_CHUNK_HDR:
+		case SPARSE_STREAM_FILL_VAL:
+			/* Headers may be split across pieces */
+			n = min(len, ss->hdr_size - ss->hdr_len);
+			memcpy(ss->hdr + ss->hdr_len, ptr, n);
+			ss->hdr_len += n;
+			if (ss->hdr_len < ss->hdr_size)
+				break;
+			if (ss->state == SPARSE_STREAM_FILE_HDR)
+				ret = sparse_stream_file_hdr(ss);
+			else if (ss->state == SPARSE_STREAM_CHUNK_HDR)
+				ret = sparse_stream_chunk_hdr(ss);
+			else
+				ret = sparse_stream_fill(ss);
+			break;
+		case SPARSE_STREAM_DATA:
+			n = sparse_stream_data(ss, ptr, len);
+			if (!ss->data_left)
+				sparse_stream_next_chunk(ss);
+			break;
 		default:
-			printf("%s: Unknown chunk type: %x\n", __func__,
-			       chunk_header->chunk_type);
-			fastboot_fail("Unknown chunk type");
-			return;
+			/* Ignore anything after the last chunk */
+			n = len;
+			break;
 		}
+		ptr += n;
+		len -= n;
+	}
+
+	return ss->err ? -EIO : ret;
+}
+
+int sparse_stream_finish(struct sparse_stream *ss, const char *part_name)
+{
+	/* A raw image shorter than a sparse header is still only collected */
+	if (!ss->err && ss->state == SPARSE_STREAM_FILE_HDR && ss->hdr_len) {
+		memcpy(ss->buf, ss->hdr, ss->hdr_len);
+		ss->buf_len = ss->hdr_len;
+		ss->raw_image = true;
+	}
+	if (!ss->err)
+		sparse_stream_flush(ss);
+	free(ss->buf);
+	ss->buf = NULL;
+
+	if (ss->err)
+		return -EIO;
+
+	if (ss->raw_image) {
+		printf("........ wrote %llu bytes to '%s'\n", ss->bytes_written,
+		       part_name);
+		return 0;
 	}
 
 	debug("Wrote %d blocks, expected to write %d blocks\n",
-	      total_blocks, sparse_header->total_blks);
-	printf("........ wrote %u bytes to '%s'\n", bytes_written, part_name);
+	      ss->total_blocks, ss->sparse_header.total_blks);
+	printf("........ wrote %llu bytes to '%s'\n", ss->bytes_written,
+	       part_name);
+	if (ss->bytes_erased)
+		printf("........ erased %llu bytes\n", ss->bytes_erased);
+
+	if (ss->state != SPARSE_STREAM_DONE ||
+	    ss->total_blocks != ss->sparse_header.total_blks) {
+		ss->err = "sparse image write failure";
+		return -EIO;
+	}
 
-	if (total_blocks != sparse_header->total_blks)
-		fastboot_fail("sparse image write failure");
+	return 0;
+}
+
+#ifdef CONFIG_FASTBOOT_FLASH
+void write_sparse_image(
+		struct sparse_storage *info, const char *part_name,
+		void *data, unsigned sz)
+{
+	struct sparse_stream ss;
+
+	if (sparse_stream_start(&ss, info)) {
+		fastboot_fail("Malloc failed for sparse image buffer");
+		return;
+	}
+	sparse_stream_write(&ss, data, sz);
+	if (sparse_stream_finish(&ss, part_name))
+		fastboot_fail(ss.err);
 	else
 		fastboot_okay("");
-
-	return;
 }
+#endif
@@ -0,0 +1,393 @@
+/*
+ * Block-level delta updates from one partition to another
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <environment.h>
+#include <errno.h>
+#include <image.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <update_delta.h>
+#include <watchdog.h>
+#include <asm/unaligned.h>
+#include <u-boot/crc.h>
+
+/**
+ * struct delta_part - One side of an update
+ *
+ * @desc:	Block device
+ * @part:	Partition on it
+ * @mult:	Device blocks per delta block
+ */
+struct delta_part {
+	struct blk_desc *desc;
+	disk_partition_t *part;
+	lbaint_t mult;
+};
+
+static int delta_setup_part(struct delta_part *dp, struct blk_desc *desc,
+			    disk_partition_t *part, uint block_size,
+			    uint blocks)
+{
+	dp->desc = desc;
+	dp->part = part;
+	if (!desc->blksz || block_size % desc->blksz)
+		return -EINVAL;
+	dp->mult = block_size / desc->blksz;
+	if ((u64)blocks * dp->mult > part->size)
+		return -EINVAL;
+
+	return 0;
+}
+
+/* Copy the next operation out of the delta, returning its data */
+static const u8 *delta_next_op(const u8 **pp, const u8 *end,
+			       struct update_delta_op *op)
+{
+	const u8 *data;
+
+	if (end - *pp < sizeof(*op))
+		return NULL;
+	memcpy(op, *pp, sizeof(*op));
+	op->type = le32_to_cpu(op->type);
+	op->blocks = le32_to_cpu(op->blocks);
+	op->src_blk = le32_to_cpu(op->src_blk);
+	op->dst_blk = le32_to_cpu(op->dst_blk);
+	op->data_len = le32_to_cpu(op->data_len);
+	data = *pp + sizeof(*op);
+	if (end - data < op->data_len)
+		return NULL;
+	*pp = data + op->data_len;
+
+	return data;
+}
+
+/* Check that all the operations fit in the delta, the buffer and the parts */
+static int delta_check_ops(const struct update_delta_header *hdr,
+			   const u8 *ptr, const u8 *end)
+{
+	uint block_size = le32_to_cpu(hdr->block_size);
+	uint src_blocks = le32_to_cpu(hdr->src_blocks);
+	uint dst_blocks = le32_to_cpu(hdr->dst_blocks);
+	uint count = le32_to_cpu(hdr->op_count);
+	struct update_delta_op op;
+	u64 bytes;
+	uint i;
+
+	for (i = 0; i < count; i++) {
+		if (!delta_next_op(&ptr, end, &op))
+			return -EINVAL;
+		bytes = (u64)op.blocks * block_size;
+		if (!op.blocks || bytes > CONFIG_UPDATE_DELTA_BUF_SIZE ||
+		    op.blocks > dst_blocks ||
+		    op.dst_blk > dst_blocks - op.blocks)
+			return -EINVAL;
+
+		switch (op.type) {
+		case DELTA_OP_COPY:
+		case DELTA_OP_DIFF:
+			if (op.blocks > src_blocks ||
+			    op.src_blk > src_blocks - op.blocks)
+				return -EINVAL;
+			if (op.type == DELTA_OP_COPY && op.data_len)
+				return -EINVAL;
+			break;
+		case DELTA_OP_DATA:
+			if (op.data_len != bytes)
+				return -EINVAL;
+			break;
+		case DELTA_OP_ZERO:
+			if (op.data_len)
+				return -EINVAL;
+			break;
+		default:
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+/* Add the differences in @data to the source bytes in @buf */
+static int delta_add_diff(u8 *buf, uint bytes, const u8 *data, uint len)
+{
+	const u8 *end = data + len;
+	uint pos = 0, skip, n, i;
+
+	while (data < end) {
+		if (end - data < 8)
+			return -EINVAL;
+		skip = get_unaligned_le32(data);
+		n = get_unaligned_le32(data + 4);
+		data += 8;
+		if (skip > bytes - pos || n > bytes - pos - skip ||
+		    n > end - data)
+			return -EINVAL;
+		pos += skip;
+		for (i = 0; i < n; i++)
+			buf[pos + i] += data[i];
+		pos += n;
+		data += n;
+	}
+
+	return 0;
+}
+
+static int delta_hash_check(const u8 *buf, uint bytes, const u8 *hash)
+{
+	u8 sum[SHA256_SUM_LEN];
+
+	sha256_csum_wd(buf, bytes, sum, CHUNKSZ_SHA256);
+
+	return memcmp(sum, hash, SHA256_SUM_LEN) ? -EILSEQ : 0;
+}
+
+/* Read the source blocks used by @op into @buf */
+static int delta_read_src(struct update_delta_op *op, struct delta_part *src,
+			  u8 *buf)
+{
+	lbaint_t blk = src->part->start + (lbaint_t)op->src_blk * src->mult;
+	lbaint_t cnt = op->blocks * src->mult;
+
+	return blk_dread(src->desc, blk, cnt, buf) == cnt ? 0 : -EIO;
+}
+
+/*
+ * Check the hash of all the source blocks used from operation @first on, so
+ * that a delta for another source writes nothing
+ */
+static int delta_check_src(const u8 *ptr, const u8 *end, uint count,
+			   uint first, uint block_size, struct delta_part *src,
+			   u8 *buf, u64 *read)
+{
+	struct update_delta_op op;
+	uint i;
+	int ret;
+
+	for (i = 0; i < count; i++) {
+		delta_next_op(&ptr, end, &op);
+		if (i < first ||
+		    (op.type != DELTA_OP_COPY && op.type != DELTA_OP_DIFF))
+			continue;
+		WATCHDOG_RESET();
+		ret = delta_read_src(&op, src, buf);
+		if (ret)
+			return ret;
+		*read += op.blocks * block_size;
+		ret = delta_hash_check(buf, op.blocks * block_size,
+				       op.src_hash);
+		if (ret) {
+			printf("Source blocks %u-%u do not match the delta\n",
+			       op.src_blk, op.src_blk + op.blocks - 1);
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+static int delta_apply_op(struct update_delta_op *op, const u8 *data,
+			  uint block_size, struct delta_part *src,
+			  struct delta_part *dst, u8 *buf)
+{
+	uint bytes = op->blocks * block_size;
+	lbaint_t blk, cnt;
+	int ret;
+
+	switch (op->type) {
+	case DELTA_OP_COPY:
+	case DELTA_OP_DIFF:
+		/*
+		 * delta_check_src() checked these blocks and they cannot have
+		 * changed, since the source does not overlap the target. The
+		 * target hash below still covers what is made from them.
+		 */
+		ret = delta_read_src(op, src, buf);
+		if (ret)
+			return ret;
+		if (op->type == DELTA_OP_DIFF) {
+			ret = delta_add_diff(buf, bytes, data, op->data_len);
+			if (ret)
+				return ret;
+		}
+		break;
+	case DELTA_OP_DATA:
+		memcpy(buf, data, bytes);
+		break;
+	case DELTA_OP_ZERO:
+		memset(buf, '\0', bytes);
+		break;
+	}
+
+	ret = delta_hash_check(buf, bytes, op->dst_hash);
+	if (ret) {
+		printf("Target blocks %u-%u do not match their hash\n",
+		       op->dst_blk, op->dst_blk + op->blocks - 1);
+		return ret;
+	}
+
+	blk = dst->part->start + (lbaint_t)op->dst_blk * dst->mult;
+	cnt = op->blocks * dst->mult;
+	if (blk_dwrite(dst->desc, blk, cnt, buf) != cnt)
+		return -EIO;
+
+	return 0;
+}
+
+/* Find the first operation to apply, from the progress of an earlier try */
+static uint delta_get_progress(u32 id)
+{
+	const char *val = env_get(UPDATE_DELTA_PROGRESS_ENV);
+	char *end;
+
+	if (!val || simple_strtoul(val, &end, 16) != id || *end != ':')
+		return 0;
+
+	return simple_strtoul(end + 1, NULL, 10);
+}
+
+static int delta_set_progress(u32 id, uint next)
+{
+	char val[20];
+
+	/* Nothing to clear if progress was never saved */
+	if (!next && !env_get(UPDATE_DELTA_PROGRESS_ENV))
+		return 0;
+	if (next) {
+		snprintf(val, sizeof(val), "%08x:%u", id, next);
+		env_set(UPDATE_DELTA_PROGRESS_ENV, val);
+	} else {
+		env_set(UPDATE_DELTA_PROGRESS_ENV, NULL);
+	}
+
+	return env_save();
+}
+
+int update_delta_apply(const void *delta, size_t size,
+		       struct blk_desc *src_desc, disk_partition_t *src,
+		       struct blk_desc *dst_desc, disk_partition_t *dst)
+{
+	const struct update_delta_header *hdr = delta;
+	const u8 *ptr = delta + sizeof(*hdr);
+	const u8 *end = delta + size;
+	struct delta_part src_part, dst_part;
+	struct update_delta_op op;
+	uint block_size, count, first, i;
+	u64 read = 0, written = 0;
+	bool saved = true;
+	const u8 *data;
+	u8 *buf;
+	u32 id;
+	int ret;
+
+	if (size < sizeof(*hdr) ||
+	    le32_to_cpu(hdr->magic) != UPDATE_DELTA_MAGIC ||
+	    le32_to_cpu(hdr->version) != UPDATE_DELTA_VERSION) {
+		printf("Not a delta\n");
+		return -EINVAL;
+	}
+	block_size = le32_to_cpu(hdr->block_size);
+	count = le32_to_cpu(hdr->op_count);
+
+	/* The source must stay as it is for the update to be restartable */
+	if (src_desc == dst_desc && src->start < dst->start + dst->size &&
+	    dst->start < src->start + src->size) {
+		printf("Source and target partitions overlap\n");
+		return -EINVAL;
+	}
+	if (!block_size ||
+	    delta_setup_part(&src_part, src_desc, src, block_size,
+			     le32_to_cpu(hdr->src_blocks)) ||
+	    delta_setup_part(&dst_part, dst_desc, dst, block_size,
+			     le32_to_cpu(hdr->dst_blocks))) {
+		printf("Delta does not fit the partitions\n");
+		return -EINVAL;
+	}
+	if (delta_check_ops(hdr, ptr, end)) {
+		printf("Delta is corrupted\n");
+		return -EINVAL;
+	}
+
+	buf = memalign(ARCH_DMA_MINALIGN, CONFIG_UPDATE_DELTA_BUF_SIZE);
+	if (!buf)
+		return -ENOMEM;
+
+	id = crc32(0, delta, size);
+	first = delta_get_progress(id);
+	if (first)
+		printf("Resuming delta update at operation %u of %u\n", first,
+		       count);
+
+	ret = delta_check_src(ptr, end, count, first, block_size, &src_part,
+			      buf, &read);
+	if (ret)
+		goto out;
+
+	for (i = 0; i < count; i++) {
+		data = delta_next_op(&ptr, end, &op);
+		if (i < first)
+			continue;
+		WATCHDOG_RESET();
+		ret = delta_apply_op(&op, data, block_size, &src_part,
+				     &dst_part, buf);
+		if (ret) {
+			printf("Delta operation %u failed (err=%d)\n", i, ret);
+			goto out;
+		}
+		written += op.blocks * block_size;
+
+		if ((i + 1) % CONFIG_UPDATE_DELTA_SAVE_INTERVAL == 0 &&
+		    i + 1 < count && saved && delta_set_progress(id, i + 1)) {
+			printf("Warning: cannot save update progress\n");
+			saved = false;
+		}
+	}
+
+	if (delta_set_progress(id, 0) && saved)
+		printf("Warning: cannot clear progress\n");
+	printf("Delta applied: read %llu bytes, wrote %llu bytes\n", read,
+	       written);
+	ret = 0;
+out:
+	free(buf);
+
+	return ret;
+}
+
+int update_delta_fit(ulong addr, const char *name, const char *ifname,
+		     const char *src_str, const char *dst_str)
+{
+	struct blk_desc *src_desc, *dst_desc;
+	disk_partition_t src, dst;
+	const void *data;
+	size_t size;
+	void *fit;
+	int noffset;
+
+	fit = map_sysmem(addr, 0);
+	if (!fit_check_format(fit)) {
+		printf("Bad FIT format of the update file\n");
+		return -EINVAL;
+	}
+	noffset = fit_image_get_node(fit, name);
+	if (noffset < 0) {
+		printf("Can't find image '%s'\n", name);
+		return -ENOENT;
+	}
+	if (!fit_image_verify(fit, noffset)) {
+		printf("Invalid hash of image '%s'\n", name);
+		return -EILSEQ;
+	}
+	if (fit_image_get_data(fit, noffset, &data, &size))
+		return -EINVAL;
+
+	if (blk_get_device_part_str(ifname, src_str, &src_desc, &src, 1) < 0 ||
+	    blk_get_device_part_str(ifname, dst_str, &dst_desc, &dst, 1) < 0)
+		return -ENODEV;
+
+	return update_delta_apply(data, size, src_desc, &src, dst_desc, &dst);
+}
@@ -184,6 +184,44 @@ int usb_disable_asynch(int disable)
 	asynch_allowed = !disable;
 	return old_value;
 }
+
+/*
+ * Without driver model no host controller queues bulk transfers, so each
+ * request is run when it is waited for
+ */
+int usb_submit_bulk(struct usb_device *dev, struct usb_bulk_req *req)
+{
+	req->actual = 0;
+	req->status = -EINPROGRESS;
+	req->done = false;
+
+	return 0;
+}
+
+int usb_poll_bulk(struct usb_device *dev)
+{
+	return 0;
+}
+
+int usb_wait_bulk(struct usb_device *dev, struct usb_bulk_req *req,
+		  int timeout)
+{
+	if (!req->done)
+		return usb_bulk_req_sync(dev, req, timeout);
+
+	return req->status;
+}
+
+int usb_cancel_bulk(struct usb_device *dev, unsigned long pipe)
+{
+	return 0;
+}
+
+int usb_alloc_streams(struct usb_device *dev, unsigned long *pipes,
+		      int num_pipes, int num_streams)
+{
+	return -ENOSYS;
+}
 #endif /* !CONFIG_DM_USB */
 
 
@@ -282,6 +320,21 @@ int usb_bulk_msg(struct usb_device *dev, unsigned int pipe,
 		return -EIO;
 }
 
+int usb_bulk_req_sync(struct usb_device *dev, struct usb_bulk_req *req,
+		      int timeout)
+{
+	int ret;
+
+	ret = usb_bulk_msg(dev, req->pipe, req->buffer, req->length,
+			   &req->actual, timeout);
+	if (ret && (dev->status & USB_ST_STALLED))
+		ret = -EPIPE;
+	req->status = ret;
+	req->done = true;
+
+	return ret;
+}
+
 
 /*-------------------------------------------------------------------
  * Max Packet stuff
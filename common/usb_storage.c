@@ -58,7 +58,7 @@
 static const unsigned char us_direction[256/8] = {
 	0x28, 0x81, 0x14, 0x14, 0x20, 0x01, 0x90, 0x77,
 	0x0C, 0x20, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00,
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x01,
+	0x00, 0x01, 0x00, 0x40, 0x00, 0x01, 0x00, 0x01,
 	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
 };
 #define US_DIRECTION(x) ((us_direction[x>>3] >> (x & 7)) & 1)
@@ -99,6 +99,12 @@ struct us_data {
 	trans_reset	transport_reset;	/* reset routine */
 	trans_cmnd	transport;		/* transport routine */
 	unsigned short	max_xfer_blk;		/* maximum transfer blocks */
+	bool		cmd16;			/* use READ(16)/WRITE(16) */
+#ifdef CONFIG_USB_UAS
+	unsigned char	ep_cmd;			/* UAS command pipe */
+	unsigned char	ep_status;		/* UAS status pipe */
+	bool		uas_streams;		/* UAS uses bulk streams */
+#endif
 };
 
 #ifndef CONFIG_BLK
@@ -109,6 +115,9 @@ static struct us_data usb_stor[USB_MAX_STOR_DEV];
 #define USB_STOR_TRANSPORT_FAILED -1
 #define USB_STOR_TRANSPORT_ERROR  -2
 
+/* Timeout for the data phase of a queued read or write, in ms */
+#define USB_STOR_DATA_TIMEOUT	5000
+
 int usb_stor_get_info(struct usb_device *dev, struct us_data *us,
 		      struct blk_desc *dev_desc);
 int usb_storage_probe(struct usb_device *dev, unsigned int ifnum,
@@ -173,6 +182,10 @@ static unsigned int usb_get_max_lun(struct us_data *us)
 {
 	int len;
 	ALLOC_CACHE_ALIGN_BUFFER(unsigned char, result, 1);
+
+	/* GET MAX LUN is a bulk-only request */
+	if (us->protocol == US_PR_UAS)
+		return 0;
 	len = usb_control_msg(us->pusb_dev,
 			      usb_rcvctrlpipe(us->pusb_dev, 0),
 			      US_BBB_GET_MAX_LUN,
@@ -531,13 +544,11 @@ static int usb_stor_CB_reset(struct us_data *us)
  * Set up the command for a BBB device. Note that the actual SCSI
  * command is copied into cbw.CBWCDB.
  */
-static int usb_stor_BBB_comdat(struct scsi_cmd *srb, struct us_data *us)
+static int usb_stor_BBB_fill_cbw(struct scsi_cmd *srb, struct us_data *us,
+				 struct umass_bbb_cbw *cbw)
 {
-	int result;
-	int actlen;
 	int dir_in;
-	unsigned int pipe;
-	ALLOC_CACHE_ALIGN_BUFFER(struct umass_bbb_cbw, cbw, 1);
+	int __maybe_unused result;
 
 	dir_in = US_DIRECTION(srb->cmd[0]);
 
@@ -557,9 +568,6 @@ static int usb_stor_BBB_comdat(struct scsi_cmd *srb, struct us_data *us)
 		return -1;
 	}
 
-	/* always OUT to the ep */
-	pipe = usb_sndbulkpipe(us->pusb_dev, us->ep_out);
-
 	cbw->dCBWSignature = cpu_to_le32(CBWSIGNATURE);
 	cbw->dCBWTag = cpu_to_le32(CBWTag++);
 	cbw->dCBWDataTransferLength = cpu_to_le32(srb->datalen);
@@ -570,6 +578,22 @@ static int usb_stor_BBB_comdat(struct scsi_cmd *srb, struct us_data *us)
 	/* DST SRC LEN!!! */
 
 	memcpy(cbw->CBWCDB, srb->cmd, srb->cmdlen);
+
+	return 0;
+}
+
+static int usb_stor_BBB_comdat(struct scsi_cmd *srb, struct us_data *us)
+{
+	int result;
+	int actlen;
+	unsigned int pipe;
+	ALLOC_CACHE_ALIGN_BUFFER(struct umass_bbb_cbw, cbw, 1);
+
+	if (usb_stor_BBB_fill_cbw(srb, us, cbw))
+		return -1;
+
+	/* always OUT to the ep */
+	pipe = usb_sndbulkpipe(us->pusb_dev, us->ep_out);
 	result = usb_bulk_msg(us->pusb_dev, pipe, cbw, UMASS_BBB_CBW_SIZE,
 			      &actlen, USB_CNTL_TIMEOUT * 5);
 	if (result < 0)
@@ -704,6 +728,100 @@ static int usb_stor_BBB_clear_endpt_stall(struct us_data *us, __u8 endpt)
 			       endpt, NULL, 0, USB_CNTL_TIMEOUT * 5);
 }
 
+static bool usb_stor_is_rw(struct scsi_cmd *srb)
+{
+	switch (srb->cmd[0]) {
+	case SCSI_READ10:
+	case SCSI_WRITE10:
+	case SCSI_READ16:
+	case SCSI_WRITE16:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+ * Allow 1ms per KiB on top of the fixed timeout, so that a large transfer
+ * to a slow device (down to 1MiB/s) still completes
+ */
+static int usb_stor_data_timeout(unsigned long len)
+{
+	return USB_STOR_DATA_TIMEOUT + len / 1024;
+}
+
+/*
+ * Queue the command, data and status phases of a read or write together,
+ * so that the host controller can run them back to back.
+ *
+ * Returns 0 if the CSW was received, 1 if the data phase finished but the
+ * CSW still needs to be read and -ve if the transport must be reset.
+ */
+static int usb_stor_BBB_queued(struct scsi_cmd *srb, struct us_data *us,
+			       struct umass_bbb_csw *csw, int *data_actlen)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(struct umass_bbb_cbw, cbw, 1);
+	struct usb_device *udev = us->pusb_dev;
+	struct usb_bulk_req cbw_req, data_req, csw_req;
+	unsigned int pipein, pipeout;
+	int dir_in;
+	int ret;
+
+	if (usb_stor_BBB_fill_cbw(srb, us, cbw))
+		return -EINVAL;
+	dir_in = US_DIRECTION(srb->cmd[0]);
+	pipein = usb_rcvbulkpipe(udev, us->ep_in);
+	pipeout = usb_sndbulkpipe(udev, us->ep_out);
+
+	memset(&cbw_req, '\0', sizeof(cbw_req));
+	memset(&data_req, '\0', sizeof(data_req));
+	memset(&csw_req, '\0', sizeof(csw_req));
+	cbw_req.pipe = pipeout;
+	cbw_req.buffer = cbw;
+	cbw_req.length = UMASS_BBB_CBW_SIZE;
+	data_req.pipe = dir_in ? pipein : pipeout;
+	data_req.buffer = srb->pdata;
+	data_req.length = srb->datalen;
+	csw_req.pipe = pipein;
+	csw_req.buffer = csw;
+	csw_req.length = UMASS_BBB_CSW_SIZE;
+
+	ret = usb_submit_bulk(udev, &cbw_req);
+	if (!ret)
+		ret = usb_submit_bulk(udev, &data_req);
+	if (!ret)
+		ret = usb_submit_bulk(udev, &csw_req);
+	if (!ret)
+		ret = usb_wait_bulk(udev, &cbw_req, USB_CNTL_TIMEOUT * 5);
+	if (ret) {
+		debug("CBW failed %d\n", ret);
+		goto err;
+	}
+
+	ret = usb_wait_bulk(udev, &data_req,
+			    usb_stor_data_timeout(srb->datalen));
+	*data_actlen = data_req.actual;
+	if (ret == -EPIPE) {
+		debug("DATA:stall\n");
+		/* the CSW follows once the STALL is cleared */
+		ret = usb_stor_BBB_clear_endpt_stall(us, dir_in ? us->ep_in :
+						     us->ep_out);
+	}
+	if (ret < 0) {
+		debug("DATA failed %d\n", ret);
+		goto err;
+	}
+
+	/* if this failed, the status phase is done again without queueing */
+	return usb_wait_bulk(udev, &csw_req, USB_CNTL_TIMEOUT * 5) ? 1 : 0;
+
+err:
+	usb_cancel_bulk(udev, pipeout);
+	usb_cancel_bulk(udev, pipein);
+
+	return ret;
+}
+
 static int usb_stor_BBB_transport(struct scsi_cmd *srb, struct us_data *us)
 {
 	int result, retry;
@@ -717,6 +835,24 @@ static int usb_stor_BBB_transport(struct scsi_cmd *srb, struct us_data *us)
 #endif
 
 	dir_in = US_DIRECTION(srb->cmd[0]);
+	pipein = usb_rcvbulkpipe(us->pusb_dev, us->ep_in);
+	pipeout = usb_sndbulkpipe(us->pusb_dev, us->ep_out);
+
+	/*
+	 * Reads and writes queue all their phases at once, unless the device
+	 * is not ready yet and needs a pause between command and data
+	 */
+	if (srb->datalen && usb_stor_is_rw(srb) && (us->flags & USB_READY)) {
+		data_actlen = 0;
+		result = usb_stor_BBB_queued(srb, us, csw, &data_actlen);
+		if (result < 0) {
+			usb_stor_BBB_reset(us);
+			return USB_STOR_TRANSPORT_FAILED;
+		}
+		if (result)
+			goto st;
+		goto check;
+	}
 
 	/* COMMAND phase */
 	debug("COMMAND phase\n");
@@ -729,8 +865,6 @@ static int usb_stor_BBB_transport(struct scsi_cmd *srb, struct us_data *us)
 	}
 	if (!(us->flags & USB_READY))
 		mdelay(5);
-	pipein = usb_rcvbulkpipe(us->pusb_dev, us->ep_in);
-	pipeout = usb_sndbulkpipe(us->pusb_dev, us->ep_out);
 	/* DATA phase + error handling */
 	data_actlen = 0;
 	/* no data, go immediately to the STATUS phase */
@@ -795,6 +929,7 @@ again:
 		printf("ptr[%d] %#x ", index, ptr[index]);
 	printf("\n");
 #endif
+check:
 	/* misuse pipe to get the residue */
 	pipe = le32_to_cpu(csw->dCSWDataResidue);
 	if (pipe == 0 && srb->datalen != 0 && srb->datalen - data_actlen != 0)
@@ -939,6 +1074,429 @@ do_retry:
 	return USB_STOR_TRANSPORT_FAILED;
 }
 
+#ifdef CONFIG_USB_UAS
+/* Commands that may be queued on a UAS device at once, tags 1 to this */
+#define USB_UAS_TAGS	4
+/* Tag for task management functions */
+#define USB_UAS_TMF_TAG	(USB_UAS_TAGS + 1)
+
+/**
+ * struct usb_uas_cmd - a queued UAS command
+ *
+ * @iu:		Buffer for its status IU, when using streams
+ * @srb:	SCSI command, NULL if the tag is free
+ * @status:	Transfer reading @iu, when using streams
+ * @data:	Data transfer, already done if there is none
+ */
+struct usb_uas_cmd {
+	struct uas_sense_iu iu __aligned(ARCH_DMA_MINALIGN);
+	struct scsi_cmd *srb;
+	struct usb_bulk_req status;
+	struct usb_bulk_req data;
+};
+
+/**
+ * struct usb_uas_queue - the UAS commands in flight
+ *
+ * Without streams every IU comes through one transfer on the status pipe.
+ *
+ * @iu:		Buffer for the next IU, without streams
+ * @cmds:	Commands, indexed by tag - 1
+ * @status:	Transfer reading @iu, without streams
+ * @status_queued: true if @status has been submitted and not waited for
+ */
+struct usb_uas_queue {
+	struct uas_sense_iu iu __aligned(ARCH_DMA_MINALIGN);
+	struct usb_uas_cmd cmds[USB_UAS_TAGS];
+	struct usb_bulk_req status;
+	bool status_queued;
+};
+
+/* Queue a transfer, on the stream for @tag if the device uses streams */
+static int usb_stor_uas_submit(struct us_data *us, struct usb_bulk_req *req,
+			       unsigned long pipe, int tag, void *buf, int len)
+{
+	memset(req, '\0', sizeof(*req));
+	req->pipe = pipe;
+	req->stream = us->uas_streams ? tag : 0;
+	req->buffer = buf;
+	req->length = len;
+
+	return usb_submit_bulk(us->pusb_dev, req);
+}
+
+/*
+ * Send the command IU for a SCSI command. With streams, the transfers for
+ * its data and status are queued first so that they are ready as soon as
+ * the device picks the command.
+ */
+static int usb_stor_uas_send(struct us_data *us, struct usb_uas_queue *q,
+			     struct scsi_cmd *srb, int tag)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(struct uas_cmd_iu, iu, 1);
+	struct usb_device *udev = us->pusb_dev;
+	struct usb_uas_cmd *cmd = &q->cmds[tag - 1];
+	unsigned long pipe;
+	int actlen;
+
+	memset(&cmd->data, '\0', sizeof(cmd->data));
+	cmd->data.done = true;
+	if (us->uas_streams) {
+		if (US_DIRECTION(srb->cmd[0]))
+			pipe = usb_rcvbulkpipe(udev, us->ep_in);
+		else
+			pipe = usb_sndbulkpipe(udev, us->ep_out);
+		if (usb_stor_uas_submit(us, &cmd->status,
+					usb_rcvbulkpipe(udev, us->ep_status),
+					tag, &cmd->iu, sizeof(cmd->iu)))
+			return -EIO;
+		if (srb->datalen &&
+		    usb_stor_uas_submit(us, &cmd->data, pipe, tag, srb->pdata,
+					srb->datalen))
+			return -EIO;
+	}
+
+	memset(iu, '\0', sizeof(*iu));
+	iu->iu_id = UAS_IU_COMMAND;
+	iu->tag = cpu_to_be16(tag);
+	iu->lun[1] = srb->lun;
+	memcpy(iu->cdb, srb->cmd, min_t(int, srb->cmdlen, sizeof(iu->cdb)));
+	if (usb_bulk_msg(udev, usb_sndbulkpipe(udev, us->ep_cmd), iu,
+			 sizeof(*iu), &actlen, USB_CNTL_TIMEOUT * 5) < 0)
+		return -EIO;
+	cmd->srb = srb;
+
+	return 0;
+}
+
+/*
+ * Wait until the status of a queued command arrives on its stream. A failed
+ * data transfer means that its status will not come.
+ */
+static int usb_stor_uas_wait_streams(struct us_data *us,
+				     struct usb_uas_queue *q)
+{
+	struct usb_uas_cmd *cmd;
+	unsigned long len = 0;
+	ulong start;
+	int tag;
+
+	for (tag = 1; tag <= USB_UAS_TAGS; tag++) {
+		if (q->cmds[tag - 1].srb)
+			len += q->cmds[tag - 1].srb->datalen;
+	}
+	start = get_timer(0);
+	for (;;) {
+		for (tag = 1; tag <= USB_UAS_TAGS; tag++) {
+			cmd = &q->cmds[tag - 1];
+			if (!cmd->srb)
+				continue;
+			if (cmd->data.done && cmd->data.status < 0)
+				return -EIO;
+			if (cmd->status.done)
+				return tag;
+		}
+		if (usb_poll_bulk(us->pusb_dev) < 0 ||
+		    get_timer(start) > usb_stor_data_timeout(len))
+			return -EIO;
+	}
+}
+
+/**
+ * usb_stor_uas_service() - handle the next IU from the status pipe
+ *
+ * Without streams, the device tells us which queued command it wants to
+ * move data for next with a READ READY or WRITE READY IU. The data is moved
+ * with the read of the following IU already queued, so that it arrives as
+ * soon as the device sends it. With streams, the data and status of each
+ * command were queued on its stream when it was sent, so this just waits
+ * for one of them to finish.
+ *
+ * @us:		Storage device
+ * @q:		Queued commands; the command which finished is removed
+ * @statusp:	Returns USB_STOR_TRANSPORT_GOOD or _FAILED for the command
+ *		which finished
+ * @return tag of the command which finished, 0 if data was transferred,
+ *	-ve on transport error
+ */
+static int usb_stor_uas_service(struct us_data *us, struct usb_uas_queue *q,
+				int *statusp)
+{
+	struct usb_device *udev = us->pusb_dev;
+	unsigned long status_pipe = usb_rcvbulkpipe(udev, us->ep_status);
+	struct uas_sense_iu *iu = &q->iu;
+	struct usb_bulk_req *req = &q->status;
+	struct usb_uas_cmd *cmd;
+	struct scsi_cmd *srb;
+	unsigned long pipe;
+	int len;
+	int tag;
+
+	if (us->uas_streams) {
+		tag = usb_stor_uas_wait_streams(us, q);
+		if (tag < 0)
+			return tag;
+		iu = &q->cmds[tag - 1].iu;
+		req = &q->cmds[tag - 1].status;
+	} else if (!q->status_queued &&
+		   usb_stor_uas_submit(us, req, status_pipe, 0, iu,
+				       sizeof(*iu))) {
+		return -EIO;
+	}
+	q->status_queued = false;
+	if (usb_wait_bulk(udev, req, USB_CNTL_TIMEOUT * 5) < 0 ||
+	    req->actual < sizeof(struct uas_iu_header))
+		return -EIO;
+
+	tag = be16_to_cpu(iu->tag);
+	if (tag < 1 || tag > USB_UAS_TAGS || !q->cmds[tag - 1].srb) {
+		debug("UAS: IU %x for unknown tag %d\n", iu->iu_id, tag);
+		return -EIO;
+	}
+	cmd = &q->cmds[tag - 1];
+	srb = cmd->srb;
+
+	switch (iu->iu_id) {
+	case UAS_IU_READ_READY:
+	case UAS_IU_WRITE_READY:
+		if (us->uas_streams)
+			return -EIO;
+		if (iu->iu_id == UAS_IU_READ_READY)
+			pipe = usb_rcvbulkpipe(udev, us->ep_in);
+		else
+			pipe = usb_sndbulkpipe(udev, us->ep_out);
+		if (usb_stor_uas_submit(us, &cmd->data, pipe, 0, srb->pdata,
+					srb->datalen) ||
+		    usb_stor_uas_submit(us, req, status_pipe, 0, iu,
+					sizeof(*iu)))
+			return -EIO;
+		q->status_queued = true;
+		if (usb_wait_bulk(udev, &cmd->data,
+				  usb_stor_data_timeout(srb->datalen)) < 0)
+			return -EIO;
+		return 0;
+	case UAS_IU_SENSE:
+		/*
+		 * The data comes before the status, so this should be done.
+		 * A command which failed may have skipped it, though, leaving
+		 * the transfer queued on its stream.
+		 */
+		if (!cmd->data.done && iu->status)
+			return -EIO;
+		if (usb_wait_bulk(udev, &cmd->data,
+				  usb_stor_data_timeout(srb->datalen)) < 0)
+			return -EIO;
+		*statusp = USB_STOR_TRANSPORT_GOOD;
+		if (iu->status) {
+			/* Keep the sense data for usb_request_sense() */
+			len = min_t(int, be16_to_cpu(iu->len),
+				    sizeof(srb->sense_buf));
+			memset(srb->sense_buf, '\0', sizeof(srb->sense_buf));
+			memcpy(srb->sense_buf, iu->sense, len);
+			*statusp = USB_STOR_TRANSPORT_FAILED;
+		}
+		cmd->srb = NULL;
+		return tag;
+	default:
+		debug("UAS: IU %x for tag %d\n", iu->iu_id, tag);
+		/* Its data transfer cannot be reused while it is queued */
+		if (!cmd->data.done)
+			return -EIO;
+		*statusp = USB_STOR_TRANSPORT_FAILED;
+		cmd->srb = NULL;
+		return tag;
+	}
+}
+
+/**
+ * usb_stor_uas_reset() - abort all the commands queued on a logical unit
+ *
+ * After a transport error the commands still queued may carry on, so their
+ * tags and buffers cannot be used again until the device has dropped them.
+ * A LOGICAL UNIT RESET task management function does that. Its response
+ * follows any sense IUs of the commands being aborted, or comes on its own
+ * stream when using streams. The transfers queued by the host are
+ * cancelled first.
+ *
+ * @us:		Storage device
+ * @lun:	Logical unit to reset
+ * @return 0 if OK, -ve on error
+ */
+static int usb_stor_uas_reset(struct us_data *us, int lun)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(struct uas_task_mgmt_iu, tmf, 1);
+	ALLOC_CACHE_ALIGN_BUFFER(struct uas_sense_iu, iu, 1);
+	struct usb_device *udev = us->pusb_dev;
+	struct uas_response_iu *resp = (struct uas_response_iu *)iu;
+	struct usb_bulk_req req;
+	int tag = USB_UAS_TMF_TAG;
+	int actlen, i;
+
+	usb_cancel_bulk(udev, usb_rcvbulkpipe(udev, us->ep_status));
+	usb_cancel_bulk(udev, usb_rcvbulkpipe(udev, us->ep_in));
+	usb_cancel_bulk(udev, usb_sndbulkpipe(udev, us->ep_out));
+	usb_clear_halt(udev, usb_sndbulkpipe(udev, us->ep_cmd));
+	usb_clear_halt(udev, usb_rcvbulkpipe(udev, us->ep_status));
+	usb_clear_halt(udev, usb_rcvbulkpipe(udev, us->ep_in));
+	usb_clear_halt(udev, usb_sndbulkpipe(udev, us->ep_out));
+
+	memset(tmf, '\0', sizeof(*tmf));
+	tmf->iu_id = UAS_IU_TASK_MGMT;
+	tmf->tag = cpu_to_be16(tag);
+	tmf->function = UAS_TMF_LOGICAL_UNIT_RESET;
+	tmf->lun[1] = lun;
+	if (usb_bulk_msg(udev, usb_sndbulkpipe(udev, us->ep_cmd), tmf,
+			 sizeof(*tmf), &actlen, USB_CNTL_TIMEOUT * 5) < 0)
+		return -EIO;
+
+	for (i = 0; i <= USB_UAS_TAGS; i++) {
+		if (usb_stor_uas_submit(us, &req,
+					usb_rcvbulkpipe(udev, us->ep_status),
+					tag, iu, sizeof(*iu)) ||
+		    usb_wait_bulk(udev, &req, USB_CNTL_TIMEOUT * 5) < 0)
+			return -EIO;
+		if (req.actual < sizeof(*resp) ||
+		    resp->iu_id != UAS_IU_RESPONSE ||
+		    be16_to_cpu(resp->tag) != tag)
+			continue;
+		if (resp->response_code != UAS_RC_TMF_COMPLETE &&
+		    resp->response_code != UAS_RC_TMF_SUCCEEDED)
+			return -EIO;
+		return 0;
+	}
+
+	return -ETIMEDOUT;
+}
+
+static int usb_stor_UAS_transport(struct scsi_cmd *srb, struct us_data *us)
+{
+	struct usb_uas_queue q;
+	int status;
+	int tag;
+
+	memset(&q, '\0', sizeof(q));
+	if (usb_stor_uas_send(us, &q, srb, 1) < 0)
+		goto err;
+	do {
+		tag = usb_stor_uas_service(us, &q, &status);
+		if (tag < 0)
+			goto err;
+	} while (!tag);
+
+	return status;
+
+err:
+	usb_stor_uas_reset(us, srb->lun);
+
+	return USB_STOR_TRANSPORT_ERROR;
+}
+
+/**
+ * usb_stor_uas_probe() - switch to the UAS alternate setting if there is one
+ *
+ * UAS devices offer it as an alternate setting of the bulk-only interface.
+ * Its endpoints are identified by the pipe usage descriptors that follow
+ * them, which are not kept by the USB core, so the configuration
+ * descriptor is read again here.
+ *
+ * At SuperSpeed the status and data of each command move on the bulk
+ * stream matching its tag, so the host controller must be able to set up
+ * streams. If it cannot, the device is left using bulk-only transport.
+ *
+ * @dev:	USB device
+ * @iface:	Mass storage interface
+ * @us:		Storage device, updated with the UAS endpoints
+ * @return 0 if switched to UAS, -ve if not
+ */
+static int usb_stor_uas_probe(struct usb_device *dev,
+			      struct usb_interface *iface, struct us_data *us)
+{
+	struct usb_interface_descriptor *idesc;
+	struct usb_pipe_usage_descriptor *pdesc;
+	unsigned char pipes[UAS_PIPE_DATA_OUT + 1] = { 0 };
+	unsigned long stream_pipes[3];
+	unsigned char ep = 0;
+	int alt = -1;
+	bool in_uas = false;
+	u8 *buf;
+	int len, pos;
+	int ret;
+
+	len = usb_get_configuration_len(dev, 0);
+	if (len < 0)
+		return len;
+	buf = malloc_cache_aligned(len);
+	if (!buf)
+		return -ENOMEM;
+	ret = usb_get_configuration_no(dev, 0, buf, len);
+	if (ret < 0)
+		goto out;
+	len = ret;
+
+	for (pos = 0; pos + 2 < len && buf[pos]; pos += buf[pos]) {
+		switch (buf[pos + 1]) {
+		case USB_DT_INTERFACE:
+			idesc = (struct usb_interface_descriptor *)&buf[pos];
+			in_uas = idesc->bInterfaceNumber ==
+					iface->desc.bInterfaceNumber &&
+				 idesc->bInterfaceClass ==
+					USB_CLASS_MASS_STORAGE &&
+				 idesc->bInterfaceProtocol == US_PR_UAS;
+			if (in_uas)
+				alt = idesc->bAlternateSetting;
+			break;
+		case USB_DT_ENDPOINT:
+			ep = buf[pos + 2] & USB_ENDPOINT_NUMBER_MASK;
+			break;
+		case USB_DT_PIPE_USAGE:
+			pdesc = (struct usb_pipe_usage_descriptor *)&buf[pos];
+			if (in_uas && pdesc->bPipeID <= UAS_PIPE_DATA_OUT)
+				pipes[pdesc->bPipeID] = ep;
+			break;
+		}
+	}
+
+	ret = -ENOENT;
+	if (alt < 0 || !pipes[UAS_PIPE_CMD] || !pipes[UAS_PIPE_STATUS] ||
+	    !pipes[UAS_PIPE_DATA_IN] || !pipes[UAS_PIPE_DATA_OUT])
+		goto out;
+
+	ret = usb_set_interface(dev, iface->desc.bInterfaceNumber, alt);
+	if (ret)
+		goto out;
+	us->uas_streams = dev->speed == USB_SPEED_SUPER;
+	if (us->uas_streams) {
+		stream_pipes[0] = usb_rcvbulkpipe(dev, pipes[UAS_PIPE_STATUS]);
+		stream_pipes[1] = usb_rcvbulkpipe(dev, pipes[UAS_PIPE_DATA_IN]);
+		stream_pipes[2] = usb_sndbulkpipe(dev,
+						  pipes[UAS_PIPE_DATA_OUT]);
+		ret = usb_alloc_streams(dev, stream_pipes,
+					ARRAY_SIZE(stream_pipes),
+					USB_UAS_TMF_TAG);
+		if (ret < USB_UAS_TMF_TAG) {
+			debug("UAS: cannot set up streams, ret=%d\n", ret);
+			usb_set_interface(dev, iface->desc.bInterfaceNumber, 0);
+			ret = -EPROTONOSUPPORT;
+			goto out;
+		}
+		ret = 0;
+	}
+	us->ep_cmd = pipes[UAS_PIPE_CMD];
+	us->ep_status = pipes[UAS_PIPE_STATUS];
+	us->ep_in = pipes[UAS_PIPE_DATA_IN];
+	us->ep_out = pipes[UAS_PIPE_DATA_OUT];
+	us->protocol = US_PR_UAS;
+	us->transport = usb_stor_UAS_transport;
+	debug("UAS: alt %d, endpoints cmd %d status %d in %d out %d%s\n",
+	      alt, us->ep_cmd, us->ep_status, us->ep_in, us->ep_out,
+	      us->uas_streams ? ", streams" : "");
+out:
+	free(buf);
+
+	return ret;
+}
+#endif
+
 static void usb_stor_set_max_xfer_blk(struct usb_device *udev,
 				      struct us_data *us)
 {
@@ -1000,6 +1558,10 @@ static int usb_request_sense(struct scsi_cmd *srb, struct us_data *ss)
 {
 	char *ptr;
 
+	/* UAS devices return the sense data along with the failed command */
+	if (ss->protocol == US_PR_UAS)
+		return 0;
+
 	ptr = (char *)srb->pdata;
 	memset(&srb->cmd[0], 0, 12);
 	srb->cmd[0] = SCSI_REQ_SENSE;
@@ -1065,40 +1627,152 @@ static int usb_read_capacity(struct scsi_cmd *srb, struct us_data *ss)
 	return -1;
 }
 
-static int usb_read_10(struct scsi_cmd *srb, struct us_data *ss,
-		       unsigned long start, unsigned short blocks)
+static int usb_read_capacity_16(struct scsi_cmd *srb, struct us_data *ss)
 {
-	memset(&srb->cmd[0], 0, 12);
-	srb->cmd[0] = SCSI_READ10;
-	srb->cmd[1] = srb->lun << 5;
-	srb->cmd[2] = ((unsigned char) (start >> 24)) & 0xff;
-	srb->cmd[3] = ((unsigned char) (start >> 16)) & 0xff;
-	srb->cmd[4] = ((unsigned char) (start >> 8)) & 0xff;
-	srb->cmd[5] = ((unsigned char) (start)) & 0xff;
-	srb->cmd[7] = ((unsigned char) (blocks >> 8)) & 0xff;
-	srb->cmd[8] = (unsigned char) blocks & 0xff;
-	srb->cmdlen = 12;
-	debug("read10: start %lx blocks %x\n", start, blocks);
-	return ss->transport(srb, ss);
+	int retry;
+
+	retry = 3;
+	do {
+		memset(&srb->cmd[0], 0, 16);
+		srb->cmd[0] = SCSI_RD_CAPAC16;
+		srb->cmd[1] = 0x10;	/* service action */
+		srb->cmd[13] = 16;	/* allocation length */
+		srb->datalen = 16;
+		srb->cmdlen = 16;
+		if (ss->transport(srb, ss) == USB_STOR_TRANSPORT_GOOD)
+			return 0;
+	} while (retry--);
+
+	return -1;
 }
 
-static int usb_write_10(struct scsi_cmd *srb, struct us_data *ss,
-			unsigned long start, unsigned short blocks)
+/*
+ * Set up a READ or WRITE command. Devices too large for the 32-bit LBA of
+ * the 10-byte commands get the 16-byte ones.
+ */
+static void usb_setup_rw(struct scsi_cmd *srb, struct us_data *ss,
+			 lbaint_t start, unsigned short blocks, bool write)
 {
-	memset(&srb->cmd[0], 0, 12);
-	srb->cmd[0] = SCSI_WRITE10;
-	srb->cmd[1] = srb->lun << 5;
-	srb->cmd[2] = ((unsigned char) (start >> 24)) & 0xff;
-	srb->cmd[3] = ((unsigned char) (start >> 16)) & 0xff;
-	srb->cmd[4] = ((unsigned char) (start >> 8)) & 0xff;
-	srb->cmd[5] = ((unsigned char) (start)) & 0xff;
-	srb->cmd[7] = ((unsigned char) (blocks >> 8)) & 0xff;
-	srb->cmd[8] = (unsigned char) blocks & 0xff;
-	srb->cmdlen = 12;
-	debug("write10: start %lx blocks %x\n", start, blocks);
+	u64 lba = start;
+
+	memset(&srb->cmd[0], 0, 16);
+	if (ss->cmd16) {
+		srb->cmd[0] = write ? SCSI_WRITE16 : SCSI_READ16;
+		srb->cmd[2] = (lba >> 56) & 0xff;
+		srb->cmd[3] = (lba >> 48) & 0xff;
+		srb->cmd[4] = (lba >> 40) & 0xff;
+		srb->cmd[5] = (lba >> 32) & 0xff;
+		srb->cmd[6] = (lba >> 24) & 0xff;
+		srb->cmd[7] = (lba >> 16) & 0xff;
+		srb->cmd[8] = (lba >> 8) & 0xff;
+		srb->cmd[9] = lba & 0xff;
+		srb->cmd[12] = (blocks >> 8) & 0xff;
+		srb->cmd[13] = blocks & 0xff;
+		srb->cmdlen = 16;
+	} else {
+		srb->cmd[0] = write ? SCSI_WRITE10 : SCSI_READ10;
+		srb->cmd[1] = srb->lun << 5;
+		srb->cmd[2] = (lba >> 24) & 0xff;
+		srb->cmd[3] = (lba >> 16) & 0xff;
+		srb->cmd[4] = (lba >> 8) & 0xff;
+		srb->cmd[5] = lba & 0xff;
+		srb->cmd[7] = (blocks >> 8) & 0xff;
+		srb->cmd[8] = blocks & 0xff;
+		srb->cmdlen = 12;
+	}
+}
+
+static int usb_read_write(struct scsi_cmd *srb, struct us_data *ss,
+			  lbaint_t start, unsigned short blocks, bool write)
+{
+	usb_setup_rw(srb, ss, start, blocks, write);
+	debug("%s: start " LBAF " blocks %x\n", write ? "write" : "read",
+	      start, blocks);
 	return ss->transport(srb, ss);
 }
 
+#ifdef CONFIG_USB_UAS
+/**
+ * usb_stor_uas_rw() - read or write with several commands queued
+ *
+ * The transfer is split into commands of at most max_xfer_blk blocks and
+ * up to USB_UAS_TAGS of them are queued on the device. The device may
+ * finish them in any order.
+ *
+ * @us:		Storage device
+ * @block_dev:	Block device to access
+ * @start:	First block
+ * @blkcnt:	Number of blocks
+ * @buf_addr:	Data buffer
+ * @write:	true to write, false to read
+ * @return number of blocks transferred before the first failed one
+ */
+static lbaint_t usb_stor_uas_rw(struct us_data *us, struct blk_desc *block_dev,
+				lbaint_t start, lbaint_t blkcnt,
+				uintptr_t buf_addr, bool write)
+{
+	struct scsi_cmd srbs[USB_UAS_TAGS];
+	struct usb_uas_queue q;
+	lbaint_t cmd_start[USB_UAS_TAGS];
+	lbaint_t next = start, end = start + blkcnt;
+	lbaint_t fail = end;
+	unsigned short blks;
+	int queued = 0;
+	int status;
+	int tag;
+
+	memset(&q, '\0', sizeof(q));
+	while (next < end || queued) {
+		/* Queue a command under each free tag */
+		for (tag = 1; tag <= USB_UAS_TAGS && next < end &&
+		     fail == end; tag++) {
+			struct scsi_cmd *srb = &srbs[tag - 1];
+
+			if (q.cmds[tag - 1].srb)
+				continue;
+			blks = min_t(lbaint_t, end - next, us->max_xfer_blk);
+			if (blks == us->max_xfer_blk)
+				usb_show_progress();
+			srb->lun = block_dev->lun;
+			srb->pdata = (unsigned char *)buf_addr +
+				     (next - start) * block_dev->blksz;
+			srb->datalen = block_dev->blksz * blks;
+			usb_setup_rw(srb, us, next, blks, write);
+			if (usb_stor_uas_send(us, &q, srb, tag) < 0)
+				goto err;
+			cmd_start[tag - 1] = next;
+			next += blks;
+			queued++;
+		}
+
+		tag = usb_stor_uas_service(us, &q, &status);
+		if (tag < 0)
+			goto err;
+		if (tag) {
+			if (status != USB_STOR_TRANSPORT_GOOD) {
+				debug("UAS: %s error at " LBAF "\n",
+				      write ? "write" : "read",
+				      cmd_start[tag - 1]);
+				fail = min(fail, cmd_start[tag - 1]);
+			}
+			queued--;
+		}
+	}
+
+	return fail - start;
+
+err:
+	/* Stop what is still queued so that its tags can be used again */
+	usb_stor_uas_reset(us, block_dev->lun);
+	fail = min(fail, next);
+	for (tag = 1; tag <= USB_UAS_TAGS; tag++) {
+		if (q.cmds[tag - 1].srb)
+			fail = min(fail, cmd_start[tag - 1]);
+	}
+
+	return fail - start;
+}
+#endif
 
 #ifdef CONFIG_USB_BIN_FIXUP
 /*
@@ -1133,7 +1807,7 @@ static unsigned long usb_stor_read(struct blk_desc *block_dev, lbaint_t blknr,
 {
 	lbaint_t start, blks;
 	uintptr_t buf_addr;
-	unsigned short smallblks;
+	unsigned short smallblks = 0;
 	struct usb_device *udev;
 	struct us_data *ss;
 	int retry;
@@ -1168,7 +1842,15 @@ static unsigned long usb_stor_read(struct blk_desc *block_dev, lbaint_t blknr,
 	debug("\nusb_read: dev %d startblk " LBAF ", blccnt " LBAF " buffer %"
 	      PRIxPTR "\n", block_dev->devnum, start, blks, buf_addr);
 
-	do {
+#ifdef CONFIG_USB_UAS
+	if (ss->protocol == US_PR_UAS) {
+		blkcnt = usb_stor_uas_rw(ss, block_dev, start, blks, buf_addr,
+					 false);
+		start += blkcnt;
+		blks = 0;
+	}
+#endif
+	while (blks) {
 		/* XXX need some comment here */
 		retry = 2;
 		srb->pdata = (unsigned char *)buf_addr;
@@ -1181,7 +1863,7 @@ retry_it:
 			usb_show_progress();
 		srb->datalen = block_dev->blksz * smallblks;
 		srb->pdata = (unsigned char *)buf_addr;
-		if (usb_read_10(srb, ss, start, smallblks)) {
+		if (usb_read_write(srb, ss, start, smallblks, false)) {
 			debug("Read ERROR\n");
 			usb_request_sense(srb, ss);
 			if (retry--)
@@ -1192,7 +1874,7 @@ retry_it:
 		start += smallblks;
 		blks -= smallblks;
 		buf_addr += srb->datalen;
-	} while (blks != 0);
+	}
 	ss->flags &= ~USB_READY;
 
 	debug("usb_read: end startblk " LBAF
@@ -1215,7 +1897,7 @@ static unsigned long usb_stor_write(struct blk_desc *block_dev, lbaint_t blknr,
 {
 	lbaint_t start, blks;
 	uintptr_t buf_addr;
-	unsigned short smallblks;
+	unsigned short smallblks = 0;
 	struct usb_device *udev;
 	struct us_data *ss;
 	int retry;
@@ -1252,7 +1934,15 @@ static unsigned long usb_stor_write(struct blk_desc *block_dev, lbaint_t blknr,
 	debug("\nusb_write: dev %d startblk " LBAF ", blccnt " LBAF " buffer %"
 	      PRIxPTR "\n", block_dev->devnum, start, blks, buf_addr);
 
-	do {
+#ifdef CONFIG_USB_UAS
+	if (ss->protocol == US_PR_UAS) {
+		blkcnt = usb_stor_uas_rw(ss, block_dev, start, blks, buf_addr,
+					 true);
+		start += blkcnt;
+		blks = 0;
+	}
+#endif
+	while (blks) {
 		/* If write fails retry for max retry count else
 		 * return with number of blocks written successfully.
 		 */
@@ -1267,7 +1957,7 @@ retry_it:
 			usb_show_progress();
 		srb->datalen = block_dev->blksz * smallblks;
 		srb->pdata = (unsigned char *)buf_addr;
-		if (usb_write_10(srb, ss, start, smallblks)) {
+		if (usb_read_write(srb, ss, start, smallblks, true)) {
 			debug("Write ERROR\n");
 			usb_request_sense(srb, ss);
 			if (retry--)
@@ -1278,7 +1968,7 @@ retry_it:
 		start += smallblks;
 		blks -= smallblks;
 		buf_addr += srb->datalen;
-	} while (blks != 0);
+	}
 	ss->flags &= ~USB_READY;
 
 	debug("usb_write: end startblk " LBAF ", blccnt %x buffer %"
@@ -1387,6 +2077,11 @@ int usb_storage_probe(struct usb_device *dev, unsigned int ifnum,
 		debug("Problems with device\n");
 		return 0;
 	}
+#ifdef CONFIG_USB_UAS
+	/* Prefer UAS, falling back to the interface as probed above */
+	if (ss->protocol == US_PR_BULK && ss->subclass == US_SC_SCSI)
+		usb_stor_uas_probe(dev, iface, ss);
+#endif
 	/* set class specific stuff */
 	/* We only handle certain protocols.  Currently, these are
 	 * the only ones.
@@ -1418,9 +2113,10 @@ int usb_stor_get_info(struct usb_device *dev, struct us_data *ss,
 		      struct blk_desc *dev_desc)
 {
 	unsigned char perq, modi;
-	ALLOC_CACHE_ALIGN_BUFFER(u32, cap, 2);
+	ALLOC_CACHE_ALIGN_BUFFER(u32, cap, 4);
 	ALLOC_CACHE_ALIGN_BUFFER(u8, usb_stor_buf, 36);
-	u32 capacity, blksz;
+	u64 capacity;
+	u32 blksz;
 	struct scsi_cmd *pccb = &usb_ccb;
 
 	pccb->pdata = usb_stor_buf;
@@ -1487,10 +2183,22 @@ int usb_stor_get_info(struct usb_device *dev, struct us_data *ss,
 	cap[1] = cpu_to_be32(cap[1]);
 #endif
 
-	capacity = be32_to_cpu(cap[0]) + 1;
+	capacity = be32_to_cpu(cap[0]) + 1ULL;
 	blksz = be32_to_cpu(cap[1]);
 
-	debug("Capacity = 0x%08x, blocksz = 0x%08x\n", capacity, blksz);
+	/* The last LBA does not fit in 32 bits, so ask for the 64-bit one */
+	if (cap[0] == 0xffffffff) {
+		memset(pccb->pdata, 0, 16);
+		if (usb_read_capacity_16(pccb, ss) == 0) {
+			capacity = ((u64)be32_to_cpu(cap[0]) << 32 |
+				    be32_to_cpu(cap[1])) + 1;
+			blksz = be32_to_cpu(cap[2]);
+			ss->cmd16 = true;
+		}
+		ss->flags &= ~USB_READY;
+	}
+
+	debug("Capacity = 0x%llx, blocksz = 0x%08x\n", capacity, blksz);
 	dev_desc->lba = capacity;
 	dev_desc->blksz = blksz;
 	dev_desc->log2blksz = LOG2(dev_desc->blksz);
@@ -92,14 +92,21 @@ static void ahci_dcache_invalidate_range(unsigned long begin, unsigned long len)
 	invalidate_dcache_range(start, end);
 }
 
+/* Each command slot has its own command table, see ahci_port_start() */
+static ulong ahci_cmd_tbl(struct ahci_ioports *pp, int tag)
+{
+	return pp->cmd_tbl + tag * AHCI_CMD_TBL_SZ;
+}
+
 /*
  * Ensure data for SATA controller is flushed out of dcache and
  * written to physical memory.
  */
-static void ahci_dcache_flush_sata_cmd(struct ahci_ioports *pp)
+static void ahci_dcache_flush_sata_cmd(struct ahci_ioports *pp, int tag)
 {
 	ahci_dcache_flush_range((unsigned long)pp->cmd_slot,
-				AHCI_PORT_PRIV_DMA_SZ);
+				AHCI_CMD_SLOT_SZ * AHCI_MAX_CMD_SLOT);
+	ahci_dcache_flush_range(ahci_cmd_tbl(pp, tag), AHCI_CMD_TBL_SZ);
 }
 
 static int waiting_for_cmd_completed(void __iomem *offset,
@@ -499,11 +506,11 @@ static int ahci_init_one(struct ahci_uc_priv *uc_priv, pci_dev_t dev)
 
 #define MAX_DATA_BYTE_COUNT  (4*1024*1024)
 
-static int ahci_fill_sg(struct ahci_uc_priv *uc_priv, u8 port,
+static int ahci_fill_sg(struct ahci_uc_priv *uc_priv, u8 port, int tag,
 			unsigned char *buf, int buf_len)
 {
 	struct ahci_ioports *pp = &(uc_priv->port[port]);
-	struct ahci_sg *ahci_sg = pp->cmd_tbl_sg;
+	struct ahci_sg *ahci_sg;
 	u32 sg_count;
 	int i;
 
@@ -513,6 +520,8 @@ static int ahci_fill_sg(struct ahci_uc_priv *uc_priv, u8 port,
 		return -1;
 	}
 
+	ahci_sg = (struct ahci_sg *)(ahci_cmd_tbl(pp, tag) + AHCI_CMD_TBL_HDR);
+
 	for (i = 0; i < sg_count; i++) {
 		ahci_sg->addr =
 		    cpu_to_le32((unsigned long) buf + i * MAX_DATA_BYTE_COUNT);
@@ -529,14 +538,16 @@ static int ahci_fill_sg(struct ahci_uc_priv *uc_priv, u8 port,
 }
 
 
-static void ahci_fill_cmd_slot(struct ahci_ioports *pp, u32 opts)
+static void ahci_fill_cmd_slot(struct ahci_ioports *pp, int tag, u32 opts)
 {
-	pp->cmd_slot->opts = cpu_to_le32(opts);
-	pp->cmd_slot->status = 0;
-	pp->cmd_slot->tbl_addr = cpu_to_le32((u32)pp->cmd_tbl & 0xffffffff);
+	struct ahci_cmd_hdr *cmd_slot = &pp->cmd_slot[tag];
+	ulong cmd_tbl = ahci_cmd_tbl(pp, tag);
+
+	cmd_slot->opts = cpu_to_le32(opts);
+	cmd_slot->status = 0;
+	cmd_slot->tbl_addr = cpu_to_le32((u32)cmd_tbl & 0xffffffff);
 #ifdef CONFIG_PHYS_64BIT
-	pp->cmd_slot->tbl_addr_hi =
-	    cpu_to_le32((u32)(((pp->cmd_tbl) >> 16) >> 16));
+	cmd_slot->tbl_addr_hi = cpu_to_le32((u32)((cmd_tbl >> 16) >> 16));
 #endif
 }
 
@@ -570,25 +581,22 @@ static int ahci_port_start(struct ahci_uc_priv *uc_priv, u8 port)
 		return -1;
 	}
 
-	mem = malloc(AHCI_PORT_PRIV_DMA_SZ + 2048);
+	/* Aligned to 2048-bytes */
+	mem = memalign(2048, AHCI_PORT_NCQ_DMA_SZ);
 	if (!mem) {
-		free(pp);
 		printf("%s: No mem for table!\n", __func__);
 		return -ENOMEM;
 	}
-
-	/* Aligned to 2048-bytes */
-	mem = memalign(2048, AHCI_PORT_PRIV_DMA_SZ);
-	memset(mem, 0, AHCI_PORT_PRIV_DMA_SZ);
+	memset(mem, 0, AHCI_PORT_NCQ_DMA_SZ);
 
 	/*
-	 * First item in chunk of DMA memory: 32-slot command table,
+	 * First item in chunk of DMA memory: 32-slot command list,
 	 * 32 bytes each in size
 	 */
 	pp->cmd_slot =
 		(struct ahci_cmd_hdr *)(uintptr_t)virt_to_phys((void *)mem);
 	debug("cmd_slot = %p\n", pp->cmd_slot);
-	mem += (AHCI_CMD_SLOT_SZ + 224);
+	mem += AHCI_CMD_SLOT_SZ * AHCI_MAX_CMD_SLOT;
 
 	/*
 	 * Second item: Received-FIS area
@@ -597,8 +605,8 @@ static int ahci_port_start(struct ahci_uc_priv *uc_priv, u8 port)
 	mem += AHCI_RX_FIS_SZ;
 
 	/*
-	 * Third item: data area for storing a single command
-	 * and its scatter-gather table
+	 * Third item: one data area per command slot for storing the
+	 * command and its scatter-gather table
 	 */
 	pp->cmd_tbl = virt_to_phys((void *)mem);
 	debug("cmd_tbl_dma = %lx\n", pp->cmd_tbl);
@@ -655,11 +663,11 @@ static int ahci_device_data_io(struct ahci_uc_priv *uc_priv, u8 port, u8 *fis,
 
 	memcpy((unsigned char *)pp->cmd_tbl, fis, fis_len);
 
-	sg_count = ahci_fill_sg(uc_priv, port, buf, buf_len);
+	sg_count = ahci_fill_sg(uc_priv, port, 0, buf, buf_len);
 	opts = (fis_len >> 2) | (sg_count << 16) | (is_write << 6);
-	ahci_fill_cmd_slot(pp, opts);
+	ahci_fill_cmd_slot(pp, 0, opts);
 
-	ahci_dcache_flush_sata_cmd(pp);
+	ahci_dcache_flush_sata_cmd(pp, 0);
 	ahci_dcache_flush_range((unsigned long)buf, (unsigned long)buf_len);
 
 	writel_with_flush(1, port_mmio + PORT_CMD_ISSUE);
@@ -740,6 +748,19 @@ static int ata_scsiop_inquiry(struct ahci_uc_priv *uc_priv,
 	memcpy(idbuf, tmpid, ATA_ID_WORDS * 2);
 	ata_swap_buf_le16(idbuf, ATA_ID_WORDS);
 
+	/* Use as many queued commands as both the host and drive handle */
+	uc_priv->port[port].ncq_depth = 0;
+	if ((uc_priv->cap & HOST_CAP_NCQ) &&
+	    (idbuf[ATA_ID_SATA_CAP] & (1 << 8))) {
+		u32 depth = ((uc_priv->cap & HOST_CAP_NCS_MASK) >>
+			     HOST_CAP_NCS_SHIFT) + 1;
+
+		depth = min(depth, (u32)(idbuf[ATA_ID_QUEUE_DEPTH] & 0x1f) + 1);
+		if (depth > 1)
+			uc_priv->port[port].ncq_depth = depth;
+		debug("scsi_ahci: port %d NCQ depth %d\n", port, depth);
+	}
+
 	memcpy(&pccb->pdata[8], "ATA     ", 8);
 	ata_id_strcpy((u16 *)&pccb->pdata[16], &idbuf[ATA_ID_PROD], 16);
 	ata_id_strcpy((u16 *)&pccb->pdata[32], &idbuf[ATA_ID_FW_REV], 4);
@@ -751,6 +772,196 @@ static int ata_scsiop_inquiry(struct ahci_uc_priv *uc_priv,
 }
 
 
+/* Stop the command engine of a port and clear its error status */
+static void ahci_port_stop_engine(void __iomem *port_mmio)
+{
+	u32 tmp;
+
+	tmp = readl(port_mmio + PORT_CMD);
+	writel_with_flush(tmp & ~PORT_CMD_START, port_mmio + PORT_CMD);
+	waiting_for_cmd_completed(port_mmio + PORT_CMD, 500, PORT_CMD_LIST_ON);
+
+	writel(readl(port_mmio + PORT_SCR_ERR), port_mmio + PORT_SCR_ERR);
+	writel(readl(port_mmio + PORT_IRQ_STAT), port_mmio + PORT_IRQ_STAT);
+}
+
+static void ahci_port_start_engine(void __iomem *port_mmio)
+{
+	u32 tmp = readl(port_mmio + PORT_CMD);
+
+	writel_with_flush(tmp | PORT_CMD_START, port_mmio + PORT_CMD);
+}
+
+/*
+ * Send a COMRESET on a stopped port, which aborts everything the drive
+ * has queued, then bring the link back up and restart the port
+ */
+static int ahci_port_comreset(struct ahci_uc_priv *uc_priv, u8 port)
+{
+	void __iomem *port_mmio = uc_priv->port[port].port_mmio;
+	u32 tmp;
+
+	/* SControl.DET = 1 for at least 1ms sends the COMRESET */
+	tmp = readl(port_mmio + PORT_SCR_CTL) & ~0xf;
+	writel_with_flush(tmp | 1, port_mmio + PORT_SCR_CTL);
+	mdelay(2);
+	writel_with_flush(tmp, port_mmio + PORT_SCR_CTL);
+	if (ahci_link_up(uc_priv, port))
+		return -ENOLINK;
+
+	writel(readl(port_mmio + PORT_SCR_ERR), port_mmio + PORT_SCR_ERR);
+	writel(readl(port_mmio + PORT_IRQ_STAT), port_mmio + PORT_IRQ_STAT);
+	ahci_port_start_engine(port_mmio);
+
+	return wait_spinup(port_mmio);
+}
+
+/*
+ * Recover a port after a failed queued command. The command engine is
+ * restarted, which clears SActive and the command issue register and drops
+ * the other commands still queued. The drive refuses all commands until
+ * the NCQ error log (page 10h) has been read, so read it. If that fails,
+ * or the drive is still busy, reset the port instead. The drive is left to
+ * plain READ/WRITE DMA EXT from then on.
+ */
+static void ahci_ncq_recover(struct ahci_uc_priv *uc_priv, u8 port)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(u8, log, ATA_SECT_SIZE);
+	struct ahci_ioports *pp = &uc_priv->port[port];
+	void __iomem *port_mmio = pp->port_mmio;
+	u8 fis[20];
+	int ret = -EBUSY;
+
+	pp->ncq_depth = 0;
+	ahci_port_stop_engine(port_mmio);
+
+	/* The engine must not be started while the drive is busy */
+	if (!(readl(port_mmio + PORT_TFDATA) & (ATA_BUSY | ATA_DRQ))) {
+		ahci_port_start_engine(port_mmio);
+
+		memset(fis, 0, sizeof(fis));
+		fis[0] = 0x27;		/* Host to device FIS. */
+		fis[1] = 1 << 7;	/* Command FIS. */
+		fis[2] = ATA_CMD_READ_LOG_EXT;
+		fis[4] = ATA_LOG_SATA_NCQ;
+		fis[12] = 1;		/* One sector */
+		ret = ahci_device_data_io(uc_priv, port, fis, sizeof(fis),
+					  log, ATA_SECT_SIZE, 0);
+		if (!ret && (readl(port_mmio + PORT_TFDATA) & ATA_ERR))
+			ret = -EIO;
+	}
+	if (!ret) {
+		debug("scsi_ahci: port %d NCQ error on tag %d, error %x\n",
+		      port, log[0] & 0x1f, log[3]);
+		return;
+	}
+
+	printf("scsi_ahci: resetting port %d\n", port);
+	ahci_port_stop_engine(port_mmio);
+	if (ahci_port_comreset(uc_priv, port))
+		printf("scsi_ahci: port %d did not come back after reset\n",
+		       port);
+}
+
+/*
+ * Read or write using READ/WRITE FPDMA QUEUED. The transfer is split
+ * into chunks of MAX_SATA_BLOCKS_READ_WRITE blocks and every free slot
+ * up to the queue depth is given one, so the drive always has work
+ * queued. The drive reports each completed tag by clearing its bit in
+ * SActive.
+ */
+static int ahci_ncq_read_write(struct ahci_uc_priv *uc_priv, u8 port,
+			       lbaint_t lba, u32 blocks, u8 *buf, u8 is_write)
+{
+	struct ahci_ioports *pp = &uc_priv->port[port];
+	void __iomem *port_mmio = pp->port_mmio;
+	u32 all = (u32)((1ULL << pp->ncq_depth) - 1);
+	u32 len = blocks * ATA_SECT_SIZE;
+	u32 busy = 0, issue, done;
+	u32 now_blocks;
+	u8 fis[20];
+	ulong start;
+	int sg_count;
+	int tag;
+
+	ahci_dcache_flush_range((unsigned long)buf, len);
+	writel(readl(port_mmio + PORT_IRQ_STAT), port_mmio + PORT_IRQ_STAT);
+
+	memset(fis, 0, sizeof(fis));
+	fis[0] = 0x27;		 /* Host to device FIS. */
+	fis[1] = 1 << 7;	 /* Command FIS. */
+	fis[2] = is_write ? ATA_CMD_FPDMA_WRITE : ATA_CMD_FPDMA_READ;
+	fis[7] = 1 << 6;	 /* device reg: set LBA mode */
+
+	start = get_timer(0);
+	while (blocks || busy) {
+		/* Give each free slot a chunk and issue them together */
+		issue = 0;
+		while (blocks && (busy | issue) != all) {
+			tag = ffs(~(busy | issue)) - 1;
+			now_blocks = min((u32)MAX_SATA_BLOCKS_READ_WRITE,
+					 blocks);
+
+			/* The block count goes in the features registers */
+			fis[3] = now_blocks & 0xff;
+			fis[11] = (now_blocks >> 8) & 0xff;
+			fis[4] = (lba >> 0) & 0xff;
+			fis[5] = (lba >> 8) & 0xff;
+			fis[6] = (lba >> 16) & 0xff;
+			fis[8] = (lba >> 24) & 0xff;
+#ifdef CONFIG_SYS_64BIT_LBA
+			fis[9] = (lba >> 32) & 0xff;
+			fis[10] = (lba >> 40) & 0xff;
+#endif
+			/* ...and the tag in the sector count register */
+			fis[12] = tag << 3;
+
+			memcpy((void *)ahci_cmd_tbl(pp, tag), fis, sizeof(fis));
+			sg_count = ahci_fill_sg(uc_priv, port, tag, buf,
+						now_blocks * ATA_SECT_SIZE);
+			ahci_fill_cmd_slot(pp, tag, (sizeof(fis) >> 2) |
+					   (sg_count << 16) | (is_write << 6));
+			ahci_dcache_flush_sata_cmd(pp, tag);
+
+			issue |= 1 << tag;
+			buf += now_blocks * ATA_SECT_SIZE;
+			lba += now_blocks;
+			blocks -= now_blocks;
+		}
+		if (issue) {
+			writel(issue, port_mmio + PORT_SCR_ACT);
+			writel_with_flush(issue, port_mmio + PORT_CMD_ISSUE);
+			busy |= issue;
+		}
+
+		if (readl(port_mmio + PORT_IRQ_STAT) & (PORT_IRQ_FATAL)) {
+			printf("scsi_ahci: queued command failed on port %d\n",
+			       port);
+			ahci_ncq_recover(uc_priv, port);
+			return -EIO;
+		}
+
+		done = busy & ~readl(port_mmio + PORT_SCR_ACT);
+		if (done) {
+			busy &= ~done;
+			start = get_timer(0);
+		} else if (get_timer(start) > WAIT_MS_DATAIO) {
+			printf("scsi_ahci: queued command timeout on port %d\n",
+			       port);
+			ahci_ncq_recover(uc_priv, port);
+			return -EIO;
+		}
+	}
+
+	ahci_dcache_invalidate_range((unsigned long)buf - len, len);
+
+	/* See ata_scsiop_read_write(), one flush covers all the chunks */
+	if (is_write)
+		return ata_io_flush(uc_priv, port);
+
+	return 0;
+}
+
 /*
  * SCSI READ10/WRITE10 command operation.
  */
@@ -792,6 +1003,15 @@ static int ata_scsiop_read_write(struct ahci_uc_priv *uc_priv,
 	debug("scsi_ahci: %s %u blocks starting from lba 0x" LBAFU "\n",
 	      is_write ?  "write" : "read", blocks, lba);
 
+	if (uc_priv->port[pccb->target].ncq_depth && blocks) {
+		if (ATA_SECT_SIZE * blocks > user_buffer_size) {
+			printf("scsi_ahci: Error: buffer too small.\n");
+			return -EIO;
+		}
+		return ahci_ncq_read_write(uc_priv, pccb->target, lba, blocks,
+					   user_buffer, is_write);
+	}
+
 	/* Preset the FIS */
 	memset(fis, 0, sizeof(fis));
 	fis[0] = 0x27;		 /* Host to device FIS. */
@@ -1124,8 +1344,8 @@ static int ata_io_flush(struct ahci_uc_priv *uc_priv, u8 port)
 	fis[2] = ATA_CMD_FLUSH_EXT;
 
 	memcpy((unsigned char *)pp->cmd_tbl, fis, 20);
-	ahci_fill_cmd_slot(pp, cmd_fis_len);
-	ahci_dcache_flush_sata_cmd(pp);
+	ahci_fill_cmd_slot(pp, 0, cmd_fis_len);
+	ahci_dcache_flush_sata_cmd(pp, 0);
 	writel_with_flush(1, port_mmio + PORT_CMD_ISSUE);
 
 	if (waiting_for_cmd_completed(port_mmio + PORT_CMD_ISSUE,
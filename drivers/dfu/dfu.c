@@ -82,8 +82,37 @@ int dfu_init_env_entities(char *interface, char *devstr)
 static unsigned char *dfu_buf;
 static unsigned long dfu_buf_size;
 
+#ifdef CONFIG_DFU_DOUBLE_BUFFER
+#define DFU_BUF_COUNT	2
+
+/*
+ * A full buffer being written out by dfu_write_background(), while the
+ * entity fills the other one
+ */
+static struct dfu_entity *dfu_bg;
+static u8 *dfu_bg_buf;
+static long dfu_bg_left;
+static u64 dfu_bg_offset;
+/* Error from the background write, reported by the next write or flush */
+static int dfu_bg_ret;
+
+/* Drop the background write of @dfu, or of any entity if NULL */
+static void dfu_bg_cancel(struct dfu_entity *dfu)
+{
+	if (!dfu || dfu_bg == dfu) {
+		dfu_bg = NULL;
+		dfu_bg_ret = 0;
+	}
+}
+#else
+#define DFU_BUF_COUNT	1
+
+static inline void dfu_bg_cancel(struct dfu_entity *dfu) {}
+#endif
+
 unsigned char *dfu_free_buf(void)
 {
+	dfu_bg_cancel(NULL);
 	free(dfu_buf);
 	dfu_buf = NULL;
 	return dfu_buf;
@@ -111,10 +140,11 @@ unsigned char *dfu_get_buf(struct dfu_entity *dfu)
 	if (dfu->max_buf_size && dfu_buf_size > dfu->max_buf_size)
 		dfu_buf_size = dfu->max_buf_size;
 
-	dfu_buf = memalign(CONFIG_SYS_CACHELINE_SIZE, dfu_buf_size);
+	dfu_buf = memalign(CONFIG_SYS_CACHELINE_SIZE,
+			   DFU_BUF_COUNT * dfu_buf_size);
 	if (dfu_buf == NULL)
 		printf("%s: Could not memalign 0x%lx bytes\n",
-		       __func__, dfu_buf_size);
+		       __func__, DFU_BUF_COUNT * dfu_buf_size);
 
 	return dfu_buf;
 }
@@ -165,8 +195,117 @@ static int dfu_write_buffer_drain(struct dfu_entity *dfu)
 	return ret;
 }
 
+#ifdef CONFIG_DFU_DOUBLE_BUFFER
+/* Write out the next slice of the background buffer, or all of it */
+static void dfu_bg_write(bool all)
+{
+	struct dfu_entity *dfu = dfu_bg;
+	long w_size;
+	int ret;
+
+	while (dfu_bg) {
+		w_size = dfu_bg_left;
+		if (!all && dfu->write_slice && w_size > dfu->write_slice)
+			w_size = dfu->write_slice;
+
+		ret = dfu->write_medium(dfu, dfu_bg_offset, dfu_bg_buf,
+					&w_size);
+		if (ret) {
+			debug("%s: Write error!\n", __func__);
+			dfu_bg_ret = ret;
+			dfu_bg = NULL;
+			break;
+		}
+
+		/* the medium may have rounded the size up */
+		w_size = min(w_size, dfu_bg_left);
+		dfu_bg_buf += w_size;
+		dfu_bg_offset += w_size;
+		dfu_bg_left -= w_size;
+		if (!dfu_bg_left) {
+			dfu_bg = NULL;
+			puts("#");
+		}
+
+		if (!all)
+			break;
+	}
+}
+
+void dfu_write_background(void)
+{
+	dfu_bg_write(false);
+}
+
+/*
+ * Return the error of a failed background write, if @wait is set first
+ * finish the one in progress
+ */
+static int dfu_bg_sync(bool wait)
+{
+	int ret;
+
+	if (wait)
+		dfu_bg_write(true);
+
+	ret = dfu_bg_ret;
+	dfu_bg_ret = 0;
+
+	return ret;
+}
+
+/*
+ * Hand a full buffer over to be written in the background and switch to
+ * the other one. If that is still being written, wait for it first.
+ */
+static int dfu_write_buffer_queue(struct dfu_entity *dfu)
+{
+	long w_size;
+	int ret;
+
+	w_size = dfu->i_buf - dfu->i_buf_start;
+	if (w_size == 0)
+		return 0;
+
+	ret = dfu_bg_sync(true);
+	if (ret)
+		return ret;
+
+	if (dfu_hash_algo)
+		dfu_hash_algo->hash_update(dfu_hash_algo, &dfu->crc,
+					   dfu->i_buf_start, w_size, 0);
+
+	dfu_bg = dfu;
+	dfu_bg_buf = dfu->i_buf_start;
+	dfu_bg_left = w_size;
+	dfu_bg_offset = dfu->offset;
+	dfu->offset += w_size;
+
+	if (dfu->i_buf_start == dfu_buf)
+		dfu->i_buf_start = dfu_buf + dfu_buf_size;
+	else
+		dfu->i_buf_start = dfu_buf;
+	dfu->i_buf_end = dfu->i_buf_start + dfu_buf_size;
+	dfu->i_buf = dfu->i_buf_start;
+
+	return 0;
+}
+#else
+static inline int dfu_bg_sync(bool wait)
+{
+	return 0;
+}
+
+static int dfu_write_buffer_queue(struct dfu_entity *dfu)
+{
+	return dfu_write_buffer_drain(dfu);
+}
+#endif
+
 void dfu_transaction_cleanup(struct dfu_entity *dfu)
 {
+	dfu_bg_cancel(dfu);
+
 	/* clear everything */
 	dfu->crc = 0;
 	dfu->offset = 0;
@@ -211,6 +350,10 @@ int dfu_flush(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 {
 	int ret = 0;
 
+	ret = dfu_bg_sync(true);
+	if (ret)
+		return ret;
+
 	ret = dfu_write_buffer_drain(dfu);
 	if (ret)
 		return ret;
@@ -262,9 +405,16 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 	/* handle rollover */
 	dfu->i_blk_seq_num = (dfu->i_blk_seq_num + 1) & 0xffff;
 
+	/* a buffer written in the background may have failed */
+	ret = dfu_bg_sync(false);
+	if (ret) {
+		dfu_transaction_cleanup(dfu);
+		return ret;
+	}
+
 	/* flush buffer if overflow */
 	if ((dfu->i_buf + size) > dfu->i_buf_end) {
-		ret = dfu_write_buffer_drain(dfu);
+		ret = dfu_write_buffer_queue(dfu);
 		if (ret) {
 			dfu_transaction_cleanup(dfu);
 			return ret;
@@ -284,7 +434,7 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 
 	/* if end or if buffer full flush */
 	if (size == 0 || (dfu->i_buf + size) > dfu->i_buf_end) {
-		ret = dfu_write_buffer_drain(dfu);
+		ret = dfu_write_buffer_queue(dfu);
 		if (ret) {
 			dfu_transaction_cleanup(dfu);
 			return ret;
@@ -394,6 +544,7 @@ static int dfu_fill_entity(struct dfu_entity *dfu, char *s, int alt,
 
 	dfu->alt = alt;
 	dfu->max_buf_size = 0;
+	dfu->write_slice = 0;
 	dfu->free_entity = NULL;
 
 	/* Specific for mmc device */
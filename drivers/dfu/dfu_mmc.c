@@ -16,6 +16,9 @@
 #include <fat.h>
 #include <mmc.h>
 
+/* Size of the raw writes done in the background, in whole blocks */
+#define DFU_MMC_WRITE_SLICE	(128 * 1024)
+
 static unsigned char *dfu_file_buf;
 static u64 dfu_file_buf_len;
 static long dfu_file_buf_filled;
@@ -384,6 +387,10 @@ int dfu_fill_entity_mmc(struct dfu_entity *dfu, char *devstr, char *s)
 		dfu->data.mmc.part = third_arg;
 	}
 
+	/* file writes only go to dfu_file_buf until the flush */
+	if (dfu->layout == DFU_RAW_ADDR)
+		dfu->write_slice = DFU_MMC_WRITE_SLICE;
+
 	dfu->dev_type = DFU_DEV_MMC;
 	dfu->get_medium_size = dfu_get_medium_size_mmc;
 	dfu->read_medium = dfu_read_medium_mmc;
@@ -79,6 +79,37 @@ int mmc_getcd(struct mmc *mmc)
 	return dm_mmc_get_cd(mmc->dev);
 }
 
+int dm_mmc_execute_tuning(struct udevice *dev, uint opcode)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(dev);
+
+	if (!ops->execute_tuning)
+		return -ENOSYS;
+	return ops->execute_tuning(dev, opcode);
+}
+
+int mmc_execute_tuning(struct mmc *mmc, uint opcode)
+{
+	int ret = dm_mmc_execute_tuning(mmc->dev, opcode);
+
+	/* A host with a fixed sampling point has nothing to tune */
+	return ret == -ENOSYS ? 0 : ret;
+}
+
+int dm_mmc_card_busy(struct udevice *dev)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(dev);
+
+	if (!ops->card_busy)
+		return -ENOSYS;
+	return ops->card_busy(dev);
+}
+
+int mmc_card_busy(struct mmc *mmc)
+{
+	return dm_mmc_card_busy(mmc->dev);
+}
+
 struct mmc *mmc_get_mmc_dev(struct udevice *dev)
 {
 	struct mmc_uclass_priv *upriv;
@@ -151,11 +182,27 @@ void mmc_do_preinit(void)
 #ifdef CONFIG_FSL_ESDHC_ADAPTER_IDENT
 		mmc_set_preinit(m, 1);
 #endif
-		if (m->preinit)
+		if (m->preinit || CONFIG_IS_ENABLED(MMC_PREINIT_ALL))
 			mmc_start_init(m);
 	}
 }
 
+#ifdef CONFIG_MMC_CACHE
+void mmc_flush_all_caches(void)
+{
+	struct udevice *dev;
+	struct uclass *uc;
+
+	if (uclass_get(UCLASS_MMC, &uc))
+		return;
+	uclass_foreach_dev(dev, uc) {
+		/* Nothing can have been written to a device not yet probed */
+		if (device_active(dev))
+			mmc_flush_cache(mmc_get_mmc_dev(dev));
+	}
+}
+#endif
+
 #if !defined(CONFIG_SPL_BUILD) || defined(CONFIG_SPL_LIBCOMMON_SUPPORT)
 void print_mmc_devices(char separator)
 {
@@ -20,6 +20,7 @@
 #include <memalign.h>
 #include <linux/list.h>
 #include <div64.h>
+#include <asm/unaligned.h>
 #include "mmc_private.h"
 
 static const unsigned int sd_au_size[] = {
@@ -43,7 +44,7 @@ void mmc_do_preinit(void)
 #ifdef CONFIG_FSL_ESDHC_ADAPTER_IDENT
 	mmc_set_preinit(m, 1);
 #endif
-	if (m->preinit)
+	if (m->preinit || CONFIG_IS_ENABLED(MMC_PREINIT_ALL))
 		mmc_start_init(m);
 }
 
@@ -220,11 +221,29 @@ int mmc_set_blocklen(struct mmc *mmc, int len)
 	return mmc_send_cmd(mmc, &cmd, NULL);
 }
 
+int mmc_set_blockcount(struct mmc *mmc, lbaint_t blkcnt)
+{
+	struct mmc_cmd cmd;
+
+	cmd.cmdidx = MMC_CMD_SET_BLOCK_COUNT;
+	cmd.resp_type = MMC_RSP_R1;
+	cmd.cmdarg = blkcnt;
+
+	return mmc_send_cmd(mmc, &cmd, NULL);
+}
+
 static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
 			   lbaint_t blkcnt)
 {
 	struct mmc_cmd cmd;
 	struct mmc_data data;
+	bool stop = blkcnt > 1;
+
+	if (stop && mmc_use_cmd23(mmc, blkcnt)) {
+		if (mmc_set_blockcount(mmc, blkcnt))
+			return 0;
+		stop = false;
+	}
 
 	if (blkcnt > 1)
 		cmd.cmdidx = MMC_CMD_READ_MULTIPLE_BLOCK;
@@ -246,7 +265,7 @@ static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
 	if (mmc_send_cmd(mmc, &cmd, &data))
 		return 0;
 
-	if (blkcnt > 1) {
+	if (stop) {
 		cmd.cmdidx = MMC_CMD_STOP_TRANSMISSION;
 		cmd.cmdarg = 0;
 		cmd.resp_type = MMC_RSP_R1b;
@@ -339,54 +358,56 @@ static int mmc_go_idle(struct mmc *mmc)
 	return 0;
 }
 
-static int sd_send_op_cond(struct mmc *mmc)
+static int sd_send_op_cond_iter(struct mmc *mmc)
 {
-	int timeout = 1000;
-	int err;
 	struct mmc_cmd cmd;
+	int err;
 
-	while (1) {
-		cmd.cmdidx = MMC_CMD_APP_CMD;
-		cmd.resp_type = MMC_RSP_R1;
-		cmd.cmdarg = 0;
-
-		err = mmc_send_cmd(mmc, &cmd, NULL);
-
-		if (err)
-			return err;
+	cmd.cmdidx = MMC_CMD_APP_CMD;
+	cmd.resp_type = MMC_RSP_R1;
+	cmd.cmdarg = 0;
 
-		cmd.cmdidx = SD_CMD_APP_SEND_OP_COND;
-		cmd.resp_type = MMC_RSP_R3;
+	err = mmc_send_cmd(mmc, &cmd, NULL);
 
-		/*
-		 * Most cards do not answer if some reserved bits
-		 * in the ocr are set. However, Some controller
-		 * can set bit 7 (reserved for low voltages), but
-		 * how to manage low voltages SD card is not yet
-		 * specified.
-		 */
-		cmd.cmdarg = mmc_host_is_spi(mmc) ? 0 :
-			(mmc->cfg->voltages & 0xff8000);
+	if (err)
+		return err;
 
-		if (mmc->version == SD_VERSION_2)
-			cmd.cmdarg |= OCR_HCS;
+	cmd.cmdidx = SD_CMD_APP_SEND_OP_COND;
+	cmd.resp_type = MMC_RSP_R3;
 
-		err = mmc_send_cmd(mmc, &cmd, NULL);
+	/*
+	 * Most cards do not answer if some reserved bits
+	 * in the ocr are set. However, Some controller
+	 * can set bit 7 (reserved for low voltages), but
+	 * how to manage low voltages SD card is not yet
+	 * specified.
+	 */
+	cmd.cmdarg = mmc_host_is_spi(mmc) ? 0 :
+		(mmc->cfg->voltages & 0xff8000);
+
+	if (mmc->version == SD_VERSION_2)
+		cmd.cmdarg |= OCR_HCS;
+#ifdef CONFIG_MMC_UHS_SUPPORT
+	/* Offer 1.8V signalling if we can go on to UHS-I */
+	if (mmc->version == SD_VERSION_2 &&
+	    (mmc->cfg->host_caps & MMC_MODE_UHS) && !mmc->uhs_failed)
+		cmd.cmdarg |= OCR_S18R;
+#endif
 
-		if (err)
-			return err;
+	err = mmc_send_cmd(mmc, &cmd, NULL);
 
-		if (cmd.response[0] & OCR_BUSY)
-			break;
+	if (err)
+		return err;
 
-		if (timeout-- <= 0)
-			return -EOPNOTSUPP;
+	mmc->ocr = cmd.response[0];
 
-		udelay(1000);
-	}
+	return 0;
+}
 
-	if (mmc->version != SD_VERSION_2)
-		mmc->version = SD_VERSION_1_0;
+static int sd_finish_op_cond(struct mmc *mmc)
+{
+	struct mmc_cmd cmd;
+	int err;
 
 	if (mmc_host_is_spi(mmc)) { /* read OCR for spi */
 		cmd.cmdidx = MMC_CMD_SPI_READ_OCR;
@@ -397,9 +418,9 @@ static int sd_send_op_cond(struct mmc *mmc)
 
 		if (err)
 			return err;
-	}
 
-	mmc->ocr = cmd.response[0];
+		mmc->ocr = cmd.response[0];
+	}
 
 	mmc->high_capacity = ((mmc->ocr & OCR_HCS) == OCR_HCS);
 	mmc->rca = 0;
@@ -407,6 +428,49 @@ static int sd_send_op_cond(struct mmc *mmc)
 	return 0;
 }
 
+/*
+ * Ask the card for its operating conditions once. If it is still powering
+ * up, leave the polling to sd_complete_op_cond() so that other cards can
+ * power up meanwhile.
+ */
+static int sd_send_op_cond(struct mmc *mmc)
+{
+	int err;
+
+	err = sd_send_op_cond_iter(mmc);
+	if (err)
+		return err;
+
+	if (mmc->version != SD_VERSION_2)
+		mmc->version = SD_VERSION_1_0;
+
+	if (!(mmc->ocr & OCR_BUSY)) {
+		mmc->op_cond_pending = 1;
+		return 0;
+	}
+
+	return sd_finish_op_cond(mmc);
+}
+
+static int sd_complete_op_cond(struct mmc *mmc)
+{
+	int timeout = 1000;
+	int err;
+
+	while (!(mmc->ocr & OCR_BUSY)) {
+		if (timeout-- <= 0)
+			return -EOPNOTSUPP;
+
+		udelay(1000);
+
+		err = sd_send_op_cond_iter(mmc);
+		if (err)
+			return err;
+	}
+
+	return sd_finish_op_cond(mmc);
+}
+
 static int mmc_send_op_cond_iter(struct mmc *mmc, int use_arg)
 {
 	struct mmc_cmd cmd;
@@ -457,6 +521,9 @@ static int mmc_complete_op_cond(struct mmc *mmc)
 	int err;
 
 	mmc->op_cond_pending = 0;
+	if (IS_SD(mmc))
+		return sd_complete_op_cond(mmc);
+
 	if (!(mmc->ocr & OCR_BUSY)) {
 		/* Some cards seem to need this */
 		mmc_go_idle(mmc);
@@ -549,7 +616,7 @@ int mmc_switch(struct mmc *mmc, u8 set, u8 index, u8 value)
 static int mmc_change_freq(struct mmc *mmc)
 {
 	ALLOC_CACHE_ALIGN_BUFFER(u8, ext_csd, MMC_MAX_BLOCK_LEN);
-	char cardtype;
+	u8 cardtype;
 	int err;
 
 	mmc->card_caps = 0;
@@ -561,14 +628,14 @@ static int mmc_change_freq(struct mmc *mmc)
 	if (mmc->version < MMC_VERSION_4)
 		return 0;
 
-	mmc->card_caps |= MMC_MODE_4BIT | MMC_MODE_8BIT;
+	mmc->card_caps |= MMC_MODE_4BIT | MMC_MODE_8BIT | MMC_MODE_CMD23;
 
 	err = mmc_send_ext_csd(mmc, ext_csd);
 
 	if (err)
 		return err;
 
-	cardtype = ext_csd[EXT_CSD_CARD_TYPE] & 0xf;
+	cardtype = ext_csd[EXT_CSD_CARD_TYPE];
 
 	err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_HS_TIMING, 1);
 
@@ -594,6 +661,14 @@ static int mmc_change_freq(struct mmc *mmc)
 		mmc->card_caps |= MMC_MODE_HS;
 	}
 
+#ifdef CONFIG_MMC_HS200_SUPPORT
+	/* Only the 1.8V I/O flavours, we do not switch to 1.2V */
+	if (cardtype & EXT_CSD_CARD_TYPE_HS200_1_8V)
+		mmc->card_caps |= MMC_MODE_HS200;
+	if (cardtype & EXT_CSD_CARD_TYPE_HS400_1_8V)
+		mmc->card_caps |= MMC_MODE_HS400;
+#endif
+
 	return 0;
 }
 
@@ -945,6 +1020,9 @@ retry_scr:
 
 	if (mmc->scr[0] & SD_DATA_4BIT)
 		mmc->card_caps |= MMC_MODE_4BIT;
+	if (mmc->scr[0] & SD_SCR_CMD23)
+		mmc->card_caps |= MMC_MODE_CMD23;
+	mmc->erased_byte = mmc->scr[0] & SD_DATA_STAT_AFTER_ERASE ? 0xff : 0;
 
 	/* Version 1.0 doesn't support switching */
 	if (mmc->version == SD_VERSION_1_0)
@@ -963,6 +1041,24 @@ retry_scr:
 			break;
 	}
 
+#ifdef CONFIG_MMC_UHS_SUPPORT
+	/*
+	 * A UHS-I card gets its bus speed once the bus is 4 bits wide, see
+	 * sd_select_uhs()
+	 */
+	if (mmc->signal_voltage == MMC_SIGNAL_VOLTAGE_180) {
+		u32 funcs = __be32_to_cpu(switch_status[3]);
+
+		if (funcs & SD_UHS_SDR104_SUPPORTED)
+			mmc->card_caps |= MMC_MODE_UHS_SDR104;
+		if (funcs & SD_UHS_DDR50_SUPPORTED)
+			mmc->card_caps |= MMC_MODE_UHS_DDR50;
+		if (funcs & SD_UHS_SDR50_SUPPORTED)
+			mmc->card_caps |= MMC_MODE_UHS_SDR50;
+		return 0;
+	}
+#endif
+
 	/* If high-speed isn't supported, we return */
 	if (!(__be32_to_cpu(switch_status[3]) & SD_HIGHSPEED_SUPPORTED))
 		return 0;
@@ -1081,6 +1177,24 @@ static void mmc_set_ios(struct mmc *mmc)
 	if (mmc->cfg->ops->set_ios)
 		mmc->cfg->ops->set_ios(mmc);
 }
+
+#ifdef CONFIG_MMC_IO_VOLTAGE
+static int mmc_execute_tuning(struct mmc *mmc, uint opcode)
+{
+	if (!mmc->cfg->ops->execute_tuning)
+		return 0;
+	return mmc->cfg->ops->execute_tuning(mmc, opcode);
+}
+#endif
+
+#ifdef CONFIG_MMC_UHS_SUPPORT
+static int mmc_card_busy(struct mmc *mmc)
+{
+	if (!mmc->cfg->ops->card_busy)
+		return -ENOSYS;
+	return mmc->cfg->ops->card_busy(mmc);
+}
+#endif
 #endif
 
 void mmc_set_clock(struct mmc *mmc, uint clock)
@@ -1103,6 +1217,258 @@ static void mmc_set_bus_width(struct mmc *mmc, uint width)
 	mmc_set_ios(mmc);
 }
 
+#ifdef CONFIG_MMC_IO_VOLTAGE
+/*
+ * Change the I/O signalling voltage: the vqmmc-supply regulator, if there
+ * is one, and then the host's own setting through set_ios().
+ */
+static int mmc_set_signal_voltage(struct mmc *mmc, uint signal_voltage)
+{
+#if CONFIG_IS_ENABLED(DM_MMC) && defined(CONFIG_DM_REGULATOR) && \
+	!defined(CONFIG_SPL_BUILD)
+	if (mmc->vqmmc_supply) {
+		int uv = signal_voltage == MMC_SIGNAL_VOLTAGE_180 ?
+			1800000 : 3300000;
+		int err;
+
+		err = regulator_set_value(mmc->vqmmc_supply, uv);
+		if (err) {
+			debug("%s: Cannot set I/O voltage to %d uV\n",
+			      mmc->dev->name, uv);
+			return err;
+		}
+	}
+#endif
+	mmc->signal_voltage = signal_voltage;
+	mmc_set_ios(mmc);
+
+	return 0;
+}
+#endif
+
+#ifdef CONFIG_MMC_UHS_SUPPORT
+/*
+ * Move an SD card which accepted OCR_S18R to 1.8V signalling. This has to
+ * happen while the card is still in the ready state, before CMD2.
+ *
+ * The card holds DAT[3:0] low from its response to CMD11 until it has
+ * switched, which it does while the host keeps the SD clock stopped. Hosts
+ * which cannot see the data lines skip those checks.
+ *
+ * If this fails, mmc->uhs_failed is set and the card must be power-cycled.
+ */
+static int sd_switch_voltage(struct mmc *mmc)
+{
+	struct mmc_cmd cmd;
+	int err;
+
+	cmd.cmdidx = SD_CMD_SWITCH_UHS18V;
+	cmd.resp_type = MMC_RSP_R1;
+	cmd.cmdarg = 0;
+
+	err = mmc_send_cmd(mmc, &cmd, NULL);
+	if (err)
+		goto err;
+
+	mmc->clk_disable = true;
+	mmc_set_ios(mmc);
+	if (!mmc_card_busy(mmc)) {
+		err = -EIO;
+		goto err;
+	}
+
+	err = mmc_set_signal_voltage(mmc, MMC_SIGNAL_VOLTAGE_180);
+	if (err)
+		goto err;
+
+	/* Keep the clock stopped for at least 5ms */
+	mdelay(5);
+	mmc->clk_disable = false;
+	mmc_set_ios(mmc);
+
+	/* The card releases DAT[3:0] within 1ms of the clock starting */
+	mdelay(1);
+	if (mmc_card_busy(mmc) > 0) {
+		err = -EIO;
+		goto err;
+	}
+
+	return 0;
+
+err:
+	debug("%s: Cannot switch to 1.8V signalling (err=%d)\n", __func__,
+	      err);
+	mmc->clk_disable = false;
+	mmc->uhs_failed = true;
+
+	return err;
+}
+
+/* UHS-I bus speeds, in order of preference */
+static const struct sd_uhs_mode {
+	uint mode;	/* MMC_MODE_... */
+	u8 func;	/* SD_SWITCH_FUNC_... */
+	u8 timing;	/* MMC_TIMING_... */
+	uint clock;
+} sd_uhs_modes[] = {
+	{ MMC_MODE_UHS_SDR104, SD_SWITCH_FUNC_SDR104, MMC_TIMING_UHS_SDR104,
+	  208000000 },
+	{ MMC_MODE_UHS_DDR50, SD_SWITCH_FUNC_DDR50, MMC_TIMING_UHS_DDR50,
+	  50000000 },
+	{ MMC_MODE_UHS_SDR50, SD_SWITCH_FUNC_SDR50, MMC_TIMING_UHS_SDR50,
+	  100000000 },
+};
+
+/* Switch a 1.8V SD card with a 4-bit bus to the best common UHS-I mode */
+static int sd_select_uhs(struct mmc *mmc)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(uint, switch_status, 16);
+	const struct sd_uhs_mode *m;
+	int err, i;
+
+	for (i = 0; i < ARRAY_SIZE(sd_uhs_modes); i++) {
+		m = &sd_uhs_modes[i];
+		if (!(mmc->card_caps & m->mode))
+			continue;
+
+		err = sd_switch(mmc, SD_SWITCH_SWITCH, 0, m->func,
+				(u8 *)switch_status);
+		if (err)
+			return err;
+		if (((__be32_to_cpu(switch_status[4]) >> 24) & 0xf) != m->func)
+			continue;
+
+		mmc->timing = m->timing;
+		mmc->ddr_mode = m->timing == MMC_TIMING_UHS_DDR50;
+		mmc->tran_speed = m->clock;
+		mmc_set_clock(mmc, mmc->tran_speed);
+		if (m->timing == MMC_TIMING_UHS_DDR50)
+			return 0;
+
+		return mmc_execute_tuning(mmc, SD_CMD_SEND_TUNING_BLOCK);
+	}
+
+	/* Stay at SDR12 */
+	mmc->tran_speed = 25000000;
+
+	return 0;
+}
+#endif
+
+#ifdef CONFIG_MMC_HS200_SUPPORT
+/* HS400 is entered from high speed, with an 8-bit DDR bus */
+static int mmc_select_hs400(struct mmc *mmc)
+{
+	int err;
+
+	err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_HS_TIMING,
+			 EXT_CSD_TIMING_HS);
+	if (err)
+		return err;
+	mmc->timing = MMC_TIMING_LEGACY;
+	mmc_set_clock(mmc, 52000000);
+
+	err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_BUS_WIDTH,
+			 EXT_CSD_DDR_BUS_WIDTH_8);
+	if (err)
+		return err;
+
+	err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_HS_TIMING,
+			 EXT_CSD_TIMING_HS400);
+	if (err)
+		return err;
+	mmc->timing = MMC_TIMING_MMC_HS400;
+	mmc->ddr_mode = 1;
+	mmc_set_clock(mmc, mmc->tran_speed);
+
+	return 0;
+}
+
+/*
+ * Move an eMMC to HS200 at 1.8V, tune, and go on to HS400 if both sides
+ * can. On failure the card is put back in high speed with the old clock
+ * and signalling voltage, ready for the usual bus width selection.
+ */
+static int mmc_select_hs200(struct mmc *mmc)
+{
+	uint old_voltage = mmc->signal_voltage;
+	uint old_clock = mmc->clock;
+	uint width, ext_width;
+	int err;
+
+	if (mmc->card_caps & MMC_MODE_8BIT) {
+		width = 8;
+		ext_width = EXT_CSD_BUS_WIDTH_8;
+	} else if (mmc->card_caps & MMC_MODE_4BIT) {
+		width = 4;
+		ext_width = EXT_CSD_BUS_WIDTH_4;
+	} else {
+		return -EOPNOTSUPP;
+	}
+
+	err = mmc_set_signal_voltage(mmc, MMC_SIGNAL_VOLTAGE_180);
+	if (err)
+		return err;
+
+	err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_BUS_WIDTH,
+			 ext_width);
+	if (err)
+		goto err;
+	mmc_set_bus_width(mmc, width);
+
+	err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_HS_TIMING,
+			 EXT_CSD_TIMING_HS200);
+	if (err)
+		goto err;
+	mmc->timing = MMC_TIMING_MMC_HS200;
+	mmc->tran_speed = 200000000;
+	mmc_set_clock(mmc, mmc->tran_speed);
+
+	err = mmc_execute_tuning(mmc, MMC_CMD_SEND_TUNING_BLOCK_HS200);
+	if (err)
+		goto err;
+
+	if ((mmc->card_caps & MMC_MODE_HS400) && width == 8) {
+		err = mmc_select_hs400(mmc);
+		if (err)
+			goto err;
+	}
+
+	return 0;
+
+err:
+	debug("%s: Cannot use HS200, err=%d\n", __func__, err);
+	mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_HS_TIMING,
+		   EXT_CSD_TIMING_HS);
+	mmc->timing = MMC_TIMING_LEGACY;
+	mmc->ddr_mode = 0;
+	mmc_set_clock(mmc, old_clock);
+	mmc_set_signal_voltage(mmc, old_voltage);
+
+	return err;
+}
+#endif
+
+/*
+ * Put a card seen before back into the speed sd_change_freq() or
+ * mmc_change_freq() found for it, without asking it all over again
+ */
+static int mmc_restore_freq(struct mmc *mmc)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(uint, switch_status, 16);
+
+	mmc->card_caps = mmc->cached_caps;
+	mmc->version = mmc->cached_version;
+	if (mmc_host_is_spi(mmc) || !(mmc->card_caps & MMC_MODE_HS))
+		return 0;
+
+	if (IS_SD(mmc))
+		return sd_switch(mmc, SD_SWITCH_SWITCH, 0, 1,
+				 (u8 *)switch_status);
+
+	return mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_HS_TIMING, 1);
+}
+
 static int mmc_startup(struct mmc *mmc)
 {
 	int err, i;
@@ -1114,6 +1480,7 @@ static int mmc_startup(struct mmc *mmc)
 	bool has_parts = false;
 	bool part_completed;
 	struct blk_desc *bdesc;
+	bool known;
 
 #ifdef CONFIG_MMC_SPI_CRC_ON
 	if (mmc_host_is_spi(mmc)) { /* enable CRC check for spi */
@@ -1127,6 +1494,15 @@ static int mmc_startup(struct mmc *mmc)
 	}
 #endif
 
+#ifdef CONFIG_MMC_UHS_SUPPORT
+	if (IS_SD(mmc) && mmc->high_capacity && (mmc->ocr & OCR_S18R) &&
+	    (mmc->cfg->host_caps & MMC_MODE_UHS)) {
+		err = sd_switch_voltage(mmc);
+		if (err)
+			return err;
+	}
+#endif
+
 	/* Put the Card in Identify Mode */
 	cmd.cmdidx = mmc_host_is_spi(mmc) ? MMC_CMD_SEND_CID :
 		MMC_CMD_ALL_SEND_CID; /* cmd not supported in spi */
@@ -1138,6 +1514,9 @@ static int mmc_startup(struct mmc *mmc)
 	if (err)
 		return err;
 
+	/* The same card as last time may skip negotiating its bus modes */
+	known = mmc->id_cached && !memcmp(mmc->cid, cmd.response, 16);
+	mmc->id_cached = false;
 	memcpy(mmc->cid, cmd.response, 16);
 
 	/*
@@ -1169,6 +1548,7 @@ static int mmc_startup(struct mmc *mmc)
 	if (err)
 		return err;
 
+	known = known && !memcmp(mmc->csd, cmd.response, 16);
 	mmc->csd[0] = cmd.response[0];
 	mmc->csd[1] = cmd.response[1];
 	mmc->csd[2] = cmd.response[2];
@@ -1260,6 +1640,8 @@ static int mmc_startup(struct mmc *mmc)
 	 */
 	mmc->erase_grp_size = 1;
 	mmc->part_config = MMCPART_NOAVAILABLE;
+	if (!known)
+		mmc->erased_byte = -1;
 	if (!IS_SD(mmc) && (mmc->version >= MMC_VERSION_4)) {
 		/* check  ext_csd version and capacity */
 		err = mmc_send_ext_csd(mmc, ext_csd);
@@ -1303,6 +1685,9 @@ static int mmc_startup(struct mmc *mmc)
 			mmc->version = MMC_VERSION_5_1;
 			break;
 		}
+		if (ext_csd[EXT_CSD_REV] >= 3)
+			mmc->erased_byte = ext_csd[EXT_CSD_ERASED_MEM_CONT] ?
+					   0xff : 0;
 
 		/* The partition data may be non-zero but it is only
 		 * effective if PARTITION_SETTING_COMPLETED is set in
@@ -1403,6 +1788,18 @@ static int mmc_startup(struct mmc *mmc)
 				* (erase_gmul + 1);
 		}
 
+#ifdef CONFIG_MMC_CACHE
+		/* Let the card cache writes, they are flushed when done */
+		if (mmc->version >= MMC_VERSION_4_5 &&
+		    get_unaligned_le32(&ext_csd[EXT_CSD_CACHE_SIZE])) {
+			err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL,
+					 EXT_CSD_CACHE_CTRL, 1);
+			if (err)
+				return err;
+			mmc->cache_on = true;
+		}
+#endif
+
 		mmc->hc_wp_grp_size = 1024
 			* ext_csd[EXT_CSD_HC_ERASE_GRP_SIZE]
 			* ext_csd[EXT_CSD_HC_WP_GRP_SIZE];
@@ -1414,13 +1811,17 @@ static int mmc_startup(struct mmc *mmc)
 	if (err)
 		return err;
 
-	if (IS_SD(mmc))
+	if (known)
+		err = mmc_restore_freq(mmc);
+	else if (IS_SD(mmc))
 		err = sd_change_freq(mmc);
 	else
 		err = mmc_change_freq(mmc);
 
 	if (err)
 		return err;
+	mmc->cached_caps = mmc->card_caps;
+	mmc->cached_version = mmc->version;
 
 	/* Restrict card's capabilities by what the host can do */
 	mmc->card_caps &= mmc->cfg->host_caps;
@@ -1453,6 +1854,20 @@ static int mmc_startup(struct mmc *mmc)
 			mmc->tran_speed = 50000000;
 		else
 			mmc->tran_speed = 25000000;
+#ifdef CONFIG_MMC_UHS_SUPPORT
+		/* A card at 1.8V has no high speed, it uses the UHS-I modes */
+		if (mmc->signal_voltage == MMC_SIGNAL_VOLTAGE_180 &&
+		    (mmc->card_caps & MMC_MODE_4BIT)) {
+			err = sd_select_uhs(mmc);
+			if (err)
+				return err;
+		}
+#endif
+#ifdef CONFIG_MMC_HS200_SUPPORT
+	} else if ((mmc->card_caps & MMC_MODE_HS200) &&
+		   !mmc_select_hs200(mmc)) {
+		/* The bus width, timing and clock are all set up */
+#endif
 	} else if (mmc->version >= MMC_VERSION_4) {
 		/* Only version 4 of MMC supports wider bus widths */
 		int idx;
@@ -1503,6 +1918,8 @@ static int mmc_startup(struct mmc *mmc)
 			 */
 			if ((mmc->card_caps & caps) != caps)
 				continue;
+			if (known && extw != mmc->cached_bus_width)
+				continue;
 
 			err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL,
 					EXT_CSD_BUS_WIDTH, extw);
@@ -1513,6 +1930,10 @@ static int mmc_startup(struct mmc *mmc)
 			mmc->ddr_mode = (caps & MMC_MODE_DDR_52MHz) ? 1 : 0;
 			mmc_set_bus_width(mmc, widths[idx]);
 
+			/* This width worked last time */
+			if (known)
+				break;
+
 			err = mmc_send_ext_csd(mmc, test_csd);
 
 			if (err)
@@ -1536,6 +1957,7 @@ static int mmc_startup(struct mmc *mmc)
 
 		if (err)
 			return err;
+		mmc->cached_bus_width = ext_csd_bits[idx];
 
 		if (mmc->card_caps & MMC_MODE_HS) {
 			if (mmc->card_caps & MMC_MODE_HS_52MHz)
@@ -1581,6 +2003,7 @@ static int mmc_startup(struct mmc *mmc)
 #if !defined(CONFIG_SPL_BUILD) || defined(CONFIG_SPL_LIBDISK_SUPPORT)
 	part_init(bdesc);
 #endif
+	mmc->id_cached = true;
 
 	return 0;
 }
@@ -1619,17 +2042,31 @@ static int mmc_power_init(struct mmc *mmc)
 {
 #if CONFIG_IS_ENABLED(DM_MMC)
 #if defined(CONFIG_DM_REGULATOR) && !defined(CONFIG_SPL_BUILD)
-	struct udevice *vmmc_supply;
 	int ret;
 
+#ifdef CONFIG_MMC_IO_VOLTAGE
+	ret = device_get_supply_regulator(mmc->dev, "vqmmc-supply",
+					  &mmc->vqmmc_supply);
+	if (!ret) {
+		ret = regulator_set_enable(mmc->vqmmc_supply, true);
+		if (ret) {
+			puts("Error enabling VQMMC supply\n");
+			return ret;
+		}
+	} else {
+		mmc->vqmmc_supply = NULL;
+	}
+#endif
+
 	ret = device_get_supply_regulator(mmc->dev, "vmmc-supply",
-					  &vmmc_supply);
+					  &mmc->vmmc_supply);
 	if (ret) {
 		debug("%s: No vmmc supply\n", mmc->dev->name);
+		mmc->vmmc_supply = NULL;
 		return 0;
 	}
 
-	ret = regulator_set_enable(vmmc_supply, true);
+	ret = regulator_set_enable(mmc->vmmc_supply, true);
 	if (ret) {
 		puts("Error enabling VMMC supply\n");
 		return ret;
@@ -1645,7 +2082,31 @@ static int mmc_power_init(struct mmc *mmc)
 	return 0;
 }
 
-int mmc_start_init(struct mmc *mmc)
+#ifdef CONFIG_MMC_UHS_SUPPORT
+/* Switch the card off and on again, if its power supply allows it */
+static int mmc_power_cycle(struct mmc *mmc)
+{
+#if CONFIG_IS_ENABLED(DM_MMC) && defined(CONFIG_DM_REGULATOR) && \
+	!defined(CONFIG_SPL_BUILD)
+	int ret;
+
+	if (!mmc->vmmc_supply)
+		return -ENOSYS;
+
+	ret = regulator_set_enable(mmc->vmmc_supply, false);
+	if (ret)
+		return ret;
+	/* The card needs its supply below 0.5V for at least 1ms */
+	mdelay(2);
+
+	return regulator_set_enable(mmc->vmmc_supply, true);
+#else
+	return -ENOSYS;
+#endif
+}
+#endif
+
+static int mmc_begin_init(struct mmc *mmc)
 {
 	bool no_card;
 	int err;
@@ -1666,6 +2127,10 @@ int mmc_start_init(struct mmc *mmc)
 	if (mmc->has_init)
 		return 0;
 
+	/* The card forgets what is in its cache when it is reset */
+	mmc_flush_cache(mmc);
+	mmc->cache_on = false;
+
 #ifdef CONFIG_FSL_ESDHC_ADAPTER_IDENT
 	mmc_adapter_card_type_ident();
 #endif
@@ -1682,6 +2147,12 @@ int mmc_start_init(struct mmc *mmc)
 		return err;
 #endif
 	mmc->ddr_mode = 0;
+	mmc->timing = MMC_TIMING_LEGACY;
+#ifdef CONFIG_MMC_IO_VOLTAGE
+	err = mmc_set_signal_voltage(mmc, MMC_SIGNAL_VOLTAGE_330);
+	if (err)
+		return err;
+#endif
 	mmc_set_bus_width(mmc, 1);
 	mmc_set_clock(mmc, 1);
 
@@ -1695,6 +2166,7 @@ int mmc_start_init(struct mmc *mmc)
 	mmc_get_blk_desc(mmc)->hwpart = 0;
 
 	/* Test for SD version 2 */
+	mmc->version = MMC_VERSION_UNKNOWN;
 	err = mmc_send_if_cond(mmc);
 
 	/* Now try to get the SD card's operating condition */
@@ -1718,16 +2190,56 @@ int mmc_start_init(struct mmc *mmc)
 	return err;
 }
 
+int mmc_start_init(struct mmc *mmc)
+{
+	int err;
+
+	bootstage_start(BOOTSTAGE_ID_ACCUM_MMC_START, "mmc_start");
+	err = mmc_begin_init(mmc);
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_MMC_START);
+
+	return err;
+}
+
 static int mmc_complete_init(struct mmc *mmc)
 {
 	int err = 0;
 
 	mmc->init_in_progress = 0;
-	if (mmc->op_cond_pending)
+	if (mmc->op_cond_pending) {
+		bootstage_start(BOOTSTAGE_ID_ACCUM_MMC_OP_COND, "mmc_op_cond");
 		err = mmc_complete_op_cond(mmc);
+		bootstage_accum(BOOTSTAGE_ID_ACCUM_MMC_OP_COND);
+	}
 
-	if (!err)
+	if (!err) {
+		bootstage_start(BOOTSTAGE_ID_ACCUM_MMC_STARTUP, "mmc_startup");
 		err = mmc_startup(mmc);
+		bootstage_accum(BOOTSTAGE_ID_ACCUM_MMC_STARTUP);
+	}
+
+#ifdef CONFIG_MMC_UHS_SUPPORT
+	/*
+	 * A card which did not manage to switch to 1.8V signalling is in an
+	 * unknown state. Power it off and on where we can and start again at
+	 * 3.3V, without offering 1.8V this time.
+	 */
+	if (err && mmc->uhs_failed) {
+		printf("%s: 1.8V signalling failed, retrying at 3.3V\n",
+		       mmc->cfg->name);
+		err = mmc_power_cycle(mmc);
+		if (err == -ENOSYS)
+			err = 0;
+		if (!err)
+			err = mmc_begin_init(mmc);
+		mmc->init_in_progress = 0;
+		if (!err && mmc->op_cond_pending)
+			err = mmc_complete_op_cond(mmc);
+		if (!err)
+			err = mmc_startup(mmc);
+	}
+	mmc->uhs_failed = false;
+#endif
 	if (err)
 		mmc->has_init = 0;
 	else
@@ -1852,6 +2364,23 @@ int mmc_initialize(bd_t *bis)
 	return 0;
 }
 
+#ifdef CONFIG_MMC_CACHE
+int mmc_flush_cache(struct mmc *mmc)
+{
+	int err;
+
+	if (!mmc->cache_on || !mmc->cache_dirty)
+		return 0;
+
+	err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_FLUSH_CACHE, 1);
+	if (err)
+		return err;
+	mmc->cache_dirty = false;
+
+	return 0;
+}
+#endif
+
 #ifdef CONFIG_CMD_BKOPS_ENABLE
 int mmc_set_bkops_enable(struct mmc *mmc)
 {
@@ -59,12 +59,22 @@ void mmc_do_preinit(void)
 #ifdef CONFIG_FSL_ESDHC_ADAPTER_IDENT
 		mmc_set_preinit(m, 1);
 #endif
-		if (m->preinit)
+		if (m->preinit || CONFIG_IS_ENABLED(MMC_PREINIT_ALL))
 			mmc_start_init(m);
 	}
 }
 #endif
 
+#ifdef CONFIG_MMC_CACHE
+void mmc_flush_all_caches(void)
+{
+	struct list_head *entry;
+
+	list_for_each(entry, &mmc_devices)
+		mmc_flush_cache(list_entry(entry, struct mmc, link));
+}
+#endif
+
 void mmc_list_init(void)
 {
 	INIT_LIST_HEAD(&mmc_devices);
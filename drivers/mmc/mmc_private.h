@@ -16,6 +16,23 @@ extern int mmc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
 			struct mmc_data *data);
 extern int mmc_send_status(struct mmc *mmc, int timeout);
 extern int mmc_set_blocklen(struct mmc *mmc, int len);
+
+/**
+ * mmc_set_blockcount() - Set the length of the next multi-block transfer
+ *
+ * The transfer then stops by itself, with no STOP_TRANSMISSION command.
+ *
+ * @mmc:	MMC device
+ * @blkcnt:	Number of blocks the next read or write command transfers
+ * @return 0 if OK, -ve on error
+ */
+int mmc_set_blockcount(struct mmc *mmc, lbaint_t blkcnt);
+
+/* SET_BLOCK_COUNT can only give a 16-bit block count */
+static inline bool mmc_use_cmd23(struct mmc *mmc, lbaint_t blkcnt)
+{
+	return (mmc->card_caps & MMC_MODE_CMD23) && blkcnt <= 0xffff;
+}
 #ifdef CONFIG_FSL_ESDHC_ADAPTER_IDENT
 void mmc_adapter_card_type_ident(void);
 #endif
@@ -0,0 +1,697 @@
+/*
+ * Sandbox emulation of an SDHCI controller with an SD card attached
+ *
+ * The controller registers live in memory and are accessed through the
+ * SDHCI IO accessors, so that writing the command register can run the
+ * command against an emulated high-capacity SD card held in RAM. Data moves
+ * by PIO through the buffer data port, or by SDMA or ADMA2 straight into
+ * memory, following the descriptor table the driver set up.
+ *
+ * With "sandbox,uhs" the controller can also do 1.8V signalling, the UHS-I
+ * and HS200 timings and tuning. With "sandbox,emmc" the card is an eMMC
+ * which can do HS200 and HS400, instead of an SD card.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <errno.h>
+#include <malloc.h>
+#include <mmc.h>
+#include <sdhci.h>
+#include <asm/test.h>
+#include <asm/unaligned.h>
+
+/* Size of the emulated card, in 512-byte blocks */
+#define SB_SDHCI_CARD_BLOCKS	(2 << 11)	/* 2 MiB */
+#define SB_SDHCI_RCA		0x1234
+/* Operating conditions commands after reset until the card is powered up */
+#define SB_SDHCI_POWER_UP_POLLS	2
+/* Tuning blocks the controller needs to find its sampling point */
+#define SB_SDHCI_TUNING_BLOCKS	3
+
+struct sandbox_sdhci_plat {
+	struct mmc_config cfg;
+	struct mmc mmc;
+};
+
+/**
+ * struct sandbox_sdhci_priv - state of the emulated controller and card
+ *
+ * @host:	SDHCI host, must be first
+ * @regs:	Register file
+ * @card:	Contents of the card
+ * @app_cmd:	The next command is an application command (after CMD55)
+ * @buf:	Data returned by commands which do not access the card contents
+ * @pio_data:	Data of the current PIO transfer
+ * @pio_len:	Length of the current PIO transfer
+ * @pio_pos:	Bytes moved through the data port so far
+ * @pio_write:	The current PIO transfer is a write
+ * @emmc:	The card is an eMMC, not an SD card
+ * @s18:	The SD card has switched to 1.8V signalling
+ * @s18_switching: The SD card accepted CMD11 and holds DAT[3:0] low until
+ *		the host has moved to 1.8V with the clock stopped
+ * @s18_fail:	How the next switch to 1.8V fails, SB_SDHCI_S18_...
+ * @tuning:	Tuning blocks read in the current tuning run
+ * @block_count: Block count set by CMD23 for the next transfer, or 0
+ * @op_conds:	Operating conditions commands since the card was reset
+ * @ext_csd:	EXT_CSD register of the eMMC
+ * @stats:	What the tests look at
+ */
+struct sandbox_sdhci_priv {
+	struct sdhci_host host;
+	u8 regs[0x100];
+	u8 *card;
+	bool app_cmd;
+	u8 buf[64];
+	u8 *pio_data;
+	int pio_len;
+	int pio_pos;
+	bool pio_write;
+	bool emmc;
+	bool s18;
+	bool s18_switching;
+	int s18_fail;
+	int tuning;
+	int block_count;
+	int op_conds;
+	u8 ext_csd[MMC_MAX_BLOCK_LEN];
+	struct sandbox_sdhci_stats stats;
+};
+
+static struct sandbox_sdhci_priv *host_to_priv(struct sdhci_host *host)
+{
+	return container_of(host, struct sandbox_sdhci_priv, host);
+}
+
+static u32 reg_get(struct sandbox_sdhci_priv *priv, int reg, int size)
+{
+	u32 val = 0;
+
+	memcpy(&val, &priv->regs[reg], size);
+
+	return le32_to_cpu(val);
+}
+
+static void reg_set(struct sandbox_sdhci_priv *priv, int reg, u32 val,
+		    int size)
+{
+	val = cpu_to_le32(val);
+	memcpy(&priv->regs[reg], &val, size);
+}
+
+static void int_raise(struct sandbox_sdhci_priv *priv, u32 bits)
+{
+	u32 stat = reg_get(priv, SDHCI_INT_STATUS, 4) | bits;
+
+	if (bits & SDHCI_INT_ERROR_MASK)
+		stat |= SDHCI_INT_ERROR;
+	reg_set(priv, SDHCI_INT_STATUS, stat, 4);
+}
+
+/* Fill the response registers, which leave out the CRC of long responses */
+static void set_response(struct sandbox_sdhci_priv *priv, const u32 *resp,
+			 bool long_resp)
+{
+	int i;
+
+	memset(&priv->regs[SDHCI_RESPONSE], '\0', 16);
+	if (!long_resp) {
+		reg_set(priv, SDHCI_RESPONSE, resp[0], 4);
+		return;
+	}
+
+	/* Byte i of the register holds bits 8 * (i + 1) up of the response */
+	for (i = 0; i < 15; i++)
+		priv->regs[SDHCI_RESPONSE + i] =
+			resp[3 - (i + 1) / 4] >> (((i + 1) % 4) * 8);
+}
+
+/* Run one descriptor table, copying between memory and the card */
+static int adma_transfer(struct sandbox_sdhci_priv *priv, u8 *data, int len,
+			 bool read)
+{
+	bool adma64 = (priv->regs[SDHCI_HOST_CONTROL] & SDHCI_CTRL_DMA_MASK) ==
+		SDHCI_CTRL_ADMA64;
+	ulong addr = reg_get(priv, SDHCI_ADMA_ADDRESS, 4);
+	struct sdhci_adma_desc *desc;
+	int done = 0;
+	u8 *mem;
+
+	if (adma64)
+		addr |= (ulong)reg_get(priv, SDHCI_ADMA_ADDRESS_HI, 4) << 32;
+
+	while (1) {
+		desc = (struct sdhci_adma_desc *)addr;
+		if (!(desc->attr & ADMA_DESC_ATTR_VALID))
+			return -EINVAL;
+		if ((desc->attr & ADMA_DESC_ATTR_ACT_MASK) ==
+		    ADMA_DESC_TRANSFER_DATA) {
+			int dlen = le16_to_cpu(desc->len) ?: 65536;
+			u64 hi = adma64 ? le32_to_cpu(desc->addr_hi) : 0;
+			ulong daddr = hi << 32 | le32_to_cpu(desc->addr_lo);
+
+			/* Only 32-bit aligned addresses work in ADMA2 */
+			if ((daddr & (ADMA_ADDR_ALIGN - 1)) ||
+			    done + dlen > len)
+				return -EINVAL;
+			mem = (u8 *)daddr;
+			if (read)
+				memcpy(mem, data + done, dlen);
+			else
+				memcpy(data + done, mem, dlen);
+			done += dlen;
+			priv->stats.adma_descs++;
+		}
+		if (desc->attr & ADMA_DESC_ATTR_END)
+			break;
+		addr += adma64 ? ADMA_DESC_LEN_64 : ADMA_DESC_LEN_32;
+	}
+
+	return done == len ? 0 : -EINVAL;
+}
+
+/* Move the data of a command, by DMA if the driver asked for it */
+static void data_transfer(struct sandbox_sdhci_priv *priv, u8 *data, int len,
+			  bool read)
+{
+	u16 mode = reg_get(priv, SDHCI_TRANSFER_MODE, 2);
+	u8 *mem;
+
+	priv->stats.data_cmds++;
+	if (!(mode & SDHCI_TRNS_DMA)) {
+		/* PIO: the driver moves the data through SDHCI_BUFFER */
+		priv->pio_data = data;
+		priv->pio_pos = 0;
+		priv->pio_len = len;
+		priv->pio_write = !read;
+		int_raise(priv, read ? SDHCI_INT_DATA_AVAIL :
+			  SDHCI_INT_SPACE_AVAIL);
+		return;
+	}
+
+	switch (priv->regs[SDHCI_HOST_CONTROL] & SDHCI_CTRL_DMA_MASK) {
+	case SDHCI_CTRL_SDMA:
+		/* There is no boundary to stop at, the card is in RAM */
+		priv->stats.sdma_cmds++;
+		mem = (u8 *)(ulong)reg_get(priv, SDHCI_DMA_ADDRESS, 4);
+		if (read)
+			memcpy(mem, data, len);
+		else
+			memcpy(data, mem, len);
+		break;
+	case SDHCI_CTRL_ADMA32:
+	case SDHCI_CTRL_ADMA64:
+		priv->stats.adma_cmds++;
+		if (adma_transfer(priv, data, len, read)) {
+			int_raise(priv, SDHCI_INT_ADMA_ERROR);
+			return;
+		}
+		break;
+	default:
+		int_raise(priv, SDHCI_INT_ADMA_ERROR);
+		return;
+	}
+	int_raise(priv, SDHCI_INT_DATA_END);
+}
+
+/*
+ * The controller reads a tuning block. It finds its sampling point after a
+ * few of them, as long as the driver selected a timing which is tuned.
+ */
+static void tuning_block(struct sandbox_sdhci_priv *priv)
+{
+	u16 ctrl2 = reg_get(priv, SDHCI_HOST_CONTROL2, 2);
+	u16 uhs = ctrl2 & SDHCI_CTRL_UHS_MASK;
+
+	priv->stats.tunings++;
+	int_raise(priv, SDHCI_INT_RESPONSE | SDHCI_INT_DATA_AVAIL);
+	if (!(ctrl2 & SDHCI_CTRL_EXEC_TUNING) ||
+	    !(ctrl2 & SDHCI_CTRL_VDD_180) ||
+	    (uhs != SDHCI_CTRL_UHS_SDR50 && uhs != SDHCI_CTRL_UHS_SDR104))
+		return;
+
+	if (++priv->tuning == SB_SDHCI_TUNING_BLOCKS) {
+		priv->tuning = 0;
+		ctrl2 &= ~SDHCI_CTRL_EXEC_TUNING;
+		ctrl2 |= SDHCI_CTRL_TUNED_CLK;
+		reg_set(priv, SDHCI_HOST_CONTROL2, ctrl2, 2);
+	}
+}
+
+/* Run the command just written to SDHCI_COMMAND against the card */
+static void sb_sdhci_run_cmd(struct sandbox_sdhci_priv *priv, u16 command)
+{
+	int idx = SDHCI_GET_CMD(command);
+	u32 arg = reg_get(priv, SDHCI_ARGUMENT, 4);
+	int blksz = reg_get(priv, SDHCI_BLOCK_SIZE, 2) & 0xfff;
+	int blocks = reg_get(priv, SDHCI_BLOCK_COUNT, 2);
+	bool app_cmd = priv->app_cmd;
+	u32 resp[4] = { 0 };
+	bool long_resp = false;
+	u8 *data = NULL;
+	u32 *words = (u32 *)priv->buf;
+	bool read = true;
+	u32 funcs;
+	int len = 0;
+
+	priv->app_cmd = false;
+	priv->stats.cmds++;
+
+	switch (idx) {
+	case MMC_CMD_GO_IDLE_STATE:
+		/* The eMMC goes back to the legacy 1-bit bus */
+		priv->ext_csd[EXT_CSD_HS_TIMING] = 0;
+		priv->ext_csd[EXT_CSD_BUS_WIDTH] = 0;
+		priv->op_conds = 0;
+		priv->s18 = false;
+		priv->s18_switching = false;
+		break;
+	case MMC_CMD_SEND_OP_COND:
+		if (!priv->emmc)
+			goto unknown;
+		resp[0] = OCR_HCS | OCR_VOLTAGE_MASK;
+		if (++priv->op_conds >= SB_SDHCI_POWER_UP_POLLS)
+			resp[0] |= OCR_BUSY;
+		break;
+	case MMC_CMD_ALL_SEND_CID:
+		resp[0] = 0x1b534d53;	/* "SMS", looks like a Samsung card */
+		resp[1] = 0x414e4420;
+		resp[2] = 0x10000000;
+		resp[3] = 0x00000100;
+		long_resp = true;
+		break;
+	case SD_CMD_SEND_RELATIVE_ADDR:
+		resp[0] = SB_SDHCI_RCA << 16;
+		break;
+	case MMC_CMD_SEND_CSD:
+		/* CSD version 2.0, 25 MHz, 512-byte blocks */
+		resp[0] = 0x40000032;
+		/* or for eMMC, structure version 1.2 and spec version 4 */
+		if (priv->emmc)
+			resp[0] = 0x90000032;
+		resp[1] = 9 << 16 | ((SB_SDHCI_CARD_BLOCKS / 1024 - 1) >> 16);
+		resp[2] = (SB_SDHCI_CARD_BLOCKS / 1024 - 1) << 16;
+		resp[3] = 9 << 22;
+		long_resp = true;
+		break;
+	case MMC_CMD_STOP_TRANSMISSION:
+		priv->stats.stop_cmds++;
+		/* fall through */
+	case MMC_CMD_SELECT_CARD:
+	case MMC_CMD_SET_BLOCKLEN:
+		resp[0] = MMC_STATUS_RDY_FOR_DATA;
+		break;
+	case MMC_CMD_SET_BLOCK_COUNT:
+		priv->stats.set_count_cmds++;
+		priv->block_count = arg & 0xffff;
+		resp[0] = MMC_STATUS_RDY_FOR_DATA;
+		break;
+	case SD_CMD_SEND_IF_COND:
+		if (!priv->emmc) {
+			resp[0] = arg & 0xfff;
+			break;
+		}
+		/* MMC_CMD_SEND_EXT_CSD */
+		if (!(command & SDHCI_CMD_DATA))
+			goto unknown;
+		priv->stats.ext_csd_reads++;
+		resp[0] = MMC_STATUS_RDY_FOR_DATA;
+		data = priv->ext_csd;
+		len = sizeof(priv->ext_csd);
+		break;
+	case SD_CMD_SWITCH_UHS18V:
+		if (priv->emmc || priv->s18_fail == SB_SDHCI_S18_NO_CMD)
+			goto unknown;
+		priv->s18_switching = true;
+		resp[0] = MMC_STATUS_RDY_FOR_DATA;
+		break;
+	case SD_CMD_SEND_TUNING_BLOCK:
+	case MMC_CMD_SEND_TUNING_BLOCK_HS200:
+		if (priv->emmc != (idx == MMC_CMD_SEND_TUNING_BLOCK_HS200))
+			goto unknown;
+		tuning_block(priv);
+		return;
+	case MMC_CMD_SEND_STATUS:
+		resp[0] = MMC_STATUS_RDY_FOR_DATA | 4 << 9;	/* tran state */
+		if (!app_cmd)
+			break;
+		/* ACMD13, SD status: all zero is a card with no AU info */
+		memset(priv->buf, '\0', 64);
+		data = priv->buf;
+		len = 64;
+		break;
+	case MMC_CMD_APP_CMD:
+		if (priv->emmc)
+			goto unknown;
+		priv->app_cmd = true;
+		resp[0] = MMC_STATUS_RDY_FOR_DATA;
+		break;
+	case SD_CMD_APP_SEND_OP_COND:
+		if (!app_cmd)
+			goto unknown;
+		/* The card can do UHS-I if asked */
+		resp[0] = OCR_HCS | OCR_VOLTAGE_MASK | (arg & OCR_S18R);
+		if (++priv->op_conds >= SB_SDHCI_POWER_UP_POLLS)
+			resp[0] |= OCR_BUSY;
+		break;
+	case SD_CMD_SWITCH_FUNC:
+		if (priv->emmc) {
+			/* MMC_CMD_SWITCH, write one EXT_CSD byte */
+			if (((arg >> 16) & 0xff) == EXT_CSD_FLUSH_CACHE)
+				priv->stats.cache_flushes++;
+			else
+				priv->ext_csd[(arg >> 16) & 0xff] = arg >> 8;
+			resp[0] = MMC_STATUS_RDY_FOR_DATA;
+			break;
+		}
+		if (app_cmd) {
+			/* ACMD6, set bus width */
+			break;
+		}
+		memset(priv->buf, '\0', 64);
+		funcs = SD_HIGHSPEED_SUPPORTED;
+		if (priv->s18)
+			funcs |= SD_UHS_SDR50_SUPPORTED |
+				SD_UHS_SDR104_SUPPORTED |
+				SD_UHS_DDR50_SUPPORTED;
+		words[3] = cpu_to_be32(funcs);
+		if (arg >> 31 == SD_SWITCH_SWITCH) {
+			/* Bus speed is function group 1, bits 3:0 */
+			int func = arg & 0xf;
+
+			if (!(funcs & 1 << (16 + func)))
+				func = 0xf;
+			else
+				priv->stats.sd_speed = func;
+			words[4] = cpu_to_be32(func << 24);
+		}
+		data = priv->buf;
+		len = 64;
+		break;
+	case SD_CMD_APP_SEND_SCR:
+		if (!app_cmd)
+			goto unknown;
+		/* SD version 3.0, 1 and 4 bit bus, CMD23 */
+		words[0] = cpu_to_be32(0x02000000 | SD_DATA_4BIT | 0x10000 |
+				       0x8000 | SD_SCR_CMD23);
+		words[1] = 0;
+		data = priv->buf;
+		len = 8;
+		break;
+	case MMC_CMD_READ_SINGLE_BLOCK:
+	case MMC_CMD_READ_MULTIPLE_BLOCK:
+	case MMC_CMD_WRITE_SINGLE_BLOCK:
+	case MMC_CMD_WRITE_MULTIPLE_BLOCK:
+		read = idx == MMC_CMD_READ_SINGLE_BLOCK ||
+			idx == MMC_CMD_READ_MULTIPLE_BLOCK;
+		len = blksz * blocks;
+		/* A count set by CMD23 must match what the host sends */
+		if (priv->block_count && priv->block_count != blocks) {
+			int_raise(priv, SDHCI_INT_RESPONSE);
+			int_raise(priv, SDHCI_INT_DATA_TIMEOUT);
+			return;
+		}
+		priv->block_count = 0;
+		if (arg + blocks > SB_SDHCI_CARD_BLOCKS) {
+			int_raise(priv, SDHCI_INT_RESPONSE);
+			int_raise(priv, SDHCI_INT_DATA_TIMEOUT);
+			return;
+		}
+		data = priv->card + (ulong)arg * MMC_MAX_BLOCK_LEN;
+		resp[0] = MMC_STATUS_RDY_FOR_DATA;
+		break;
+	default:
+unknown:
+		debug("%s: Unknown command %d\n", __func__, idx);
+		int_raise(priv, SDHCI_INT_TIMEOUT);
+		return;
+	}
+
+	set_response(priv, resp, long_resp);
+	int_raise(priv, SDHCI_INT_RESPONSE);
+
+	if (data && (command & SDHCI_CMD_DATA))
+		data_transfer(priv, data, len, read);
+}
+
+/* The driver moves one word of a PIO transfer */
+static u32 pio_word(struct sandbox_sdhci_priv *priv, u32 val, bool write)
+{
+	u8 *p = priv->pio_data + priv->pio_pos;
+	u32 word = 0;
+
+	if (priv->pio_pos >= priv->pio_len)
+		return 0;
+
+	if (write)
+		memcpy(p, &val, 4);
+	else
+		memcpy(&word, p, 4);
+	priv->pio_pos += 4;
+
+	if (priv->pio_pos == priv->pio_len) {
+		int_raise(priv, SDHCI_INT_DATA_END);
+	} else if (!(priv->pio_pos % MMC_MAX_BLOCK_LEN)) {
+		int_raise(priv, priv->pio_write ? SDHCI_INT_SPACE_AVAIL :
+			  SDHCI_INT_DATA_AVAIL);
+	}
+
+	return word;
+}
+
+static u32 sb_sdhci_read(struct sdhci_host *host, int reg, int size)
+{
+	struct sandbox_sdhci_priv *priv = host_to_priv(host);
+	u32 val;
+
+	switch (reg) {
+	case SDHCI_BUFFER:
+		return pio_word(priv, 0, false);
+	case SDHCI_PRESENT_STATE:
+		val = SDHCI_CARD_PRESENT | SDHCI_CARD_STATE_STABLE;
+		if (priv->pio_pos < priv->pio_len)
+			val |= priv->pio_write ? SDHCI_SPACE_AVAILABLE :
+				SDHCI_DATA_AVAILABLE;
+		if (!priv->s18_switching)
+			val |= SDHCI_DATA_LVL_MASK;
+		return val;
+	case SDHCI_CLOCK_CONTROL:
+		/* The internal clock is stable straight away */
+		return reg_get(priv, reg, size) | SDHCI_CLOCK_INT_STABLE;
+	default:
+		return reg_get(priv, reg, size);
+	}
+}
+
+static void sb_sdhci_write(struct sdhci_host *host, u32 val, int reg,
+			   int size)
+{
+	struct sandbox_sdhci_priv *priv = host_to_priv(host);
+	u16 ctrl2;
+
+	switch (reg) {
+	case SDHCI_BUFFER:
+		pio_word(priv, val, true);
+		break;
+	case SDHCI_INT_STATUS:
+		/* Write 1 to clear */
+		reg_set(priv, reg, reg_get(priv, reg, 4) & ~val, 4);
+		if (!(reg_get(priv, reg, 4) & SDHCI_INT_ERROR_MASK))
+			reg_set(priv, reg, reg_get(priv, reg, 4) &
+				~SDHCI_INT_ERROR, 4);
+		break;
+	case SDHCI_SOFTWARE_RESET:
+		/* Reset completes at once, the register reads back 0 */
+		if (val & SDHCI_RESET_ALL) {
+			u32 caps = reg_get(priv, SDHCI_CAPABILITIES, 4);
+			u32 caps_1 = reg_get(priv, SDHCI_CAPABILITIES_1, 4);
+			u16 version = reg_get(priv, SDHCI_HOST_VERSION, 2);
+
+			memset(priv->regs, '\0', sizeof(priv->regs));
+			reg_set(priv, SDHCI_CAPABILITIES, caps, 4);
+			reg_set(priv, SDHCI_CAPABILITIES_1, caps_1, 4);
+			reg_set(priv, SDHCI_HOST_VERSION, version, 2);
+		}
+		priv->pio_len = 0;
+		priv->pio_pos = 0;
+		break;
+	case SDHCI_COMMAND:
+		reg_set(priv, reg, val, size);
+		sb_sdhci_run_cmd(priv, val);
+		break;
+	case SDHCI_CLOCK_CONTROL:
+		/* The card switches when the clock restarts at 1.8V */
+		ctrl2 = reg_get(priv, SDHCI_HOST_CONTROL2, 2);
+		if (priv->s18_switching && (val & SDHCI_CLOCK_CARD_EN) &&
+		    (ctrl2 & SDHCI_CTRL_VDD_180) &&
+		    priv->s18_fail != SB_SDHCI_S18_DAT_LOW) {
+			priv->s18_switching = false;
+			priv->s18 = true;
+		}
+		reg_set(priv, reg, val, size);
+		break;
+	default:
+		reg_set(priv, reg, val, size);
+		break;
+	}
+}
+
+static u32 sb_sdhci_read_l(struct sdhci_host *host, int reg)
+{
+	return sb_sdhci_read(host, reg, 4);
+}
+
+static u16 sb_sdhci_read_w(struct sdhci_host *host, int reg)
+{
+	return sb_sdhci_read(host, reg, 2);
+}
+
+static u8 sb_sdhci_read_b(struct sdhci_host *host, int reg)
+{
+	return sb_sdhci_read(host, reg, 1);
+}
+
+static void sb_sdhci_write_l(struct sdhci_host *host, u32 val, int reg)
+{
+	sb_sdhci_write(host, val, reg, 4);
+}
+
+static void sb_sdhci_write_w(struct sdhci_host *host, u16 val, int reg)
+{
+	sb_sdhci_write(host, val, reg, 2);
+}
+
+static void sb_sdhci_write_b(struct sdhci_host *host, u8 val, int reg)
+{
+	sb_sdhci_write(host, val, reg, 1);
+}
+
+static const struct sdhci_ops sandbox_sdhci_ops = {
+	.read_l		= sb_sdhci_read_l,
+	.read_w		= sb_sdhci_read_w,
+	.read_b		= sb_sdhci_read_b,
+	.write_l	= sb_sdhci_write_l,
+	.write_w	= sb_sdhci_write_w,
+	.write_b	= sb_sdhci_write_b,
+};
+
+void sandbox_sdhci_get_stats(struct udevice *dev,
+			     struct sandbox_sdhci_stats *stats)
+{
+	struct sandbox_sdhci_priv *priv = dev_get_priv(dev);
+
+	*stats = priv->stats;
+	stats->hs_timing = priv->ext_csd[EXT_CSD_HS_TIMING];
+	stats->bus_width = priv->ext_csd[EXT_CSD_BUS_WIDTH];
+}
+
+void sandbox_sdhci_s18_fail(struct udevice *dev, int fail)
+{
+	struct sandbox_sdhci_priv *priv = dev_get_priv(dev);
+
+	priv->s18_fail = fail;
+}
+
+void sandbox_sdhci_reset_stats(struct udevice *dev)
+{
+	struct sandbox_sdhci_priv *priv = dev_get_priv(dev);
+
+	memset(&priv->stats, '\0', sizeof(priv->stats));
+}
+
+static int sandbox_sdhci_probe(struct udevice *dev)
+{
+	struct mmc_uclass_priv *upriv = dev_get_uclass_priv(dev);
+	struct sandbox_sdhci_plat *plat = dev_get_platdata(dev);
+	struct sandbox_sdhci_priv *priv = dev_get_priv(dev);
+	struct sdhci_host *host = &priv->host;
+	u32 caps, caps_1 = 0;
+	int ret;
+
+	priv->card = calloc(SB_SDHCI_CARD_BLOCKS, MMC_MAX_BLOCK_LEN);
+	if (!priv->card)
+		return -ENOMEM;
+
+	/* A version 3.00 controller with a 50 MHz base clock */
+	caps = SDHCI_CAN_VDD_330 | SDHCI_CAN_DO_HISPD | SDHCI_CAN_DO_SDMA |
+		50 << SDHCI_CLOCK_BASE_SHIFT;
+	if (!dev_read_bool(dev, "sandbox,no-adma"))
+		caps |= SDHCI_CAN_DO_ADMA2 | SDHCI_CAN_64BIT;
+	/* or 200 MHz, for UHS-I and HS200 */
+	if (dev_read_bool(dev, "sandbox,uhs")) {
+		caps &= ~SDHCI_CLOCK_V3_BASE_MASK;
+		caps |= SDHCI_CAN_VDD_180 | 200 << SDHCI_CLOCK_BASE_SHIFT;
+		caps_1 = SDHCI_SUPPORT_SDR50 | SDHCI_SUPPORT_SDR104 |
+			SDHCI_SUPPORT_DDR50 | SDHCI_USE_SDR50_TUNING;
+	}
+	reg_set(priv, SDHCI_CAPABILITIES, caps, 4);
+	reg_set(priv, SDHCI_CAPABILITIES_1, caps_1, 4);
+	reg_set(priv, SDHCI_HOST_VERSION, SDHCI_SPEC_300, 2);
+
+	priv->emmc = dev_read_bool(dev, "sandbox,emmc");
+	if (priv->emmc) {
+		u8 *ext_csd = priv->ext_csd;
+
+		ext_csd[EXT_CSD_REV] = 7;	/* eMMC 5.0 */
+		ext_csd[EXT_CSD_CARD_TYPE] = EXT_CSD_CARD_TYPE_26 |
+			EXT_CSD_CARD_TYPE_52 | EXT_CSD_CARD_TYPE_DDR_1_8V |
+			EXT_CSD_CARD_TYPE_HS200_1_8V |
+			EXT_CSD_CARD_TYPE_HS400_1_8V;
+		put_unaligned_le32(SB_SDHCI_CARD_BLOCKS,
+				   &ext_csd[EXT_CSD_SEC_CNT]);
+		/* 64 KiB of cache */
+		put_unaligned_le32(64, &ext_csd[EXT_CSD_CACHE_SIZE]);
+		caps |= SDHCI_CAN_DO_8BIT;
+		reg_set(priv, SDHCI_CAPABILITIES, caps, 4);
+		host->host_caps = MMC_MODE_8BIT | MMC_MODE_HS400;
+	}
+
+	host->name = dev->name;
+	host->ops = &sandbox_sdhci_ops;
+	ret = sdhci_setup_cfg(&plat->cfg, host, 0, 400000);
+	if (ret)
+		return ret;
+
+	host->mmc = &plat->mmc;
+	host->mmc->priv = host;
+	host->mmc->dev = dev;
+	upriv->mmc = host->mmc;
+
+	return sdhci_probe(dev);
+}
+
+static int sandbox_sdhci_remove(struct udevice *dev)
+{
+	struct sandbox_sdhci_priv *priv = dev_get_priv(dev);
+
+	free(priv->card);
+	free(priv->host.adma_desc_table);
+
+	return 0;
+}
+
+static int sandbox_sdhci_bind(struct udevice *dev)
+{
+	struct sandbox_sdhci_plat *plat = dev_get_platdata(dev);
+
+	return sdhci_bind(dev, &plat->mmc, &plat->cfg);
+}
+
+static const struct udevice_id sandbox_sdhci_ids[] = {
+	{ .compatible = "sandbox,sdhci" },
+	{ }
+};
+
+U_BOOT_DRIVER(sdhci_sandbox) = {
+	.name		= "sdhci_sandbox",
+	.id		= UCLASS_MMC,
+	.of_match	= sandbox_sdhci_ids,
+	.ops		= &sdhci_ops,
+	.bind		= sandbox_sdhci_bind,
+	.probe		= sandbox_sdhci_probe,
+	.remove		= sandbox_sdhci_remove,
+	.priv_auto_alloc_size = sizeof(struct sandbox_sdhci_priv),
+	.platdata_auto_alloc_size = sizeof(struct sandbox_sdhci_plat),
+};
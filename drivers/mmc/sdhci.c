@@ -68,18 +68,150 @@ static void sdhci_transfer_pio(struct sdhci_host *host, struct mmc_data *data)
 	}
 }
 
-static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data,
-				unsigned int start_addr)
+#ifdef CONFIG_MMC_SDHCI_ADMA
+static void sdhci_adma_write_desc(struct sdhci_host *host, char **desc,
+				  dma_addr_t addr, int len, bool end)
 {
-	unsigned int stat, rdy, mask, timeout, block = 0;
-	bool transfer_done = false;
-#ifdef CONFIG_MMC_SDHCI_SDMA
-	unsigned char ctrl;
+	struct sdhci_adma_desc *d = (struct sdhci_adma_desc *)*desc;
+
+	d->attr = ADMA_DESC_ATTR_VALID | ADMA_DESC_TRANSFER_DATA;
+	if (end)
+		d->attr |= ADMA_DESC_ATTR_END;
+	d->reserved = 0;
+	d->len = cpu_to_le16(len);
+	d->addr_lo = cpu_to_le32(lower_32_bits(addr));
+	if (host->flags & USE_ADMA64) {
+		d->addr_hi = cpu_to_le32(upper_32_bits(addr));
+		*desc += ADMA_DESC_LEN_64;
+	} else {
+		*desc += ADMA_DESC_LEN_32;
+	}
+}
+
+/*
+ * Describe a transfer of trans_bytes at addr in the descriptor table. Any
+ * unaligned head of the buffer goes through host->adma_align, the rest is
+ * moved in place however it crosses page or boundary limits.
+ *
+ * Returns 0 if OK, -EINVAL if the controller cannot reach the buffer.
+ */
+static int sdhci_prepare_adma_table(struct sdhci_host *host,
+				    struct mmc_data *data, dma_addr_t addr,
+				    int trans_bytes)
+{
+	char *desc = host->adma_desc_table;
+	int head, len;
+
+	if (!(host->flags & USE_ADMA64) &&
+	    (upper_32_bits(addr + trans_bytes - 1) ||
+	     upper_32_bits((ulong)host->adma_desc_table)))
+		return -EINVAL;
+
+	head = (ADMA_ADDR_ALIGN - (addr & (ADMA_ADDR_ALIGN - 1))) &
+		(ADMA_ADDR_ALIGN - 1);
+	head = min(head, trans_bytes);
+	host->adma_head = head;
+	if (head) {
+		if (data->flags != MMC_DATA_READ)
+			memcpy(host->adma_align, data->src, head);
+		sdhci_adma_write_desc(host, &desc, (ulong)host->adma_align,
+				      head, head == trans_bytes);
+		addr += head;
+		trans_bytes -= head;
+	}
+
+	while (trans_bytes) {
+		len = min(trans_bytes, ADMA_MAX_LEN);
+		trans_bytes -= len;
+		sdhci_adma_write_desc(host, &desc, addr, len, !trans_bytes);
+		addr += len;
+	}
+
+	flush_cache((ulong)host->adma_desc_table,
+		    ALIGN(desc - (char *)host->adma_desc_table,
+			  ARCH_DMA_MINALIGN));
+	if (head)
+		flush_cache((ulong)host->adma_align, ARCH_DMA_MINALIGN);
+
+	return 0;
+}
+#endif
+
+#if defined(CONFIG_MMC_SDHCI_SDMA) || defined(CONFIG_MMC_SDHCI_ADMA)
+/*
+ * Set up the controller to move the data of a transfer by DMA.
+ *
+ * Returns 0 if OK, or < 0 if the transfer must fall back to PIO.
+ */
+static int sdhci_prepare_dma(struct sdhci_host *host, struct mmc_data *data,
+			     int trans_bytes, unsigned int *start_addr,
+			     int *is_aligned)
+{
+	u8 ctrl, dma_mode = SDHCI_CTRL_SDMA;
+	dma_addr_t addr;
+
+	if (data->flags == MMC_DATA_READ)
+		addr = (ulong)data->dest;
+	else
+		addr = (ulong)data->src;
+
+#ifdef CONFIG_MMC_SDHCI_ADMA
+	if (host->flags & USE_ADMA) {
+		ulong table = (ulong)host->adma_desc_table;
+
+		if (sdhci_prepare_adma_table(host, data, addr, trans_bytes))
+			return -EINVAL;
+		if (host->flags & USE_ADMA64) {
+			dma_mode = SDHCI_CTRL_ADMA64;
+			sdhci_writel(host, upper_32_bits(table),
+				     SDHCI_ADMA_ADDRESS_HI);
+		} else {
+			dma_mode = SDHCI_CTRL_ADMA32;
+		}
+		sdhci_writel(host, lower_32_bits(table), SDHCI_ADMA_ADDRESS);
+	} else
+#endif
+	{
+		if ((host->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR) &&
+				(addr & 0x7) != 0x0) {
+			*is_aligned = 0;
+			addr = (unsigned long)aligned_buffer;
+			if (data->flags != MMC_DATA_READ)
+				memcpy(aligned_buffer, data->src, trans_bytes);
+		}
+
+#if defined(CONFIG_FIXED_SDHCI_ALIGNED_BUFFER)
+		/*
+		 * Always use this bounce-buffer when
+		 * CONFIG_FIXED_SDHCI_ALIGNED_BUFFER is defined
+		 */
+		*is_aligned = 0;
+		addr = (unsigned long)aligned_buffer;
+		if (data->flags != MMC_DATA_READ)
+			memcpy(aligned_buffer, data->src, trans_bytes);
+#endif
+
+		sdhci_writel(host, addr, SDHCI_DMA_ADDRESS);
+		*start_addr = addr;
+	}
+
 	ctrl = sdhci_readb(host, SDHCI_HOST_CONTROL);
 	ctrl &= ~SDHCI_CTRL_DMA_MASK;
+	ctrl |= dma_mode;
 	sdhci_writeb(host, ctrl, SDHCI_HOST_CONTROL);
+
+	flush_cache(addr, ALIGN(trans_bytes, CONFIG_SYS_CACHELINE_SIZE));
+
+	return 0;
+}
 #endif
 
+static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data,
+				unsigned int start_addr)
+{
+	unsigned int stat, rdy, mask, timeout, block = 0;
+	bool transfer_done = false;
+
 	timeout = 1000000;
 	rdy = SDHCI_INT_SPACE_AVAIL | SDHCI_INT_DATA_AVAIL;
 	mask = SDHCI_DATA_AVAILABLE | SDHCI_SPACE_AVAILABLE;
@@ -106,7 +238,8 @@ static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data,
 			}
 		}
 #ifdef CONFIG_MMC_SDHCI_SDMA
-		if (!transfer_done && (stat & SDHCI_INT_DMA_END)) {
+		if (!transfer_done && (host->flags & USE_SDMA) &&
+		    (stat & SDHCI_INT_DMA_END)) {
 			sdhci_writel(host, SDHCI_INT_DMA_END, SDHCI_INT_STATUS);
 			start_addr &= ~(SDHCI_DEFAULT_BOUNDARY_SIZE - 1);
 			start_addr += SDHCI_DEFAULT_BOUNDARY_SIZE;
@@ -133,6 +266,9 @@ static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data,
 #define SDHCI_CMD_MAX_TIMEOUT			3200
 #define SDHCI_CMD_DEFAULT_TIMEOUT		100
 #define SDHCI_READ_STATUS_TIMEOUT		1000
+/* Tuning gives up after this many blocks, each waited for this many ms */
+#define SDHCI_MAX_TUNING_LOOP			40
+#define SDHCI_TUNING_TIMEOUT			50
 
 #ifdef CONFIG_DM_MMC
 static int sdhci_send_command(struct udevice *dev, struct mmc_cmd *cmd,
@@ -149,6 +285,7 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 	unsigned int stat = 0;
 	int ret = 0;
 	int trans_bytes = 0, is_aligned = 1;
+	bool dma = false;
 	u32 mask, flags, mode;
 	unsigned int time = 0, start_addr = 0;
 	int mmc_dev = mmc_get_blk_desc(mmc)->devnum;
@@ -211,32 +348,13 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 		if (data->flags == MMC_DATA_READ)
 			mode |= SDHCI_TRNS_READ;
 
-#ifdef CONFIG_MMC_SDHCI_SDMA
-		if (data->flags == MMC_DATA_READ)
-			start_addr = (unsigned long)data->dest;
-		else
-			start_addr = (unsigned long)data->src;
-		if ((host->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR) &&
-				(start_addr & 0x7) != 0x0) {
-			is_aligned = 0;
-			start_addr = (unsigned long)aligned_buffer;
-			if (data->flags != MMC_DATA_READ)
-				memcpy(aligned_buffer, data->src, trans_bytes);
+#if defined(CONFIG_MMC_SDHCI_SDMA) || defined(CONFIG_MMC_SDHCI_ADMA)
+		if ((host->flags & (USE_SDMA | USE_ADMA)) &&
+		    !sdhci_prepare_dma(host, data, trans_bytes, &start_addr,
+				       &is_aligned)) {
+			dma = true;
+			mode |= SDHCI_TRNS_DMA;
 		}
-
-#if defined(CONFIG_FIXED_SDHCI_ALIGNED_BUFFER)
-		/*
-		 * Always use this bounce-buffer when
-		 * CONFIG_FIXED_SDHCI_ALIGNED_BUFFER is defined
-		 */
-		is_aligned = 0;
-		start_addr = (unsigned long)aligned_buffer;
-		if (data->flags != MMC_DATA_READ)
-			memcpy(aligned_buffer, data->src, trans_bytes);
-#endif
-
-		sdhci_writel(host, start_addr, SDHCI_DMA_ADDRESS);
-		mode |= SDHCI_TRNS_DMA;
 #endif
 		sdhci_writew(host, SDHCI_MAKE_BLKSZ(SDHCI_DEFAULT_BOUNDARY_ARG,
 				data->blocksize),
@@ -248,12 +366,6 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 	}
 
 	sdhci_writel(host, cmd->cmdarg, SDHCI_ARGUMENT);
-#ifdef CONFIG_MMC_SDHCI_SDMA
-	if (data != 0) {
-		trans_bytes = ALIGN(trans_bytes, CONFIG_SYS_CACHELINE_SIZE);
-		flush_cache(start_addr, trans_bytes);
-	}
-#endif
 	sdhci_writew(host, SDHCI_MAKE_CMD(cmd->cmdidx, flags), SDHCI_COMMAND);
 	start = get_timer(0);
 	do {
@@ -290,6 +402,11 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 		if ((host->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR) &&
 				!is_aligned && (data->flags == MMC_DATA_READ))
 			memcpy(data->dest, aligned_buffer, trans_bytes);
+#ifdef CONFIG_MMC_SDHCI_ADMA
+		if (dma && (host->flags & USE_ADMA) && host->adma_head &&
+		    data->flags == MMC_DATA_READ)
+			memcpy(data->dest, host->adma_align, host->adma_head);
+#endif
 		return 0;
 	}
 
@@ -422,6 +539,51 @@ static void sdhci_set_power(struct sdhci_host *host, unsigned short power)
 	sdhci_writeb(host, pwr, SDHCI_POWER_CONTROL);
 }
 
+#ifdef CONFIG_MMC_IO_VOLTAGE
+/*
+ * Program the UHS mode select and 1.8V signalling bits for the timing and
+ * voltage the core asked for. Returns true if they changed, in which case
+ * the SD clock has been stopped and must be set up again.
+ */
+static bool sdhci_set_uhs(struct sdhci_host *host, struct mmc *mmc)
+{
+	u16 old, ctrl2;
+
+	old = sdhci_readw(host, SDHCI_HOST_CONTROL2);
+	ctrl2 = old & ~(SDHCI_CTRL_UHS_MASK | SDHCI_CTRL_VDD_180);
+	switch (mmc->timing) {
+	case MMC_TIMING_UHS_SDR50:
+		ctrl2 |= SDHCI_CTRL_UHS_SDR50;
+		break;
+	case MMC_TIMING_UHS_SDR104:
+	case MMC_TIMING_MMC_HS200:
+		ctrl2 |= SDHCI_CTRL_UHS_SDR104;
+		break;
+	case MMC_TIMING_UHS_DDR50:
+		ctrl2 |= SDHCI_CTRL_UHS_DDR50;
+		break;
+	case MMC_TIMING_MMC_HS400:
+		ctrl2 |= SDHCI_CTRL_HS400;
+		break;
+	}
+	if (mmc->signal_voltage == MMC_SIGNAL_VOLTAGE_180)
+		ctrl2 |= SDHCI_CTRL_VDD_180;
+	if (ctrl2 == old)
+		return false;
+
+	/* The SD clock must be off while these change */
+	sdhci_writew(host, sdhci_readw(host, SDHCI_CLOCK_CONTROL) &
+		     ~SDHCI_CLOCK_CARD_EN, SDHCI_CLOCK_CONTROL);
+	sdhci_writew(host, ctrl2, SDHCI_HOST_CONTROL2);
+
+	/* Give the 1.8V regulator 5 ms to settle */
+	if ((ctrl2 ^ old) & SDHCI_CTRL_VDD_180)
+		mdelay(5);
+
+	return true;
+}
+#endif
+
 #ifdef CONFIG_DM_MMC
 static int sdhci_set_ios(struct udevice *dev)
 {
@@ -432,11 +594,19 @@ static int sdhci_set_ios(struct mmc *mmc)
 #endif
 	u32 ctrl;
 	struct sdhci_host *host = mmc->priv;
+	bool clock_stopped = false;
 
 	if (host->ops && host->ops->set_control_reg)
 		host->ops->set_control_reg(host);
 
-	if (mmc->clock != host->clock)
+#ifdef CONFIG_MMC_IO_VOLTAGE
+	if (SDHCI_GET_VERSION(host) >= SDHCI_SPEC_300)
+		clock_stopped = sdhci_set_uhs(host, mmc);
+#endif
+
+	if (mmc->clk_disable)
+		sdhci_set_clock(mmc, 0);
+	else if (mmc->clock != host->clock || clock_stopped)
 		sdhci_set_clock(mmc, mmc->clock);
 
 	/* Set bus width */
@@ -473,6 +643,79 @@ static int sdhci_set_ios(struct mmc *mmc)
 	return 0;
 }
 
+#ifdef CONFIG_MMC_IO_VOLTAGE
+/*
+ * Run the standard tuning procedure: the controller reads tuning blocks
+ * itself and moves its sampling point until it gets them right, or gives
+ * up.
+ */
+#ifdef CONFIG_DM_MMC
+static int sdhci_execute_tuning(struct udevice *dev, uint opcode)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev);
+#else
+static int sdhci_execute_tuning(struct mmc *mmc, uint opcode)
+{
+#endif
+	struct sdhci_host *host = mmc->priv;
+	uint flags = SDHCI_CMD_RESP_SHORT | SDHCI_CMD_CRC | SDHCI_CMD_INDEX |
+		SDHCI_CMD_DATA;
+	int blksz = 64;
+	ulong start;
+	u16 ctrl2;
+	int i;
+
+	/* SDR50 only needs tuning on controllers which say so */
+	if (mmc->timing == MMC_TIMING_UHS_SDR50 &&
+	    !(sdhci_readl(host, SDHCI_CAPABILITIES_1) & SDHCI_USE_SDR50_TUNING))
+		return 0;
+
+	if (opcode == MMC_CMD_SEND_TUNING_BLOCK_HS200 && mmc->bus_width == 8)
+		blksz = 128;
+
+	ctrl2 = sdhci_readw(host, SDHCI_HOST_CONTROL2);
+	ctrl2 &= ~SDHCI_CTRL_TUNED_CLK;
+	ctrl2 |= SDHCI_CTRL_EXEC_TUNING;
+	sdhci_writew(host, ctrl2, SDHCI_HOST_CONTROL2);
+
+	for (i = 0; i < SDHCI_MAX_TUNING_LOOP; i++) {
+		sdhci_writel(host, SDHCI_INT_ALL_MASK, SDHCI_INT_STATUS);
+		sdhci_writew(host, SDHCI_MAKE_BLKSZ(SDHCI_DEFAULT_BOUNDARY_ARG,
+						    blksz), SDHCI_BLOCK_SIZE);
+		sdhci_writew(host, 1, SDHCI_BLOCK_COUNT);
+		sdhci_writew(host, SDHCI_TRNS_READ, SDHCI_TRANSFER_MODE);
+		sdhci_writel(host, 0, SDHCI_ARGUMENT);
+		sdhci_writew(host, SDHCI_MAKE_CMD(opcode, flags),
+			     SDHCI_COMMAND);
+
+		/* The block stays in the controller, just wait for it */
+		start = get_timer(0);
+		while (!(sdhci_readl(host, SDHCI_INT_STATUS) &
+			 SDHCI_INT_DATA_AVAIL)) {
+			if (get_timer(start) > SDHCI_TUNING_TIMEOUT)
+				break;
+		}
+
+		ctrl2 = sdhci_readw(host, SDHCI_HOST_CONTROL2);
+		if (!(ctrl2 & SDHCI_CTRL_EXEC_TUNING))
+			break;
+	}
+	sdhci_writel(host, SDHCI_INT_ALL_MASK, SDHCI_INT_STATUS);
+
+	if ((ctrl2 & SDHCI_CTRL_EXEC_TUNING) ||
+	    !(ctrl2 & SDHCI_CTRL_TUNED_CLK)) {
+		printf("%s: Tuning failed\n", __func__);
+		ctrl2 &= ~(SDHCI_CTRL_EXEC_TUNING | SDHCI_CTRL_TUNED_CLK);
+		sdhci_writew(host, ctrl2, SDHCI_HOST_CONTROL2);
+		sdhci_reset(host, SDHCI_RESET_CMD);
+		sdhci_reset(host, SDHCI_RESET_DATA);
+		return -EIO;
+	}
+
+	return 0;
+}
+#endif
+
 static int sdhci_init(struct mmc *mmc)
 {
 	struct sdhci_host *host = mmc->priv;
@@ -502,6 +745,23 @@ static int sdhci_init(struct mmc *mmc)
 	return 0;
 }
 
+#ifdef CONFIG_MMC_UHS_SUPPORT
+#ifdef CONFIG_DM_MMC
+static int sdhci_card_busy(struct udevice *dev)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev);
+#else
+static int sdhci_card_busy(struct mmc *mmc)
+{
+#endif
+	struct sdhci_host *host = mmc->priv;
+	u32 state = sdhci_readl(host, SDHCI_PRESENT_STATE);
+
+	/* The card holds DAT[3:0] low while it is busy */
+	return (state & SDHCI_DATA_LVL_MASK) != SDHCI_DATA_LVL_MASK;
+}
+#endif
+
 #ifdef CONFIG_DM_MMC
 int sdhci_probe(struct udevice *dev)
 {
@@ -513,27 +773,57 @@ int sdhci_probe(struct udevice *dev)
 const struct dm_mmc_ops sdhci_ops = {
 	.send_cmd	= sdhci_send_command,
 	.set_ios	= sdhci_set_ios,
+#ifdef CONFIG_MMC_IO_VOLTAGE
+	.execute_tuning	= sdhci_execute_tuning,
+#endif
+#ifdef CONFIG_MMC_UHS_SUPPORT
+	.card_busy	= sdhci_card_busy,
+#endif
 };
 #else
 static const struct mmc_ops sdhci_ops = {
 	.send_cmd	= sdhci_send_command,
 	.set_ios	= sdhci_set_ios,
 	.init		= sdhci_init,
+#ifdef CONFIG_MMC_IO_VOLTAGE
+	.execute_tuning	= sdhci_execute_tuning,
+#endif
+#ifdef CONFIG_MMC_UHS_SUPPORT
+	.card_busy	= sdhci_card_busy,
+#endif
 };
 #endif
 
 int sdhci_setup_cfg(struct mmc_config *cfg, struct sdhci_host *host,
 		u32 f_max, u32 f_min)
 {
-	u32 caps, caps_1;
+	u32 caps, caps_1 = 0;
 
 	caps = sdhci_readl(host, SDHCI_CAPABILITIES);
 
+	host->flags = 0;
+#ifdef CONFIG_MMC_SDHCI_ADMA
+	if (caps & SDHCI_CAN_DO_ADMA2) {
+		if (!host->adma_desc_table)
+			host->adma_desc_table = memalign(ARCH_DMA_MINALIGN,
+				ADMA_TABLE_SZ + ARCH_DMA_MINALIGN);
+		if (host->adma_desc_table) {
+			host->adma_align = host->adma_desc_table +
+				ADMA_TABLE_SZ;
+			host->flags |= USE_ADMA;
+			if ((caps & SDHCI_CAN_64BIT) && sizeof(dma_addr_t) > 4)
+				host->flags |= USE_ADMA64;
+		}
+	}
+#endif
 #ifdef CONFIG_MMC_SDHCI_SDMA
-	if (!(caps & SDHCI_CAN_DO_SDMA)) {
-		printf("%s: Your controller doesn't support SDMA!!\n",
-		       __func__);
-		return -EINVAL;
+	if (!(host->flags & USE_ADMA)) {
+		if (!(caps & SDHCI_CAN_DO_SDMA)) {
+			printf("%s: Your controller doesn't support SDMA!!\n",
+			       __func__);
+			return -EINVAL;
+		}
+		host->flags |= USE_SDMA;
 	}
 #endif
 	if (host->quirks & SDHCI_QUIRK_REG32_RW)
@@ -593,7 +883,9 @@ int sdhci_setup_cfg(struct mmc_config *cfg, struct sdhci_host *host,
 	if (host->quirks & SDHCI_QUIRK_BROKEN_VOLTAGE)
 		cfg->voltages |= host->voltages;
 
-	cfg->host_caps = MMC_MODE_HS | MMC_MODE_HS_52MHz | MMC_MODE_4BIT;
+	/* The block count register ends a transfer started after CMD23 */
+	cfg->host_caps = MMC_MODE_HS | MMC_MODE_HS_52MHz | MMC_MODE_4BIT |
+		MMC_MODE_CMD23;
 
 	/* Since Host Controller Version3.0 */
 	if (SDHCI_GET_VERSION(host) >= SDHCI_SPEC_300) {
@@ -601,6 +893,27 @@ int sdhci_setup_cfg(struct mmc_config *cfg, struct sdhci_host *host,
 			cfg->host_caps &= ~MMC_MODE_8BIT;
 	}
 
+#ifdef CONFIG_MMC_UHS_SUPPORT
+	if (caps & SDHCI_CAN_VDD_180) {
+		if (caps_1 & SDHCI_SUPPORT_SDR104)
+			cfg->host_caps |= MMC_MODE_UHS_SDR104 |
+				MMC_MODE_UHS_SDR50;
+		if (caps_1 & SDHCI_SUPPORT_SDR50)
+			cfg->host_caps |= MMC_MODE_UHS_SDR50;
+		if (caps_1 & SDHCI_SUPPORT_DDR50)
+			cfg->host_caps |= MMC_MODE_UHS_DDR50;
+	}
+#endif
+#ifdef CONFIG_MMC_HS200_SUPPORT
+	/*
+	 * HS200 uses the SDR104 timing. There is no standard way to tell
+	 * whether the controller can do HS400, so drivers must add
+	 * MMC_MODE_HS400 to host_caps themselves.
+	 */
+	if (caps_1 & SDHCI_SUPPORT_SDR104)
+		cfg->host_caps |= MMC_MODE_HS200;
+#endif
+
 	if (host->host_caps)
 		cfg->host_caps |= host->host_caps;
 
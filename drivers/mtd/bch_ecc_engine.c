@@ -0,0 +1,133 @@
+/*
+ * Software BCH ECC engine, using the generic BCH library lib/bch.c
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <ecc_engine.h>
+#include <errno.h>
+#include <malloc.h>
+#include <linux/bch.h>
+#include <linux/bitops.h>
+
+/**
+ * struct bch_ecc_engine_priv - Private data for the software BCH engine
+ *
+ * @bch:	BCH control structure
+ * @errloc:	Error locations returned by decode_bch()
+ * @eccmask:	XOR mask which makes an erased step a valid codeword
+ */
+struct bch_ecc_engine_priv {
+	struct bch_control *bch;
+	unsigned int *errloc;
+	u8 *eccmask;
+};
+
+static int bch_ecc_engine_calculate(struct udevice *dev, const u8 *data,
+				    u8 *ecc)
+{
+	struct ecc_engine_uc_priv *uc_priv = dev_get_uclass_priv(dev);
+	struct bch_ecc_engine_priv *priv = dev_get_priv(dev);
+	unsigned int i;
+
+	memset(ecc, '\0', uc_priv->bytes);
+	encode_bch(priv->bch, data, uc_priv->step_size, ecc);
+	for (i = 0; i < uc_priv->bytes; i++)
+		ecc[i] ^= priv->eccmask[i];
+
+	return 0;
+}
+
+static int bch_ecc_engine_correct(struct udevice *dev, u8 *data,
+				  const u8 *read_ecc, const u8 *calc_ecc)
+{
+	struct ecc_engine_uc_priv *uc_priv = dev_get_uclass_priv(dev);
+	struct bch_ecc_engine_priv *priv = dev_get_priv(dev);
+	unsigned int *errloc = priv->errloc;
+	int i, count;
+
+	count = decode_bch(priv->bch, NULL, uc_priv->step_size, read_ecc,
+			   calc_ecc, NULL, errloc);
+	if (count < 0)
+		return -EBADMSG;
+
+	for (i = 0; i < count; i++) {
+		/* Errors in the ECC itself need no action */
+		if (errloc[i] < uc_priv->step_size * 8)
+			data[errloc[i] >> 3] ^= 1 << (errloc[i] & 7);
+	}
+
+	return count;
+}
+
+static int bch_ecc_engine_probe(struct udevice *dev)
+{
+	struct ecc_engine_uc_priv *uc_priv = dev_get_uclass_priv(dev);
+	struct bch_ecc_engine_priv *priv = dev_get_priv(dev);
+	unsigned int m, i;
+	u8 *erased;
+
+	uc_priv->step_size = dev_read_u32_default(dev, "nand-ecc-step-size",
+						  512);
+	uc_priv->strength = dev_read_u32_default(dev, "nand-ecc-strength", 4);
+
+	/* Smallest field which holds the data and the ECC */
+	m = fls(1 + 8 * uc_priv->step_size);
+	priv->bch = init_bch(m, uc_priv->strength, 0);
+	if (!priv->bch)
+		return -EINVAL;
+	uc_priv->bytes = priv->bch->ecc_bytes;
+
+	priv->errloc = calloc(uc_priv->strength, sizeof(*priv->errloc));
+	priv->eccmask = calloc(1, uc_priv->bytes);
+	erased = malloc(uc_priv->step_size);
+	if (!priv->errloc || !priv->eccmask || !erased) {
+		free(erased);
+		free(priv->eccmask);
+		free(priv->errloc);
+		free_bch(priv->bch);
+		return -ENOMEM;
+	}
+
+	/* An erased step must decode without errors */
+	memset(erased, 0xff, uc_priv->step_size);
+	encode_bch(priv->bch, erased, uc_priv->step_size, priv->eccmask);
+	free(erased);
+	for (i = 0; i < uc_priv->bytes; i++)
+		priv->eccmask[i] ^= 0xff;
+
+	return 0;
+}
+
+static int bch_ecc_engine_remove(struct udevice *dev)
+{
+	struct bch_ecc_engine_priv *priv = dev_get_priv(dev);
+
+	free(priv->eccmask);
+	free(priv->errloc);
+	free_bch(priv->bch);
+
+	return 0;
+}
+
+static const struct ecc_engine_ops bch_ecc_engine_ops = {
+	.calculate	= bch_ecc_engine_calculate,
+	.correct	= bch_ecc_engine_correct,
+};
+
+static const struct udevice_id bch_ecc_engine_ids[] = {
+	{ .compatible = "u-boot,bch-ecc-engine" },
+	{ }
+};
+
+U_BOOT_DRIVER(bch_ecc_engine) = {
+	.name		= "bch_ecc_engine",
+	.id		= UCLASS_ECC_ENGINE,
+	.of_match	= bch_ecc_engine_ids,
+	.ops		= &bch_ecc_engine_ops,
+	.probe		= bch_ecc_engine_probe,
+	.remove		= bch_ecc_engine_remove,
+	.priv_auto_alloc_size = sizeof(struct bch_ecc_engine_priv),
+};
@@ -0,0 +1,56 @@
+/*
+ * ECC engine uclass
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <ecc_engine.h>
+#include <errno.h>
+
+int ecc_engine_calculate(struct udevice *dev, const u8 *data, u8 *ecc)
+{
+	struct ecc_engine_ops *ops = ecc_engine_get_ops(dev);
+
+	if (!ops->calculate)
+		return -ENOSYS;
+
+	return ops->calculate(dev, data, ecc);
+}
+
+int ecc_engine_correct(struct udevice *dev, u8 *data, const u8 *read_ecc,
+		       const u8 *calc_ecc)
+{
+	struct ecc_engine_ops *ops = ecc_engine_get_ops(dev);
+
+	if (!ops->correct)
+		return -ENOSYS;
+
+	return ops->correct(dev, data, read_ecc, calc_ecc);
+}
+
+int ecc_engine_find(unsigned int step_size, unsigned int strength,
+		    struct udevice **devp)
+{
+	struct ecc_engine_uc_priv *uc_priv;
+	struct udevice *dev;
+
+	for (uclass_first_device(UCLASS_ECC_ENGINE, &dev); dev;
+	     uclass_next_device(&dev)) {
+		uc_priv = dev_get_uclass_priv(dev);
+		if (uc_priv->step_size == step_size &&
+		    uc_priv->strength >= strength) {
+			*devp = dev;
+			return 0;
+		}
+	}
+
+	return -ENODEV;
+}
+
+UCLASS_DRIVER(ecc_engine) = {
+	.id		= UCLASS_ECC_ENGINE,
+	.name		= "ecc_engine",
+	.per_device_auto_alloc_size = sizeof(struct ecc_engine_uc_priv),
+};
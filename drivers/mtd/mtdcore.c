@@ -29,6 +29,7 @@
 #else
 #include <linux/err.h>
 #include <ubi_uboot.h>
+#include <watchdog.h>
 #endif
 
 #include <linux/log2.h>
@@ -537,6 +538,7 @@ int del_mtd_device(struct mtd_info *mtd)
 #endif
 
 		idr_remove(&mtd_idr, mtd->index);
+		mtd_read_cache_invalidate();
 
 		module_put(THIS_MODULE);
 		ret = 0;
@@ -862,6 +864,7 @@ int mtd_erase(struct mtd_info *mtd, struct erase_info *instr)
 		return -EINVAL;
 	if (!(mtd->flags & MTD_WRITEABLE))
 		return -EROFS;
+	mtd_read_cache_invalidate();
 	instr->fail_addr = MTD_FAIL_ADDR_UNKNOWN;
 	if (!instr->len) {
 		instr->state = MTD_ERASE_DONE;
@@ -923,6 +926,101 @@ unsigned long mtd_get_unmapped_area(struct mtd_info *mtd, unsigned long len,
 }
 EXPORT_SYMBOL_GPL(mtd_get_unmapped_area);
 
+#ifdef CONFIG_MTD_READ_CACHE
+/*
+ * Small reads, such as of the environment, UBI headers or a device tree, are
+ * served from a few whole pages kept in RAM. Any write, erase or bad block
+ * marking empties the cache, so it never returns stale data.
+ */
+struct mtd_read_cache_page {
+	struct mtd_info *mtd;
+	loff_t page;
+	u_char *buf;
+	size_t size;
+	int bitflips;
+	unsigned long last_use;
+};
+
+static struct mtd_read_cache_page mtd_rc[CONFIG_MTD_READ_CACHE_PAGES];
+static struct mtd_read_cache_stats mtd_rc_stats;
+static unsigned long mtd_rc_clock;
+
+void mtd_read_cache_invalidate(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(mtd_rc); i++)
+		mtd_rc[i].mtd = NULL;
+	mtd_rc_stats.flushes++;
+}
+
+void mtd_read_cache_get_stats(struct mtd_read_cache_stats *stats)
+{
+	*stats = mtd_rc_stats;
+}
+
+static bool mtd_read_cache_usable(struct mtd_info *mtd, loff_t from,
+				  size_t len)
+{
+	return mtd->writesize > 1 &&
+	       mtd_mod_by_ws(from, mtd) + len <= mtd->writesize &&
+	       len < mtd->writesize;
+}
+
+static int mtd_read_cached(struct mtd_info *mtd, loff_t from, size_t len,
+			   size_t *retlen, u_char *buf)
+{
+	struct mtd_read_cache_page *rc, *victim = &mtd_rc[0];
+	size_t offset = mtd_mod_by_ws(from, mtd);
+	loff_t page = from - offset;
+	size_t readlen;
+	int i, ret;
+
+	for (i = 0; i < ARRAY_SIZE(mtd_rc); i++) {
+		rc = &mtd_rc[i];
+		if (rc->mtd == mtd && rc->page == page) {
+			rc->last_use = ++mtd_rc_clock;
+			mtd_rc_stats.hits++;
+			memcpy(buf, rc->buf + offset, len);
+			*retlen = len;
+			return rc->bitflips;
+		}
+		if (!rc->mtd ||
+		    (victim->mtd && rc->last_use < victim->last_use))
+			victim = rc;
+	}
+
+	mtd_rc_stats.misses++;
+	rc = victim;
+	rc->mtd = NULL;
+	if (rc->size < mtd->writesize) {
+		free(rc->buf);
+		rc->size = 0;
+		rc->buf = malloc(mtd->writesize);
+		if (!rc->buf)
+			return mtd->_read(mtd, from, len, retlen, buf);
+		rc->size = mtd->writesize;
+	}
+
+	/*
+	 * Leave pages which fail to read, even uncorrectable ones, to the
+	 * driver so the caller gets whatever data and length it returns
+	 */
+	ret = mtd->_read(mtd, page, mtd->writesize, &readlen, rc->buf);
+	if (ret < 0 || readlen != mtd->writesize)
+		return mtd->_read(mtd, from, len, retlen, buf);
+
+	rc->mtd = mtd;
+	rc->page = page;
+	rc->bitflips = ret;
+	rc->last_use = ++mtd_rc_clock;
+	memcpy(buf, rc->buf + offset, len);
+	*retlen = len;
+
+	return ret;
+}
+#endif
+
 int mtd_read(struct mtd_info *mtd, loff_t from, size_t len, size_t *retlen,
 	     u_char *buf)
 {
@@ -938,7 +1036,14 @@ int mtd_read(struct mtd_info *mtd, loff_t from, size_t len, size_t *retlen,
 	 * representing the maximum number of bitflips that were corrected on
 	 * any one ecc region (if applicable; zero otherwise).
 	 */
+#ifdef CONFIG_MTD_READ_CACHE
+	if (mtd_read_cache_usable(mtd, from, len))
+		ret_code = mtd_read_cached(mtd, from, len, retlen, buf);
+	else
+		ret_code = mtd->_read(mtd, from, len, retlen, buf);
+#else
 	ret_code = mtd->_read(mtd, from, len, retlen, buf);
+#endif
 	if (unlikely(ret_code < 0))
 		return ret_code;
 	if (mtd->ecc_strength == 0)
@@ -947,6 +1052,50 @@ int mtd_read(struct mtd_info *mtd, loff_t from, size_t len, size_t *retlen,
 }
 EXPORT_SYMBOL_GPL(mtd_read);
 
+int mtd_read_skip_bad(struct mtd_info *mtd, loff_t from, size_t len,
+		      loff_t lim, size_t *retlen, u_char *buf)
+{
+	loff_t end = from + lim;
+	bool bitflips = false;
+	size_t chunk, done;
+	int ret;
+
+	*retlen = 0;
+	while (len) {
+		loff_t block = from - mtd_mod_by_eb(from, mtd);
+
+		WATCHDOG_RESET();
+		if (from >= mtd->size)
+			return -EINVAL;
+
+		ret = mtd_block_isbad(mtd, block);
+		if (ret < 0)
+			return ret;
+		if (ret) {
+			from = block + mtd->erasesize;
+			continue;
+		}
+
+		chunk = min_t(size_t, len, block + mtd->erasesize - from);
+		if (from + chunk > end)
+			return -EFBIG;
+
+		ret = mtd_read(mtd, from, chunk, &done, buf);
+		if (mtd_is_bitflip(ret))
+			bitflips = true;
+		else if (ret)
+			return ret;
+
+		*retlen += done;
+		from += chunk;
+		buf += chunk;
+		len -= chunk;
+	}
+
+	return bitflips ? -EUCLEAN : 0;
+}
+EXPORT_SYMBOL_GPL(mtd_read_skip_bad);
+
 int mtd_write(struct mtd_info *mtd, loff_t to, size_t len, size_t *retlen,
 	      const u_char *buf)
 {
@@ -957,6 +1106,7 @@ int mtd_write(struct mtd_info *mtd, loff_t to, size_t len, size_t *retlen,
 		return -EROFS;
 	if (!len)
 		return 0;
+	mtd_read_cache_invalidate();
 	return mtd->_write(mtd, to, len, retlen, buf);
 }
 EXPORT_SYMBOL_GPL(mtd_write);
@@ -980,6 +1130,7 @@ int mtd_panic_write(struct mtd_info *mtd, loff_t to, size_t len, size_t *retlen,
 		return -EROFS;
 	if (!len)
 		return 0;
+	mtd_read_cache_invalidate();
 	return mtd->_panic_write(mtd, to, len, retlen, buf);
 }
 EXPORT_SYMBOL_GPL(mtd_panic_write);
@@ -1153,6 +1304,7 @@ int mtd_block_markbad(struct mtd_info *mtd, loff_t ofs)
 		return -EINVAL;
 	if (!(mtd->flags & MTD_WRITEABLE))
 		return -EROFS;
+	mtd_read_cache_invalidate();
 	return mtd->_block_markbad(mtd, ofs);
 }
 EXPORT_SYMBOL_GPL(mtd_block_markbad);
@@ -423,6 +423,30 @@ static int nand_default_block_markbad(struct mtd_info *mtd, loff_t ofs)
 	return ret;
 }
 
+static void nand_bbc_set(struct nand_chip *chip, loff_t ofs, int state)
+{
+	if (chip->bbt_cache)
+		nand_bbc_put(chip->bbt_cache,
+			     (int)(ofs >> chip->phys_erase_shift), state);
+}
+
+/*
+ * Forget what the cache knows about the blocks in [ofs, ofs + len), since an
+ * OOB write may have changed their bad block markers
+ */
+static void nand_bbc_invalidate(struct nand_chip *chip, loff_t ofs,
+				uint64_t len)
+{
+	int block, last;
+
+	if (!chip->bbt_cache || !len)
+		return;
+	last = (int)((ofs + len - 1) >> chip->phys_erase_shift);
+	for (block = (int)(ofs >> chip->phys_erase_shift); block <= last;
+	     block++)
+		nand_bbc_put(chip->bbt_cache, block, NAND_BBC_UNKNOWN);
+}
+
 /**
  * nand_block_markbad_lowlevel - mark a block bad
  * @mtd: MTD device structure
@@ -468,6 +492,8 @@ static int nand_block_markbad_lowlevel(struct mtd_info *mtd, loff_t ofs)
 			ret = res;
 	}
 
+	nand_bbc_set(chip, ofs, NAND_BBC_BAD);
+
 	if (!ret)
 		mtd->ecc_stats.badblocks++;
 
@@ -511,6 +537,40 @@ static int nand_block_isreserved(struct mtd_info *mtd, loff_t ofs)
 	return nand_isreserved_bbt(mtd, ofs);
 }
 
+/**
+ * nand_block_bad_cached - [GENERIC] Check the bad block marker of a block once
+ * @mtd: MTD device structure
+ * @ofs: offset from device start
+ *
+ * Without a bad block table, remember what the markers said so that each
+ * block's OOB is only read the first time it is checked. The cache is
+ * allocated on first use; if that fails the markers are always read.
+ */
+static int nand_block_bad_cached(struct mtd_info *mtd, loff_t ofs)
+{
+	struct nand_chip *chip = mtd_to_nand(mtd);
+	int block = (int)(ofs >> chip->phys_erase_shift);
+	int state, res;
+
+	if (!chip->bbt_cache) {
+		int blocks = (int)(mtd->size >> chip->phys_erase_shift);
+
+		chip->bbt_cache = kzalloc(DIV_ROUND_UP(blocks, 4), GFP_KERNEL);
+		if (!chip->bbt_cache)
+			return chip->block_bad(mtd, ofs);
+	}
+
+	state = nand_bbc_get(chip->bbt_cache, block);
+	if (state != NAND_BBC_UNKNOWN)
+		return state == NAND_BBC_BAD;
+
+	res = chip->block_bad(mtd, ofs);
+	if (res == 0 || res == 1)
+		nand_bbc_set(chip, ofs, res ? NAND_BBC_BAD : NAND_BBC_GOOD);
+
+	return res;
+}
+
 /**
  * nand_block_checkbad - [GENERIC] Check if a block is marked bad
  * @mtd: MTD device structure
@@ -531,7 +591,7 @@ static int nand_block_checkbad(struct mtd_info *mtd, loff_t ofs, int allowbbt)
 	}
 
 	if (!chip->bbt)
-		return chip->block_bad(mtd, ofs);
+		return nand_block_bad_cached(mtd, ofs);
 
 	/* Return info from the table */
 	return nand_isbad_bbt(mtd, ofs, allowbbt);
@@ -1502,6 +1562,42 @@ static int nand_setup_read_retry(struct mtd_info *mtd, int retry_mode)
 	return chip->setup_read_retry(mtd, retry_mode);
 }
 
+/**
+ * nand_read_page_cmd - [INTERN] Start reading a page, using cache reads
+ * @mtd: MTD device structure
+ * @page: page number to read
+ * @cache_page: page preloaded by a previous cache read, -1 if none
+ * @more: the following page in the same block will be read next
+ *
+ * Issue the commands needed to make @page available for data out. When the
+ * chip supports cache reads and @more is set, the following page is loaded
+ * into the page register while @page is transferred.
+ *
+ * Returns the page which has been preloaded, or -1 if none.
+ */
+static int nand_read_page_cmd(struct mtd_info *mtd, int page, int cache_page,
+			      bool more)
+{
+	struct nand_chip *chip = mtd_to_nand(mtd);
+
+	if (page == cache_page) {
+		chip->cmdfunc(mtd, more ? NAND_CMD_READCACHESEQ :
+			      NAND_CMD_READCACHEEND, -1, -1);
+		return more ? page + 1 : -1;
+	}
+
+	/* Leave any sequence we did not follow up */
+	if (cache_page >= 0)
+		chip->cmdfunc(mtd, NAND_CMD_READCACHEEND, -1, -1);
+
+	chip->cmdfunc(mtd, NAND_CMD_READ0, 0x00, page);
+	if (!more || !NAND_HAS_CACHE_READ(chip))
+		return -1;
+
+	chip->cmdfunc(mtd, NAND_CMD_READCACHESEQ, -1, -1);
+	return page + 1;
+}
+
 /**
  * nand_do_read_ops - [INTERN] Read data with ECC
  * @mtd: MTD device structure
@@ -1525,6 +1621,9 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 	unsigned int max_bitflips = 0;
 	int retry_mode = 0;
 	bool ecc_fail = false;
+	int ppb_mask = (1 << (chip->phys_erase_shift - chip->page_shift)) - 1;
+	int cache_page = -1;
+	bool more;
 
 	chipnr = (int)(from >> chip->chip_shift);
 	chip->select_chip(mtd, chipnr);
@@ -1559,7 +1658,11 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 						 __func__, buf);
 
 read_retry:
-			chip->cmdfunc(mtd, NAND_CMD_READ0, 0x00, page);
+			/* Only preload a page of the same block */
+			more = NAND_HAS_CACHE_READ(chip) && !retry_mode &&
+			       readlen > bytes && ((page + 1) & ppb_mask);
+			cache_page = nand_read_page_cmd(mtd, page, cache_page,
+							more);
 
 			/*
 			 * Now read the page into the buffer.  Absent an error,
@@ -1620,6 +1723,12 @@ read_retry:
 
 			if (mtd->ecc_stats.failed - ecc_failures) {
 				if (retry_mode + 1 < chip->read_retries) {
+					if (cache_page >= 0) {
+						chip->cmdfunc(mtd,
+							NAND_CMD_READCACHEEND,
+							-1, -1);
+						cache_page = -1;
+					}
 					retry_mode++;
 					ret = nand_setup_read_retry(mtd,
 							retry_mode);
@@ -1669,6 +1778,8 @@ read_retry:
 			chip->select_chip(mtd, chipnr);
 		}
 	}
+	if (cache_page >= 0)
+		chip->cmdfunc(mtd, NAND_CMD_READCACHEEND, -1, -1);
 	chip->select_chip(mtd, -1);
 
 	ops->retlen = ops->len - (size_t) readlen;
@@ -2411,6 +2522,9 @@ static int nand_do_write_ops(struct mtd_info *mtd, loff_t to,
 		goto err_out;
 	}
 
+	if (oob)
+		nand_bbc_invalidate(chip, to, ops->len);
+
 	while (1) {
 		int bytes = mtd->writesize;
 		int cached = writelen > bytes && page != blockmask;
@@ -2605,6 +2719,9 @@ static int nand_do_write_oob(struct mtd_info *mtd, loff_t to,
 	if (page == chip->pagebuf)
 		chip->pagebuf = -1;
 
+	/* The write may change the block's bad block marker */
+	nand_bbc_set(chip, to, NAND_BBC_UNKNOWN);
+
 	nand_fill_oob(mtd, ops->oobbuf, ops->ooblen, ops);
 
 	if (ops->mode == MTD_OPS_RAW)
@@ -2781,6 +2898,11 @@ int nand_erase_nand(struct mtd_info *mtd, struct erase_info *instr,
 			goto erase_exit;
 		}
 
+		/* A scrub may have erased the bad block marker */
+		if (instr->scrub)
+			nand_bbc_set(chip, (loff_t)page << chip->page_shift,
+				     NAND_BBC_UNKNOWN);
+
 		/* Increment page address and decrement length */
 		len -= (1ULL << chip->phys_erase_shift);
 		page += pages_per_block;
@@ -3950,6 +4072,10 @@ int nand_scan_tail(struct mtd_info *mtd)
 	BUG_ON((chip->bbt_options & NAND_BBT_NO_OOB_BBM) &&
 			!(chip->bbt_options & NAND_BBT_USE_FLASH));
 
+	/* Forget the markers of any chip scanned before */
+	kfree(chip->bbt_cache);
+	chip->bbt_cache = NULL;
+
 	if (!(chip->options & NAND_OWN_BUFFERS)) {
 		nbuf = kzalloc(sizeof(struct nand_buffers), GFP_KERNEL);
 		chip->buffers = nbuf;
@@ -4188,6 +4314,20 @@ int nand_scan_tail(struct mtd_info *mtd)
 		break;
 	}
 
+#if defined(CONFIG_SYS_NAND_CACHE_READ) && \
+	defined(CONFIG_SYS_NAND_ONFI_DETECTION)
+	/*
+	 * Cache reads rely on the generic large page command function and on
+	 * the read hooks only doing data out, so leave them off otherwise.
+	 */
+	if (chip->onfi_version &&
+	    (le16_to_cpu(chip->onfi_params.opt_cmd) &
+	     ONFI_OPT_CMD_READ_CACHE) &&
+	    chip->cmdfunc == nand_command_lp &&
+	    ecc->read_page != nand_read_page_hwecc_oob_first)
+		chip->options |= NAND_CACHE_READ;
+#endif
+
 	/* Fill in remaining MTD driver data */
 	mtd->type = nand_is_slc(chip) ? MTD_NANDFLASH : MTD_MLCNANDFLASH;
 	mtd->flags = (chip->options & NAND_ROM) ? MTD_CAP_ROM :
@@ -4242,6 +4382,32 @@ int nand_scan(struct mtd_info *mtd, int maxchips)
 }
 EXPORT_SYMBOL(nand_scan);
 
+/**
+ * nand_release - [NAND Interface] Free resources held by the NAND device
+ * @mtd: MTD device structure
+ */
+void nand_release(struct mtd_info *mtd)
+{
+	struct nand_chip *chip = mtd_to_nand(mtd);
+
+	if (chip->ecc.mode == NAND_ECC_SOFT_BCH)
+		nand_bch_free((struct nand_bch_control *)chip->ecc.priv);
+
+	/* Free bad block table memory */
+	kfree(chip->bbt);
+	chip->bbt = NULL;
+	kfree(chip->bbt_cache);
+	chip->bbt_cache = NULL;
+	if (!(chip->options & NAND_OWN_BUFFERS))
+		kfree(chip->buffers);
+
+	/* Free bad block descriptor memory */
+	if (chip->badblock_pattern && chip->badblock_pattern->options
+			& NAND_BBT_DYNAMICSTRUCT)
+		kfree(chip->badblock_pattern);
+}
+EXPORT_SYMBOL_GPL(nand_release);
+
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Steven J. Hill <sjhill@realitydiluted.com>");
 MODULE_AUTHOR("Thomas Gleixner <tglx@linutronix.de>");
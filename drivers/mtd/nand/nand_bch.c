@@ -8,6 +8,8 @@
  */
 
 #include <common.h>
+#include <dm.h>
+#include <ecc_engine.h>
 /*#include <asm/io.h>*/
 #include <linux/types.h>
 
@@ -24,12 +26,14 @@
  * @ecclayout: private ecc layout for this BCH configuration
  * @errloc:    error location array
  * @eccmask:   XOR ecc mask, allows erased pages to be decoded as valid
+ * @engine:    ECC engine doing the work instead of the BCH library, if any
  */
 struct nand_bch_control {
 	struct bch_control   *bch;
 	struct nand_ecclayout ecclayout;
 	unsigned int         *errloc;
 	unsigned char        *eccmask;
+	struct udevice       *engine;
 };
 
 /**
@@ -45,6 +49,9 @@ int nand_bch_calculate_ecc(struct mtd_info *mtd, const unsigned char *buf,
 	struct nand_bch_control *nbc = chip->ecc.priv;
 	unsigned int i;
 
+	if (IS_ENABLED(CONFIG_ECC_ENGINE) && nbc->engine)
+		return ecc_engine_calculate(nbc->engine, buf, code);
+
 	memset(code, 0, chip->ecc.bytes);
 	encode_bch(nbc->bch, buf, chip->ecc.size, code);
 
@@ -72,6 +79,14 @@ int nand_bch_correct_data(struct mtd_info *mtd, unsigned char *buf,
 	unsigned int *errloc = nbc->errloc;
 	int i, count;
 
+	if (IS_ENABLED(CONFIG_ECC_ENGINE) && nbc->engine) {
+		count = ecc_engine_correct(nbc->engine, buf, read_ecc,
+					   calc_ecc);
+		if (count == -EBADMSG)
+			printk(KERN_ERR "ecc unrecoverable error\n");
+		return count;
+	}
+
 	count = decode_bch(nbc->bch, NULL, chip->ecc.size, read_ecc, calc_ecc,
 			   NULL, errloc);
 	if (count > 0) {
@@ -91,6 +106,27 @@ int nand_bch_correct_data(struct mtd_info *mtd, unsigned char *buf,
 	return count;
 }
 
+/*
+ * Look for an ECC engine, such as the NAND controller's BCH block, which
+ * produces @eccbytes of ECC for @eccsize bytes and corrects @t bits
+ */
+static struct udevice *nand_bch_find_engine(unsigned int eccsize,
+					    unsigned int eccbytes,
+					    unsigned int t)
+{
+	struct ecc_engine_uc_priv *uc_priv;
+	struct udevice *dev;
+
+	if (!IS_ENABLED(CONFIG_ECC_ENGINE) ||
+	    ecc_engine_find(eccsize, t, &dev))
+		return NULL;
+	uc_priv = dev_get_uclass_priv(dev);
+	if (uc_priv->bytes != eccbytes)
+		return NULL;
+
+	return dev;
+}
+
 /**
  * nand_bch_init - [NAND Interface] Initialize NAND BCH error correction
  * @mtd:	MTD block structure
@@ -106,6 +142,9 @@ int nand_bch_correct_data(struct mtd_info *mtd, unsigned char *buf,
  * Example: to configure 4 bit correction per 512 bytes, you should pass
  * @eccsize = 512  (thus, m=13 is the smallest integer such that 2^m-1 > 512*8)
  * @eccbytes = 7   (7 bytes are required to store m*t = 13*4 = 52 bits)
+ *
+ * With CONFIG_ECC_ENGINE, a suitable ECC engine is used in preference to the
+ * BCH library.
  */
 struct nand_bch_control *nand_bch_init(struct mtd_info *mtd)
 {
@@ -135,15 +174,18 @@ struct nand_bch_control *nand_bch_init(struct mtd_info *mtd)
 	if (!nbc)
 		goto fail;
 
-	nbc->bch = init_bch(m, t, 0);
-	if (!nbc->bch)
-		goto fail;
+	nbc->engine = nand_bch_find_engine(eccsize, eccbytes, t);
+	if (!nbc->engine) {
+		nbc->bch = init_bch(m, t, 0);
+		if (!nbc->bch)
+			goto fail;
 
-	/* verify that eccbytes has the expected value */
-	if (nbc->bch->ecc_bytes != eccbytes) {
-		printk(KERN_WARNING "invalid eccbytes %u, should be %u\n",
-		       eccbytes, nbc->bch->ecc_bytes);
-		goto fail;
+		/* verify that eccbytes has the expected value */
+		if (nbc->bch->ecc_bytes != eccbytes) {
+			printk(KERN_WARNING "invalid eccbytes %u, should be %u\n",
+			       eccbytes, nbc->bch->ecc_bytes);
+			goto fail;
+		}
 	}
 
 	eccsteps = mtd->writesize/eccsize;
@@ -188,6 +230,10 @@ struct nand_bch_control *nand_bch_init(struct mtd_info *mtd)
 		goto fail;
 	}
 
+	/* the engine applies its own erased page mask */
+	if (nbc->engine)
+		goto done;
+
 	nbc->eccmask = kmalloc(eccbytes, GFP_KERNEL);
 	nbc->errloc = kmalloc(t*sizeof(*nbc->errloc), GFP_KERNEL);
 	if (!nbc->eccmask || !nbc->errloc)
@@ -207,6 +253,7 @@ struct nand_bch_control *nand_bch_init(struct mtd_info *mtd)
 	for (i = 0; i < eccbytes; i++)
 		nbc->eccmask[i] ^= 0xff;
 
+done:
 	if (!eccstrength)
 		nand->ecc.strength = (eccbytes * 8) / fls(8 * eccsize);
 
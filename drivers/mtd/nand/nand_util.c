@@ -93,6 +93,8 @@ int nand_erase_opts(struct mtd_info *mtd,
 			kfree(chip->bbt);
 		}
 		chip->bbt = NULL;
+		kfree(chip->bbt_cache);
+		chip->bbt_cache = NULL;
 		chip->options &= ~NAND_BBT_SCANNED;
 	}
 
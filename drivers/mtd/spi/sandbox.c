@@ -41,13 +41,14 @@ enum sandbox_sf_state {
 	SF_READ_STATUS, /* read the flash's status register */
 	SF_READ_STATUS1, /* read the flash's status register upper 8 bits*/
 	SF_WRITE_STATUS, /* write the flash's status register */
+	SF_SFDP,  /* read the flash's discoverable parameters */
 };
 
 static const char *sandbox_sf_state_name(enum sandbox_sf_state state)
 {
 	static const char * const states[] = {
 		"CMD", "ID", "ADDR", "READ", "WRITE", "ERASE", "READ_STATUS",
-		"READ_STATUS1", "WRITE_STATUS",
+		"READ_STATUS1", "WRITE_STATUS", "SFDP",
 	};
 	return states[state];
 }
@@ -61,6 +62,10 @@ static const char *sandbox_sf_state_name(enum sandbox_sf_state state)
 
 #define IDCODE_LEN 3
 
+/* SFDP header, one parameter header and a 16-dword BFPT */
+#define SFDP_BFPT_OFFSET	0x10
+#define SFDP_LEN		(SFDP_BFPT_OFFSET + 16 * 4)
+
 /* Used to quickly bulk erase backing store */
 static u8 sandbox_sf_0xff[0x1000];
 
@@ -91,6 +96,8 @@ struct sandbox_spi_flash {
 	const struct spi_flash_info *data;
 	/* The file on disk to serv up data from */
 	int fd;
+	/* Discoverable parameters, built from @data */
+	__le32 sfdp[SFDP_LEN / 4];
 };
 
 struct sandbox_spi_flash_plat_data {
@@ -100,6 +107,45 @@ struct sandbox_spi_flash_plat_data {
 	int cs;
 };
 
+/* Build the SFDP tables (JESD216) to match the flags of the flash */
+static void sandbox_sf_build_sfdp(struct sandbox_spi_flash *sbsf)
+{
+	const struct spi_flash_info *data = sbsf->data;
+	__le32 *bfpt = &sbsf->sfdp[SFDP_BFPT_OFFSET / 4];
+	u64 size = (u64)data->sector_size * data->n_sectors;
+	u32 dw1 = 0xffe00000 | 0xff << 8 | 0x3 << 0;
+
+	memset(sbsf->sfdp, 0xff, sizeof(sbsf->sfdp));
+	sbsf->sfdp[0] = cpu_to_le32(0x50444653);	/* "SFDP" */
+	sbsf->sfdp[1] = cpu_to_le32(0xff000106);	/* v1.6, 1 header */
+	sbsf->sfdp[2] = cpu_to_le32(16 << 24 | 0x0106 << 8 | 0x00);
+	sbsf->sfdp[3] = cpu_to_le32(0xff000000 | SFDP_BFPT_OFFSET);
+
+	/* DWORD1: 4KiB erase and the fast read modes */
+	if (data->flags & SECT_4K)
+		dw1 = (dw1 & ~0xff03) | CMD_ERASE_4K << 8 | 0x1;
+	dw1 &= ~(BIT(16) | BIT(19) | BIT(20) | BIT(21) | BIT(22));
+	if (data->flags & RD_DUAL)
+		dw1 |= BIT(16);
+	if (data->flags & RD_DUALIO)
+		dw1 |= BIT(20);
+	if (data->flags & RD_QUADIO)
+		dw1 |= BIT(21) | BIT(19);
+	if (data->flags & RD_QUAD)
+		dw1 |= BIT(22);
+	bfpt[0] = cpu_to_le32(dw1);
+	/* DWORD2: density in bits, minus 1 */
+	bfpt[1] = cpu_to_le32(size * 8 - 1);
+	/* DWORD3: 1-4-4 and 1-1-4: opcode, mode clocks and wait states */
+	bfpt[2] = cpu_to_le32(CMD_READ_QUAD_OUTPUT_FAST << 24 | 8 << 16 |
+			      CMD_READ_QUAD_IO_FAST << 8 | 2 << 5 | 4);
+	/* DWORD4: 1-2-2 and 1-1-2 */
+	bfpt[3] = cpu_to_le32((u32)CMD_READ_DUAL_IO_FAST << 24 | 4 << 21 |
+			      CMD_READ_DUAL_OUTPUT_FAST << 8 | 8);
+	/* DWORD15: no quad enable bit needed */
+	bfpt[14] = cpu_to_le32(0);
+}
+
 /**
  * This is a very strange probe function. If it has platform data (which may
  * have come from the device tree) then this function gets the filename and
@@ -195,6 +241,7 @@ static int sandbox_sf_probe(struct udevice *dev)
 
 	sbsf->data = data;
 	sbsf->cs = cs;
+	sandbox_sf_build_sfdp(sbsf);
 
 	return 0;
 
@@ -261,9 +308,26 @@ static int sandbox_sf_process_cmd(struct sandbox_spi_flash *sbsf, const u8 *rx,
 		sbsf->cmd = SF_ID;
 		break;
 	case CMD_READ_ARRAY_FAST:
+	case CMD_READ_DUAL_OUTPUT_FAST:
+	case CMD_READ_DUAL_IO_FAST:
+	case CMD_READ_QUAD_OUTPUT_FAST:
+	case CMD_READ_SFDP:
 		sbsf->pad_addr_bytes = 1;
+		sbsf->state = SF_ADDR;
+		break;
+	case CMD_READ_QUAD_IO_FAST:
+		/* 2 mode and 4 wait clocks on 4 wires */
+		sbsf->pad_addr_bytes = 3;
+		sbsf->state = SF_ADDR;
+		break;
+	case CMD_READ_QUAD_IO_DTR:
+		/* Same clocks, but on both edges */
+		sbsf->pad_addr_bytes = 6;
+		sbsf->state = SF_ADDR;
+		break;
 	case CMD_READ_ARRAY_SLOW:
 	case CMD_PAGE_PROGRAM:
+	case CMD_QUAD_PAGE_PROGRAM:
 		sbsf->state = SF_ADDR;
 		break;
 	case CMD_WRITE_DISABLE:
@@ -388,6 +452,10 @@ static int sandbox_sf_xfer(struct udevice *dev, unsigned int bitlen,
 				break;
 
 			/* Next state! */
+			if (sbsf->cmd == CMD_READ_SFDP) {
+				sbsf->state = SF_SFDP;
+				break;
+			}
 			if (os_lseek(sbsf->fd, sbsf->off, OS_SEEK_SET) < 0) {
 				puts("sandbox_sf: os_lseek() failed");
 				return -EIO;
@@ -395,9 +463,15 @@ static int sandbox_sf_xfer(struct udevice *dev, unsigned int bitlen,
 			switch (sbsf->cmd) {
 			case CMD_READ_ARRAY_FAST:
 			case CMD_READ_ARRAY_SLOW:
+			case CMD_READ_DUAL_OUTPUT_FAST:
+			case CMD_READ_DUAL_IO_FAST:
+			case CMD_READ_QUAD_OUTPUT_FAST:
+			case CMD_READ_QUAD_IO_FAST:
+			case CMD_READ_QUAD_IO_DTR:
 				sbsf->state = SF_READ;
 				break;
 			case CMD_PAGE_PROGRAM:
+			case CMD_QUAD_PAGE_PROGRAM:
 				sbsf->state = SF_WRITE;
 				break;
 			default:
@@ -424,6 +498,15 @@ static int sandbox_sf_xfer(struct udevice *dev, unsigned int bitlen,
 			}
 			pos += ret;
 			break;
+		case SF_SFDP: {
+			const u8 *sfdp = (const u8 *)sbsf->sfdp;
+
+			assert(tx);
+			tx[pos++] = sbsf->off < SFDP_LEN ? sfdp[sbsf->off] :
+				0xff;
+			++sbsf->off;
+			break;
+		}
 		case SF_READ_STATUS:
 			debug(" read status: %#x\n", sbsf->status);
 			cnt = bytes - pos;
@@ -558,7 +641,7 @@ static int sandbox_cmdline_cb_spi_sf(struct sandbox_state *state,
 SANDBOX_CMDLINE_OPT(spi_sf, 1, "connect a SPI flash: <bus>:<cs>:<id>:<file>");
 
 int sandbox_sf_bind_emul(struct sandbox_state *state, int busnum, int cs,
-			 struct udevice *bus, int of_offset, const char *spec)
+			 struct udevice *bus, ofnode node, const char *spec)
 {
 	struct udevice *emul;
 	char name[20], *str;
@@ -577,7 +660,7 @@ int sandbox_sf_bind_emul(struct sandbox_state *state, int busnum, int cs,
 		puts("Cannot find sandbox_sf_emul driver\n");
 		return -ENOENT;
 	}
-	ret = device_bind(bus, drv, str, NULL, of_offset, &emul);
+	ret = device_bind_with_driver_data(bus, drv, str, 0, node, &emul);
 	if (ret) {
 		printf("Cannot create emul device for spec '%s' (err=%d)\n",
 		       spec, ret);
@@ -621,7 +704,8 @@ static int sandbox_sf_bind_bus_cs(struct sandbox_state *state, int busnum,
 	if (ret)
 		return ret;
 
-	return sandbox_sf_bind_emul(state, busnum, cs, bus, -1, spec);
+	return sandbox_sf_bind_emul(state, busnum, cs, bus, ofnode_null(),
+				    spec);
 }
 
 int sandbox_spi_get_emul(struct sandbox_state *state,
@@ -639,7 +723,7 @@ int sandbox_spi_get_emul(struct sandbox_state *state,
 		debug("%s: busnum=%u, cs=%u: binding SPI flash emulation: ",
 		      __func__, busnum, cs);
 		ret = sandbox_sf_bind_emul(state, busnum, cs, bus,
-					   dev_of_offset(slave), slave->name);
+					   dev_ofnode(slave), slave->name);
 		if (ret) {
 			debug("failed (err=%d)\n", ret);
 			return ret;
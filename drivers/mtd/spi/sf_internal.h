@@ -24,6 +24,7 @@ enum spi_nor_option_flags {
 	SNOR_F_SST_WR		= BIT(0),
 	SNOR_F_USE_FSR		= BIT(1),
 	SNOR_F_USE_UPAGE	= BIT(3),
+	SNOR_F_USE_READ_OP	= BIT(4),
 };
 
 #define SPI_FLASH_3B_ADDR_LEN		3
@@ -57,6 +58,8 @@ enum spi_nor_option_flags {
 #define CMD_READ_DUAL_IO_FAST		0xbb
 #define CMD_READ_QUAD_OUTPUT_FAST	0x6b
 #define CMD_READ_QUAD_IO_FAST		0xeb
+#define CMD_READ_QUAD_IO_DTR		0xed
+#define CMD_READ_SFDP			0x5a
 #define CMD_READ_ID			0x9f
 #define CMD_READ_STATUS			0x05
 #define CMD_READ_STATUS1		0x35
@@ -74,7 +74,8 @@ static int write_sr(struct spi_flash *flash, u8 ws)
 	return 0;
 }
 
-#if defined(CONFIG_SPI_FLASH_SPANSION) || defined(CONFIG_SPI_FLASH_WINBOND)
+#if defined(CONFIG_SPI_FLASH_SPANSION) || defined(CONFIG_SPI_FLASH_WINBOND) || \
+	defined(CONFIG_SPI_FLASH_SFDP)
 static int read_cr(struct spi_flash *flash, u8 *rc)
 {
 	int ret;
@@ -452,6 +453,33 @@ int spi_flash_read_common(struct spi_flash *flash, const u8 *cmd,
 	return ret;
 }
 
+#ifdef CONFIG_DM_SPI
+/* Read using the flash_read() op of the SPI controller */
+static int spi_flash_read_op(struct spi_flash *flash, u32 addr, void *data,
+			     size_t data_len)
+{
+	struct spi_slave *spi = flash->spi;
+	int ret;
+
+	ret = spi_claim_bus(spi);
+	if (ret) {
+		debug("SF: unable to claim SPI bus\n");
+		return ret;
+	}
+
+	/* As with the command, only the bank offset is sent */
+	addr &= SPI_FLASH_16MB_BOUN - 1;
+	ret = dm_spi_flash_read(spi->dev, &flash->read_ops[flash->read_mode],
+				addr, data_len, data);
+	if (ret)
+		debug("SF: flash_read failed\n");
+
+	spi_release_bus(spi);
+
+	return ret;
+}
+#endif
+
 /*
  * TODO: remove the weak after all the other spi_flash_copy_mmap
  * implementations removed from drivers
@@ -518,7 +546,14 @@ int spi_flash_cmd_read_ops(struct spi_flash *flash, u32 offset,
 
 		spi_flash_addr(read_addr, cmd);
 
-		ret = spi_flash_read_common(flash, cmd, cmdsz, data, read_len);
+#ifdef CONFIG_DM_SPI
+		if (flash->flags & SNOR_F_USE_READ_OP)
+			ret = spi_flash_read_op(flash, read_addr, data,
+						read_len);
+		else
+#endif
+			ret = spi_flash_read_common(flash, cmd, cmdsz, data,
+						    read_len);
 		if (ret < 0) {
 			debug("SF: read failed\n");
 			break;
@@ -1018,7 +1053,7 @@ int sst26_is_locked(struct spi_flash *flash, u32 ofs, size_t len)
 }
 #endif
 
-#ifdef CONFIG_SPI_FLASH_MACRONIX
+#if defined(CONFIG_SPI_FLASH_MACRONIX) || defined(CONFIG_SPI_FLASH_SFDP)
 static int macronix_quad_enable(struct spi_flash *flash)
 {
 	u8 qeb_status;
@@ -1046,7 +1081,8 @@ static int macronix_quad_enable(struct spi_flash *flash)
 }
 #endif
 
-#if defined(CONFIG_SPI_FLASH_SPANSION) || defined(CONFIG_SPI_FLASH_WINBOND)
+#if defined(CONFIG_SPI_FLASH_SPANSION) || defined(CONFIG_SPI_FLASH_WINBOND) || \
+	defined(CONFIG_SPI_FLASH_SFDP)
 static int spansion_quad_enable(struct spi_flash *flash)
 {
 	u8 qeb_status;
@@ -1124,6 +1160,282 @@ static int set_quad_mode(struct spi_flash *flash,
 	}
 }
 
+static void spi_flash_add_read_mode(struct spi_flash *flash, int mode,
+				    u8 opcode, u8 dummy, u8 addr_width,
+				    u8 data_width)
+{
+	struct spi_flash_read_op *op = &flash->read_ops[mode];
+
+	op->opcode = opcode;
+	op->addr_len = SPI_FLASH_3B_ADDR_LEN;
+	op->dummy = dummy;
+	op->cmd_width = 1;
+	op->addr_width = addr_width;
+	op->data_width = data_width;
+	op->dtr = mode == SPI_FLASH_READ_1_4_4_DTR;
+	flash->read_modes |= BIT(mode);
+}
+
+#ifdef CONFIG_SPI_FLASH_SFDP
+/* Serial Flash Discoverable Parameters, see JESD216 */
+#define SFDP_SIGNATURE		0x50444653	/* "SFDP" */
+#define SFDP_BFPT_ID		0x00	/* Basic Flash Parameter Table */
+#define SFDP_BFPT_MIN_DWORDS	9
+#define SFDP_BFPT_MAX_DWORDS	16
+
+/* BFPT DWORD1 */
+#define BFPT_DW1_READ_1_1_2	BIT(16)
+#define BFPT_DW1_DTR		BIT(19)
+#define BFPT_DW1_READ_1_2_2	BIT(20)
+#define BFPT_DW1_READ_1_4_4	BIT(21)
+#define BFPT_DW1_READ_1_1_4	BIT(22)
+
+/* BFPT DWORD15: Quad Enable Requirements */
+#define BFPT_DW15_QER_SHIFT	20
+#define BFPT_DW15_QER_MASK	(7 << BFPT_DW15_QER_SHIFT)
+#define BFPT_QER_NONE		0
+#define BFPT_QER_SR2_BIT1_BUGGY	1
+#define BFPT_QER_SR1_BIT6	2
+#define BFPT_QER_SR2_BIT7	3
+#define BFPT_QER_SR2_BIT1_NO_RD	4
+#define BFPT_QER_SR2_BIT1	5
+#define BFPT_QER_UNKNOWN	-1
+
+struct sfdp_header {
+	__le32 signature;
+	u8 minor;
+	u8 major;
+	u8 nph;			/* number of parameter headers - 1 */
+	u8 unused;
+
+	/* The first parameter header, which must be the BFPT */
+	u8 id_lsb;
+	u8 param_minor;
+	u8 param_major;
+	u8 length;		/* in dwords */
+	u8 ptp[3];		/* parameter table pointer, little-endian */
+	u8 id_msb;
+};
+
+static int spi_flash_read_sfdp(struct spi_flash *flash, u32 addr,
+			       void *data, size_t len)
+{
+	u8 cmd[SPI_FLASH_CMD_LEN + 1];
+
+	cmd[0] = CMD_READ_SFDP;
+	spi_flash_addr(addr, cmd);
+	cmd[SPI_FLASH_CMD_LEN] = 0;	/* 8 dummy cycles */
+
+	return spi_flash_read_common(flash, cmd, sizeof(cmd), data, len);
+}
+
+/* Add a read mode from its 16-bit BFPT descriptor */
+static void sfdp_add_read_mode(struct spi_flash *flash, int mode, u16 desc,
+			       u8 addr_width, u8 data_width)
+{
+	u8 wait = desc & 0x1f;
+	u8 mode_clks = (desc >> 5) & 0x7;
+
+	spi_flash_add_read_mode(flash, mode, desc >> 8, wait + mode_clks,
+				addr_width, data_width);
+}
+
+/**
+ * spi_flash_parse_sfdp() - Find the read modes from the flash's SFDP
+ *
+ * @flash:	SPI flash
+ * @qer:	Returns the quad enable requirement (BFPT_QER_...)
+ * @return 0 if OK, -ENOENT if the flash has no usable SFDP, other -ve on
+ *	error
+ */
+static int spi_flash_parse_sfdp(struct spi_flash *flash, int *qer)
+{
+	struct sfdp_header hdr;
+	__le32 bfpt[SFDP_BFPT_MAX_DWORDS];
+	const int mode = SPI_FLASH_READ_1_4_4;
+	u32 dw1, ptp;
+	int len, ret;
+
+	ret = spi_flash_read_sfdp(flash, 0, &hdr, sizeof(hdr));
+	if (ret)
+		return ret;
+	if (le32_to_cpu(hdr.signature) != SFDP_SIGNATURE || hdr.major != 1 ||
+	    hdr.id_lsb != SFDP_BFPT_ID || hdr.length < SFDP_BFPT_MIN_DWORDS)
+		return -ENOENT;
+
+	len = min_t(int, hdr.length, SFDP_BFPT_MAX_DWORDS);
+	ptp = hdr.ptp[0] | hdr.ptp[1] << 8 | hdr.ptp[2] << 16;
+	memset(bfpt, '\0', sizeof(bfpt));
+	ret = spi_flash_read_sfdp(flash, ptp, bfpt, len * sizeof(u32));
+	if (ret)
+		return ret;
+
+	dw1 = le32_to_cpu(bfpt[0]);
+	if (dw1 & BFPT_DW1_READ_1_1_2)
+		sfdp_add_read_mode(flash, SPI_FLASH_READ_1_1_2,
+				   le32_to_cpu(bfpt[3]), 1, 2);
+	if (dw1 & BFPT_DW1_READ_1_2_2)
+		sfdp_add_read_mode(flash, SPI_FLASH_READ_1_2_2,
+				   le32_to_cpu(bfpt[3]) >> 16, 2, 2);
+	if (dw1 & BFPT_DW1_READ_1_1_4)
+		sfdp_add_read_mode(flash, SPI_FLASH_READ_1_1_4,
+				   le32_to_cpu(bfpt[2]) >> 16, 1, 4);
+	if (dw1 & BFPT_DW1_READ_1_4_4) {
+		sfdp_add_read_mode(flash, mode, le32_to_cpu(bfpt[2]), 4, 4);
+		/*
+		 * The BFPT only says whether DTR is supported, not which
+		 * command to use. Assume the common one, with the same dummy
+		 * cycles as the SDR version.
+		 */
+		if (dw1 & BFPT_DW1_DTR)
+			spi_flash_add_read_mode(flash, SPI_FLASH_READ_1_4_4_DTR,
+						CMD_READ_QUAD_IO_DTR,
+						flash->read_ops[mode].dummy,
+						4, 4);
+	}
+
+	*qer = BFPT_QER_UNKNOWN;
+	if (len >= 15)
+		*qer = (le32_to_cpu(bfpt[14]) & BFPT_DW15_QER_MASK) >>
+			BFPT_DW15_QER_SHIFT;
+
+	return 0;
+}
+
+static int sfdp_quad_enable(struct spi_flash *flash,
+			    const struct spi_flash_info *info, int qer)
+{
+	switch (qer) {
+	case BFPT_QER_NONE:
+		return 0;
+	case BFPT_QER_SR1_BIT6:
+		return macronix_quad_enable(flash);
+	case BFPT_QER_SR2_BIT1_BUGGY:
+	case BFPT_QER_SR2_BIT1_NO_RD:
+	case BFPT_QER_SR2_BIT1:
+		return spansion_quad_enable(flash);
+	default:
+		return set_quad_mode(flash, info);
+	}
+}
+#endif /* CONFIG_SPI_FLASH_SFDP */
+
+/* Work out which read modes the SPI bus can use */
+static u16 spi_flash_bus_read_modes(struct spi_flash *flash)
+{
+	struct spi_slave *spi = flash->spi;
+	u16 modes = BIT(SPI_FLASH_READ_1_1_1);
+	bool read_op = false;
+
+	if (spi->mode & SPI_RX_SLOW)
+		return modes;
+
+#ifdef CONFIG_DM_SPI
+	/* Only flash_read() can send the address on several wires */
+	read_op = flash->dual_flash == SF_SINGLE_FLASH &&
+		  dm_spi_can_flash_read(spi->dev);
+#endif
+	if (spi->mode & (SPI_RX_DUAL | SPI_RX_QUAD)) {
+		modes |= BIT(SPI_FLASH_READ_1_1_2);
+		if (read_op && spi->mode & (SPI_TX_DUAL | SPI_TX_QUAD))
+			modes |= BIT(SPI_FLASH_READ_1_2_2);
+	}
+	if (spi->mode & SPI_RX_QUAD) {
+		modes |= BIT(SPI_FLASH_READ_1_1_4);
+		if (read_op && spi->mode & SPI_TX_QUAD) {
+			modes |= BIT(SPI_FLASH_READ_1_4_4);
+			if (spi->mode & SPI_RX_DTR)
+				modes |= BIT(SPI_FLASH_READ_1_4_4_DTR);
+		}
+	}
+
+	return modes;
+}
+
+int spi_flash_set_read_mode(struct spi_flash *flash, int mode)
+{
+	const struct spi_flash_read_op *op;
+
+	if (mode < 0 || mode >= SPI_FLASH_READ_MODES ||
+	    !(flash->read_modes & BIT(mode)))
+		return -EINVAL;
+
+	op = &flash->read_ops[mode];
+	flash->read_mode = mode;
+	flash->read_cmd = op->opcode;
+	flash->dummy_byte = spi_flash_read_dummy_bytes(op);
+
+	return 0;
+}
+
+/*
+ * Find the read commands supported by both the flash and the bus, select the
+ * fastest one and set the quad enable bit if it (or the write command) needs
+ * it.
+ */
+static int spi_flash_setup_read_modes(struct spi_flash *flash,
+				      const struct spi_flash_info *info)
+{
+	struct spi_slave *spi = flash->spi;
+	const struct spi_flash_read_op *op;
+#ifdef CONFIG_SPI_FLASH_SFDP
+	int qer = BFPT_QER_UNKNOWN;
+#endif
+	int ret;
+
+	flash->read_modes = 0;
+	if (spi->mode & SPI_RX_SLOW)
+		spi_flash_add_read_mode(flash, SPI_FLASH_READ_1_1_1,
+					CMD_READ_ARRAY_SLOW, 0, 1, 1);
+	else
+		spi_flash_add_read_mode(flash, SPI_FLASH_READ_1_1_1,
+					CMD_READ_ARRAY_FAST, 8, 1, 1);
+
+#ifdef CONFIG_SPI_FLASH_SFDP
+	if (flash->dual_flash == SF_SINGLE_FLASH &&
+	    !spi_flash_parse_sfdp(flash, &qer))
+		debug("SF: SFDP read modes %x\n", flash->read_modes);
+	else
+#endif
+	{
+		if (info->flags & RD_DUAL)
+			spi_flash_add_read_mode(flash, SPI_FLASH_READ_1_1_2,
+						CMD_READ_DUAL_OUTPUT_FAST, 8,
+						1, 2);
+		if (info->flags & RD_QUAD)
+			spi_flash_add_read_mode(flash, SPI_FLASH_READ_1_1_4,
+						CMD_READ_QUAD_OUTPUT_FAST, 8,
+						1, 4);
+	}
+
+	flash->read_modes &= spi_flash_bus_read_modes(flash);
+	spi_flash_set_read_mode(flash, fls(flash->read_modes) - 1);
+
+#ifdef CONFIG_DM_SPI
+	if (flash->dual_flash == SF_SINGLE_FLASH &&
+	    dm_spi_can_flash_read(spi->dev))
+		flash->flags |= SNOR_F_USE_READ_OP;
+#endif
+
+	/* Set the quad enable bit - only for quad commands */
+	op = &flash->read_ops[flash->read_mode];
+	if (op->data_width != 4 && flash->write_cmd != CMD_QUAD_PAGE_PROGRAM)
+		return 0;
+
+#ifdef CONFIG_SPI_FLASH_SFDP
+	if (qer != BFPT_QER_UNKNOWN)
+		ret = sfdp_quad_enable(flash, info, qer);
+	else
+#endif
+		ret = set_quad_mode(flash, info);
+	if (ret) {
+		debug("SF: Fail to set QEB for %02x\n", JEDEC_MFR(info));
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
 #if CONFIG_IS_ENABLED(OF_CONTROL)
 int spi_flash_decode_fdt(struct spi_flash *flash)
 {
@@ -1255,15 +1567,6 @@ int spi_flash_scan(struct spi_flash *flash)
 	/* Now erase size becomes valid sector size */
 	flash->sector_size = flash->erase_size;
 
-	/* Look for read commands */
-	flash->read_cmd = CMD_READ_ARRAY_FAST;
-	if (spi->mode & SPI_RX_SLOW)
-		flash->read_cmd = CMD_READ_ARRAY_SLOW;
-	else if (spi->mode & SPI_RX_QUAD && info->flags & RD_QUAD)
-		flash->read_cmd = CMD_READ_QUAD_OUTPUT_FAST;
-	else if (spi->mode & SPI_RX_DUAL && info->flags & RD_DUAL)
-		flash->read_cmd = CMD_READ_DUAL_OUTPUT_FAST;
-
 	/* Look for write commands */
 	if (info->flags & WR_QPP && spi->mode & SPI_TX_QUAD)
 		flash->write_cmd = CMD_QUAD_PAGE_PROGRAM;
@@ -1271,36 +1574,10 @@ int spi_flash_scan(struct spi_flash *flash)
 		/* Go for default supported write cmd */
 		flash->write_cmd = CMD_PAGE_PROGRAM;
 
-	/* Set the quad enable bit - only for quad commands */
-	if ((flash->read_cmd == CMD_READ_QUAD_OUTPUT_FAST) ||
-	    (flash->read_cmd == CMD_READ_QUAD_IO_FAST) ||
-	    (flash->write_cmd == CMD_QUAD_PAGE_PROGRAM)) {
-		ret = set_quad_mode(flash, info);
-		if (ret) {
-			debug("SF: Fail to set QEB for %02x\n",
-			      JEDEC_MFR(info));
-			return -EINVAL;
-		}
-	}
-
-	/* Read dummy_byte: dummy byte is determined based on the
-	 * dummy cycles of a particular command.
-	 * Fast commands - dummy_byte = dummy_cycles/8
-	 * I/O commands- dummy_byte = (dummy_cycles * no.of lines)/8
-	 * For I/O commands except cmd[0] everything goes on no.of lines
-	 * based on particular command but incase of fast commands except
-	 * data all go on single line irrespective of command.
-	 */
-	switch (flash->read_cmd) {
-	case CMD_READ_QUAD_IO_FAST:
-		flash->dummy_byte = 2;
-		break;
-	case CMD_READ_ARRAY_SLOW:
-		flash->dummy_byte = 0;
-		break;
-	default:
-		flash->dummy_byte = 1;
-	}
+	/* Look for read commands, setting the quad enable bit if needed */
+	ret = spi_flash_setup_read_modes(flash, info);
+	if (ret)
+		return ret;
 
 #ifdef CONFIG_SPI_FLASH_STMICRO
 	if (info->flags & E_FSR)
@@ -11,7 +11,9 @@
 #include <dm.h>
 #include <malloc.h>
 #include <net.h>
+#include <net6.h>
 #include <asm/test.h>
+#include <asm/unaligned.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -20,18 +22,55 @@ DECLARE_GLOBAL_DATA_PTR;
  *
  * fake_host_hwaddr: MAC address of mocked machine
  * fake_host_ipaddr: IP address of mocked machine
+ * fake_host_ip6: IPv6 address of mocked machine
  * recv_packet_buffer: buffer of the packet returned as received
  * recv_packet_length: length of the packet returned as received
  */
 struct eth_sandbox_priv {
 	uchar fake_host_hwaddr[ARP_HLEN];
 	struct in_addr fake_host_ipaddr;
+	struct in6_addr fake_host_ip6;
 	uchar *recv_packet_buffer;
 	int recv_packet_length;
 };
 
 static bool disabled[8] = {false};
 static bool skip_timeout;
+static int arp_requests;
+
+/* Frames shorter than this are padded on the wire */
+#define SB_ETH_MIN_LEN		60
+
+/* The fake host's TFTP server */
+#define SB_TFTP_PORT		69
+#define SB_TFTP_REPLY_PORT	1069
+#define SB_TFTP_BLKSZ		512
+#define SB_TFTP_FILES		4
+#define SB_TFTP_QUEUE		16
+#define SB_TFTP_RRQ		1
+#define SB_TFTP_DATA		3
+#define SB_TFTP_ACK		4
+#define SB_TFTP_ERROR		5
+#define SB_TFTP_OACK		6
+
+static struct sb_tftp_file {
+	const char *name;
+	const void *data;
+	int len;
+	int requests;
+} tftp_files[SB_TFTP_FILES];
+
+/* Replies waiting to be received, oldest first */
+static struct sb_tftp_reply {
+	uchar pkt[PKTSIZE_ALIGN];
+	int len;
+} tftp_replies[SB_TFTP_QUEUE];
+static int tftp_reply_head;
+static int tftp_reply_count;
+static int tftp_max_pending = SB_TFTP_QUEUE;
+/* File being sent and the client's port, one transfer at a time */
+static int tftp_xfer_file = -1;
+static int tftp_xfer_port;
 
 /*
  * sandbox_eth_disable_response()
@@ -54,19 +93,357 @@ void sandbox_eth_skip_timeout(void)
 	skip_timeout = true;
 }
 
+/*
+ * sandbox_eth_arp_requests()
+ *
+ * Return the number of ARP requests answered so far
+ */
+int sandbox_eth_arp_requests(void)
+{
+	return arp_requests;
+}
+
+/*
+ * sandbox_eth_tftp_add()
+ *
+ * Serve a file from the fake host's TFTP server
+ */
+int sandbox_eth_tftp_add(const char *name, const void *data, int len)
+{
+	int i;
+
+	for (i = 0; i < SB_TFTP_FILES; i++) {
+		if (!tftp_files[i].name) {
+			tftp_files[i].name = name;
+			tftp_files[i].data = data;
+			tftp_files[i].len = len;
+			tftp_files[i].requests = 0;
+			return 0;
+		}
+	}
+
+	return -ENOSPC;
+}
+
+/*
+ * sandbox_eth_tftp_reset()
+ *
+ * Forget the files served and any replies not yet received
+ */
+void sandbox_eth_tftp_reset(void)
+{
+	memset(tftp_files, '\0', sizeof(tftp_files));
+	tftp_reply_count = 0;
+	tftp_max_pending = SB_TFTP_QUEUE;
+	tftp_xfer_file = -1;
+}
+
+/*
+ * sandbox_eth_tftp_requests()
+ *
+ * Return the number of read requests received for a file served
+ */
+int sandbox_eth_tftp_requests(const char *name)
+{
+	int i;
+
+	for (i = 0; i < SB_TFTP_FILES; i++)
+		if (tftp_files[i].name && !strcmp(tftp_files[i].name, name))
+			return tftp_files[i].requests;
+
+	return 0;
+}
+
+/*
+ * sandbox_eth_tftp_max_pending()
+ *
+ * max - Read requests the TFTP server answers at once, it ignores those
+ *	 which arrive while this many replies are still waiting
+ */
+void sandbox_eth_tftp_max_pending(int max)
+{
+	tftp_max_pending = min(max, SB_TFTP_QUEUE);
+}
+
 static int sb_eth_start(struct udevice *dev)
 {
 	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	const u8 *hwaddr;
 
 	debug("eth_sandbox: Start\n");
 
-	fdtdec_get_byte_array(gd->fdt_blob, dev_of_offset(dev),
-			      "fake-host-hwaddr", priv->fake_host_hwaddr,
-			      ARP_HLEN);
+	hwaddr = dev_read_u8_array_ptr(dev, "fake-host-hwaddr", ARP_HLEN);
+	if (hwaddr)
+		memcpy(priv->fake_host_hwaddr, hwaddr, ARP_HLEN);
 	priv->recv_packet_buffer = net_rx_packets[0];
 	return 0;
 }
 
+/* Find the UDP header of a TFTP packet sent over IPv4 or IPv6 */
+static struct udp_hdr *sb_eth_udp_hdr(void *packet)
+{
+	struct ethernet_hdr *eth = packet;
+
+	if (ntohs(eth->et_protlen) == PROT_IPV6)
+		return packet + ETHER_HDR_SIZE + IP6_HDR_SIZE;
+
+	return packet + ETHER_HDR_SIZE + IP_HDR_SIZE;
+}
+
+/* Queue a reply from the TFTP server to @packet, carrying @len bytes of @msg */
+static void sb_eth_tftp_reply(struct eth_sandbox_priv *priv, void *packet,
+			      const void *msg, int len)
+{
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	struct udp_hdr *udp = sb_eth_udp_hdr(packet);
+	struct sb_tftp_reply *reply;
+	struct ethernet_hdr *eth_recv;
+	struct ip_udp_hdr *ipr;
+	struct udp_hdr *udpr;
+
+	if (tftp_reply_count >= SB_TFTP_QUEUE)
+		return;
+	reply = &tftp_replies[(tftp_reply_head + tftp_reply_count) %
+			      SB_TFTP_QUEUE];
+	tftp_reply_count++;
+	memset(reply->pkt, '\0', SB_ETH_MIN_LEN);
+
+	eth_recv = (void *)reply->pkt;
+	memcpy(eth_recv->et_dest, eth->et_src, ARP_HLEN);
+	memcpy(eth_recv->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth_recv->et_protlen = eth->et_protlen;
+
+	udpr = sb_eth_udp_hdr(reply->pkt);
+	udpr->udp_src = htons(SB_TFTP_REPLY_PORT);
+	udpr->udp_dst = udp->udp_src;
+	udpr->udp_len = htons(UDP_HDR_SIZE + len);
+	udpr->udp_xsum = 0;
+	memcpy(udpr + 1, msg, len);
+
+#ifdef CONFIG_IPV6
+	if (ntohs(eth->et_protlen) == PROT_IPV6) {
+		struct ip6_hdr *ip6 = packet + ETHER_HDR_SIZE;
+		struct in6_addr saddr, daddr;
+
+		net_copy_ip6(&saddr, &ip6->daddr);
+		net_copy_ip6(&daddr, &ip6->saddr);
+		net_set_ip6_header(reply->pkt + ETHER_HDR_SIZE, &saddr, &daddr,
+				   IPPROTO_UDP, IP6_HOP_LIMIT,
+				   UDP_HDR_SIZE + len);
+		udpr->udp_xsum = net_ip6_checksum(&saddr, &daddr,
+						  UDP_HDR_SIZE + len,
+						  IPPROTO_UDP, udpr);
+		reply->len = max_t(int, ETHER_HDR_SIZE + IP6_UDP_HDR_SIZE + len,
+				   SB_ETH_MIN_LEN);
+		return;
+	}
+#endif
+
+	ipr = (void *)reply->pkt + ETHER_HDR_SIZE;
+	memcpy(ipr, ip, IP_HDR_SIZE);
+	ipr->ip_len = htons(IP_UDP_HDR_SIZE + len);
+	ipr->ip_off = 0;
+	ipr->ip_sum = 0;
+	net_copy_ip((void *)&ipr->ip_dst, &ip->ip_src);
+	net_copy_ip((void *)&ipr->ip_src, &ip->ip_dst);
+	ipr->ip_sum = compute_ip_checksum(ipr, IP_HDR_SIZE);
+
+	reply->len = max_t(int, ETHER_HDR_SIZE + IP_UDP_HDR_SIZE + len,
+			   SB_ETH_MIN_LEN);
+}
+
+/* Send data block @block of the file being transferred */
+static void sb_eth_tftp_data(struct eth_sandbox_priv *priv, void *packet,
+			     int block)
+{
+	struct sb_tftp_file *file = &tftp_files[tftp_xfer_file];
+	int offset = (block - 1) * SB_TFTP_BLKSZ;
+	u8 msg[4 + SB_TFTP_BLKSZ];
+	int len;
+
+	/* A file ends with a short block, which is empty if need be */
+	if (offset > file->len) {
+		tftp_xfer_file = -1;
+		return;
+	}
+	len = min(file->len - offset, SB_TFTP_BLKSZ);
+	put_unaligned_be16(SB_TFTP_DATA, msg);
+	put_unaligned_be16(block, msg + 2);
+	memcpy(msg + 4, file->data + offset, len);
+	sb_eth_tftp_reply(priv, packet, msg, 4 + len);
+}
+
+/*
+ * Answer a TFTP read request with the first block, the size of the file if
+ * asked for, or an error. Acknowledgements bring the following blocks.
+ */
+static void sb_eth_tftp_request(struct eth_sandbox_priv *priv, void *packet,
+				int length)
+{
+	struct udp_hdr *udp = sb_eth_udp_hdr(packet);
+	char *name = (char *)(udp + 1) + 2;
+	char *end = packet + length;
+	int max = end - name;
+	bool tsize = false;
+	char msg[32];
+	char *opt;
+	int i;
+
+	if (max <= 0)
+		return;
+	if (ntohs(udp->udp_dst) == SB_TFTP_REPLY_PORT) {
+		if (tftp_xfer_file < 0 || ntohs(udp->udp_src) != tftp_xfer_port)
+			return;
+		if (ntohs(*(__be16 *)(udp + 1)) == SB_TFTP_ACK && max >= 2)
+			sb_eth_tftp_data(priv, packet,
+					 get_unaligned_be16(name) + 1);
+		else
+			tftp_xfer_file = -1;
+		return;
+	}
+	if (ntohs(*(__be16 *)(udp + 1)) != SB_TFTP_RRQ || end[-1] ||
+	    tftp_reply_count >= tftp_max_pending)
+		return;
+
+	/* Options follow the name and the mode, as pairs of strings */
+	opt = name + strlen(name) + 1;
+	for (i = 0; opt < end; i++, opt += strlen(opt) + 1)
+		if (i % 2 && !strcmp(opt, "tsize"))
+			tsize = true;
+
+	for (i = 0; i < SB_TFTP_FILES; i++)
+		if (tftp_files[i].name && !strcmp(tftp_files[i].name, name))
+			break;
+	if (i == SB_TFTP_FILES) {
+		put_unaligned_be16(SB_TFTP_ERROR, msg);
+		put_unaligned_be16(1, msg + 2);		/* File not found */
+		strcpy(msg + 4, "File not found");
+		sb_eth_tftp_reply(priv, packet, msg,
+				  4 + strlen("File not found") + 1);
+		return;
+	}
+
+	tftp_files[i].requests++;
+	tftp_xfer_file = i;
+	tftp_xfer_port = ntohs(udp->udp_src);
+	if (tsize) {
+		put_unaligned_be16(SB_TFTP_OACK, msg);
+		strcpy(msg + 2, "tsize");
+		i = sprintf(msg + 8, "%d", tftp_files[i].len);
+		sb_eth_tftp_reply(priv, packet, msg, 8 + i + 1);
+	} else {
+		sb_eth_tftp_data(priv, packet, 1);
+	}
+}
+
+#ifdef CONFIG_IPV6
+/* The prefix the fake host advertises as a router, 2001:db8:1::/64 */
+static const struct in6_addr sb_eth_ra_prefix = {
+	.s6_addr = { 0x20, 0x01, 0x0d, 0xb8, 0x00, 0x01 },
+};
+
+/*
+ * Answer neighbor solicitations, router solicitations, ICMPv6 echo requests
+ * and TFTP over IPv6
+ */
+static void sb_eth_ip6_reply(struct eth_sandbox_priv *priv, void *packet,
+			     int length)
+{
+	struct ethernet_hdr *eth = packet;
+	struct ip6_hdr *ip6 = packet + ETHER_HDR_SIZE;
+	struct icmp6_hdr *icmp = (struct icmp6_hdr *)(ip6 + 1);
+	struct udp_hdr *udp = (struct udp_hdr *)(ip6 + 1);
+	struct nd_opt_prefix_info *pi;
+	struct ethernet_hdr *eth_recv;
+	struct in6_addr saddr, daddr;
+	struct ip6_hdr *ip6r;
+	struct icmp6_hdr *icmpr;
+	struct nd_msg *ndr;
+	struct ra_msg *rar;
+	int len;
+
+	if (ip6->nexthdr == IPPROTO_UDP &&
+	    (ntohs(udp->udp_dst) == SB_TFTP_PORT ||
+	     ntohs(udp->udp_dst) == SB_TFTP_REPLY_PORT)) {
+		sb_eth_tftp_request(priv, packet, length);
+		return;
+	}
+	if (ip6->nexthdr != IPPROTO_ICMPV6)
+		return;
+
+	eth_recv = (void *)priv->recv_packet_buffer;
+	ip6r = (void *)priv->recv_packet_buffer + ETHER_HDR_SIZE;
+	icmpr = (struct icmp6_hdr *)(ip6r + 1);
+
+	switch (icmp->icmp6_type) {
+	case ICMPV6_NEIGHBOR_SOLICIT:
+		/* store this as the assumed IPv6 address of the fake host */
+		net_copy_ip6(&priv->fake_host_ip6,
+			     &((struct nd_msg *)icmp)->target);
+
+		/* Formulate a fake advertisement */
+		ndr = (struct nd_msg *)icmpr;
+		len = sizeof(*ndr) + ND_OPT_LL_ADDR_SIZE;
+		memset(ndr, '\0', len);
+		ndr->icmph.icmp6_type = ICMPV6_NEIGHBOR_ADVERT;
+		ndr->icmph.icmp6_dataun.na.flags =
+			htonl(ND_NA_FLAG_SOLICITED | ND_NA_FLAG_OVERRIDE);
+		ndr->target = priv->fake_host_ip6;
+		ndr->opt[0] = ND_OPT_TARGET_LL_ADDR;
+		ndr->opt[1] = ND_OPT_LL_ADDR_SIZE / 8;
+		memcpy(&ndr->opt[2], priv->fake_host_hwaddr, ARP_HLEN);
+		saddr = priv->fake_host_ip6;
+		net_copy_ip6(&daddr, &ip6->saddr);
+		net_set_ip6_header((uchar *)ip6r, &saddr, &daddr,
+				   IPPROTO_ICMPV6, IP6_ND_HOP_LIMIT, len);
+		break;
+	case ICMPV6_ROUTER_SOLICIT:
+		/* Advertise a prefix for stateless autoconfiguration */
+		rar = (struct ra_msg *)icmpr;
+		pi = (struct nd_opt_prefix_info *)rar->opt;
+		len = sizeof(*rar) + sizeof(*pi);
+		memset(rar, '\0', len);
+		rar->icmph.icmp6_type = ICMPV6_ROUTER_ADVERT;
+		rar->icmph.icmp6_dataun.ra.hop_limit = IP6_HOP_LIMIT;
+		rar->icmph.icmp6_dataun.ra.router_lifetime = htons(1800);
+		pi->type = ND_OPT_PREFIX_INFO;
+		pi->len = sizeof(*pi) / 8;
+		pi->prefix_len = 64;
+		pi->flags = ND_PREFIX_FLAG_ONLINK | ND_PREFIX_FLAG_AUTO;
+		pi->valid_lifetime = htonl(86400);
+		pi->preferred_lifetime = htonl(14400);
+		pi->prefix = sb_eth_ra_prefix;
+		ip6_make_lladdr(&saddr, priv->fake_host_hwaddr);
+		net_copy_ip6(&daddr, &ip6->saddr);
+		net_set_ip6_header((uchar *)ip6r, &saddr, &daddr,
+				   IPPROTO_ICMPV6, IP6_ND_HOP_LIMIT, len);
+		break;
+	case ICMPV6_ECHO_REQUEST:
+		/* reply to the ping */
+		len = ntohs(ip6->payload_len);
+		memcpy(ip6r, ip6, length - ETHER_HDR_SIZE);
+		net_copy_ip6(&saddr, &ip6->daddr);
+		net_copy_ip6(&daddr, &ip6->saddr);
+		ip6r->saddr = saddr;
+		ip6r->daddr = daddr;
+		icmpr->icmp6_type = ICMPV6_ECHO_REPLY;
+		break;
+	default:
+		return;
+	}
+
+	memcpy(eth_recv->et_dest, eth->et_src, ARP_HLEN);
+	memcpy(eth_recv->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth_recv->et_protlen = htons(PROT_IPV6);
+	icmpr->icmp6_cksum = 0;
+	icmpr->icmp6_cksum = net_ip6_checksum(&saddr, &daddr, len,
+					      IPPROTO_ICMPV6, icmpr);
+
+	priv->recv_packet_length = ETHER_HDR_SIZE + IP6_HDR_SIZE + len;
+}
+#endif
+
 static int sb_eth_send(struct udevice *dev, void *packet, int length)
 {
 	struct eth_sandbox_priv *priv = dev_get_priv(dev);
@@ -85,6 +462,7 @@ static int sb_eth_send(struct udevice *dev, void *packet, int length)
 			struct ethernet_hdr *eth_recv;
 			struct arp_hdr *arp_recv;
 
+			arp_requests++;
 			/* store this as the assumed IP of the fake host */
 			priv->fake_host_ipaddr = net_read_ip(&arp->ar_tpa);
 			/* Formulate a fake response */
@@ -135,8 +513,8 @@ static int sb_eth_send(struct udevice *dev, void *packet, int length)
 				ipr->ip_sum = 0;
 				ipr->ip_off = 0;
 				net_copy_ip((void *)&ipr->ip_dst, &ip->ip_src);
-				net_write_ip((void *)&ipr->ip_src,
-					     priv->fake_host_ipaddr);
+				/* the sender may know us without asking */
+				net_copy_ip((void *)&ipr->ip_src, &ip->ip_dst);
 				ipr->ip_sum = compute_ip_checksum(ipr,
 					IP_HDR_SIZE);
 
@@ -147,12 +525,36 @@ static int sb_eth_send(struct udevice *dev, void *packet, int length)
 
 				priv->recv_packet_length = length;
 			}
+		} else if (ip->ip_p == IPPROTO_UDP &&
+			   (ntohs(ip->udp_dst) == SB_TFTP_PORT ||
+			    ntohs(ip->udp_dst) == SB_TFTP_REPLY_PORT)) {
+			sb_eth_tftp_request(priv, packet, length);
 		}
+#ifdef CONFIG_IPV6
+	} else if (ntohs(eth->et_protlen) == PROT_IPV6) {
+		sb_eth_ip6_reply(priv, packet, length);
+#endif
 	}
 
 	return 0;
 }
 
+#ifdef CONFIG_NET_RX_ZEROCOPY
+/* Mimic a DMA engine receiving the frame into the buffer the stack chose */
+static uchar *sb_eth_rx_in_place(uchar *packet, int length)
+{
+	uchar *buf;
+	int maxlen;
+
+	buf = net_rx_dest_claim(&maxlen);
+	if (!buf || length > maxlen)
+		return packet;
+	memcpy(buf, packet, length);
+
+	return buf;
+}
+#endif
+
 static int sb_eth_recv(struct udevice *dev, int flags, uchar **packetp)
 {
 	struct eth_sandbox_priv *priv = dev_get_priv(dev);
@@ -169,8 +571,24 @@ static int sb_eth_recv(struct udevice *dev, int flags, uchar **packetp)
 		      priv->recv_packet_length);
 		priv->recv_packet_length = 0;
 		*packetp = priv->recv_packet_buffer;
+#ifdef CONFIG_NET_RX_ZEROCOPY
+		*packetp = sb_eth_rx_in_place(*packetp, lcl_recv_packet_length);
+#endif
 		return lcl_recv_packet_length;
 	}
+	if (tftp_reply_count) {
+		struct sb_tftp_reply *reply = &tftp_replies[tftp_reply_head];
+		int len = reply->len;
+
+		tftp_reply_head = (tftp_reply_head + 1) % SB_TFTP_QUEUE;
+		tftp_reply_count--;
+		memcpy(priv->recv_packet_buffer, reply->pkt, len);
+		*packetp = priv->recv_packet_buffer;
+#ifdef CONFIG_NET_RX_ZEROCOPY
+		*packetp = sb_eth_rx_in_place(*packetp, len);
+#endif
+		return len;
+	}
 	return 0;
 }
 
@@ -13,13 +13,14 @@
 #include <dm/device-internal.h>
 #include "nvme.h"
 
-#define NVME_Q_DEPTH		2
+#define NVME_Q_DEPTH		32
 #define NVME_AQ_DEPTH		2
 #define NVME_SQ_SIZE(depth)	(depth * sizeof(struct nvme_command))
 #define NVME_CQ_SIZE(depth)	(depth * sizeof(struct nvme_completion))
 #define ADMIN_TIMEOUT		60
 #define IO_TIMEOUT		30
-#define MAX_PRP_POOL		512
+/* Largest transfer per I/O command, which bounds the PRP lists needed */
+#define NVME_MAX_XFER_SHIFT	20
 
 enum nvme_queue_id {
 	NVME_ADMIN_Q,
@@ -45,6 +46,13 @@ struct nvme_queue {
 	u16 qid;
 	u8 cq_phase;
 	u8 cqe_seen;
+	/* I/O queues keep several commands in flight, each in its own slot */
+	u64 *prp_lists;		/* prp_pages of PRP lists per slot */
+	int prp_pages;
+	u64 *slot_lba;		/* first LBA transferred by each slot */
+	u16 *free_slots;	/* stack of slots with no command in flight */
+	u16 nr_free;
+	u64 err_lba;		/* lowest LBA of a failed command */
 	unsigned long cmdid_data[];
 };
 
@@ -66,57 +74,59 @@ static int nvme_wait_ready(struct nvme_dev *dev, bool enabled)
 	return -ETIME;
 }
 
-static int nvme_setup_prps(struct nvme_dev *dev, u64 *prp2,
-			   int total_len, u64 dma_addr)
+/**
+ * nvme_setup_prps() - set up the second PRP entry of a transfer
+ *
+ * Transfers covering more than two memory pages need a PRP list, which is
+ * built in @prp_list. This must be large enough for the transfer, see
+ * nvme_alloc_io_slots().
+ *
+ * @dev:	NVMe device
+ * @prp_list:	Page-aligned space for the PRP list
+ * @prp2:	Returns the value for the PRP2 field of the command
+ * @total_len:	Length of the transfer in bytes
+ * @dma_addr:	Start address of the transfer
+ */
+static void nvme_setup_prps(struct nvme_dev *dev, u64 *prp_list, u64 *prp2,
+			    int total_len, u64 dma_addr)
 {
 	u32 page_size = dev->page_size;
+	int entries = page_size >> 3;
 	int offset = dma_addr & (page_size - 1);
-	u64 *prp_pool;
+	u64 *prp_pool = prp_list;
 	int length = total_len;
 	int i, nprps;
 	length -= (page_size - offset);
 
 	if (length <= 0) {
 		*prp2 = 0;
-		return 0;
+		return;
 	}
 
-	if (length)
-		dma_addr += (page_size - offset);
+	dma_addr += (page_size - offset);
 
 	if (length <= page_size) {
 		*prp2 = dma_addr;
-		return 0;
+		return;
 	}
 
 	nprps = DIV_ROUND_UP(length, page_size);
 
-	if (nprps > dev->prp_entry_num) {
-		free(dev->prp_pool);
-		dev->prp_pool = malloc(nprps << 3);
-		if (!dev->prp_pool) {
-			printf("Error: malloc prp_pool fail\n");
-			return -ENOMEM;
-		}
-		dev->prp_entry_num = nprps;
-	}
-
-	prp_pool = dev->prp_pool;
 	i = 0;
 	while (nprps) {
-		if (i == ((page_size >> 3) - 1)) {
-			*(prp_pool + i) = cpu_to_le64((ulong)prp_pool +
-					page_size);
+		/* The last entry of a full list page chains to the next */
+		if (i == entries - 1 && nprps > 1) {
+			prp_pool[i] = cpu_to_le64((ulong)(prp_pool + entries));
 			i = 0;
-			prp_pool += page_size;
+			prp_pool += entries;
 		}
-		*(prp_pool + i++) = cpu_to_le64(dma_addr);
+		prp_pool[i++] = cpu_to_le64(dma_addr);
 		dma_addr += page_size;
 		nprps--;
 	}
-	*prp2 = (ulong)dev->prp_pool;
-
-	return 0;
+	flush_dcache_range((ulong)prp_list,
+			   ALIGN((ulong)(prp_pool + i), ARCH_DMA_MINALIGN));
+	*prp2 = (ulong)prp_list;
 }
 
 static __le16 nvme_get_cmd_id(void)
@@ -137,12 +147,15 @@ static u16 nvme_read_completion_status(struct nvme_queue *nvmeq, u16 index)
 }
 
 /**
- * nvme_submit_cmd() - copy a command into a queue and ring the doorbell
+ * nvme_queue_cmd() - copy a command into a queue without ringing the doorbell
+ *
+ * The controller does not see the command until nvme_ring_sq() is called,
+ * so several commands can be handed over with one doorbell write.
  *
  * @nvmeq:	The queue to use
- * @cmd:	The command to send
+ * @cmd:	The command to add
  */
-static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
+static void nvme_queue_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
 {
 	u16 tail = nvmeq->sq_tail;
 
@@ -152,10 +165,26 @@ static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
 
 	if (++tail == nvmeq->q_depth)
 		tail = 0;
-	writel(tail, nvmeq->q_db);
 	nvmeq->sq_tail = tail;
 }
 
+static void nvme_ring_sq(struct nvme_queue *nvmeq)
+{
+	writel(nvmeq->sq_tail, nvmeq->q_db);
+}
+
+/**
+ * nvme_submit_cmd() - copy a command into a queue and ring the doorbell
+ *
+ * @nvmeq:	The queue to use
+ * @cmd:	The command to send
+ */
+static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
+{
+	nvme_queue_cmd(nvmeq, cmd);
+	nvme_ring_sq(nvmeq);
+}
+
 static int nvme_submit_sync_cmd(struct nvme_queue *nvmeq,
 				struct nvme_command *cmd,
 				u32 *result, unsigned timeout)
@@ -164,7 +193,7 @@ static int nvme_submit_sync_cmd(struct nvme_queue *nvmeq,
 	u16 phase = nvmeq->cq_phase;
 	u16 status;
 	ulong start_time;
-	ulong timeout_us = timeout * 100000;
+	ulong timeout_us = timeout * 1000000;
 
 	cmd->common.command_id = nvme_get_cmd_id();
 	nvme_submit_cmd(nvmeq, cmd);
@@ -296,6 +325,9 @@ static int nvme_disable_ctrl(struct nvme_dev *dev)
 
 static void nvme_free_queue(struct nvme_queue *nvmeq)
 {
+	free(nvmeq->prp_lists);
+	free(nvmeq->slot_lba);
+	free(nvmeq->free_slots);
 	free((void *)nvmeq->cqes);
 	free(nvmeq->sq_cmds);
 	free(nvmeq);
@@ -608,9 +640,17 @@ static int nvme_get_info_from_identify(struct nvme_dev *dev)
 		 * which means dev->max_transfer_shift = 15 + 9 (ns->lba_shift).
 		 * Let's use 20 which provides 1MB size.
 		 */
-		dev->max_transfer_shift = 20;
+		dev->max_transfer_shift = NVME_MAX_XFER_SHIFT;
 	}
 
+	/*
+	 * Larger transfers do not help much once several commands are in
+	 * flight, and each command slot needs a PRP list for the largest
+	 * one, so keep to the same limit.
+	 */
+	if (dev->max_transfer_shift > NVME_MAX_XFER_SHIFT)
+		dev->max_transfer_shift = NVME_MAX_XFER_SHIFT;
+
 	return 0;
 }
 
@@ -670,17 +710,154 @@ static int nvme_blk_probe(struct udevice *udev)
 	return 0;
 }
 
+/**
+ * nvme_alloc_io_slots() - set up the command slots of an I/O queue
+ *
+ * A queue of depth n can have n - 1 commands in flight. Each gets a slot
+ * with room for the PRP list of the largest transfer, so that nothing needs
+ * to be allocated while commands are being submitted.
+ *
+ * @dev:	NVMe device
+ * @nvmeq:	I/O queue
+ * @return 0 if OK, -ENOMEM if out of memory
+ */
+static int nvme_alloc_io_slots(struct nvme_dev *dev, struct nvme_queue *nvmeq)
+{
+	int nr_slots = nvmeq->q_depth - 1;
+	int entries = dev->page_size >> 3;
+	int nprps;
+	int i;
+
+	/* A misaligned buffer touches one more page, the first is in PRP1 */
+	nprps = (1 << dev->max_transfer_shift) / dev->page_size;
+	nvmeq->prp_pages = max(DIV_ROUND_UP(nprps, entries - 1), 1);
+
+	nvmeq->prp_lists = memalign(dev->page_size,
+				    nr_slots * nvmeq->prp_pages *
+				    dev->page_size);
+	nvmeq->slot_lba = malloc(nr_slots * sizeof(*nvmeq->slot_lba));
+	nvmeq->free_slots = malloc(nr_slots * sizeof(*nvmeq->free_slots));
+	if (!nvmeq->prp_lists || !nvmeq->slot_lba || !nvmeq->free_slots)
+		return -ENOMEM;
+
+	for (i = 0; i < nr_slots; i++) {
+		nvmeq->free_slots[i] = i;
+		nvmeq->slot_lba[i] = U64_MAX;
+	}
+	nvmeq->nr_free = nr_slots;
+
+	return 0;
+}
+
+/**
+ * nvme_reset_io_queue() - abort all the commands in flight on an I/O queue
+ *
+ * Deleting the submission queue aborts its commands, so none of them can
+ * still transfer data once their slots are used again. Both queues are then
+ * created again, empty. If that fails the controller is disabled, which
+ * also stops all its commands.
+ *
+ * @nvmeq:	I/O queue
+ * @return 0 if OK, -ve on error
+ */
+static int nvme_reset_io_queue(struct nvme_queue *nvmeq)
+{
+	struct nvme_dev *dev = nvmeq->dev;
+	int nr_slots = nvmeq->q_depth - 1;
+	int i, ret;
+
+	ret = nvme_delete_sq(dev, nvmeq->qid);
+	if (!ret)
+		ret = nvme_delete_cq(dev, nvmeq->qid);
+	if (!ret) {
+		dev->online_queues--;
+		ret = nvme_create_queue(nvmeq, nvmeq->qid);
+	}
+	if (ret) {
+		printf("ERROR: cannot reset I/O queue, disabling controller\n");
+		nvme_disable_ctrl(dev);
+	}
+
+	for (i = 0; i < nr_slots; i++) {
+		nvmeq->free_slots[i] = i;
+		nvmeq->slot_lba[i] = U64_MAX;
+	}
+	nvmeq->nr_free = nr_slots;
+
+	return ret;
+}
+
+/**
+ * nvme_reap_io() - collect all completions that an I/O queue has posted
+ *
+ * The slot of each completed command is released. Failed commands update
+ * err_lba. The completion queue doorbell is written once for the batch.
+ *
+ * @nvmeq:	I/O queue
+ * @return number of completions collected
+ */
+static int nvme_reap_io(struct nvme_queue *nvmeq)
+{
+	u16 head = nvmeq->cq_head;
+	u16 phase = nvmeq->cq_phase;
+	int count = 0;
+	u16 status;
+	u16 slot;
+
+	for (;;) {
+		status = nvme_read_completion_status(nvmeq, head);
+		if ((status & 0x01) != phase)
+			break;
+
+		slot = le16_to_cpu(readw(&nvmeq->cqes[head].command_id));
+		status >>= 1;
+		if (slot >= nvmeq->q_depth - 1 ||
+		    nvmeq->slot_lba[slot] == U64_MAX) {
+			debug("Dropping completion for idle slot %u\n", slot);
+		} else {
+			if (status) {
+				printf("ERROR: status = %x, lba = %llx\n",
+				       status, nvmeq->slot_lba[slot]);
+				nvmeq->err_lba = min(nvmeq->err_lba,
+						     nvmeq->slot_lba[slot]);
+			}
+			nvmeq->slot_lba[slot] = U64_MAX;
+			nvmeq->free_slots[nvmeq->nr_free++] = slot;
+		}
+		count++;
+
+		if (++head == nvmeq->q_depth) {
+			head = 0;
+			phase = !phase;
+		}
+	}
+
+	if (count) {
+		writel(head, nvmeq->q_db + nvmeq->dev->db_stride);
+		nvmeq->cq_head = head;
+		nvmeq->cq_phase = phase;
+	}
+
+	return count;
+}
+
 static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
 			 lbaint_t blkcnt, void *buffer, bool read)
 {
 	struct nvme_ns *ns = dev_get_priv(udev);
 	struct nvme_dev *dev = ns->dev;
+	struct nvme_queue *nvmeq = dev->queues[NVME_IO_Q];
 	struct nvme_command c;
 	struct blk_desc *desc = dev_get_uclass_platdata(udev);
-	int status;
+	int nr_slots = nvmeq->q_depth - 1;
+	u64 *prp_list;
 	u64 prp2;
 	u64 total_len = blkcnt << desc->log2blksz;
-	u64 temp_len = total_len;
+	void *buf = buffer;
+	ulong timeout_us = IO_TIMEOUT * 1000000;
+	ulong start_time;
+	int queued;
+	u16 slot;
 
 	u64 slba = blknr;
 	u16 lbas = 1 << (dev->max_transfer_shift - ns->lba_shift);
@@ -700,35 +877,62 @@ static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
 	c.rw.appmask = 0;
 	c.rw.metadata = 0;
 
-	while (total_lbas) {
-		if (total_lbas < lbas) {
-			lbas = (u16)total_lbas;
-			total_lbas = 0;
-		} else {
+	nvmeq->err_lba = U64_MAX;
+	start_time = timer_get_us();
+	while (total_lbas || nvmeq->nr_free < nr_slots) {
+		/* Fill every free slot, then tell the controller once */
+		queued = 0;
+		while (total_lbas && nvmeq->nr_free) {
+			if (total_lbas < lbas)
+				lbas = (u16)total_lbas;
 			total_lbas -= lbas;
-		}
 
-		if (nvme_setup_prps(dev, &prp2,
-				    lbas << ns->lba_shift, (ulong)buffer))
-			return -EIO;
-		c.rw.slba = cpu_to_le64(slba);
-		slba += lbas;
-		c.rw.length = cpu_to_le16(lbas - 1);
-		c.rw.prp1 = cpu_to_le64((ulong)buffer);
-		c.rw.prp2 = cpu_to_le64(prp2);
-		status = nvme_submit_sync_cmd(dev->queues[NVME_IO_Q],
-				&c, NULL, IO_TIMEOUT);
-		if (status)
+			slot = nvmeq->free_slots[--nvmeq->nr_free];
+			prp_list = (void *)nvmeq->prp_lists +
+				   slot * nvmeq->prp_pages * dev->page_size;
+			nvme_setup_prps(dev, prp_list, &prp2,
+					lbas << ns->lba_shift, (ulong)buf);
+			nvmeq->slot_lba[slot] = slba;
+			c.rw.command_id = cpu_to_le16(slot);
+			c.rw.slba = cpu_to_le64(slba);
+			slba += lbas;
+			c.rw.length = cpu_to_le16(lbas - 1);
+			c.rw.prp1 = cpu_to_le64((ulong)buf);
+			c.rw.prp2 = cpu_to_le64(prp2);
+			nvme_queue_cmd(nvmeq, &c);
+			buf += lbas << ns->lba_shift;
+			queued++;
+		}
+		if (queued)
+			nvme_ring_sq(nvmeq);
+
+		if (nvme_reap_io(nvmeq)) {
+			start_time = timer_get_us();
+		} else if (timer_get_us() - start_time >= timeout_us) {
+			printf("ERROR: I/O timeout, %d commands in flight\n",
+			       nr_slots - nvmeq->nr_free);
+			/* Count up to the lowest LBA still in flight */
+			for (slot = 0; slot < nr_slots; slot++)
+				nvmeq->err_lba = min(nvmeq->err_lba,
+						     nvmeq->slot_lba[slot]);
+			nvme_reset_io_queue(nvmeq);
 			break;
-		temp_len -= (u32)lbas << ns->lba_shift;
-		buffer += lbas << ns->lba_shift;
+		}
+
+		/* After an error, just wait for what is still in flight */
+		if (nvmeq->err_lba != U64_MAX)
+			total_lbas = 0;
 	}
 
 	if (read)
 		invalidate_dcache_range((unsigned long)buffer,
 					(unsigned long)buffer + total_len);
 
-	return (total_len - temp_len) >> desc->log2blksz;
+	/* Commands may complete out of order: count up to the first failure */
+	if (nvmeq->err_lba != U64_MAX)
+		return nvmeq->err_lba - blknr;
+
+	return blkcnt;
 }
 
 static ulong nvme_blk_read(struct udevice *udev, lbaint_t blknr,
@@ -790,14 +994,6 @@ static int nvme_probe(struct udevice *udev)
 	}
 	memset(ndev->queues, 0, NVME_Q_NUM * sizeof(struct nvme_queue *));
 
-	ndev->prp_pool = malloc(MAX_PRP_POOL);
-	if (!ndev->prp_pool) {
-		ret = -ENOMEM;
-		printf("Error: %s: Out of memory!\n", udev->name);
-		goto free_nvme;
-	}
-	ndev->prp_entry_num = MAX_PRP_POOL >> 3;
-
 	ndev->cap = nvme_readq(&ndev->bar->cap);
 	ndev->q_depth = min_t(int, NVME_CAP_MQES(ndev->cap) + 1, NVME_Q_DEPTH);
 	ndev->db_stride = 1 << NVME_CAP_STRIDE(ndev->cap);
@@ -813,6 +1009,12 @@ static int nvme_probe(struct udevice *udev)
 
 	nvme_get_info_from_identify(ndev);
 
+	ret = nvme_alloc_io_slots(ndev, ndev->queues[NVME_IO_Q]);
+	if (ret) {
+		printf("Error: %s: Out of memory!\n", udev->name);
+		goto free_queue;
+	}
+
 	return 0;
 
 free_queue:
@@ -124,6 +124,40 @@ static int sandbox_spi_xfer(struct udevice *slave, unsigned int bitlen,
 	return ret;
 }
 
+/*
+ * Emulate a controller which runs whole flash read commands, by sending the
+ * command as a single transfer to the flash emulator
+ */
+static int sandbox_spi_flash_read(struct udevice *slave,
+				  const struct spi_flash_read_op *op,
+				  u32 offset, size_t len, void *buf)
+{
+	int hdr_len = 1 + op->addr_len + spi_flash_read_dummy_bytes(op);
+	u8 *tx, *rx;
+	int i, ret;
+
+	tx = calloc(1, hdr_len + len);
+	rx = malloc(hdr_len + len);
+	if (!tx || !rx) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	tx[0] = op->opcode;
+	for (i = 0; i < op->addr_len; i++)
+		tx[1 + i] = offset >> (8 * (op->addr_len - 1 - i));
+
+	ret = sandbox_spi_xfer(slave, (hdr_len + len) * 8, tx, rx,
+			       SPI_XFER_ONCE);
+	if (!ret)
+		memcpy(buf, rx + hdr_len, len);
+out:
+	free(rx);
+	free(tx);
+
+	return ret;
+}
+
 static int sandbox_spi_set_speed(struct udevice *bus, uint speed)
 {
 	return 0;
@@ -149,6 +183,7 @@ static const struct dm_spi_ops sandbox_spi_ops = {
 	.set_speed	= sandbox_spi_set_speed,
 	.set_mode	= sandbox_spi_set_mode,
 	.cs_info	= sandbox_cs_info,
+	.flash_read	= sandbox_spi_flash_read,
 };
 
 static const struct udevice_id sandbox_spi_ids[] = {
@@ -91,6 +91,27 @@ int dm_spi_xfer(struct udevice *dev, unsigned int bitlen,
 	return spi_get_ops(bus)->xfer(dev, bitlen, dout, din, flags);
 }
 
+bool dm_spi_can_flash_read(struct udevice *dev)
+{
+	struct udevice *bus = dev->parent;
+
+	if (bus->uclass->uc_drv->id != UCLASS_SPI)
+		return false;
+
+	return !!spi_get_ops(bus)->flash_read;
+}
+
+int dm_spi_flash_read(struct udevice *dev, const struct spi_flash_read_op *op,
+		      u32 offset, size_t len, void *buf)
+{
+	struct udevice *bus = dev->parent;
+
+	if (!dm_spi_can_flash_read(dev))
+		return -EOPNOTSUPP;
+
+	return spi_get_ops(bus)->flash_read(dev, op, offset, len, buf);
+}
+
 int spi_claim_bus(struct spi_slave *slave)
 {
 	return dm_spi_claim_bus(slave->dev);
@@ -144,6 +165,8 @@ static int spi_post_probe(struct udevice *bus)
 		ops->set_mode += gd->reloc_off;
 	if (ops->cs_info)
 		ops->cs_info += gd->reloc_off;
+	if (ops->flash_read)
+		ops->flash_read += gd->reloc_off;
 #endif
 
 	return 0;
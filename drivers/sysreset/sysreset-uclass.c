@@ -9,6 +9,7 @@
 #include <sysreset.h>
 #include <dm.h>
 #include <errno.h>
+#include <mmc.h>
 #include <regmap.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
@@ -70,6 +71,8 @@ void reset_cpu(ulong addr)
 
 int do_reset(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
+	/* An eMMC may lose what is in its cache when it is reset */
+	mmc_flush_all_caches();
 	sysreset_walk_halt(SYSRESET_WARM);
 
 	return 0;
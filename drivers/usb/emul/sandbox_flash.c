@@ -17,12 +17,24 @@ DECLARE_GLOBAL_DATA_PTR;
  * This driver emulates a flash stick using the UFI command specification and
  * the BBB (bulk/bulk/bulk) protocol. It supports only a single logical unit
  * number (LUN 0).
+ *
+ * With the "sandbox,uas" property it also offers USB Attached SCSI as
+ * alternate setting 1. Queued commands are then run newest first, so that
+ * the host sees them complete out of order. With "sandbox,superspeed" as
+ * well the stick is a SuperSpeed device, and UAS moves the data and status
+ * of each command on the stream matching its tag.
  */
 
 enum {
 	SANDBOX_FLASH_EP_OUT		= 1,	/* endpoints */
 	SANDBOX_FLASH_EP_IN		= 2,
+	SANDBOX_FLASH_EP_CMD		= 3,	/* UAS endpoints */
+	SANDBOX_FLASH_EP_STATUS		= 4,
+	SANDBOX_FLASH_EP_DATA_IN	= 5,
+	SANDBOX_FLASH_EP_DATA_OUT	= 6,
 	SANDBOX_FLASH_BLOCK_LEN		= 512,
+	SANDBOX_FLASH_UAS_QUEUE		= 8,
+	SANDBOX_FLASH_MAX_STREAMS_LOG2	= 5,
 };
 
 enum cmd_phase {
@@ -52,6 +64,14 @@ enum {
  * @status_buff:	Data buffer for outgoing status
  * @buff_used:	Number of bytes ready to transfer back to host
  * @buff:	Data buffer for outgoing data
+ * @alt:	Current alternate setting, 1 for UAS
+ * @uas_queue:	UAS commands received and not yet finished
+ * @uas_count:	Number of entries in @uas_queue
+ * @uas_max_queued: Largest number of UAS commands queued at once
+ * @uas_active:	true if the last entry of @uas_queue is being run
+ * @uas_tmf_tag: Tag of a task management function to respond to, or 0
+ * @uas_fail_after: Number of status IUs to send before failing a status
+ *		read, 0 to never fail
  */
 struct sandbox_flash_priv {
 	bool error;
@@ -65,11 +85,26 @@ struct sandbox_flash_priv {
 	struct umass_bbb_csw status;
 	int buff_used;
 	u8 buff[512];
+	int alt;
+	struct uas_cmd_iu uas_queue[SANDBOX_FLASH_UAS_QUEUE];
+	int uas_count;
+	int uas_max_queued;
+	bool uas_active;
+	int uas_tmf_tag;
+	int uas_fail_after;
 };
 
+/**
+ * struct sandbox_flash_plat - platform data for this driver
+ *
+ * @pathname:	Backing file
+ * @flash_strings: USB strings
+ * @superspeed:	true to appear as a SuperSpeed device using UAS streams
+ */
 struct sandbox_flash_plat {
 	const char *pathname;
 	struct usb_string flash_strings[STRINGID_COUNT];
+	bool superspeed;
 };
 
 struct scsi_inquiry_resp {
@@ -98,6 +133,15 @@ struct __packed scsi_read10_req {
 	u8 spare2[3];
 };
 
+struct __packed scsi_read16_req {
+	u8 cmd;
+	u8 flags;
+	u64 lba;
+	u32 transfer_len;
+	u8 group;
+	u8 control;
+};
+
 static struct usb_device_descriptor flash_device_desc = {
 	.bLength =		sizeof(flash_device_desc),
 	.bDescriptorType =	USB_DT_DEVICE,
@@ -116,6 +160,24 @@ static struct usb_device_descriptor flash_device_desc = {
 	.bNumConfigurations =	1,
 };
 
+static struct usb_device_descriptor flash_ss_device_desc = {
+	.bLength =		sizeof(flash_ss_device_desc),
+	.bDescriptorType =	USB_DT_DEVICE,
+
+	.bcdUSB =		__constant_cpu_to_le16(0x0300),
+
+	.bDeviceClass =		0,
+	.bDeviceSubClass =	0,
+	.bDeviceProtocol =	0,
+
+	.idVendor =		__constant_cpu_to_le16(0x1234),
+	.idProduct =		__constant_cpu_to_le16(0x5678),
+	.iManufacturer =	STRINGID_MANUFACTURER,
+	.iProduct =		STRINGID_PRODUCT,
+	.iSerialNumber =	STRINGID_SERIAL,
+	.bNumConfigurations =	1,
+};
+
 static struct usb_config_descriptor flash_config0 = {
 	.bLength		= sizeof(flash_config0),
 	.bDescriptorType	= USB_DT_CONFIG,
@@ -170,6 +232,177 @@ static void *flash_desc_list[] = {
 	NULL,
 };
 
+static struct usb_config_descriptor flash_uas_config0 = {
+	.bLength		= sizeof(flash_uas_config0),
+	.bDescriptorType	= USB_DT_CONFIG,
+
+	/* wTotalLength is set up by usb-emul-uclass */
+	.bNumInterfaces		= 1,
+	.bConfigurationValue	= 0,
+	.iConfiguration		= 0,
+	.bmAttributes		= 1 << 7,
+	.bMaxPower		= 50,
+};
+
+/* UAS devices use the SCSI command set for bulk-only transport too */
+static struct usb_interface_descriptor flash_uas_interface0 = {
+	.bLength		= sizeof(flash_uas_interface0),
+	.bDescriptorType	= USB_DT_INTERFACE,
+
+	.bInterfaceNumber	= 0,
+	.bAlternateSetting	= 0,
+	.bNumEndpoints		= 2,
+	.bInterfaceClass	= USB_CLASS_MASS_STORAGE,
+	.bInterfaceSubClass	= US_SC_SCSI,
+	.bInterfaceProtocol	= US_PR_BULK,
+	.iInterface		= 0,
+};
+
+static struct usb_interface_descriptor flash_uas_interface1 = {
+	.bLength		= sizeof(flash_uas_interface1),
+	.bDescriptorType	= USB_DT_INTERFACE,
+
+	.bInterfaceNumber	= 0,
+	.bAlternateSetting	= 1,
+	.bNumEndpoints		= 4,
+	.bInterfaceClass	= USB_CLASS_MASS_STORAGE,
+	.bInterfaceSubClass	= US_SC_SCSI,
+	.bInterfaceProtocol	= US_PR_UAS,
+	.iInterface		= 0,
+};
+
+static struct usb_endpoint_descriptor flash_endpoint_cmd = {
+	.bLength		= USB_DT_ENDPOINT_SIZE,
+	.bDescriptorType	= USB_DT_ENDPOINT,
+
+	.bEndpointAddress	= SANDBOX_FLASH_EP_CMD,
+	.bmAttributes		= USB_ENDPOINT_XFER_BULK,
+	.wMaxPacketSize		= __constant_cpu_to_le16(512),
+	.bInterval		= 0,
+};
+
+static struct usb_pipe_usage_descriptor flash_pipe_cmd = {
+	.bLength		= sizeof(flash_pipe_cmd),
+	.bDescriptorType	= USB_DT_PIPE_USAGE,
+	.bPipeID		= UAS_PIPE_CMD,
+};
+
+static struct usb_endpoint_descriptor flash_endpoint_status = {
+	.bLength		= USB_DT_ENDPOINT_SIZE,
+	.bDescriptorType	= USB_DT_ENDPOINT,
+
+	.bEndpointAddress	= SANDBOX_FLASH_EP_STATUS |
+				  USB_ENDPOINT_DIR_MASK,
+	.bmAttributes		= USB_ENDPOINT_XFER_BULK,
+	.wMaxPacketSize		= __constant_cpu_to_le16(512),
+	.bInterval		= 0,
+};
+
+static struct usb_pipe_usage_descriptor flash_pipe_status = {
+	.bLength		= sizeof(flash_pipe_status),
+	.bDescriptorType	= USB_DT_PIPE_USAGE,
+	.bPipeID		= UAS_PIPE_STATUS,
+};
+
+static struct usb_endpoint_descriptor flash_endpoint_data_in = {
+	.bLength		= USB_DT_ENDPOINT_SIZE,
+	.bDescriptorType	= USB_DT_ENDPOINT,
+
+	.bEndpointAddress	= SANDBOX_FLASH_EP_DATA_IN |
+				  USB_ENDPOINT_DIR_MASK,
+	.bmAttributes		= USB_ENDPOINT_XFER_BULK,
+	.wMaxPacketSize		= __constant_cpu_to_le16(512),
+	.bInterval		= 0,
+};
+
+static struct usb_pipe_usage_descriptor flash_pipe_data_in = {
+	.bLength		= sizeof(flash_pipe_data_in),
+	.bDescriptorType	= USB_DT_PIPE_USAGE,
+	.bPipeID		= UAS_PIPE_DATA_IN,
+};
+
+static struct usb_endpoint_descriptor flash_endpoint_data_out = {
+	.bLength		= USB_DT_ENDPOINT_SIZE,
+	.bDescriptorType	= USB_DT_ENDPOINT,
+
+	.bEndpointAddress	= SANDBOX_FLASH_EP_DATA_OUT,
+	.bmAttributes		= USB_ENDPOINT_XFER_BULK,
+	.wMaxPacketSize		= __constant_cpu_to_le16(512),
+	.bInterval		= 0,
+};
+
+static struct usb_pipe_usage_descriptor flash_pipe_data_out = {
+	.bLength		= sizeof(flash_pipe_data_out),
+	.bDescriptorType	= USB_DT_PIPE_USAGE,
+	.bPipeID		= UAS_PIPE_DATA_OUT,
+};
+
+static struct usb_config_descriptor flash_uas_ss_config0 = {
+	.bLength		= sizeof(flash_uas_ss_config0),
+	.bDescriptorType	= USB_DT_CONFIG,
+
+	/* wTotalLength is set up by usb-emul-uclass */
+	.bNumInterfaces		= 1,
+	.bConfigurationValue	= 0,
+	.iConfiguration		= 0,
+	.bmAttributes		= 1 << 7,
+	.bMaxPower		= 50,
+};
+
+static struct usb_ss_ep_comp_descriptor flash_ss_ep_comp = {
+	.bLength		= USB_DT_SS_EP_COMP_SIZE,
+	.bDescriptorType	= USB_DT_SS_ENDPOINT_COMP,
+};
+
+/* The UAS status and data endpoints support streams */
+static struct usb_ss_ep_comp_descriptor flash_ss_stream_comp = {
+	.bLength		= USB_DT_SS_EP_COMP_SIZE,
+	.bDescriptorType	= USB_DT_SS_ENDPOINT_COMP,
+	.bmAttributes		= SANDBOX_FLASH_MAX_STREAMS_LOG2,
+};
+
+static void *flash_uas_desc_list[] = {
+	&flash_device_desc,
+	&flash_uas_config0,
+	&flash_uas_interface0,
+	&flash_endpoint0_out,
+	&flash_endpoint1_in,
+	&flash_uas_interface1,
+	&flash_endpoint_cmd,
+	&flash_pipe_cmd,
+	&flash_endpoint_status,
+	&flash_pipe_status,
+	&flash_endpoint_data_in,
+	&flash_pipe_data_in,
+	&flash_endpoint_data_out,
+	&flash_pipe_data_out,
+	NULL,
+};
+
+static void *flash_uas_ss_desc_list[] = {
+	&flash_ss_device_desc,
+	&flash_uas_ss_config0,
+	&flash_uas_interface0,
+	&flash_endpoint0_out,
+	&flash_ss_ep_comp,
+	&flash_endpoint1_in,
+	&flash_ss_ep_comp,
+	&flash_uas_interface1,
+	&flash_endpoint_cmd,
+	&flash_ss_ep_comp,
+	&flash_pipe_cmd,
+	&flash_endpoint_status,
+	&flash_ss_stream_comp,
+	&flash_pipe_status,
+	&flash_endpoint_data_in,
+	&flash_ss_stream_comp,
+	&flash_pipe_data_in,
+	&flash_endpoint_data_out,
+	&flash_ss_stream_comp,
+	&flash_pipe_data_out,
+	NULL,
+};
+
 static int sandbox_flash_control(struct udevice *dev, struct usb_device *udev,
 				 unsigned long pipe, void *buff, int len,
 				 struct devrequest *setup)
@@ -188,6 +421,12 @@ static int sandbox_flash_control(struct udevice *dev, struct usb_device *udev,
 			debug("request=%x\n", setup->request);
 			break;
 		}
+	} else if (pipe == usb_sndctrlpipe(udev, 0) &&
+		   setup->request == USB_REQ_SET_INTERFACE) {
+		priv->alt = setup->value;
+		priv->uas_count = 0;
+		priv->uas_active = false;
+		return 0;
 	}
 	debug("pipe=%lx\n", pipe);
 
@@ -287,6 +526,13 @@ static int handle_ufi_command(struct sandbox_flash_plat *plat,
 			    be16_to_cpu(req->transfer_len));
 		break;
 	}
+	case SCSI_READ16: {
+		struct scsi_read16_req *req = (void *)buff;
+
+		handle_read(priv, be64_to_cpu(req->lba),
+			    be32_to_cpu(req->transfer_len));
+		break;
+	}
 	default:
 		debug("Command not supported: %x\n", req->cmd[0]);
 		return -EPROTONOSUPPORT;
@@ -296,6 +542,242 @@ static int handle_ufi_command(struct sandbox_flash_plat *plat,
 	return 0;
 }
 
+static int handle_data_in(struct sandbox_flash_priv *priv, void *buff, int len)
+{
+	debug("data in, len=%x, alloc_len=%x, priv->read_len=%x\n",
+	      len, priv->alloc_len, priv->read_len);
+	if (priv->read_len) {
+		ulong bytes_read;
+
+		bytes_read = os_read(priv->fd, buff, len);
+		if (bytes_read != len)
+			return -EIO;
+		priv->read_len -= len / SANDBOX_FLASH_BLOCK_LEN;
+		if (!priv->read_len)
+			priv->phase = PHASE_STATUS;
+	} else {
+		if (priv->alloc_len && len > priv->alloc_len)
+			len = priv->alloc_len;
+		memcpy(buff, priv->buff, len);
+		priv->phase = PHASE_STATUS;
+	}
+
+	return len;
+}
+
+/* Start running the newest queued UAS command */
+static void uas_start(struct sandbox_flash_plat *plat,
+		      struct sandbox_flash_priv *priv)
+{
+	struct uas_cmd_iu *cmd = &priv->uas_queue[priv->uas_count - 1];
+	int ret;
+
+	priv->alloc_len = 0;
+	priv->read_len = 0;
+	priv->transfer_len = 0;
+	ret = handle_ufi_command(plat, priv, cmd->cdb, sizeof(cmd->cdb));
+	if (ret)
+		priv->status.bCSWStatus = CSWSTATUS_FAILED;
+	if (!ret && priv->status.bCSWStatus == CSWSTATUS_GOOD &&
+	    (priv->buff_used || priv->read_len))
+		priv->phase = PHASE_DATA;
+	else
+		priv->phase = PHASE_STATUS;
+	priv->uas_active = true;
+}
+
+/* Finish the UAS command being run and return its sense IU */
+static int uas_sense(struct sandbox_flash_priv *priv, void *buff, int len)
+{
+	struct uas_cmd_iu *cmd = &priv->uas_queue[priv->uas_count - 1];
+	struct uas_sense_iu *iu = buff;
+
+	if (len < sizeof(*iu))
+		return -EIO;
+	memset(iu, '\0', sizeof(*iu));
+	iu->iu_id = UAS_IU_SENSE;
+	iu->tag = cmd->tag;
+
+	/* The host must read all the data first */
+	if (priv->phase != PHASE_STATUS)
+		priv->status.bCSWStatus = CSWSTATUS_FAILED;
+	if (priv->status.bCSWStatus != CSWSTATUS_GOOD) {
+		iu->status = 2;			/* CHECK CONDITION */
+		iu->sense[0] = 0x70;		/* current error */
+		iu->sense[2] = 5;		/* ILLEGAL REQUEST */
+		iu->sense[7] = 10;		/* additional length */
+		iu->len = cpu_to_be16(18);
+	}
+	priv->uas_active = false;
+	priv->uas_count--;
+
+	return sizeof(*iu);
+}
+
+/* Check whether a status IU should fail, see sandbox_flash_uas_fail() */
+static bool uas_status_fails(struct sandbox_flash_priv *priv)
+{
+	return priv->uas_fail_after && !--priv->uas_fail_after;
+}
+
+/*
+ * Return the response to a task management function, or else the next IU
+ * to send on the status pipe without streams: a READ READY IU when the
+ * newest queued command has data to send, then its sense IU
+ */
+static int handle_uas_status(struct sandbox_flash_plat *plat,
+			     struct sandbox_flash_priv *priv, void *buff,
+			     int len)
+{
+	struct uas_iu_header *iu = buff;
+
+	if (uas_status_fails(priv))
+		return -EIO;
+	if (priv->uas_tmf_tag && len >= sizeof(struct uas_response_iu)) {
+		struct uas_response_iu *resp = buff;
+
+		memset(resp, '\0', sizeof(*resp));
+		resp->iu_id = UAS_IU_RESPONSE;
+		resp->tag = cpu_to_be16(priv->uas_tmf_tag);
+		resp->response_code = UAS_RC_TMF_COMPLETE;
+		priv->uas_tmf_tag = 0;
+		return sizeof(*resp);
+	}
+	if (!priv->uas_count || len < sizeof(*iu))
+		return -EIO;
+	if (!priv->uas_active) {
+		uas_start(plat, priv);
+		if (priv->phase == PHASE_DATA) {
+			memset(iu, '\0', sizeof(*iu));
+			iu->iu_id = UAS_IU_READ_READY;
+			iu->tag = priv->uas_queue[priv->uas_count - 1].tag;
+			return sizeof(*iu);
+		}
+	}
+
+	return uas_sense(priv, buff, len);
+}
+
+static int sandbox_flash_uas_bulk(struct sandbox_flash_plat *plat,
+				  struct sandbox_flash_priv *priv, int ep,
+				  void *buff, int len)
+{
+	switch (ep) {
+	case SANDBOX_FLASH_EP_CMD: {
+		struct uas_task_mgmt_iu *tmf = buff;
+		struct uas_cmd_iu *iu = buff;
+
+		/* Any task management function drops every queued command */
+		if (len >= sizeof(*tmf) && tmf->iu_id == UAS_IU_TASK_MGMT) {
+			priv->uas_count = 0;
+			priv->uas_active = false;
+			priv->uas_tmf_tag = be16_to_cpu(tmf->tag);
+			return len;
+		}
+		if (len < sizeof(*iu) || iu->iu_id != UAS_IU_COMMAND ||
+		    priv->uas_count == SANDBOX_FLASH_UAS_QUEUE)
+			return -EIO;
+		/* The command being run stays last in the queue */
+		if (priv->uas_active) {
+			priv->uas_queue[priv->uas_count] =
+				priv->uas_queue[priv->uas_count - 1];
+			memcpy(&priv->uas_queue[priv->uas_count - 1], iu,
+			       sizeof(*iu));
+			priv->uas_count++;
+		} else {
+			memcpy(&priv->uas_queue[priv->uas_count++], iu,
+			       sizeof(*iu));
+		}
+		priv->uas_max_queued = max(priv->uas_max_queued,
+					   priv->uas_count);
+		return len;
+	}
+	case SANDBOX_FLASH_EP_STATUS:
+		/* At SuperSpeed the status and data go on streams */
+		if (plat->superspeed)
+			return -EIO;
+		return handle_uas_status(plat, priv, buff, len);
+	case SANDBOX_FLASH_EP_DATA_IN:
+		if (plat->superspeed || !priv->uas_active ||
+		    priv->phase != PHASE_DATA)
+			return -EIO;
+		return handle_data_in(priv, buff, len);
+	default:
+		debug("%s: ep %d not supported\n", __func__, ep);
+		return -EIO;
+	}
+}
+
+/*
+ * Move the status or data of the UAS command being run, if the request is
+ * on the stream for its tag. The device chooses which stream it is ready
+ * for, so requests on other streams have to wait.
+ */
+static int sandbox_flash_stream(struct udevice *dev, struct usb_device *udev,
+				struct usb_bulk_req *req)
+{
+	struct sandbox_flash_plat *plat = dev_get_platdata(dev);
+	struct sandbox_flash_priv *priv = dev_get_priv(dev);
+	int ep = usb_pipeendpoint(req->pipe);
+	struct uas_cmd_iu *cmd;
+
+	debug("%s: dev=%s, ep=%x, stream=%u, len=%x\n", __func__, dev->name,
+	      ep, req->stream, req->length);
+	if (!plat->superspeed || !priv->alt)
+		return -EIO;
+	if (ep == SANDBOX_FLASH_EP_STATUS && priv->uas_tmf_tag) {
+		if (req->stream != priv->uas_tmf_tag)
+			return -EAGAIN;
+		return handle_uas_status(plat, priv, req->buffer,
+					 req->length);
+	}
+	if (!priv->uas_count)
+		return -EAGAIN;
+	if (!priv->uas_active)
+		uas_start(plat, priv);
+	cmd = &priv->uas_queue[priv->uas_count - 1];
+	if (req->stream != be16_to_cpu(cmd->tag))
+		return -EAGAIN;
+
+	switch (ep) {
+	case SANDBOX_FLASH_EP_STATUS:
+		/* The data goes first */
+		if (priv->phase == PHASE_DATA)
+			return -EAGAIN;
+		if (uas_status_fails(priv))
+			return -EIO;
+		return uas_sense(priv, req->buffer, req->length);
+	case SANDBOX_FLASH_EP_DATA_IN:
+		if (priv->phase != PHASE_DATA)
+			return -EIO;
+		return handle_data_in(priv, req->buffer, req->length);
+	default:
+		debug("%s: ep %d not supported\n", __func__, ep);
+		return -EIO;
+	}
+}
+
+int sandbox_flash_get_max_queued(struct udevice *dev)
+{
+	struct sandbox_flash_priv *priv = dev_get_priv(dev);
+
+	return priv->uas_max_queued;
+}
+
+int sandbox_flash_get_queued(struct udevice *dev)
+{
+	struct sandbox_flash_priv *priv = dev_get_priv(dev);
+
+	return priv->uas_count;
+}
+
+void sandbox_flash_uas_fail(struct udevice *dev, int ius)
+{
+	struct sandbox_flash_priv *priv = dev_get_priv(dev);
+
+	priv->uas_fail_after = ius + 1;
+}
+
 static int sandbox_flash_bulk(struct udevice *dev, struct usb_device *udev,
 			      unsigned long pipe, void *buff, int len)
 {
@@ -306,6 +788,8 @@ static int sandbox_flash_bulk(struct udevice *dev, struct usb_device *udev,
 
 	debug("%s: dev=%s, pipe=%lx, ep=%x, len=%x, phase=%d\n", __func__,
 	      dev->name, pipe, ep, len, priv->phase);
+	if (priv->alt)
+		return sandbox_flash_uas_bulk(plat, priv, ep, buff, len);
 	switch (ep) {
 	case SANDBOX_FLASH_EP_OUT:
 		switch (priv->phase) {
@@ -333,24 +817,7 @@ static int sandbox_flash_bulk(struct udevice *dev, struct usb_device *udev,
 	case SANDBOX_FLASH_EP_IN:
 		switch (priv->phase) {
 		case PHASE_DATA:
-			debug("data in, len=%x, alloc_len=%x, priv->read_len=%x\n",
-			      len, priv->alloc_len, priv->read_len);
-			if (priv->read_len) {
-				ulong bytes_read;
-
-				bytes_read = os_read(priv->fd, buff, len);
-				if (bytes_read != len)
-					return -EIO;
-				priv->read_len -= len / SANDBOX_FLASH_BLOCK_LEN;
-				if (!priv->read_len)
-					priv->phase = PHASE_STATUS;
-			} else {
-				if (priv->alloc_len && len > priv->alloc_len)
-					len = priv->alloc_len;
-				memcpy(buff, priv->buff, len);
-				priv->phase = PHASE_STATUS;
-			}
-			return len;
+			return handle_data_in(priv, buff, len);
 		case PHASE_STATUS:
 			debug("status in, len=%x\n", len);
 			if (len > sizeof(priv->status))
@@ -381,6 +848,7 @@ static int sandbox_flash_bind(struct udevice *dev)
 {
 	struct sandbox_flash_plat *plat = dev_get_platdata(dev);
 	struct usb_string *fs;
+	void **desc_list;
 
 	fs = plat->flash_strings;
 	fs[0].id = STRINGID_MANUFACTURER;
@@ -390,7 +858,14 @@ static int sandbox_flash_bind(struct udevice *dev)
 	fs[2].id = STRINGID_SERIAL;
 	fs[2].s = dev->name;
 
-	return usb_emul_setup_device(dev, plat->flash_strings, flash_desc_list);
+	desc_list = flash_desc_list;
+	if (dev_read_bool(dev, "sandbox,uas")) {
+		plat->superspeed = dev_read_bool(dev, "sandbox,superspeed");
+		desc_list = plat->superspeed ? flash_uas_ss_desc_list :
+			flash_uas_desc_list;
+	}
+
+	return usb_emul_setup_device(dev, plat->flash_strings, desc_list);
 }
 
 static int sandbox_flash_probe(struct udevice *dev)
@@ -408,6 +883,7 @@ static int sandbox_flash_probe(struct udevice *dev)
 static const struct dm_usb_ops sandbox_usb_flash_ops = {
 	.control	= sandbox_flash_control,
 	.bulk		= sandbox_flash_bulk,
+	.submit_bulk	= sandbox_flash_stream,
 };
 
 static const struct udevice_id sandbox_usb_flash_ids[] = {
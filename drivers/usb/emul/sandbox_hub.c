@@ -13,7 +13,7 @@
 DECLARE_GLOBAL_DATA_PTR;
 
 /* We only support up to 8 */
-#define SANDBOX_NUM_PORTS	4
+#define SANDBOX_NUM_PORTS	6
 
 struct sandbox_hub_platdata {
 	struct usb_dev_platdata plat;
@@ -147,6 +147,9 @@ static struct udevice *hub_find_device(struct udevice *hub, int port,
 			case 0x0101:
 				*speed = USB_SPEED_FULL;
 				break;
+			case 0x0300:
+				*speed = USB_SPEED_SUPER;
+				break;
 			case 0x0200:
 			default:
 				*speed = USB_SPEED_HIGH;
@@ -183,6 +186,8 @@ static int clrset_post_state(struct udevice *hub, int port, int clear, int set)
 						set |= USB_PORT_STAT_LOW_SPEED;
 					else if (speed == USB_SPEED_HIGH)
 						set |= USB_PORT_STAT_HIGH_SPEED;
+					else if (speed == USB_SPEED_SUPER)
+						set |= USB_PORT_STAT_SUPER_SPEED;
 				}
 
 			} else if (clear & USB_PORT_STAT_POWER) {
@@ -247,6 +247,24 @@ int usb_emul_bulk(struct udevice *emul, struct usb_device *udev,
 	return ops->bulk(emul, udev, pipe, buffer, length);
 }
 
+int usb_emul_bulk_req(struct udevice *emul, struct usb_device *udev,
+		      struct usb_bulk_req *req)
+{
+	struct dm_usb_ops *ops = usb_get_emul_ops(emul);
+	int ret;
+
+	if (!req->stream)
+		return usb_emul_bulk(emul, udev, req->pipe, req->buffer,
+				     req->length);
+	if (!ops->submit_bulk)
+		return -ENOSYS;
+	debug("%s: dev=%s, stream=%u\n", __func__, emul->name, req->stream);
+	ret = device_probe(emul);
+	if (ret)
+		return ret;
+	return ops->submit_bulk(emul, udev, req);
+}
+
 int usb_emul_int(struct udevice *emul, struct usb_device *udev,
 		  unsigned long pipe, void *buffer, int length, int interval)
 {
@@ -761,7 +761,7 @@ void ax88179_eth_stop(struct udevice *dev)
 
 	debug("** %s()\n", __func__);
 
-	usb_ether_advance_rxbuf(ueth, -1);
+	usb_ether_stop_rx(ueth);
 	priv->pkt_cnt = 0;
 	priv->pkt_data = NULL;
 	priv->pkt_hdr = NULL;
@@ -855,7 +855,10 @@ static int mcs7830_eth_start(struct udevice *dev)
 
 void mcs7830_eth_stop(struct udevice *dev)
 {
+	struct mcs7830_private *priv = dev_get_priv(dev);
+
 	debug("** %s()\n", __func__);
+	usb_ether_stop_rx(&priv->ueth);
 }
 
 int mcs7830_eth_send(struct udevice *dev, void *packet, int length)
@@ -1493,6 +1493,7 @@ void r8152_eth_stop(struct udevice *dev)
 	debug("** %s (%d)\n", __func__, __LINE__);
 
 	tp->rtl_ops.disable(tp);
+	usb_ether_stop_rx(&tp->ueth);
 }
 
 int r8152_eth_send(struct udevice *dev, void *packet, int length)
@@ -17,6 +17,12 @@
 
 #define USB_BULK_RECV_TIMEOUT 500
 
+/* Space between the receive buffers, which are DMA-aligned */
+static int usb_ether_rx_stride(struct ueth_data *ueth)
+{
+	return ALIGN(ueth->rxsize, ARCH_DMA_MINALIGN);
+}
+
 int usb_ether_register(struct udevice *dev, struct ueth_data *ueth, int rxsize)
 {
 	struct usb_device *udev = dev_get_parent_priv(dev);
@@ -73,9 +79,12 @@ int usb_ether_register(struct udevice *dev, struct ueth_data *ueth, int rxsize)
 	}
 
 	ueth->rxsize = rxsize;
-	ueth->rxbuf = memalign(ARCH_DMA_MINALIGN, rxsize);
+	ueth->rxbuf = memalign(ARCH_DMA_MINALIGN,
+			       USB_ETHER_RX_REQS * usb_ether_rx_stride(ueth));
 	if (!ueth->rxbuf)
 		return -ENOMEM;
+	ueth->rx_queued = 0;
+	ueth->rx_cur = 0;
 
 	ret = usb_set_interface(udev, iface_desc->bInterfaceNumber, ifnum);
 	if (ret) {
@@ -90,48 +99,101 @@ int usb_ether_register(struct udevice *dev, struct ueth_data *ueth, int rxsize)
 
 int usb_ether_deregister(struct ueth_data *ueth)
 {
+	usb_ether_stop_rx(ueth);
+	free(ueth->rxbuf);
+	ueth->rxbuf = NULL;
+
 	return 0;
 }
 
+void usb_ether_stop_rx(struct ueth_data *ueth)
+{
+	if (ueth->rx_queued)
+		usb_cancel_bulk(ueth->pusb_dev,
+				usb_rcvbulkpipe(ueth->pusb_dev, ueth->ep_in));
+	ueth->rx_queued = 0;
+	ueth->rx_cur = 0;
+	ueth->rxlen = 0;
+}
+
+/* Hand the current receive buffer back, the next one holds the next data */
+static void usb_ether_release_rx(struct ueth_data *ueth)
+{
+	ueth->rx_queued &= ~(1 << ueth->rx_cur);
+	ueth->rx_cur = (ueth->rx_cur + 1) % USB_ETHER_RX_REQS;
+}
+
 int usb_ether_receive(struct ueth_data *ueth, int rxsize)
 {
-	int actual_len;
-	int ret;
+	struct usb_device *udev = ueth->pusb_dev;
+	struct usb_bulk_req *req;
+	int ret, i, n;
 
 	if (rxsize > ueth->rxsize)
 		return -EINVAL;
-	ret = usb_bulk_msg(ueth->pusb_dev,
-			   usb_rcvbulkpipe(ueth->pusb_dev, ueth->ep_in),
-			   ueth->rxbuf, rxsize, &actual_len,
-			   USB_BULK_RECV_TIMEOUT);
-	debug("Rx: len = %u, actual = %u, err = %d\n", rxsize, actual_len, ret);
+
+	/*
+	 * Queue a transfer in each free buffer, so that more data can arrive
+	 * while the caller deals with this lot
+	 */
+	for (i = 0; i < USB_ETHER_RX_REQS; i++) {
+		n = (ueth->rx_cur + i) % USB_ETHER_RX_REQS;
+		if (ueth->rx_queued & (1 << n))
+			continue;
+		req = &ueth->rx_req[n];
+		req->pipe = usb_rcvbulkpipe(udev, ueth->ep_in);
+		req->buffer = ueth->rxbuf + n * usb_ether_rx_stride(ueth);
+		req->length = rxsize;
+		if (usb_submit_bulk(udev, req))
+			break;
+		ueth->rx_queued |= 1 << n;
+	}
+
+	req = &ueth->rx_req[ueth->rx_cur];
+	if (!(ueth->rx_queued & (1 << ueth->rx_cur)))
+		return -EAGAIN;
+	ret = usb_wait_bulk(udev, req, USB_BULK_RECV_TIMEOUT);
+	debug("Rx: len = %u, actual = %u, err = %d\n", rxsize, req->actual,
+	      ret);
 	if (ret) {
 		printf("Rx: failed to receive: %d\n", ret);
+		usb_ether_stop_rx(ueth);
 		return ret;
 	}
-	if (actual_len > rxsize) {
-		debug("Rx: received too many bytes %d\n", actual_len);
+	if (req->actual > rxsize) {
+		debug("Rx: received too many bytes %d\n", req->actual);
+		usb_ether_release_rx(ueth);
 		return -ENOSPC;
 	}
-	ueth->rxlen = actual_len;
+	ueth->rxlen = req->actual;
 	ueth->rxptr = 0;
+	if (!ueth->rxlen) {
+		usb_ether_release_rx(ueth);
+		return -EAGAIN;
+	}
 
-	return actual_len ? 0 : -EAGAIN;
+	return 0;
 }
 
 void usb_ether_advance_rxbuf(struct ueth_data *ueth, int num_bytes)
 {
+	if (!ueth->rxlen)
+		return;
 	ueth->rxptr += num_bytes;
-	if (num_bytes < 0 || ueth->rxptr >= ueth->rxlen)
+	if (num_bytes < 0 || ueth->rxptr >= ueth->rxlen) {
 		ueth->rxlen = 0;
+		usb_ether_release_rx(ueth);
+	}
 }
 
 int usb_ether_get_rx_bytes(struct ueth_data *ueth, uint8_t **ptrp)
 {
+	uint8_t *buf = ueth->rx_req[ueth->rx_cur].buffer;
+
 	if (!ueth->rxlen)
 		return 0;
 
-	*ptrp = &ueth->rxbuf[ueth->rxptr];
+	*ptrp = &buf[ueth->rxptr];
 
 	return ueth->rxlen - ueth->rxptr;
 }
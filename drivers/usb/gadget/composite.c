@@ -11,7 +11,12 @@
 #include <linux/bitops.h>
 #include <linux/usb/composite.h>
 
+#ifdef CONFIG_USB_FUNCTION_DFU
+/* DFU moves its data through ep0, so make room for a whole block */
+#define USB_BUFSIZ	max(4096, CONFIG_USB_FUNCTION_DFU_TRANSFER_SIZE)
+#else
 #define USB_BUFSIZ	4096
+#endif
 
 static struct usb_composite_driver *composite;
 
@@ -251,6 +251,11 @@ static int handle_dnload(struct usb_gadget *gadget, u16 len)
 	struct usb_request *req = cdev->req;
 	struct f_dfu *f_dfu = req->context;
 
+	if (len > DFU_USB_BUFSIZ) {
+		f_dfu->dfu_state = DFU_STATE_dfuERROR;
+		return RET_STALL;
+	}
+
 	if (len == 0)
 		f_dfu->dfu_state = DFU_STATE_dfuMANIFEST_SYNC;
 
@@ -21,8 +21,8 @@
 #define DFU_BIT_CAN_UPLOAD		(0x1 << 1)
 #define DFU_BIT_CAN_DNLOAD		0x1
 
-/* big enough to hold our biggest descriptor */
-#define DFU_USB_BUFSIZ			4096
+/* size of one block of data, the ep0 buffer holds at least that much */
+#define DFU_USB_BUFSIZ			CONFIG_USB_FUNCTION_DFU_TRANSFER_SIZE
 
 #define USB_REQ_DFU_DETACH		0x00
 #define USB_REQ_DFU_DNLOAD		0x01
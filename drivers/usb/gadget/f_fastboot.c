@@ -19,6 +19,7 @@
 #include <linux/usb/gadget.h>
 #include <linux/usb/composite.h>
 #include <linux/compiler.h>
+#include <linux/sizes.h>
 #include <version.h>
 #include <g_dnl.h>
 #ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
@@ -45,12 +46,22 @@
  * that expect bulk OUT requests to be divisible by maxpacket size.
  */
 
+/*
+ * Downloads are received straight into the download buffer by several
+ * large requests kept queued at once, so that the controller does not
+ * sit idle while each completion is handled
+ */
+#define DL_REQ_COUNT			4
+#define DL_REQ_SIZE			SZ_1M
+
 struct f_fastboot {
 	struct usb_function usb_function;
 
 	/* IN/OUT EP's and corresponding requests */
 	struct usb_ep *in_ep, *out_ep;
 	struct usb_request *in_req, *out_req;
+	/* Requests for receiving downloads, they have no buffer of their own */
+	struct usb_request *dl_req[DL_REQ_COUNT];
 };
 
 static inline struct f_fastboot *func_to_fastboot(struct usb_function *f)
@@ -61,6 +72,22 @@ static inline struct f_fastboot *func_to_fastboot(struct usb_function *f)
 static struct f_fastboot *fastboot_func;
 static unsigned int download_size;
 static unsigned int download_bytes;
+/* Set while the download requests, rather than out_req, receive data */
+static bool download_direct;
+/* Bytes of a direct download given to the controller so far */
+static unsigned int download_queued;
+
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+/* Set by "oem stream:<partition>": the next download goes straight there */
+static bool stream_armed;
+/* Partition being streamed to, empty if the last download was not */
+static char stream_part[PART_NAME_LEN];
+static bool stream_failed;
+/* Second receive buffer, filled by the controller while one is written */
+static void *dl_spare_buf;
+#else
+#define stream_armed	false
+#endif
 
 static struct usb_endpoint_descriptor fs_ep_in = {
 	.bLength            = USB_DT_ENDPOINT_SIZE,
@@ -148,6 +175,7 @@ static struct usb_gadget_strings *fastboot_strings[] = {
 };
 
 static void rx_handler_command(struct usb_ep *ep, struct usb_request *req);
+static void rx_handler_dl_direct(struct usb_ep *ep, struct usb_request *req);
 static int strcmp_l1(const char *s1, const char *s2);
 
 
@@ -227,6 +255,17 @@ static void fastboot_unbind(struct usb_configuration *c, struct usb_function *f)
 static void fastboot_disable(struct usb_function *f)
 {
 	struct f_fastboot *f_fb = func_to_fastboot(f);
+	int i;
+
+	for (i = 0; i < DL_REQ_COUNT; i++) {
+		if (!f_fb->dl_req[i])
+			continue;
+		if (download_direct)
+			usb_ep_dequeue(f_fb->out_ep, f_fb->dl_req[i]);
+		usb_ep_free_request(f_fb->out_ep, f_fb->dl_req[i]);
+		f_fb->dl_req[i] = NULL;
+	}
+	download_direct = false;
 
 	usb_ep_disable(f_fb->out_ep);
 	usb_ep_disable(f_fb->in_ep);
@@ -236,6 +275,12 @@ static void fastboot_disable(struct usb_function *f)
 		usb_ep_free_request(f_fb->out_ep, f_fb->out_req);
 		f_fb->out_req = NULL;
 	}
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+	free(dl_spare_buf);
+	dl_spare_buf = NULL;
+	stream_armed = false;
+	fb_mmc_stream_abort();
+#endif
 	if (f_fb->in_req) {
 		free(f_fb->in_req->buf);
 		usb_ep_free_request(f_fb->in_ep, f_fb->in_req);
@@ -265,7 +310,7 @@ static struct usb_request *fastboot_start_ep(struct usb_ep *ep)
 static int fastboot_set_alt(struct usb_function *f,
 			    unsigned interface, unsigned alt)
 {
-	int ret;
+	int ret, i;
 	struct usb_composite_dev *cdev = f->config->cdev;
 	struct usb_gadget *gadget = cdev->gadget;
 	struct f_fastboot *f_fb = func_to_fastboot(f);
@@ -289,6 +334,13 @@ static int fastboot_set_alt(struct usb_function *f,
 	}
 	f_fb->out_req->complete = rx_handler_command;
 
+	/* Without these, downloads fall back to going through out_req */
+	for (i = 0; i < DL_REQ_COUNT; i++) {
+		f_fb->dl_req[i] = usb_ep_alloc_request(f_fb->out_ep, 0);
+		if (f_fb->dl_req[i])
+			f_fb->dl_req[i]->complete = rx_handler_dl_direct;
+	}
+
 	d = fb_ep_desc(gadget, &fs_ep_in, &hs_ep_in);
 	ret = usb_ep_enable(f_fb->in_ep, d);
 	if (ret) {
@@ -423,7 +475,9 @@ static void cb_getvar(struct usb_ep *ep, struct usb_request *req)
 		!strcmp_l1("max-download-size", cmd)) {
 		char str_num[12];
 
-		sprintf(str_num, "0x%08x", CONFIG_FASTBOOT_BUF_SIZE);
+		/* A streamed download need not fit in the buffer */
+		sprintf(str_num, "0x%08x",
+			stream_armed ? UINT_MAX : CONFIG_FASTBOOT_BUF_SIZE);
 		strncat(response, str_num, chars_left);
 	} else if (!strcmp_l1("serialno", cmd)) {
 		s = env_get("serial#");
@@ -479,13 +533,68 @@ static unsigned int rx_bytes_expected(struct usb_ep *ep)
 }
 
 #define BYTES_PER_DOT	0x20000
+static void dl_progress(unsigned int transfer_size)
+{
+	unsigned int pre_dot_num, now_dot_num;
+
+	pre_dot_num = download_bytes / BYTES_PER_DOT;
+	download_bytes += transfer_size;
+	now_dot_num = download_bytes / BYTES_PER_DOT;
+
+	if (pre_dot_num != now_dot_num) {
+		putc('.');
+		if (!(now_dot_num % 74))
+			putc('\n');
+	}
+}
+
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+static void rx_handler_dl_stream(struct usb_ep *ep, struct usb_request *req,
+				 unsigned int transfer_size)
+{
+	char response[FASTBOOT_RESPONSE_LEN];
+	void *buffer = req->buf;
+	bool done;
+
+	dl_progress(transfer_size);
+	done = download_bytes >= download_size;
+
+	/*
+	 * Queue the spare buffer before writing this one out, so that the
+	 * controller can take in the next packet in the meantime
+	 */
+	req->buf = dl_spare_buf;
+	dl_spare_buf = buffer;
+	if (done) {
+		download_size = 0;
+		req->complete = rx_handler_command;
+		req->length = EP_BUFFER_SIZE;
+	} else {
+		req->length = rx_bytes_expected(ep);
+	}
+	req->actual = 0;
+	usb_ep_queue(ep, req, 0);
+
+	fb_mmc_stream_write(buffer, transfer_size);
+	if (!done)
+		return;
+
+	printf("\ndownloading of %d bytes finished\n", download_bytes);
+	fb_response_str = response;
+	stream_failed = fb_mmc_stream_finish() != 0;
+	stream_armed = false;
+	/* Nothing is left in the buffer for a "flash" command to write */
+	download_bytes = 0;
+	fastboot_tx_write_str(response);
+}
+#endif
+
 static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 {
 	char response[FASTBOOT_RESPONSE_LEN];
 	unsigned int transfer_size = download_size - download_bytes;
 	const unsigned char *buffer = req->buf;
 	unsigned int buffer_size = req->actual;
-	unsigned int pre_dot_num, now_dot_num;
 
 	if (req->status != 0) {
 		printf("Bad status: %d\n", req->status);
@@ -495,18 +604,16 @@ static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 	if (buffer_size < transfer_size)
 		transfer_size = buffer_size;
 
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+	if (stream_armed) {
+		rx_handler_dl_stream(ep, req, transfer_size);
+		return;
+	}
+#endif
+
 	memcpy((void *)CONFIG_FASTBOOT_BUF_ADDR + download_bytes,
 	       buffer, transfer_size);
-
-	pre_dot_num = download_bytes / BYTES_PER_DOT;
-	download_bytes += transfer_size;
-	now_dot_num = download_bytes / BYTES_PER_DOT;
-
-	if (pre_dot_num != now_dot_num) {
-		putc('.');
-		if (!(now_dot_num % 74))
-			putc('\n');
-	}
+	dl_progress(transfer_size);
 
 	/* Check if transfer is done */
 	if (download_bytes >= download_size) {
@@ -530,6 +637,115 @@ static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 	usb_ep_queue(ep, req, 0);
 }
 
+/* Give the controller the next part of a direct download, if any is left */
+static int dl_queue_next(struct usb_ep *ep, struct usb_request *req)
+{
+	unsigned int len = download_size - download_queued;
+	unsigned int maxpacket = ep->maxpacket;
+	int ret;
+
+	if (!len)
+		return 0;
+	if (len > DL_REQ_SIZE)
+		len = DL_REQ_SIZE;
+
+	req->buf = (void *)CONFIG_FASTBOOT_BUF_ADDR + download_queued;
+	req->length = roundup(len, maxpacket);
+	req->actual = 0;
+	ret = usb_ep_queue(ep, req, 0);
+	if (!ret)
+		download_queued += len;
+
+	return ret;
+}
+
+/* Finish a direct download and get ready for the next command */
+static void dl_direct_finish(struct usb_ep *ep, const char *response)
+{
+	struct usb_request *req = fastboot_func->out_req;
+
+	download_direct = false;
+	download_size = 0;
+
+	req->complete = rx_handler_command;
+	req->length = EP_BUFFER_SIZE;
+	req->actual = 0;
+	usb_ep_queue(ep, req, 0);
+
+	fastboot_tx_write_str(response);
+}
+
+static void rx_handler_dl_direct(struct usb_ep *ep, struct usb_request *req)
+{
+	unsigned int transfer_size = download_size - download_bytes;
+
+	if (req->status != 0) {
+		printf("Bad status: %d\n", req->status);
+		return;
+	}
+	/* Left over from a download which failed */
+	if (!download_direct)
+		return;
+
+	if (req->actual < transfer_size)
+		transfer_size = req->actual;
+	dl_progress(transfer_size);
+
+	if (download_bytes >= download_size) {
+		dl_direct_finish(ep, "OKAY");
+		printf("\ndownloading of %d bytes finished\n", download_bytes);
+		return;
+	}
+
+	/*
+	 * Requests complete in order and each starts where the previous one
+	 * ended, so a short packet before the end leaves a hole. Hosts do not
+	 * send one, give up if it happens anyway.
+	 */
+	if (req->actual < req->length) {
+		printf("\nshort packet after %d bytes\n", download_bytes);
+		download_bytes = 0;
+		dl_direct_finish(ep, "FAILshort packet");
+		return;
+	}
+
+	if (dl_queue_next(ep, req))
+		printf("\nfailed to queue download request\n");
+}
+
+/*
+ * Start receiving a download straight into the download buffer. The last
+ * request is rounded up to maxpacket, so this is only done when that still
+ * fits in the buffer. Returns false if out_req is to receive it instead.
+ */
+static bool dl_direct_start(struct usb_ep *ep)
+{
+	struct f_fastboot *f_fb = fastboot_func;
+	unsigned int maxpacket = ep->maxpacket;
+	int i;
+
+	if (stream_armed ||
+	    roundup(download_size, maxpacket) > CONFIG_FASTBOOT_BUF_SIZE)
+		return false;
+	for (i = 0; i < DL_REQ_COUNT; i++) {
+		if (!f_fb->dl_req[i])
+			return false;
+	}
+
+	download_queued = 0;
+	download_direct = true;
+	for (i = 0; i < DL_REQ_COUNT; i++) {
+		if (dl_queue_next(ep, f_fb->dl_req[i])) {
+			if (i)
+				break;
+			download_direct = false;
+			return false;
+		}
+	}
+
+	return true;
+}
+
 static void cb_download(struct usb_ep *ep, struct usb_request *req)
 {
 	char *cmd = req->buf;
@@ -538,18 +754,24 @@ static void cb_download(struct usb_ep *ep, struct usb_request *req)
 	strsep(&cmd, ":");
 	download_size = simple_strtoul(cmd, NULL, 16);
 	download_bytes = 0;
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+	if (!stream_armed)
+		stream_part[0] = '\0';
+#endif
 
 	printf("Starting download of %d bytes\n", download_size);
 
 	if (0 == download_size) {
 		strcpy(response, "FAILdata invalid size");
-	} else if (download_size > CONFIG_FASTBOOT_BUF_SIZE) {
+	} else if (download_size > CONFIG_FASTBOOT_BUF_SIZE && !stream_armed) {
 		download_size = 0;
 		strcpy(response, "FAILdata too large");
 	} else {
 		sprintf(response, "DATA%08x", download_size);
-		req->complete = rx_handler_dl_image;
-		req->length = rx_bytes_expected(ep);
+		if (!dl_direct_start(ep)) {
+			req->complete = rx_handler_dl_image;
+			req->length = rx_bytes_expected(ep);
+		}
 	}
 	fastboot_tx_write_str(response);
 }
@@ -601,6 +823,20 @@ static void cb_flash(struct usb_ep *ep, struct usb_request *req)
 	/* initialize the response buffer */
 	fb_response_str = response;
 
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+	/* A streamed download has already been written */
+	if (stream_part[0] && !stream_armed) {
+		if (stream_failed)
+			fastboot_fail("streamed image write failed");
+		else if (strcmp(cmd, stream_part))
+			fastboot_fail("streamed to another partition");
+		else
+			fastboot_okay("");
+		fastboot_tx_write_str(response);
+		return;
+	}
+#endif
+
 	fastboot_fail("no flash device defined");
 #ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
 	fb_mmc_flash_write(cmd, (void *)CONFIG_FASTBOOT_BUF_ADDR,
@@ -615,9 +851,37 @@ static void cb_flash(struct usb_ep *ep, struct usb_request *req)
 }
 #endif
 
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+static void cb_oem_stream(const char *part)
+{
+	char response[FASTBOOT_RESPONSE_LEN];
+
+	fb_response_str = response;
+	stream_armed = false;
+	stream_part[0] = '\0';
+
+	if (!dl_spare_buf)
+		dl_spare_buf = memalign(CONFIG_SYS_CACHELINE_SIZE,
+					EP_BUFFER_SIZE);
+	if (!dl_spare_buf)
+		fastboot_fail("malloc error");
+	else if (!fb_mmc_stream_start(part))
+		stream_armed = true;
+	if (stream_armed)
+		strlcpy(stream_part, part, sizeof(stream_part));
+	fastboot_tx_write_str(response);
+}
+#endif
+
 static void cb_oem(struct usb_ep *ep, struct usb_request *req)
 {
 	char *cmd = req->buf;
+#ifdef CONFIG_FASTBOOT_FLASH_STREAM
+	if (strncmp("stream:", cmd + 4, 7) == 0) {
+		cb_oem_stream(cmd + 11);
+		return;
+	}
+#endif
 #ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
 	if (strncmp("format", cmd + 4, 6) == 0) {
 		char cmdbuf[32];
@@ -733,5 +997,7 @@ static void rx_handler_command(struct usb_ep *ep, struct usb_request *req)
 
 	*cmdbuf = '\0';
 	req->actual = 0;
-	usb_ep_queue(ep, req, 0);
+	/* A direct download queues this again once it is complete */
+	if (!download_direct)
+		usb_ep_queue(ep, req, 0);
 }
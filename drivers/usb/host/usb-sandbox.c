@@ -12,8 +12,26 @@
 
 DECLARE_GLOBAL_DATA_PTR;
 
+/* Number of bulk transfers which can be queued at once */
+#define SANDBOX_USB_BULK_QUEUE	8
+/* Number of streams which can be set up on a bulk endpoint */
+#define SANDBOX_USB_MAX_STREAMS	15
+
+/**
+ * struct sandbox_usb_ctrl - private state for the sandbox USB controller
+ *
+ * @rootdev:	USB address of the root hub
+ * @bulk_udev:	Device for each queued bulk transfer
+ * @bulk_reqs:	Queued bulk transfers, oldest first. These are run when
+ *		the queue is reaped, except that those on a stream wait until
+ *		the emulator is ready for them.
+ * @bulk_count:	Number of queued bulk transfers
+ */
 struct sandbox_usb_ctrl {
 	int rootdev;
+	struct usb_device *bulk_udev[SANDBOX_USB_BULK_QUEUE];
+	struct usb_bulk_req *bulk_reqs[SANDBOX_USB_BULK_QUEUE];
+	int bulk_count;
 };
 
 static void usbmon_trace(struct udevice *bus, ulong pipe,
@@ -100,6 +118,125 @@ static int sandbox_submit_bulk(struct udevice *bus, struct usb_device *udev,
 	return ret;
 }
 
+static int sandbox_submit_bulk_req(struct udevice *bus,
+				   struct usb_device *udev,
+				   struct usb_bulk_req *req)
+{
+	struct sandbox_usb_ctrl *ctrl = dev_get_priv(bus);
+
+	if (ctrl->bulk_count == SANDBOX_USB_BULK_QUEUE)
+		return -EBUSY;
+	ctrl->bulk_udev[ctrl->bulk_count] = udev;
+	ctrl->bulk_reqs[ctrl->bulk_count++] = req;
+
+	return 0;
+}
+
+/* Run a queued bulk request, returning -EAGAIN if its stream is not ready */
+static int sandbox_run_bulk_req(struct udevice *bus, struct usb_device *udev,
+				struct usb_bulk_req *req)
+{
+	struct udevice *emul;
+	int ret;
+
+	if (!req->stream)
+		return sandbox_submit_bulk(bus, udev, req->pipe, req->buffer,
+					   req->length);
+	ret = usb_emul_find(bus, req->pipe, udev->portnr, &emul);
+	usbmon_trace(bus, req->pipe, NULL, emul);
+	if (ret)
+		return ret;
+
+	return usb_emul_bulk_req(emul, udev, req);
+}
+
+static int sandbox_reap_bulk(struct udevice *bus, struct usb_device *udev)
+{
+	struct sandbox_usb_ctrl *ctrl = dev_get_priv(bus);
+	struct usb_bulk_req *req;
+	int count = 0, upto;
+	bool progress;
+	int ret, i, j;
+
+	/*
+	 * Run the transfers in order, failing the rest on the pipe after an
+	 * error. Those on a stream wait until the device is ready for it,
+	 * which may be after transfers queued later.
+	 */
+	do {
+		progress = false;
+		for (i = 0; i < ctrl->bulk_count; i++) {
+			req = ctrl->bulk_reqs[i];
+			if (req->done)
+				continue;
+			ret = sandbox_run_bulk_req(bus, ctrl->bulk_udev[i],
+						   req);
+			if (ret == -EAGAIN)
+				continue;
+			req->actual = max(ret, 0);
+			req->status = min(ret, 0);
+			req->done = true;
+			progress = true;
+			if (ret >= 0)
+				continue;
+			for (j = i + 1; j < ctrl->bulk_count; j++) {
+				if (ctrl->bulk_reqs[j]->pipe == req->pipe) {
+					ctrl->bulk_reqs[j]->status =
+						-ECANCELED;
+					ctrl->bulk_reqs[j]->done = true;
+				}
+			}
+		}
+	} while (progress);
+
+	/* Drop the transfers which completed */
+	for (i = 0, upto = 0; i < ctrl->bulk_count; i++) {
+		req = ctrl->bulk_reqs[i];
+		if (req->done) {
+			count++;
+			continue;
+		}
+		ctrl->bulk_udev[upto] = ctrl->bulk_udev[i];
+		ctrl->bulk_reqs[upto++] = req;
+	}
+	ctrl->bulk_count = upto;
+
+	return count;
+}
+
+static int sandbox_cancel_bulk(struct udevice *bus, struct usb_device *udev,
+			       unsigned long pipe)
+{
+	struct sandbox_usb_ctrl *ctrl = dev_get_priv(bus);
+	int i, upto;
+
+	for (i = 0, upto = 0; i < ctrl->bulk_count; i++) {
+		struct usb_bulk_req *req = ctrl->bulk_reqs[i];
+
+		if (req->pipe == pipe) {
+			req->status = -ECANCELED;
+			req->done = true;
+			continue;
+		}
+		ctrl->bulk_udev[upto] = ctrl->bulk_udev[i];
+		ctrl->bulk_reqs[upto++] = req;
+	}
+	ctrl->bulk_count = upto;
+
+	return 0;
+}
+
+static int sandbox_alloc_streams(struct udevice *bus, struct usb_device *udev,
+				 unsigned long *pipes, int num_pipes,
+				 int num_streams)
+{
+	/* Streams are a SuperSpeed feature */
+	if (udev->speed != USB_SPEED_SUPER)
+		return -EINVAL;
+
+	return min(num_streams, SANDBOX_USB_MAX_STREAMS);
+}
+
 static int sandbox_submit_int(struct udevice *bus, struct usb_device *udev,
 			      unsigned long pipe, void *buffer, int length,
 			      int interval)
@@ -143,6 +280,10 @@ static const struct dm_usb_ops sandbox_usb_ops = {
 	.bulk		= sandbox_submit_bulk,
 	.interrupt	= sandbox_submit_int,
 	.alloc_device	= sandbox_alloc_device,
+	.submit_bulk	= sandbox_submit_bulk_req,
+	.reap_bulk	= sandbox_reap_bulk,
+	.cancel_bulk	= sandbox_cancel_bulk,
+	.alloc_streams	= sandbox_alloc_streams,
 };
 
 static const struct udevice_id sandbox_usb_ids[] = {
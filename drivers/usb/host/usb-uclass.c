@@ -116,6 +116,85 @@ int destroy_int_queue(struct usb_device *udev, struct int_queue *queue)
 	return ops->destroy_int_queue(bus, udev, queue);
 }
 
+int usb_submit_bulk(struct usb_device *udev, struct usb_bulk_req *req)
+{
+	struct udevice *bus = udev->controller_dev;
+	struct dm_usb_ops *ops = usb_get_ops(bus);
+
+	req->actual = 0;
+	req->status = -EINPROGRESS;
+	req->done = false;
+
+	/* Otherwise usb_wait_bulk() runs the transfer */
+	if (!ops->submit_bulk)
+		return 0;
+
+	return ops->submit_bulk(bus, udev, req);
+}
+
+int usb_poll_bulk(struct usb_device *udev)
+{
+	struct udevice *bus = udev->controller_dev;
+	struct dm_usb_ops *ops = usb_get_ops(bus);
+
+	if (!ops->reap_bulk)
+		return 0;
+
+	return ops->reap_bulk(bus, udev);
+}
+
+int usb_wait_bulk(struct usb_device *udev, struct usb_bulk_req *req,
+		  int timeout)
+{
+	struct udevice *bus = udev->controller_dev;
+	struct dm_usb_ops *ops = usb_get_ops(bus);
+	ulong start;
+	int ret;
+
+	if (req->done)
+		return req->status;
+	if (!ops->submit_bulk || !ops->reap_bulk)
+		return usb_bulk_req_sync(udev, req, timeout);
+
+	start = get_timer(0);
+	while (!req->done) {
+		ret = ops->reap_bulk(bus, udev);
+		if (ret < 0)
+			return ret;
+		if (!req->done && get_timer(start) > timeout) {
+			debug("%s: timeout on pipe %lx\n", __func__, req->pipe);
+			usb_cancel_bulk(udev, req->pipe);
+			req->status = -ETIMEDOUT;
+			req->done = true;
+		}
+	}
+
+	return req->status;
+}
+
+int usb_cancel_bulk(struct usb_device *udev, unsigned long pipe)
+{
+	struct udevice *bus = udev->controller_dev;
+	struct dm_usb_ops *ops = usb_get_ops(bus);
+
+	if (!ops->cancel_bulk)
+		return 0;
+
+	return ops->cancel_bulk(bus, udev, pipe);
+}
+
+int usb_alloc_streams(struct usb_device *udev, unsigned long *pipes,
+		      int num_pipes, int num_streams)
+{
+	struct udevice *bus = udev->controller_dev;
+	struct dm_usb_ops *ops = usb_get_ops(bus);
+
+	if (!ops->alloc_streams)
+		return -ENOSYS;
+
+	return ops->alloc_streams(bus, udev, pipes, num_pipes, num_streams);
+}
+
 int usb_alloc_device(struct usb_device *udev)
 {
 	struct udevice *bus = udev->controller_dev;
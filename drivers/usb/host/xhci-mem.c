@@ -149,9 +149,11 @@ static void xhci_free_virt_devices(struct xhci_ctrl *ctrl)
 
 		ctrl->dcbaa->dev_context_ptrs[slot_id] = 0;
 
-		for (i = 0; i < 31; ++i)
+		for (i = 0; i < 31; ++i) {
 			if (virt_dev->eps[i].ring)
 				xhci_ring_free(virt_dev->eps[i].ring);
+			xhci_free_stream_info(virt_dev->eps[i].streams);
+		}
 
 		if (virt_dev->in_ctx)
 			xhci_free_container_ctx(virt_dev->in_ctx);
@@ -339,6 +341,59 @@ struct xhci_ring *xhci_ring_alloc(unsigned int num_segs, bool link_trbs)
 	return ring;
 }
 
+/**
+ * Allocates the Stream Context Array of a bulk endpoint and a transfer
+ * ring of one segment for each stream
+ *
+ * @param num_streams	number of entries in the Stream Context Array, a
+ *			power of two no more than XHCI_MAX_STREAMS
+ * @return pointer to the newly created stream info
+ */
+struct xhci_stream_info *xhci_alloc_stream_info(unsigned int num_streams)
+{
+	struct xhci_stream_info *info;
+	struct xhci_ring *ring;
+	u64 val_64;
+	int i;
+
+	info = calloc(1, sizeof(struct xhci_stream_info));
+	BUG_ON(!info);
+	info->num_streams = num_streams;
+	info->stream_ctx = xhci_malloc(num_streams *
+				       sizeof(struct xhci_stream_ctx));
+
+	/* Stream 0 is reserved */
+	for (i = 1; i < num_streams; i++) {
+		ring = xhci_ring_alloc(1, true);
+		info->rings[i] = ring;
+		val_64 = (uintptr_t)ring->enqueue;
+		info->stream_ctx[i].stream_ring = cpu_to_le64(val_64 |
+			SCT_FOR_CTX(SCT_PRI_TR) | ring->cycle_state);
+	}
+	xhci_flush_cache((uintptr_t)info->stream_ctx,
+			 num_streams * sizeof(struct xhci_stream_ctx));
+
+	return info;
+}
+
+/**
+ * frees the "xhci_stream_info" pointer passed, along with its rings
+ *
+ * @param info	pointer to the stream info to be freed, or NULL
+ * @return none
+ */
+void xhci_free_stream_info(struct xhci_stream_info *info)
+{
+	int i;
+
+	if (!info)
+		return;
+	for (i = 1; i < info->num_streams; i++)
+		xhci_ring_free(info->rings[i]);
+	free(info->stream_ctx);
+	free(info);
+}
+
 /**
  * Set up the scratchpad buffer array and scratchpad buffers
  *
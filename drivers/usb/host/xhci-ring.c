@@ -259,18 +259,18 @@ static int prepare_ring(struct xhci_ctrl *ctrl, struct xhci_ring *ep_ring,
 }
 
 /**
- * Generic function for queueing a command TRB on the command ring.
- * Check to make sure there's room on the command ring for one command TRB.
+ * Queues a command TRB on the command ring, for a stream of an endpoint
  *
  * @param ctrl		Host controller data structure
  * @param ptr		Pointer address to write in the first two fields (opt.)
  * @param slot_id	Slot ID to encode in the flags field (opt.)
  * @param ep_index	Endpoint index to encode in the flags field (opt.)
+ * @param stream_id	Stream ID to encode in the status field (opt.)
  * @param cmd		Command type to enqueue
  * @return none
  */
-void xhci_queue_command(struct xhci_ctrl *ctrl, u8 *ptr, u32 slot_id,
-			u32 ep_index, trb_type cmd)
+static void queue_command(struct xhci_ctrl *ctrl, u8 *ptr, u32 slot_id,
+			  u32 ep_index, u32 stream_id, trb_type cmd)
 {
 	u32 fields[4];
 	u64 val_64 = (uintptr_t)ptr;
@@ -279,7 +279,7 @@ void xhci_queue_command(struct xhci_ctrl *ctrl, u8 *ptr, u32 slot_id,
 
 	fields[0] = lower_32_bits(val_64);
 	fields[1] = upper_32_bits(val_64);
-	fields[2] = 0;
+	fields[2] = STREAM_ID_FOR_TRB(stream_id);
 	fields[3] = TRB_TYPE(cmd) | SLOT_ID_FOR_TRB(slot_id) |
 		    ctrl->cmd_ring->cycle_state;
 
@@ -296,6 +296,23 @@ void xhci_queue_command(struct xhci_ctrl *ctrl, u8 *ptr, u32 slot_id,
 	xhci_writel(&ctrl->dba->doorbell[0], DB_VALUE_HOST);
 }
 
+/**
+ * Generic function for queueing a command TRB on the command ring.
+ * Check to make sure there's room on the command ring for one command TRB.
+ *
+ * @param ctrl		Host controller data structure
+ * @param ptr		Pointer address to write in the first two fields (opt.)
+ * @param slot_id	Slot ID to encode in the flags field (opt.)
+ * @param ep_index	Endpoint index to encode in the flags field (opt.)
+ * @param cmd		Command type to enqueue
+ * @return none
+ */
+void xhci_queue_command(struct xhci_ctrl *ctrl, u8 *ptr, u32 slot_id,
+			u32 ep_index, trb_type cmd)
+{
+	queue_command(ctrl, ptr, slot_id, ep_index, 0, cmd);
+}
+
 /**
  * The TD size is the number of bytes remaining in the TD (including this TRB),
  * right shifted by 10.
@@ -352,12 +369,13 @@ static u32 xhci_v1_0_td_remainder(int running_total,
  *
  * @param udev		pointer to the USB device structure
  * @param ep_index	index of the endpoint
+ * @param stream	stream the TD is on, or 0
  * @param start_cycle	cycle flag of the first TRB
  * @param start_trb	pionter to the first TRB
  * @return none
  */
 static void giveback_first_trb(struct usb_device *udev, int ep_index,
-				int start_cycle,
+				unsigned int stream, int start_cycle,
 				struct xhci_generic_trb *start_trb)
 {
 	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
@@ -375,7 +393,7 @@ static void giveback_first_trb(struct usb_device *udev, int ep_index,
 
 	/* Ringing EP doorbell here */
 	xhci_writel(&ctrl->dba->doorbell[udev->slot_id],
-				DB_VALUE(ep_index, 0));
+				DB_VALUE(ep_index, stream));
 
 	return;
 }
@@ -423,6 +441,8 @@ static int event_ready(struct xhci_ctrl *ctrl)
 	return 1;
 }
 
+static int xhci_bulk_event(struct xhci_ctrl *ctrl, union xhci_trb *event);
+
 /**
  * Waits for a specific type of event and returns it. Discards unexpected
  * events. Caller *must* call xhci_acknowledge_event() after it is finished
@@ -444,6 +464,11 @@ union xhci_trb *xhci_wait_for_event(struct xhci_ctrl *ctrl, trb_type expected)
 			continue;
 
 		type = TRB_FIELD_TO_TYPE(le32_to_cpu(event->event_cmd.flags));
+		/* Queued bulk transfers may finish while we wait */
+		if (type == TRB_TRANSFER && xhci_bulk_event(ctrl, event) >= 0) {
+			xhci_acknowledge_event(ctrl);
+			continue;
+		}
 		if (type == expected)
 			return event;
 
@@ -544,16 +569,23 @@ static void record_transfer_result(struct usb_device *udev,
 
 /**** Bulk and Control transfer methods ****/
 /**
- * Queues up the BULK Request
+ * Queues up a bulk TD and rings the endpoint's doorbell
  *
  * @param udev		pointer to the USB device structure
  * @param pipe		contains the DIR_IN or OUT , devnum
+ * @param stream	stream to queue the TD on, or 0 for the endpoint ring
  * @param length	length of the buffer
  * @param buffer	buffer to be read/written based on the request
- * @return returns 0 if successful else -1 on failure
+ * @param last_trbp	returns the last TRB of the TD
+ * @param num_trbsp	returns the number of TRBs in the TD
+ * @param max_trbs	most TRBs the TD may use
+ * @return 0 if successful, -EBUSY if it needs more than max_trbs, else
+ *	error code
  */
-int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
-			int length, void *buffer)
+static int xhci_queue_bulk_td(struct usb_device *udev, unsigned long pipe,
+			      unsigned int stream, int length, void *buffer,
+			      union xhci_trb **last_trbp, int *num_trbsp,
+			      int max_trbs)
 {
 	int num_trbs = 0;
 	struct xhci_generic_trb *start_trb;
@@ -567,7 +599,7 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 	struct xhci_virt_device *virt_dev;
 	struct xhci_ep_ctx *ep_ctx;
 	struct xhci_ring *ring;		/* EP transfer ring */
-	union xhci_trb *event;
+	struct xhci_generic_trb *trb;
 
 	int running_total, trb_buff_len;
 	unsigned int total_packet_count;
@@ -588,7 +620,10 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 
 	ep_ctx = xhci_get_ep_ctx(ctrl, virt_dev->out_ctx, ep_index);
 
-	ring = virt_dev->eps[ep_index].ring;
+	if (stream)
+		ring = virt_dev->eps[ep_index].streams->rings[stream];
+	else
+		ring = virt_dev->eps[ep_index].ring;
 	/*
 	 * How much data is (potentially) left before the 64KB boundary?
 	 * XHCI Spec puts restriction( TABLE 49 and 6.4.1 section of XHCI Spec)
@@ -612,6 +647,9 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 		num_trbs++;
 		running_total += TRB_MAX_BUFF_SIZE;
 	}
+	if (num_trbs > max_trbs)
+		return -EBUSY;
+	*num_trbsp = num_trbs;
 
 	/*
 	 * XXX: Calling routine prepare_ring() called in place of
@@ -699,7 +737,7 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 		trb_fields[2] = length_field;
 		trb_fields[3] = field | (TRB_NORMAL << TRB_TYPE_SHIFT);
 
-		queue_trb(ctrl, ring, (num_trbs > 1), trb_fields);
+		trb = queue_trb(ctrl, ring, (num_trbs > 1), trb_fields);
 
 		--num_trbs;
 
@@ -710,7 +748,455 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 		trb_buff_len = min((length - running_total), TRB_MAX_BUFF_SIZE);
 	} while (running_total < length);
 
-	giveback_first_trb(udev, ep_index, start_cycle, start_trb);
+	*last_trbp = (union xhci_trb *)trb;
+	giveback_first_trb(udev, ep_index, stream, start_cycle, start_trb);
+
+	return 0;
+}
+
+/**
+ * Completes the request of a bulk TD from its transfer event
+ *
+ * @param ctrl		Host controller data structure
+ * @param ep		endpoint the TD is on
+ * @param td		TD which finished
+ * @param event		Transfer event
+ * @param trb		TRB the event is for
+ * @param short_trbp	set to the last TRB of the TD if it ended early
+ * @return none
+ */
+static void xhci_bulk_td_done(struct xhci_ctrl *ctrl, struct xhci_virt_ep *ep,
+			      struct xhci_bulk_td *td, union xhci_trb *event,
+			      union xhci_trb *trb, union xhci_trb **short_trbp)
+{
+	u32 len = le32_to_cpu(event->trans_event.transfer_len);
+	struct usb_bulk_req *req = td->req;
+	u64 addr;
+	long actual;
+
+	/* Work out how far into the buffer the TD got */
+	xhci_inval_cache((uintptr_t)trb, sizeof(union xhci_trb));
+	addr = le32_to_cpu(trb->generic.field[0]) |
+	       (u64)le32_to_cpu(trb->generic.field[1]) << 32;
+	actual = addr + (le32_to_cpu(trb->generic.field[2]) & TRB_LEN_MASK) -
+		 EVENT_TRB_LEN(len) - (uintptr_t)req->buffer;
+	req->actual = clamp(actual, 0L, (long)req->length);
+
+	switch (GET_COMP_CODE(len)) {
+	case COMP_SUCCESS:
+	case COMP_SHORT_TX:
+		req->status = 0;
+		if (trb != td->last_trb)
+			*short_trbp = td->last_trb;
+		break;
+	case COMP_STALL:
+		req->status = -EPIPE;
+		break;
+	default:
+		req->status = -EIO;
+		break;
+	}
+	if (req->status) {
+		ep->bulk_halted = true;
+		ctrl->bulk_halted = true;
+	}
+	if (usb_pipein(req->pipe))
+		xhci_inval_cache((uintptr_t)req->buffer, req->length);
+	req->done = true;
+	ep->bulk_count--;
+}
+
+/**
+ * Hands a transfer event over to the TD on its stream
+ *
+ * Each stream ring has one segment, so the event is for the stream whose
+ * segment holds its TRB. Stop events are dropped, since nothing waits for
+ * them on an endpoint with streams.
+ *
+ * @param ctrl	Host controller data structure
+ * @param ep	endpoint with streams
+ * @param event	Transfer event
+ * @param trb	TRB the event is for
+ * @return 1 if a transfer completed, 0 if the event was dropped
+ */
+static int xhci_stream_event(struct xhci_ctrl *ctrl, struct xhci_virt_ep *ep,
+			     union xhci_trb *event, union xhci_trb *trb)
+{
+	u32 len = le32_to_cpu(event->trans_event.transfer_len);
+	struct xhci_stream_info *streams = ep->streams;
+	struct xhci_bulk_td *td;
+	union xhci_trb *trbs;
+	unsigned int stream;
+
+	if (GET_COMP_CODE(len) == COMP_STOP ||
+	    GET_COMP_CODE(len) == COMP_STOP_INVAL)
+		return 0;
+	for (stream = 1; stream < streams->num_streams; stream++) {
+		trbs = streams->rings[stream]->first_seg->trbs;
+		if (trb >= trbs && trb < trbs + TRBS_PER_SEGMENT)
+			break;
+	}
+	if (stream == streams->num_streams)
+		return 0;
+	if (streams->short_trbs[stream]) {
+		bool dup = trb == streams->short_trbs[stream];
+
+		streams->short_trbs[stream] = NULL;
+		if (dup)
+			return 0;
+	}
+	td = &streams->tds[stream];
+	if (!td->req)
+		return 0;
+
+	xhci_bulk_td_done(ctrl, ep, td, event, trb,
+			  &streams->short_trbs[stream]);
+	td->req = NULL;
+
+	return 1;
+}
+
+/**
+ * Hands a transfer event over to the queued bulk transfers of its endpoint
+ *
+ * The TDs on an endpoint complete in order, so the event belongs to the
+ * oldest one. If a TD ends with a short packet before its last TRB, some
+ * controllers report its last TRB as well and that event is dropped.
+ *
+ * @param ctrl	Host controller data structure
+ * @param event	Transfer event
+ * @return 1 if a transfer completed, 0 if the event was dropped, -1 if it
+ *	is not for a queued bulk transfer
+ */
+static int xhci_bulk_event(struct xhci_ctrl *ctrl, union xhci_trb *event)
+{
+	u32 flags = le32_to_cpu(event->trans_event.flags);
+	u32 len = le32_to_cpu(event->trans_event.transfer_len);
+	union xhci_trb *trb;
+	struct xhci_virt_device *virt_dev;
+	struct xhci_virt_ep *ep;
+	struct xhci_bulk_td *td;
+
+	virt_dev = ctrl->devs[TRB_TO_SLOT_ID(flags)];
+	if (!virt_dev)
+		return -1;
+	ep = &virt_dev->eps[TRB_TO_EP_INDEX(flags)];
+	trb = (union xhci_trb *)(uintptr_t)
+		le64_to_cpu(event->trans_event.buffer);
+	if (ep->streams)
+		return xhci_stream_event(ctrl, ep, event, trb);
+
+	/* Stop events are waited for by abort_td() */
+	if (GET_COMP_CODE(len) == COMP_STOP ||
+	    GET_COMP_CODE(len) == COMP_STOP_INVAL)
+		return -1;
+	if (ep->bulk_short_trb) {
+		bool dup = trb == ep->bulk_short_trb;
+
+		ep->bulk_short_trb = NULL;
+		if (dup)
+			return 0;
+	}
+	if (!ep->bulk_count)
+		return -1;
+
+	td = &ep->bulk_tds[ep->bulk_head];
+	xhci_bulk_td_done(ctrl, ep, td, event, trb, &ep->bulk_short_trb);
+	ep->bulk_trbs -= td->num_trbs;
+	ep->bulk_head = (ep->bulk_head + 1) % XHCI_BULK_QUEUE;
+
+	return 1;
+}
+
+/**
+ * Waits for a command on an endpoint to complete
+ *
+ * @param udev	pointer to the USB device structure
+ * @return none
+ */
+static void xhci_wait_for_ep_command(struct usb_device *udev)
+{
+	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
+	union xhci_trb *event;
+
+	event = xhci_wait_for_event(ctrl, TRB_COMPLETION);
+	BUG_ON(TRB_TO_SLOT_ID(le32_to_cpu(event->event_cmd.flags))
+		!= udev->slot_id);
+	xhci_acknowledge_event(ctrl);
+}
+
+/**
+ * Throws away the TDs queued on the streams of an endpoint
+ *
+ * The endpoint is reset if it halted, otherwise it is stopped. The dequeue
+ * pointer of each stream is then moved past its TD.
+ *
+ * @param udev		pointer to the USB device structure
+ * @param ep_index	index of the endpoint
+ * @param status	status to complete the transfers with
+ * @return none
+ */
+static void xhci_stream_flush(struct usb_device *udev, int ep_index,
+			      int status)
+{
+	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
+	struct xhci_virt_ep *ep = &ctrl->devs[udev->slot_id]->eps[ep_index];
+	struct xhci_stream_info *streams = ep->streams;
+	struct xhci_ring *ring;
+	unsigned int stream;
+
+	if (!ep->bulk_halted && !ep->bulk_count)
+		return;
+	queue_command(ctrl, NULL, udev->slot_id, ep_index, 0,
+		      ep->bulk_halted ? TRB_RESET_EP : TRB_STOP_RING);
+	xhci_wait_for_ep_command(udev);
+
+	for (stream = 1; stream < streams->num_streams; stream++) {
+		ring = streams->rings[stream];
+		queue_command(ctrl, (void *)((uintptr_t)ring->enqueue |
+			      SCT_FOR_TRB(SCT_PRI_TR) | ring->cycle_state),
+			      udev->slot_id, ep_index, stream, TRB_SET_DEQ);
+		xhci_wait_for_ep_command(udev);
+
+		if (streams->tds[stream].req) {
+			streams->tds[stream].req->status = status;
+			streams->tds[stream].req->done = true;
+			streams->tds[stream].req = NULL;
+		}
+		streams->short_trbs[stream] = NULL;
+	}
+	ep->bulk_count = 0;
+	ep->bulk_halted = false;
+}
+
+/**
+ * Throws away the queued bulk transfers of an endpoint
+ *
+ * A halted endpoint is reset, otherwise it is stopped. Either way its
+ * dequeue pointer is then moved past the queued TDs.
+ *
+ * @param udev		pointer to the USB device structure
+ * @param ep_index	index of the endpoint
+ * @param status	status to complete the transfers with
+ * @return none
+ */
+static void xhci_bulk_flush(struct usb_device *udev, int ep_index,
+			    int status)
+{
+	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
+	struct xhci_virt_ep *ep = &ctrl->devs[udev->slot_id]->eps[ep_index];
+	struct xhci_ring *ring = ep->ring;
+	union xhci_trb *event;
+	struct usb_bulk_req *req;
+
+	if (ep->streams) {
+		xhci_stream_flush(udev, ep_index, status);
+		return;
+	}
+	if (ep->bulk_halted) {
+		xhci_queue_command(ctrl, NULL, udev->slot_id, ep_index,
+				   TRB_RESET_EP);
+		event = xhci_wait_for_event(ctrl, TRB_COMPLETION);
+		BUG_ON(TRB_TO_SLOT_ID(le32_to_cpu(event->event_cmd.flags))
+			!= udev->slot_id);
+		xhci_acknowledge_event(ctrl);
+
+		xhci_queue_command(ctrl, (void *)((uintptr_t)ring->enqueue |
+			ring->cycle_state), udev->slot_id, ep_index,
+			TRB_SET_DEQ);
+		event = xhci_wait_for_event(ctrl, TRB_COMPLETION);
+		BUG_ON(TRB_TO_SLOT_ID(le32_to_cpu(event->event_cmd.flags))
+			!= udev->slot_id || GET_COMP_CODE(le32_to_cpu(
+			event->event_cmd.status)) != COMP_SUCCESS);
+		xhci_acknowledge_event(ctrl);
+		ep->bulk_halted = false;
+	} else if (ep->bulk_count) {
+		abort_td(udev, ep_index);
+	}
+
+	while (ep->bulk_count) {
+		req = ep->bulk_tds[ep->bulk_head].req;
+		req->status = status;
+		req->done = true;
+		ep->bulk_head = (ep->bulk_head + 1) % XHCI_BULK_QUEUE;
+		ep->bulk_count--;
+	}
+	ep->bulk_trbs = 0;
+	ep->bulk_short_trb = NULL;
+}
+
+/**
+ * Queues up a bulk transfer without waiting for it
+ *
+ * Bulk endpoint rings have XHCI_BULK_RING_SEGS segments, so several TDs
+ * fit, up to XHCI_BULK_QUEUE of them. On an endpoint with streams the
+ * transfer goes on its stream's ring instead, which holds one TD.
+ *
+ * @param udev	pointer to the USB device structure
+ * @param req	transfer to queue
+ * @return 0 if queued, -EBUSY if there is no room, else error code
+ */
+int xhci_bulk_submit(struct usb_device *udev, struct usb_bulk_req *req)
+{
+	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
+	int ep_index = usb_pipe_ep_index(req->pipe);
+	struct xhci_virt_ep *ep = &ctrl->devs[udev->slot_id]->eps[ep_index];
+	struct xhci_bulk_td *td;
+	int room;
+	int ret;
+
+	if (!req->stream != !ep->streams ||
+	    (ep->streams && req->stream >= ep->streams->num_streams))
+		return -EINVAL;
+	if (req->stream) {
+		td = &ep->streams->tds[req->stream];
+		if (td->req)
+			return -EBUSY;
+		room = TRBS_PER_SEGMENT - 2;
+	} else {
+		/*
+		 * Keep one TRB free so that the ring never looks empty when
+		 * full
+		 */
+		room = XHCI_BULK_RING_SEGS * (TRBS_PER_SEGMENT - 1) - 1 -
+			ep->bulk_trbs;
+		if (ep->bulk_count == XHCI_BULK_QUEUE)
+			return -EBUSY;
+		td = &ep->bulk_tds[(ep->bulk_head + ep->bulk_count) %
+				   XHCI_BULK_QUEUE];
+	}
+	ret = xhci_queue_bulk_td(udev, req->pipe, req->stream, req->length,
+				 req->buffer, &td->last_trb, &td->num_trbs,
+				 room);
+	if (ret)
+		return ret;
+	td->req = req;
+	if (!req->stream)
+		ep->bulk_trbs += td->num_trbs;
+	ep->bulk_count++;
+
+	return 0;
+}
+
+/**
+ * Completes the queued bulk transfers which have finished
+ *
+ * All pending events are handled and the hardware is told about them with
+ * a single write to the event ring dequeue pointer. Endpoints which halted
+ * are then reset.
+ *
+ * @param ctrl	Host controller data structure
+ * @return number of transfers completed
+ */
+int xhci_bulk_reap(struct xhci_ctrl *ctrl)
+{
+	struct xhci_virt_device *virt_dev;
+	union xhci_trb *event;
+	int count = 0, events = 0;
+	int slot, i;
+
+	while (event_ready(ctrl)) {
+		event = ctrl->event_ring->dequeue;
+		if (TRB_FIELD_TO_TYPE(le32_to_cpu(event->event_cmd.flags)) ==
+		    TRB_TRANSFER && xhci_bulk_event(ctrl, event) > 0)
+			count++;
+		inc_deq(ctrl, ctrl->event_ring);
+		events++;
+	}
+	if (events)
+		xhci_writeq(&ctrl->ir_set->erst_dequeue,
+			    (uintptr_t)ctrl->event_ring->dequeue | ERST_EHB);
+
+	if (ctrl->bulk_halted) {
+		ctrl->bulk_halted = false;
+		for (slot = 0; slot < MAX_HC_SLOTS; slot++) {
+			virt_dev = ctrl->devs[slot];
+			if (!virt_dev || !virt_dev->udev)
+				continue;
+			for (i = 0; i < ARRAY_SIZE(virt_dev->eps); i++) {
+				if (virt_dev->eps[i].bulk_halted)
+					xhci_bulk_flush(virt_dev->udev, i,
+							-ECANCELED);
+			}
+		}
+	}
+
+	return count;
+}
+
+/**
+ * Cancels the queued bulk transfers on a pipe
+ *
+ * @param udev	pointer to the USB device structure
+ * @param pipe	pipe to cancel transfers on
+ * @return 0
+ */
+int xhci_bulk_cancel(struct usb_device *udev, unsigned long pipe)
+{
+	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
+	int ep_index = usb_pipe_ep_index(pipe);
+
+	/* Pick up anything which has finished so it is not thrown away */
+	xhci_bulk_reap(ctrl);
+	xhci_bulk_flush(udev, ep_index, -ECANCELED);
+
+	return 0;
+}
+
+/**
+ * Waits for the queued bulk transfers on an endpoint to finish
+ *
+ * @param udev		pointer to the USB device structure
+ * @param ep_index	index of the endpoint
+ * @return none
+ */
+static void xhci_bulk_drain(struct usb_device *udev, int ep_index)
+{
+	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
+	struct xhci_virt_ep *ep = &ctrl->devs[udev->slot_id]->eps[ep_index];
+	unsigned long ts = get_timer(0);
+
+	while (ep->bulk_count) {
+		xhci_bulk_reap(ctrl);
+		if (ep->bulk_count && get_timer(ts) > XHCI_TIMEOUT) {
+			debug("XHCI queued bulk transfers timed out\n");
+			xhci_bulk_flush(udev, ep_index, -ETIMEDOUT);
+		}
+	}
+}
+
+/**
+ * Queues up the BULK Request and waits for it
+ *
+ * @param udev		pointer to the USB device structure
+ * @param pipe		contains the DIR_IN or OUT , devnum
+ * @param length	length of the buffer
+ * @param buffer	buffer to be read/written based on the request
+ * @return returns 0 if successful else -1 on failure
+ */
+int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
+			int length, void *buffer)
+{
+	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
+	int slot_id = udev->slot_id;
+	int ep_index = usb_pipe_ep_index(pipe);
+	union xhci_trb *event;
+	union xhci_trb *last_trb;
+	int num_trbs;
+	u32 field;
+	int ret;
+
+	/* Transfers on an endpoint with streams must say which stream */
+	if (ctrl->devs[slot_id]->eps[ep_index].streams)
+		return -EINVAL;
+
+	/* Anything already queued on the endpoint goes first */
+	xhci_bulk_drain(udev, ep_index);
+
+	ret = xhci_queue_bulk_td(udev, pipe, 0, length, buffer, &last_trb,
+				 &num_trbs, INT_MAX);
+	if (ret < 0)
+		return ret;
 
 	event = xhci_wait_for_event(ctrl, TRB_TRANSFER);
 	if (!event) {
@@ -907,7 +1393,7 @@ int xhci_ctrl_tx(struct usb_device *udev, unsigned long pipe,
 
 	queue_trb(ctrl, ep_ring, false, trb_fields);
 
-	giveback_first_trb(udev, ep_index, start_cycle, start_trb);
+	giveback_first_trb(udev, ep_index, 0, start_cycle, start_trb);
 
 	event = xhci_wait_for_event(ctrl, TRB_TRANSFER);
 	if (!event)
@@ -29,6 +29,7 @@
 #include <asm/cache.h>
 #include <asm/unaligned.h>
 #include <linux/errno.h>
+#include <linux/log2.h>
 #include "xhci.h"
 
 #ifndef CONFIG_USB_MAX_CONTROLLER_COUNT
@@ -570,10 +571,20 @@ static int xhci_set_configuration(struct usb_device *udev)
 		ep_index = xhci_get_ep_index(endpt_desc);
 		ep_ctx[ep_index] = xhci_get_ep_ctx(ctrl, in_ctx, ep_index);
 
-		/* Allocate the ep rings */
-		virt_dev->eps[ep_index].ring = xhci_ring_alloc(1, true);
+		/* Allocate the ep rings, with room for several bulk TDs */
+		if (usb_endpoint_xfer_bulk(endpt_desc))
+			virt_dev->eps[ep_index].ring =
+				xhci_ring_alloc(XHCI_BULK_RING_SEGS, true);
+		else
+			virt_dev->eps[ep_index].ring = xhci_ring_alloc(1, true);
 		if (!virt_dev->eps[ep_index].ring)
 			return -ENOMEM;
+		virt_dev->eps[ep_index].bulk_count = 0;
+		virt_dev->eps[ep_index].bulk_trbs = 0;
+		virt_dev->eps[ep_index].bulk_short_trb = NULL;
+		virt_dev->eps[ep_index].bulk_halted = false;
+		xhci_free_stream_info(virt_dev->eps[ep_index].streams);
+		virt_dev->eps[ep_index].streams = NULL;
 
 		/*NOTE: ep_desc[0] actually represents EP1 and so on */
 		dir = (((endpt_desc->bEndpointAddress) & (0x80)) >> 7);
@@ -1385,6 +1396,122 @@ static int xhci_submit_bulk_msg(struct udevice *dev, struct usb_device *udev,
 	return _xhci_submit_bulk_msg(udev, pipe, buffer, length);
 }
 
+static int xhci_submit_bulk_req(struct udevice *dev, struct usb_device *udev,
+				struct usb_bulk_req *req)
+{
+	if (usb_pipetype(req->pipe) != PIPE_BULK) {
+		printf("non-bulk pipe (type=%lu)", usb_pipetype(req->pipe));
+		return -EINVAL;
+	}
+
+	return xhci_bulk_submit(udev, req);
+}
+
+static int xhci_reap_bulk(struct udevice *dev, struct usb_device *udev)
+{
+	return xhci_bulk_reap(dev_get_priv(dev));
+}
+
+static int xhci_cancel_bulk(struct udevice *dev, struct usb_device *udev,
+			    unsigned long pipe)
+{
+	return xhci_bulk_cancel(udev, pipe);
+}
+
+/*
+ * Finds the place of a pipe's endpoint in the endpoint descriptors of the
+ * first interface, where xhci_set_configuration() set it up
+ */
+static int xhci_find_ep_desc(struct usb_device *udev, unsigned long pipe)
+{
+	struct usb_interface *ifdesc = &udev->config.if_desc[0];
+	u8 addr = usb_pipeendpoint(pipe) | (usb_pipein(pipe) ? USB_DIR_IN : 0);
+	int i;
+
+	for (i = 0; i < ifdesc->no_of_ep; i++) {
+		if (ifdesc->ep_desc[i].bEndpointAddress == addr &&
+		    usb_endpoint_xfer_bulk(&ifdesc->ep_desc[i]))
+			return i;
+	}
+
+	return -EINVAL;
+}
+
+static int xhci_alloc_streams(struct udevice *dev, struct usb_device *udev,
+			      unsigned long *pipes, int num_pipes,
+			      int num_streams)
+{
+	struct xhci_ctrl *ctrl = dev_get_priv(dev);
+	struct xhci_virt_device *virt_dev = ctrl->devs[udev->slot_id];
+	struct usb_interface *ifdesc = &udev->config.if_desc[0];
+	struct xhci_container_ctx *in_ctx = virt_dev->in_ctx;
+	struct xhci_container_ctx *out_ctx = virt_dev->out_ctx;
+	struct xhci_input_control_ctx *ctrl_ctx;
+	struct xhci_ep_ctx *ep_ctx;
+	struct xhci_virt_ep *ep;
+	unsigned int size, max_streams;
+	u32 ep_flags = 0;
+	int ep_index, i, ret;
+	u8 attr;
+
+	/* Stream 0 is reserved, so the array needs one more entry */
+	if (udev->speed < USB_SPEED_SUPER || num_streams < 1)
+		return -EINVAL;
+	max_streams = HCC_MAX_PSA(xhci_readl(&ctrl->hccr->cr_hccparams));
+	if (max_streams < 4)
+		return -ENOSYS;
+	max_streams = min(max_streams, (unsigned int)XHCI_MAX_STREAMS);
+	for (i = 0; i < num_pipes; i++) {
+		ret = xhci_find_ep_desc(udev, pipes[i]);
+		if (ret < 0)
+			return ret;
+		attr = ifdesc->ss_ep_comp_desc[ret].bmAttributes & 0x1f;
+		if (!attr)
+			return -EINVAL;
+		max_streams = min(max_streams, 1U << attr);
+		ep_index = usb_pipe_ep_index(pipes[i]);
+		if (virt_dev->eps[ep_index].bulk_count)
+			return -EBUSY;
+		ep_flags |= 1 << (ep_index + 1);
+	}
+	size = min((unsigned int)roundup_pow_of_two(num_streams + 1),
+		   max_streams);
+
+	xhci_inval_cache((uintptr_t)out_ctx->bytes, out_ctx->size);
+	ctrl_ctx = xhci_get_input_control_ctx(in_ctx);
+	ctrl_ctx->add_flags = cpu_to_le32(SLOT_FLAG | ep_flags);
+	ctrl_ctx->drop_flags = cpu_to_le32(ep_flags);
+	xhci_slot_copy(ctrl, in_ctx, out_ctx);
+
+	/* Point each endpoint at a Linear Stream Array instead of its ring */
+	for (i = 0; i < num_pipes; i++) {
+		ep_index = usb_pipe_ep_index(pipes[i]);
+		ep = &virt_dev->eps[ep_index];
+		xhci_free_stream_info(ep->streams);
+		ep->streams = xhci_alloc_stream_info(size);
+
+		xhci_endpoint_copy(ctrl, in_ctx, out_ctx, ep_index);
+		ep_ctx = xhci_get_ep_ctx(ctrl, in_ctx, ep_index);
+		ep_ctx->ep_info &= cpu_to_le32(~(EP_MAXPSTREAMS_MASK |
+						 EP_STATE_MASK));
+		ep_ctx->ep_info |= cpu_to_le32(EP_MAXPSTREAMS(ilog2(size) - 1) |
+					       EP_HAS_LSA);
+		ep_ctx->deq = cpu_to_le64((uintptr_t)ep->streams->stream_ctx);
+	}
+
+	ret = xhci_configure_endpoints(udev, false);
+	if (ret) {
+		for (i = 0; i < num_pipes; i++) {
+			ep = &virt_dev->eps[usb_pipe_ep_index(pipes[i])];
+			xhci_free_stream_info(ep->streams);
+			ep->streams = NULL;
+		}
+		return ret;
+	}
+
+	return size - 1;
+}
+
 static int xhci_submit_int_msg(struct udevice *dev, struct usb_device *udev,
 			       unsigned long pipe, void *buffer, int length,
 			       int interval)
@@ -1525,6 +1652,10 @@ struct dm_usb_ops xhci_usb_ops = {
 	.alloc_device = xhci_alloc_device,
 	.update_hub_device = xhci_update_hub_device,
 	.get_max_xfer_size  = xhci_get_max_xfer_size,
+	.submit_bulk = xhci_submit_bulk_req,
+	.reap_bulk = xhci_reap_bulk,
+	.cancel_bulk = xhci_cancel_bulk,
+	.alloc_streams = xhci_alloc_streams,
 };
 
 #endif
@@ -1001,6 +1001,26 @@ typedef enum {
 #define TRB_MAX_BUFF_SHIFT	16
 #define TRB_MAX_BUFF_SIZE	(1 << TRB_MAX_BUFF_SHIFT)
 
+/**
+ * struct xhci_stream_ctx
+ * Stream Context - section 6.2.4.1. Each entry of a Stream Context Array
+ * points to the transfer ring of one stream.
+ *
+ * @stream_ring: 64-bit stream ring address, cycle state, and stream type
+ */
+struct xhci_stream_ctx {
+	__le64	stream_ring;
+	/* offset 0x8 - 0xf reserved for HC internal use */
+	__le32	reserved[2];
+};
+
+/* Stream Context Types (section 6.4.1) - bits 3:1 of stream ctx deq ptr */
+#define SCT_FOR_CTX(p)		(((p) & 0x7) << 1)
+/* Stream Context Type in a Set TR Dequeue Pointer command TRB */
+#define SCT_FOR_TRB(p)		(((p) << 1) & 0x7)
+/* Primary stream array type, dequeue pointer is to a transfer ring */
+#define SCT_PRI_TR		1
+
 struct xhci_segment {
 	union xhci_trb		*trbs;
 	/* private to HCD */
@@ -1057,6 +1077,47 @@ struct xhci_scratchpad {
 #define XHCI_STOP_EP_CMD_TIMEOUT	5
 /* XXX: Make these module parameters */
 
+/* Number of bulk transfers which can be queued on an endpoint */
+#define XHCI_BULK_QUEUE		8
+/* Segments in a bulk endpoint's transfer ring, so it can hold several TDs */
+#define XHCI_BULK_RING_SEGS	4
+
+/**
+ * struct xhci_bulk_td - a queued bulk transfer
+ *
+ * @req:	Request being transferred
+ * @last_trb:	Last TRB of the TD
+ * @num_trbs:	Number of TRBs in the TD
+ */
+struct xhci_bulk_td {
+	struct usb_bulk_req		*req;
+	union xhci_trb			*last_trb;
+	int				num_trbs;
+};
+
+/* Size of the largest Stream Context Array, including reserved stream 0 */
+#define XHCI_MAX_STREAMS	16
+
+/**
+ * struct xhci_stream_info - the streams of a bulk endpoint
+ *
+ * Each stream has a transfer ring of one segment and holds one TD at a
+ * time. Stream 0 is reserved, so entry 0 of each array is unused.
+ *
+ * @stream_ctx:	Stream Context Array given to the controller
+ * @num_streams: Number of entries in @stream_ctx, a power of two
+ * @rings:	Transfer ring of each stream
+ * @tds:	TD queued on each stream, with a NULL @req if there is none
+ * @short_trbs:	Last TRB of a TD which ended early; ignore an event for it
+ */
+struct xhci_stream_info {
+	struct xhci_stream_ctx		*stream_ctx;
+	unsigned int			num_streams;
+	struct xhci_ring		*rings[XHCI_MAX_STREAMS];
+	struct xhci_bulk_td		tds[XHCI_MAX_STREAMS];
+	union xhci_trb			*short_trbs[XHCI_MAX_STREAMS];
+};
+
 struct xhci_virt_ep {
 	struct xhci_ring		*ring;
 	unsigned int			ep_state;
@@ -1068,6 +1129,18 @@ struct xhci_virt_ep {
 #define EP_HAS_STREAMS		(1 << 4)
 /* Transitioning the endpoint to not using streams, don't enqueue URBs */
 #define EP_GETTING_NO_STREAMS	(1 << 5)
+	/* Queued bulk transfers, oldest first, see xhci_bulk_submit() */
+	struct xhci_bulk_td		bulk_tds[XHCI_BULK_QUEUE];
+	unsigned int			bulk_head;
+	unsigned int			bulk_count;
+	/* TRBs used by the queued bulk transfers */
+	unsigned int			bulk_trbs;
+	/* Last TRB of a TD which ended early; ignore an event for it */
+	union xhci_trb			*bulk_short_trb;
+	/* The endpoint halted and must be reset before it is used again */
+	bool				bulk_halted;
+	/* Streams set up by usb_alloc_streams(), or NULL if none */
+	struct xhci_stream_info		*streams;
 };
 
 #define CTX_SIZE(_hcc) (HCC_64BYTE_CONTEXT(_hcc) ? 64 : 32)
@@ -1231,6 +1304,8 @@ struct xhci_ctrl {
 	struct xhci_scratchpad *scratchpad;
 	struct xhci_virt_device *devs[MAX_HC_SLOTS];
 	int rootdev;
+	/* An endpoint with queued bulk transfers has halted */
+	bool bulk_halted;
 };
 
 unsigned long trb_addr(struct xhci_segment *seg, union xhci_trb *trb);
@@ -1256,6 +1331,9 @@ void xhci_acknowledge_event(struct xhci_ctrl *ctrl);
 union xhci_trb *xhci_wait_for_event(struct xhci_ctrl *ctrl, trb_type expected);
 int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 		 int length, void *buffer);
+int xhci_bulk_submit(struct usb_device *udev, struct usb_bulk_req *req);
+int xhci_bulk_reap(struct xhci_ctrl *ctrl);
+int xhci_bulk_cancel(struct usb_device *udev, unsigned long pipe);
 int xhci_ctrl_tx(struct usb_device *udev, unsigned long pipe,
 		 struct devrequest *req, int length, void *buffer);
 int xhci_check_maxpacket(struct usb_device *udev);
@@ -1264,6 +1342,8 @@ void xhci_inval_cache(uintptr_t addr, u32 type_len);
 void xhci_cleanup(struct xhci_ctrl *ctrl);
 struct xhci_ring *xhci_ring_alloc(unsigned int num_segs, bool link_trbs);
 int xhci_alloc_virt_device(struct xhci_ctrl *ctrl, unsigned int slot_id);
+struct xhci_stream_info *xhci_alloc_stream_info(unsigned int num_streams);
+void xhci_free_stream_info(struct xhci_stream_info *info);
 int xhci_mem_init(struct xhci_ctrl *ctrl, struct xhci_hccr *hccr,
 		  struct xhci_hcor *hcor);
 
@@ -179,6 +179,12 @@ static int env_mmc_save(void)
 		goto fini;
 	}
 
+	if (mmc_flush_cache(mmc)) {
+		puts("failed\n");
+		ret = 1;
+		goto fini;
+	}
+
 	puts("done\n");
 	ret = 0;
 
@@ -247,35 +247,17 @@ static int readenv(size_t offset, u_char *buf)
 #else
 static int readenv(size_t offset, u_char *buf)
 {
-	size_t end = offset + CONFIG_ENV_RANGE;
-	size_t amount_loaded = 0;
-	size_t blocksize, len;
 	struct mtd_info *mtd;
-	u_char *char_ptr;
+	size_t len;
+	int ret;
 
 	mtd = get_nand_dev_by_index(0);
 	if (!mtd)
 		return 1;
 
-	blocksize = mtd->erasesize;
-	len = min(blocksize, (size_t)CONFIG_ENV_SIZE);
-
-	while (amount_loaded < CONFIG_ENV_SIZE && offset < end) {
-		if (nand_block_isbad(mtd, offset)) {
-			offset += blocksize;
-		} else {
-			char_ptr = &buf[amount_loaded];
-			if (nand_read_skip_bad(mtd, offset,
-					       &len, NULL,
-					       mtd->size, char_ptr))
-				return 1;
-
-			offset += blocksize;
-			amount_loaded += len;
-		}
-	}
-
-	if (amount_loaded != CONFIG_ENV_SIZE)
+	ret = mtd_read_skip_bad(mtd, offset, CONFIG_ENV_SIZE,
+				CONFIG_ENV_RANGE, &len, buf);
+	if ((ret && !mtd_is_bitflip(ret)) || len != CONFIG_ENV_SIZE)
 		return 1;
 
 	return 0;
@@ -12,6 +12,7 @@
 #include <ext4fs.h>
 #include <fat.h>
 #include <fs.h>
+#include <mmc.h>
 #include <sandboxfs.h>
 #include <ubifs_uboot.h>
 #include <btrfs.h>
@@ -628,6 +629,8 @@ int do_save(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 
 	time = get_timer(0);
 	ret = fs_write(filename, addr, pos, bytes, &len);
+	if (ret >= 0)
+		mmc_flush_all_caches();
 	time = get_timer(time);
 	if (ret < 0)
 		return 1;
@@ -200,6 +200,9 @@ enum bootstage_id {
 	BOOTSTATE_ID_ACCUM_DM_SPL,
 	BOOTSTATE_ID_ACCUM_DM_F,
 	BOOTSTATE_ID_ACCUM_DM_R,
+	BOOTSTAGE_ID_ACCUM_MMC_START,
+	BOOTSTAGE_ID_ACCUM_MMC_OP_COND,
+	BOOTSTAGE_ID_ACCUM_MMC_STARTUP,
 
 	/* a few spare for the user, from here */
 	BOOTSTAGE_ID_USER,
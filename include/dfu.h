@@ -102,6 +102,8 @@ struct dfu_entity {
 	enum dfu_device_type    dev_type;
 	enum dfu_layout         layout;
 	unsigned long           max_buf_size;
+	/* Largest piece written at once in the background, 0 for no limit */
+	unsigned long           write_slice;
 
 	union {
 		struct mmc_internal_data mmc;
@@ -163,6 +165,19 @@ int dfu_read(struct dfu_entity *de, void *buf, int size, int blk_seq_num);
 int dfu_write(struct dfu_entity *de, void *buf, int size, int blk_seq_num);
 int dfu_flush(struct dfu_entity *de, void *buf, int size, int blk_seq_num);
 
+/**
+ * dfu_write_background() - Write out the next slice of a full buffer
+ *
+ * With CONFIG_DFU_DOUBLE_BUFFER a full buffer is handed over to be written
+ * while the host fills the other one. This is to be called from the gadget
+ * polling loop, an error is returned by the next dfu_write() or dfu_flush().
+ */
+#ifdef CONFIG_DFU_DOUBLE_BUFFER
+void dfu_write_background(void);
+#else
+static inline void dfu_write_background(void) {}
+#endif
+
 /*
  * dfu_defer_flush - pointer to store dfu_entity for deferred flashing.
  *		     It should be NULL when not used.
@@ -0,0 +1,100 @@
+/*
+ * ECC engine uclass
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef _ECC_ENGINE_H_
+#define _ECC_ENGINE_H_
+
+/*
+ * An ECC engine computes and checks the error correcting code of fixed-size
+ * steps of data, typically the sectors of a NAND page. NAND controllers with
+ * a BCH block register it as a device of this uclass; the software BCH
+ * engine can be used where there is none. NAND_ECC_SOFT_BCH picks an engine
+ * with the chip's step size and ECC bytes in nand_bch_init().
+ */
+
+/**
+ * struct ecc_engine_uc_priv - Information about an ECC engine
+ *
+ * Drivers must fill this in when they are probed.
+ *
+ * @step_size:	Number of data bytes covered by each code
+ * @strength:	Number of bit errors which can be corrected in a step
+ * @bytes:	Number of ECC bytes per step
+ */
+struct ecc_engine_uc_priv {
+	unsigned int step_size;
+	unsigned int strength;
+	unsigned int bytes;
+};
+
+/**
+ * struct ecc_engine_ops - Operations of an ECC engine
+ */
+struct ecc_engine_ops {
+	/**
+	 * calculate() - Calculate the ECC of a step
+	 *
+	 * @dev:	ECC engine
+	 * @data:	Step of data, step_size bytes
+	 * @ecc:	Returns the ECC, bytes bytes
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*calculate)(struct udevice *dev, const u8 *data, u8 *ecc);
+
+	/**
+	 * correct() - Correct a step using its stored and calculated ECC
+	 *
+	 * @dev:	ECC engine
+	 * @data:	Step of data as read, corrected in place
+	 * @read_ecc:	ECC read along with the data
+	 * @calc_ecc:	ECC calculated from @data by calculate()
+	 * @return number of bit errors corrected, -EBADMSG if there are
+	 *	more than can be corrected, other -ve on error
+	 */
+	int (*correct)(struct udevice *dev, u8 *data, const u8 *read_ecc,
+		       const u8 *calc_ecc);
+};
+
+#define ecc_engine_get_ops(dev)	((struct ecc_engine_ops *)(dev)->driver->ops)
+
+/**
+ * ecc_engine_calculate() - Calculate the ECC of a step
+ *
+ * @dev:	ECC engine
+ * @data:	Step of data
+ * @ecc:	Returns the ECC
+ * @return 0 if OK, -ve on error
+ */
+int ecc_engine_calculate(struct udevice *dev, const u8 *data, u8 *ecc);
+
+/**
+ * ecc_engine_correct() - Correct a step using its stored and calculated ECC
+ *
+ * @dev:	ECC engine
+ * @data:	Step of data as read, corrected in place
+ * @read_ecc:	ECC read along with the data
+ * @calc_ecc:	ECC calculated from @data
+ * @return number of bit errors corrected, -EBADMSG if uncorrectable,
+ *	other -ve on error
+ */
+int ecc_engine_correct(struct udevice *dev, u8 *data, const u8 *read_ecc,
+		       const u8 *calc_ecc);
+
+/**
+ * ecc_engine_find() - Find an ECC engine for a step size and strength
+ *
+ * Engines are tried in order, so one provided by the NAND controller should
+ * be bound before the software engine.
+ *
+ * @step_size:	Step size in bytes
+ * @strength:	Minimum number of bit errors to correct per step
+ * @devp:	Returns the engine, which is probed
+ * @return 0 if OK, -ENODEV if there is no suitable engine
+ */
+int ecc_engine_find(unsigned int step_size, unsigned int strength,
+		    struct udevice **devp);
+
+#endif
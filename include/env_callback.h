@@ -45,6 +45,15 @@
 #define DNS_CALLBACK
 #endif
 
+#ifdef CONFIG_IPV6
+#define NET6_CALLBACKS \
+	"ip6addr:ip6addr," \
+	"gatewayip6:gatewayip6," \
+	"serverip6:serverip6,"
+#else
+#define NET6_CALLBACKS
+#endif
+
 #ifdef CONFIG_NET
 #define NET_CALLBACKS \
 	"bootfile:bootfile," \
@@ -55,6 +64,7 @@
 	"nvlan:nvlan," \
 	"vlan:vlan," \
 	DNS_CALLBACK \
+	NET6_CALLBACKS \
 	"eth" ETHADDR_WILDCARD "addr:ethaddr,"
 #else
 #define NET_CALLBACKS
@@ -7,3 +7,40 @@
 void fb_mmc_flash_write(const char *cmd, void *download_buffer,
 			unsigned int download_bytes);
 void fb_mmc_erase(const char *cmd);
+
+/**
+ * fb_mmc_stream_start() - Get ready to write the next download as it arrives
+ *
+ * The image may be sparse or raw. It is written to the partition while it
+ * is received, so it need not fit in the fastboot buffer.
+ *
+ * @cmd:	Partition name
+ * @return 0 if OK, -ve on error. The result is reported with
+ *	fastboot_okay() or fastboot_fail().
+ */
+int fb_mmc_stream_start(const char *cmd);
+
+/**
+ * fb_mmc_stream_write() - Write the next piece of a streamed image
+ *
+ * @data:	Data received
+ * @len:	Number of bytes
+ * @return 0 if OK, -EIO on error (reported by fb_mmc_stream_finish())
+ */
+int fb_mmc_stream_write(const void *data, unsigned int len);
+
+/**
+ * fb_mmc_stream_finish() - Finish writing a streamed image
+ *
+ * @return 0 if OK, -EIO on error. The result is reported with
+ *	fastboot_okay() or fastboot_fail().
+ */
+int fb_mmc_stream_finish(void);
+
+/**
+ * fb_mmc_stream_abort() - Drop a stream which will not be finished
+ *
+ * This frees the buffer of a stream started by fb_mmc_stream_start(), e.g.
+ * when the host goes away before the download is complete.
+ */
+void fb_mmc_stream_abort(void);
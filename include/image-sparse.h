@@ -23,6 +23,17 @@ struct sparse_storage {
 	lbaint_t	(*reserve)(struct sparse_storage *info,
 				 lbaint_t blk,
 				 lbaint_t blkcnt);
+
+	/*
+	 * Optional: erase whole groups of @erase_grp blocks, returning the
+	 * number of blocks erased. Fills of @erased_val are then erased
+	 * rather than written.
+	 */
+	lbaint_t	(*erase)(struct sparse_storage *info,
+				 lbaint_t blk,
+				 lbaint_t blkcnt);
+	u32		erase_grp;
+	u32		erased_val;
 };
 
 static inline int is_sparse_image(void *buf)
@@ -38,3 +49,69 @@ static inline int is_sparse_image(void *buf)
 
 void write_sparse_image(struct sparse_storage *info, const char *part_name,
 			void *data, unsigned sz);
+
+/**
+ * struct sparse_stream - A sparse image being written as it arrives
+ *
+ * The image is passed in pieces of any size, so headers may be split
+ * between pieces. Raw data is collected in @buf so that the storage sees
+ * large writes, unless a piece already holds a whole buffer's worth.
+ *
+ * Images without a sparse header are written out as they are.
+ */
+struct sparse_stream {
+	struct sparse_storage *info;
+	sparse_header_t sparse_header;
+	chunk_header_t chunk_header;
+	int state;			/* enum sparse_stream_state */
+	bool raw_image;			/* not a sparse image */
+	/* Header being collected */
+	u8 hdr[sizeof(sparse_header_t)] __aligned(4);
+	unsigned int hdr_len;		/* bytes of it collected so far */
+	unsigned int hdr_size;		/* bytes needed */
+	unsigned int skip;		/* bytes to skip before the next part */
+	u32 data_left;			/* bytes left in the raw chunk */
+	unsigned int chunk;		/* chunks done */
+	lbaint_t blk;			/* block where @buf goes */
+	u32 total_blocks;		/* sparse blocks done */
+	u64 bytes_written;
+	u64 bytes_erased;		/* part of bytes_written */
+	void *buf;
+	unsigned int buf_size;
+	unsigned int buf_len;		/* bytes of data in @buf */
+	const char *err;		/* error message, if failed */
+};
+
+/**
+ * sparse_stream_start() - Start writing a sparse image in pieces
+ *
+ * @ss:		Stream state to set up
+ * @info:	Storage to write to
+ * @return 0 if OK, -ENOMEM if the buffer could not be allocated
+ */
+int sparse_stream_start(struct sparse_stream *ss, struct sparse_storage *info);
+
+/**
+ * sparse_stream_write() - Write the next piece of a sparse image
+ *
+ * @ss:		Stream state
+ * @data:	Next bytes of the image
+ * @len:	Number of bytes
+ * @return 0 if OK, -EIO if the image is bad or could not be written. The
+ *	rest of the image is then ignored and the error reported by
+ *	sparse_stream_finish().
+ */
+int sparse_stream_write(struct sparse_stream *ss, const void *data,
+			unsigned int len);
+
+/**
+ * sparse_stream_finish() - Finish writing a sparse image
+ *
+ * This writes out any buffered data and frees the buffer.
+ *
+ * @ss:		Stream state
+ * @part_name:	Partition name, for messages
+ * @return 0 if the whole image was written, -EIO if not, with ss->err
+ *	describing the failure
+ */
+int sparse_stream_finish(struct sparse_stream *ss, const char *part_name);
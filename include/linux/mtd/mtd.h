@@ -293,6 +293,11 @@ unsigned long mtd_get_unmapped_area(struct mtd_info *mtd, unsigned long len,
 				    unsigned long offset, unsigned long flags);
 int mtd_read(struct mtd_info *mtd, loff_t from, size_t len, size_t *retlen,
 	     u_char *buf);
+#ifdef CONFIG_MTD_READ_CACHE
+void mtd_read_cache_invalidate(void);
+#else
+static inline void mtd_read_cache_invalidate(void) {}
+#endif
 int mtd_write(struct mtd_info *mtd, loff_t to, size_t len, size_t *retlen,
 	      const u_char *buf);
 int mtd_panic_write(struct mtd_info *mtd, loff_t to, size_t len, size_t *retlen,
@@ -308,6 +313,7 @@ static inline int mtd_write_oob(struct mtd_info *mtd, loff_t to,
 		return -EOPNOTSUPP;
 	if (!(mtd->flags & MTD_WRITEABLE))
 		return -EROFS;
+	mtd_read_cache_invalidate();
 	return mtd->_write_oob(mtd, to, ops);
 }
 
@@ -497,5 +503,43 @@ int mtd_arg_off_size(int argc, char *const argv[], int *idx, loff_t *off,
 void mtd_get_len_incl_bad(struct mtd_info *mtd, uint64_t offset,
 			  const uint64_t length, uint64_t *len_incl_bad,
 			  int *truncated);
+
+/**
+ * mtd_read_skip_bad() - Read data straight into a buffer, skipping bad blocks
+ *
+ * Bad blocks met on the way are skipped and reading carries on at the start
+ * of the next block. Data is read into @buf directly, so that page-aligned
+ * reads are not bounced through an intermediate buffer.
+ *
+ * @mtd:	MTD device or partition
+ * @from:	Offset to start reading at
+ * @len:	Number of bytes to read
+ * @lim:	Maximum number of bytes of flash to use, including bad blocks
+ * @retlen:	Returns the number of bytes read
+ * @buf:	Buffer to read into
+ * @return 0 if OK, -EUCLEAN if bitflips were corrected, -EFBIG if the data
+ *	does not fit within @lim, -EINVAL if it runs past the end of @mtd,
+ *	other -ve on read error
+ */
+int mtd_read_skip_bad(struct mtd_info *mtd, loff_t from, size_t len,
+		      loff_t lim, size_t *retlen, u_char *buf);
+
+/**
+ * struct mtd_read_cache_stats - Counters of the MTD read cache
+ *
+ * @hits:	Reads served from the cache
+ * @misses:	Reads which had to fetch a page
+ * @flushes:	Times the cache was emptied by a write, erase or removal
+ */
+struct mtd_read_cache_stats {
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long flushes;
+};
+
+#ifdef CONFIG_MTD_READ_CACHE
+/* Get a copy of the read cache counters */
+void mtd_read_cache_get_stats(struct mtd_read_cache_stats *stats);
+#endif
 #endif
 #endif /* __MTD_MTD_H__ */
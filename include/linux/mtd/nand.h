@@ -95,6 +95,8 @@ extern void nand_wait_ready(struct mtd_info *mtd);
 #define NAND_CMD_READSTART	0x30
 #define NAND_CMD_RNDOUTSTART	0xE0
 #define NAND_CMD_CACHEDPROG	0x15
+#define NAND_CMD_READCACHESEQ	0x31
+#define NAND_CMD_READCACHEEND	0x3f
 
 /* Extended commands for AG-AND device */
 /*
@@ -195,12 +197,19 @@ typedef enum {
  */
 #define NAND_NEED_SCRAMBLING	0x00002000
 
+/*
+ * Device supports READ CACHE SEQUENTIAL / READ CACHE END, so the next page
+ * can be loaded into the page register while the current one is read out.
+ */
+#define NAND_CACHE_READ		0x00004000
+
 /* Options valid for Samsung large page devices */
 #define NAND_SAMSUNG_LP_OPTIONS NAND_CACHEPRG
 
 /* Macros to identify the above */
 #define NAND_HAS_CACHEPROG(chip) ((chip->options & NAND_CACHEPRG))
 #define NAND_HAS_SUBPAGE_READ(chip) ((chip->options & NAND_SUBPAGE_READ))
+#define NAND_HAS_CACHE_READ(chip) ((chip->options & NAND_CACHE_READ))
 
 /* Non chip related options */
 /* This option skips the bbt scan during initialization. */
@@ -261,6 +270,8 @@ struct nand_chip;
 /* ONFI subfeature parameters length */
 #define ONFI_SUBFEATURE_PARAM_LEN	4
 
+/* ONFI optional commands READ CACHE supported? */
+#define ONFI_OPT_CMD_READ_CACHE		(1 << 1)
 /* ONFI optional commands SET/GET FEATURES supported? */
 #define ONFI_OPT_CMD_SET_GET_FEATURES	(1 << 2)
 
@@ -670,6 +681,8 @@ struct nand_buffers {
  * @onfi_set_features:	[REPLACEABLE] set the features for ONFI nand
  * @onfi_get_features:	[REPLACEABLE] get the features for ONFI nand
  * @bbt:		[INTERN] bad block table pointer
+ * @bbt_cache:		[INTERN] state of the blocks checked so far, two bits
+ *			per block, used when there is no @bbt
  * @bbt_td:		[REPLACEABLE] bad block table descriptor for flash
  *			lookup.
  * @bbt_md:		[REPLACEABLE] bad block table mirror descriptor
@@ -759,6 +772,7 @@ struct nand_chip {
 	struct nand_hw_control hwcontrol;
 
 	uint8_t *bbt;
+	uint8_t *bbt_cache;
 	struct nand_bbt_descr *bbt_td;
 	struct nand_bbt_descr *bbt_md;
 
@@ -787,6 +801,42 @@ static inline void nand_set_controller_data(struct nand_chip *chip, void *priv)
 	chip->priv = priv;
 }
 
+/* Bad block cache entries, two bits per block, see nand_chip->bbt_cache */
+#define NAND_BBC_UNKNOWN	0x00
+#define NAND_BBC_GOOD		0x01
+#define NAND_BBC_BAD		0x02
+#define NAND_BBC_ENTRY_MASK	0x03
+
+/**
+ * nand_bbc_get() - Get the state of a block from a bad block cache
+ *
+ * @cache:	Bad block cache, four blocks per byte
+ * @block:	Block number
+ * @return NAND_BBC_...
+ */
+static inline int nand_bbc_get(const uint8_t *cache, int block)
+{
+	return (cache[block >> 2] >> ((block & 3) * 2)) & NAND_BBC_ENTRY_MASK;
+}
+
+/**
+ * nand_bbc_put() - Set the state of a block in a bad block cache
+ *
+ * The entries of the other three blocks sharing the byte are left alone.
+ *
+ * @cache:	Bad block cache, four blocks per byte
+ * @block:	Block number
+ * @state:	NAND_BBC_...
+ */
+static inline void nand_bbc_put(uint8_t *cache, int block, int state)
+{
+	int shift = (block & 3) * 2;
+
+	cache[block >> 2] = (cache[block >> 2] &
+			     ~(NAND_BBC_ENTRY_MASK << shift)) |
+			    ((state & NAND_BBC_ENTRY_MASK) << shift);
+}
+
 /*
  * NAND Flash Manufacturer ID Codes
  */
@@ -58,8 +58,32 @@
 #define MMC_MODE_8BIT		(1 << 3)
 #define MMC_MODE_SPI		(1 << 4)
 #define MMC_MODE_DDR_52MHz	(1 << 5)
+#define MMC_MODE_HS200		(1 << 6)
+#define MMC_MODE_HS400		(1 << 7)
+#define MMC_MODE_UHS_SDR50	(1 << 8)
+#define MMC_MODE_UHS_SDR104	(1 << 9)
+#define MMC_MODE_UHS_DDR50	(1 << 10)
+/* SET_BLOCK_COUNT ends multi-block transfers without a STOP command */
+#define MMC_MODE_CMD23		(1 << 11)
+
+#define MMC_MODE_UHS		(MMC_MODE_UHS_SDR50 | MMC_MODE_UHS_SDR104 | \
+				 MMC_MODE_UHS_DDR50)
+
+/* Bus timings beyond high speed, which need the host to do more */
+#define MMC_TIMING_LEGACY	0	/* Default and high speed */
+#define MMC_TIMING_UHS_SDR50	1
+#define MMC_TIMING_UHS_SDR104	2
+#define MMC_TIMING_UHS_DDR50	3
+#define MMC_TIMING_MMC_HS200	4
+#define MMC_TIMING_MMC_HS400	5
+
+/* I/O signalling voltage */
+#define MMC_SIGNAL_VOLTAGE_330	0
+#define MMC_SIGNAL_VOLTAGE_180	1
 
 #define SD_DATA_4BIT	0x00040000
+#define SD_DATA_STAT_AFTER_ERASE	0x00800000
+#define SD_SCR_CMD23	0x00000002
 
 #define IS_SD(x)	((x)->version & SD_VERSION_SD)
 #define IS_MMC(x)	((x)->version & MMC_VERSION_MMC)
@@ -82,6 +106,7 @@
 #define MMC_CMD_SET_BLOCKLEN		16
 #define MMC_CMD_READ_SINGLE_BLOCK	17
 #define MMC_CMD_READ_MULTIPLE_BLOCK	18
+#define MMC_CMD_SEND_TUNING_BLOCK_HS200	21
 #define MMC_CMD_SET_BLOCK_COUNT         23
 #define MMC_CMD_WRITE_SINGLE_BLOCK	24
 #define MMC_CMD_WRITE_MULTIPLE_BLOCK	25
@@ -101,6 +126,7 @@
 #define SD_CMD_SWITCH_FUNC		6
 #define SD_CMD_SEND_IF_COND		8
 #define SD_CMD_SWITCH_UHS18V		11
+#define SD_CMD_SEND_TUNING_BLOCK	19
 
 #define SD_CMD_APP_SET_BUS_WIDTH	6
 #define SD_CMD_APP_SD_STATUS		13
@@ -112,9 +138,18 @@
 /* SCR definitions in different words */
 #define SD_HIGHSPEED_BUSY	0x00020000
 #define SD_HIGHSPEED_SUPPORTED	0x00020000
+#define SD_UHS_SDR50_SUPPORTED	0x00040000
+#define SD_UHS_SDR104_SUPPORTED	0x00080000
+#define SD_UHS_DDR50_SUPPORTED	0x00100000
+
+/* Bus speed functions, in switch function group 1 */
+#define SD_SWITCH_FUNC_SDR50	2
+#define SD_SWITCH_FUNC_SDR104	3
+#define SD_SWITCH_FUNC_DDR50	4
 
 #define OCR_BUSY		0x80000000
 #define OCR_HCS			0x40000000
+#define OCR_S18R		0x01000000	/* Switch to 1.8V signalling */
 #define OCR_VOLTAGE_MASK	0x007FFF80
 #define OCR_ACCESS_MODE		0x60000000
 
@@ -166,6 +201,8 @@
 /*
  * EXT_CSD fields
  */
+#define EXT_CSD_FLUSH_CACHE		32	/* W */
+#define EXT_CSD_CACHE_CTRL		33	/* R/W */
 #define EXT_CSD_ENH_START_ADDR		136	/* R/W */
 #define EXT_CSD_ENH_SIZE_MULT		140	/* R/W */
 #define EXT_CSD_GP_SIZE_MULT		143	/* R/W */
@@ -181,6 +218,7 @@
 #define EXT_CSD_ERASE_GROUP_DEF		175	/* R/W */
 #define EXT_CSD_BOOT_BUS_WIDTH		177
 #define EXT_CSD_PART_CONF		179	/* R/W */
+#define EXT_CSD_ERASED_MEM_CONT		181	/* RO */
 #define EXT_CSD_BUS_WIDTH		183	/* R/W */
 #define EXT_CSD_HS_TIMING		185	/* R/W */
 #define EXT_CSD_REV			192	/* RO */
@@ -189,6 +227,7 @@
 #define EXT_CSD_HC_WP_GRP_SIZE		221	/* RO */
 #define EXT_CSD_HC_ERASE_GRP_SIZE	224	/* RO */
 #define EXT_CSD_BOOT_MULT		226	/* RO */
+#define EXT_CSD_CACHE_SIZE		249	/* RO, 4 bytes */
 #define EXT_CSD_BKOPS_SUPPORT		502	/* RO */
 
 /*
@@ -205,6 +244,15 @@
 #define EXT_CSD_CARD_TYPE_DDR_1_2V	(1 << 3)
 #define EXT_CSD_CARD_TYPE_DDR_52	(EXT_CSD_CARD_TYPE_DDR_1_8V \
 					| EXT_CSD_CARD_TYPE_DDR_1_2V)
+#define EXT_CSD_CARD_TYPE_HS200_1_8V	(1 << 4)	/* 200MHz at 1.8V */
+#define EXT_CSD_CARD_TYPE_HS200_1_2V	(1 << 5)
+#define EXT_CSD_CARD_TYPE_HS400_1_8V	(1 << 6)	/* 200MHz DDR at 1.8V */
+#define EXT_CSD_CARD_TYPE_HS400_1_2V	(1 << 7)
+
+#define EXT_CSD_TIMING_LEGACY	0	/* Backwards compatible timing */
+#define EXT_CSD_TIMING_HS	1	/* High speed */
+#define EXT_CSD_TIMING_HS200	2
+#define EXT_CSD_TIMING_HS400	3
 
 #define EXT_CSD_BUS_WIDTH_1	0	/* Card is in 1 bit mode */
 #define EXT_CSD_BUS_WIDTH_4	1	/* Card is in 4 bit mode */
@@ -361,6 +409,31 @@ struct dm_mmc_ops {
 	 * @return 0 if write-enabled, 1 if write-protected, -ve on error
 	 */
 	int (*get_wp)(struct udevice *dev);
+
+	/**
+	 * execute_tuning() - Find the sampling point for the card's data
+	 *
+	 * This is called once the card and host have switched to a bus mode
+	 * which needs tuning: SD SDR50 and SDR104, and eMMC HS200. Hosts
+	 * with a fixed sampling point can leave it NULL.
+	 *
+	 * @dev:	Device to tune
+	 * @opcode:	Command which makes the card send a tuning block
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*execute_tuning)(struct udevice *dev, uint opcode);
+
+	/**
+	 * card_busy() - See whether the card holds DAT[3:0] low
+	 *
+	 * This is used to follow the card through a switch to 1.8V
+	 * signalling. Hosts which cannot see the data lines can leave it
+	 * NULL.
+	 *
+	 * @dev:	Device to check
+	 * @return 1 if any data line is low, 0 if not, -ve on error
+	 */
+	int (*card_busy)(struct udevice *dev);
 };
 
 #define mmc_get_ops(dev)        ((struct dm_mmc_ops *)(dev)->driver->ops)
@@ -370,11 +443,15 @@ int dm_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 int dm_mmc_set_ios(struct udevice *dev);
 int dm_mmc_get_cd(struct udevice *dev);
 int dm_mmc_get_wp(struct udevice *dev);
+int dm_mmc_execute_tuning(struct udevice *dev, uint opcode);
+int dm_mmc_card_busy(struct udevice *dev);
 
 /* Transition functions for compatibility */
 int mmc_set_ios(struct mmc *mmc);
 int mmc_getcd(struct mmc *mmc);
 int mmc_getwp(struct mmc *mmc);
+int mmc_execute_tuning(struct mmc *mmc, uint opcode);
+int mmc_card_busy(struct mmc *mmc);
 
 #else
 struct mmc_ops {
@@ -384,6 +461,8 @@ struct mmc_ops {
 	int (*init)(struct mmc *mmc);
 	int (*getcd)(struct mmc *mmc);
 	int (*getwp)(struct mmc *mmc);
+	int (*execute_tuning)(struct mmc *mmc, uint opcode);
+	int (*card_busy)(struct mmc *mmc);
 };
 #endif
 
@@ -435,10 +514,13 @@ struct mmc {
 	u8 part_attr;
 	u8 wr_rel_set;
 	u8 part_config;
+	bool cache_on;		/* eMMC volatile cache is enabled */
+	bool cache_dirty;	/* written since the cache was last flushed */
 	uint tran_speed;
 	uint read_bl_len;
 	uint write_bl_len;
 	uint erase_grp_size;	/* in 512-byte sectors */
+	int erased_byte;	/* what erased bytes read as, -1 if unknown */
 	uint hc_wp_grp_size;	/* in 512-byte sectors */
 	struct sd_ssr	ssr;	/* SD status register */
 	u64 capacity;
@@ -455,8 +537,19 @@ struct mmc {
 	char init_in_progress;	/* 1 if we have done mmc_start_init() */
 	char preinit;		/* start init as early as possible */
 	int ddr_mode;
+	uint timing;		/* MMC_TIMING_... */
+	uint signal_voltage;	/* MMC_SIGNAL_VOLTAGE_... */
+	bool clk_disable;	/* true to stop the SD clock */
+	bool uhs_failed;	/* the switch to 1.8V failed, stay at 3.3V */
+	/* What was found out about the card, to quickly set it up again */
+	bool id_cached;		/* true if the fields below are valid */
+	uint cached_caps;	/* card_caps, not restricted by the host */
+	uint cached_version;
+	u8 cached_bus_width;	/* EXT_CSD_BUS_WIDTH value which worked */
 #if CONFIG_IS_ENABLED(DM_MMC)
 	struct udevice *dev;	/* Device for this MMC controller */
+	struct udevice *vqmmc_supply;	/* I/O voltage regulator, or NULL */
+	struct udevice *vmmc_supply;	/* Card power regulator, or NULL */
 #endif
 };
 
@@ -551,6 +644,36 @@ int mmc_rpmb_write(struct mmc *mmc, void *addr, unsigned short blk,
 int mmc_set_bkops_enable(struct mmc *mmc);
 #endif
 
+#ifdef CONFIG_MMC_CACHE
+/**
+ * mmc_flush_cache() - Write an eMMC's volatile cache out to the flash
+ *
+ * This does nothing unless the cache is on and has been written to since
+ * the last flush.
+ *
+ * @mmc:	MMC device to flush
+ * @return 0 if OK, -ve on error
+ */
+int mmc_flush_cache(struct mmc *mmc);
+
+/**
+ * mmc_flush_all_caches() - Flush the volatile cache of every MMC device
+ *
+ * This should be called before handing over to an OS or resetting, since
+ * neither knows of what U-Boot left in the caches.
+ */
+void mmc_flush_all_caches(void);
+#else
+static inline int mmc_flush_cache(struct mmc *mmc)
+{
+	return 0;
+}
+
+static inline void mmc_flush_all_caches(void)
+{
+}
+#endif
+
 /**
  * Start device initialization and return immediately; it does not block on
  * polling OCR (operation condition register) status.  Then you should call
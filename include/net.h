@@ -538,7 +538,8 @@ extern int		net_restart_wrap;	/* Tried all network devices */
 
 enum proto_t {
 	BOOTP, RARP, ARP, TFTPGET, DHCP, PING, DNS, NFS, CDP, NETCONS, SNTP,
-	TFTPSRV, TFTPPUT, LINKLOCAL
+	TFTPSRV, TFTPPUT, LINKLOCAL, MDISTSEND, MDISTRECV, PING6, SLAAC,
+	TFTPPROBE
 };
 
 extern char	net_boot_file_name[1024];/* Boot File name */
@@ -676,6 +677,38 @@ int net_send_udp_packet(uchar *ether, struct in_addr dest, int dport,
 /* Processes a received packet */
 void net_process_received_packet(uchar *in_packet, int len);
 
+#ifdef CONFIG_NET_RX_ZEROCOPY
+/**
+ * net_rx_dest_set() - Set where the next in-order payload should be received
+ *
+ * A protocol which knows where the payload of the next expected packet
+ * belongs (e.g. TFTP with the next data block) calls this so that a capable
+ * Ethernet driver can receive the frame with its payload landing directly at
+ * @dest. The @hdr_len bytes in front of @dest are saved when a driver claims
+ * the buffer and are put back once the frame has been processed.
+ *
+ * @dest:	Where the payload should land, or NULL to disable
+ * @len:	Maximum payload length
+ * @hdr_len:	Number of frame header bytes in front of the payload
+ */
+void net_rx_dest_set(void *dest, int len, int hdr_len);
+
+/**
+ * net_rx_dest_claim() - Get a buffer to receive the next frame into
+ *
+ * Called by drivers as they receive a frame, to choose where it goes. Only
+ * one buffer may be claimed at a time, and only for that frame: the claim is
+ * released by the next call to net_process_received_packet(), whether or not
+ * the frame turned out to be the expected one. A driver must therefore not
+ * claim a buffer ahead of time, e.g. when refilling a receive ring.
+ *
+ * @maxlenp:	Returns the maximum frame length which fits the buffer
+ * @return frame buffer to use, or NULL if none is available, in which case
+ *	the driver uses its normal receive buffer
+ */
+uchar *net_rx_dest_claim(int *maxlenp);
+#endif
+
 #ifdef CONFIG_NETCONSOLE
 void nc_start(void);
 int nc_input_packet(uchar *pkt, struct in_addr src_ip, unsigned dest_port,
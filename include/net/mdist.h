@@ -0,0 +1,85 @@
+/*
+ * Multicast/broadcast image distribution
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __MDIST_H__
+#define __MDIST_H__
+
+/* UDP port the distribution stream is sent to */
+#define MDIST_PORT		1758
+/* Identifies an image distribution packet */
+#define MDIST_MAGIC		0x4d445354	/* "MDST" */
+
+/* Packet types */
+#define MDIST_DATA		1
+#define MDIST_PARITY		2
+
+/* Default number of data blocks protected by one parity block */
+#define MDIST_GROUP_SIZE	8
+
+/**
+ * struct mdist_hdr - header in front of every distributed block
+ *
+ * The image is cut into blocks of @block_size bytes. Every @group_size data
+ * blocks are followed by a parity block holding the XOR of those blocks, so
+ * a receiver can recover one lost block per group without asking the sender
+ * for it. The whole stream is repeated a number of times, filling whatever
+ * the parity could not recover.
+ *
+ * @magic:	MDIST_MAGIC
+ * @type:	MDIST_DATA or MDIST_PARITY
+ * @group_size:	Number of data blocks per parity group
+ * @seq:	Block number for data, group number for parity
+ * @file_size:	Size of the whole image in bytes, so images are limited to
+ *		MDIST_FILE_SIZE_MAX
+ * @block_size:	Payload bytes per block (the last block may be shorter)
+ */
+struct mdist_hdr {
+	__be32 magic;
+	__be16 type;
+	__be16 group_size;
+	__be32 seq;
+	__be32 file_size;
+	__be16 block_size;
+	__be16 reserved;
+} __attribute__((packed));
+
+/* Largest image which @file_size can describe */
+#define MDIST_FILE_SIZE_MAX	U32_MAX
+
+/* Largest payload which keeps a packet within a 1500-byte Ethernet MTU */
+#define MDIST_BLOCK_SIZE_MAX	(1500 - IP_UDP_HDR_SIZE - \
+				 sizeof(struct mdist_hdr))
+
+/* Sender settings, filled in by the command before calling net_loop() */
+extern ulong mdist_send_addr;
+extern ulong mdist_send_size;
+extern int mdist_rounds;
+/* Group (multicast or broadcast) address the stream is sent to */
+extern struct in_addr mdist_group_ip;
+
+/**
+ * mdist_fill_packet() - Build the packet at a given position in the stream
+ *
+ * The stream consists of groups of @group_size data packets, each group
+ * followed by its parity packet.
+ *
+ * @pkt:	Buffer for the header and payload
+ * @addr:	Address of the image
+ * @size:	Size of the image in bytes
+ * @block_size:	Payload bytes per block
+ * @group_size:	Data blocks per parity group
+ * @index:	Position within the stream
+ * @return number of bytes written to @pkt, 0 if there is no packet at this
+ *	position (the last group may be short), -ENOENT if @index is past the
+ *	end of the stream
+ */
+int mdist_fill_packet(uchar *pkt, ulong addr, ulong size, int block_size,
+		      int group_size, uint index);
+
+void mdist_send_start(void);	/* Begin sending the image */
+void mdist_recv_start(void);	/* Begin receiving an image */
+
+#endif /* __MDIST_H__ */
@@ -22,6 +22,22 @@ void tftp_start(enum proto_t protocol);	/* Begin TFTP get/put */
 void tftp_start_server(void);	/* Wait for incoming TFTP put */
 #endif
 
+#ifdef CONFIG_CMD_PXE_PARALLEL
+/* Largest number of files tftp_probe_start() looks for at once */
+#define TFTP_PROBE_MAX	16
+
+/*
+ * Files to look for, most wanted first, filled in by the caller before
+ * calling net_loop(TFTPPROBE). On success tftp_probe_found is the index of
+ * the first file in the list that the server has, else it is -1.
+ */
+extern const char *tftp_probe_names[TFTP_PROBE_MAX];
+extern int tftp_probe_count;
+extern int tftp_probe_found;
+
+void tftp_probe_start(void);	/* Request all the files at once */
+#endif
+
 extern ulong tftp_timeout_ms;
 extern int tftp_timeout_count_max;
 
@@ -0,0 +1,359 @@
+/*
+ * IPv6 support for the network stack
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __NET6_H__
+#define __NET6_H__
+
+#include <net.h>
+
+/* IPv6 addresses are 128 bits in size */
+struct in6_addr {
+	union {
+		u8	u6_addr8[16];
+		__be16	u6_addr16[8];
+		__be32	u6_addr32[4];
+	} in6_u;
+#define s6_addr		in6_u.u6_addr8
+#define s6_addr16	in6_u.u6_addr16
+#define s6_addr32	in6_u.u6_addr32
+};
+
+/* Size of an IPv6 address in bytes */
+#define IN6ADDRSZ	sizeof(struct in6_addr)
+
+/*
+ *	IPv6 header
+ */
+struct ip6_hdr {
+	__be32		ip6_flow;	/* version, traffic class, flow label */
+	__be16		payload_len;	/* length after this header */
+	u8		nexthdr;	/* next header */
+	u8		hop_limit;	/* hop limit */
+	struct in6_addr	saddr;		/* source address */
+	struct in6_addr	daddr;		/* destination address */
+} __attribute__((packed));
+
+#define IP6_HDR_SIZE		(sizeof(struct ip6_hdr))
+#define IP6_VERSION		6
+#define IP6_HOP_LIMIT		64
+/* Neighbor discovery messages must only come from the local link */
+#define IP6_ND_HOP_LIMIT	255
+
+/*
+ *	UDP header as used with IPv6
+ */
+struct udp_hdr {
+	__be16		udp_src;	/* UDP source port */
+	__be16		udp_dst;	/* UDP destination port */
+	__be16		udp_len;	/* Length of UDP packet */
+	__be16		udp_xsum;	/* Checksum */
+} __attribute__((packed));
+
+#define IP6_UDP_HDR_SIZE	(IP6_HDR_SIZE + sizeof(struct udp_hdr))
+
+/* Next header values */
+#define IPPROTO_ICMPV6		58
+
+/*
+ *	ICMPv6 header
+ */
+struct icmp6_hdr {
+	u8	icmp6_type;
+	u8	icmp6_code;
+	__be16	icmp6_cksum;
+	union {
+		__be32	un_data32;
+		struct {
+			__be16	id;
+			__be16	sequence;
+		} echo;
+		struct {
+			__be32	flags;	/* router, solicited, override */
+		} na;
+		struct {
+			u8	hop_limit;
+			u8	flags;
+			__be16	router_lifetime;
+		} ra;
+	} icmp6_dataun;
+} __attribute__((packed));
+
+#define ICMP6_HDR_SIZE		(sizeof(struct icmp6_hdr))
+
+/* ICMPv6 types */
+#define ICMPV6_ECHO_REQUEST	128
+#define ICMPV6_ECHO_REPLY	129
+#define ICMPV6_ROUTER_SOLICIT	133
+#define ICMPV6_ROUTER_ADVERT	134
+#define ICMPV6_NEIGHBOR_SOLICIT	135
+#define ICMPV6_NEIGHBOR_ADVERT	136
+
+/* Neighbor advertisement flags */
+#define ND_NA_FLAG_ROUTER	0x80000000
+#define ND_NA_FLAG_SOLICITED	0x40000000
+#define ND_NA_FLAG_OVERRIDE	0x20000000
+
+/* Neighbor discovery option types */
+#define ND_OPT_SOURCE_LL_ADDR	1
+#define ND_OPT_TARGET_LL_ADDR	2
+#define ND_OPT_PREFIX_INFO	3
+
+/* Prefix information flags */
+#define ND_PREFIX_FLAG_ONLINK	0x80
+#define ND_PREFIX_FLAG_AUTO	0x40
+
+/*
+ *	Neighbor solicitation/advertisement message
+ */
+struct nd_msg {
+	struct icmp6_hdr	icmph;
+	struct in6_addr		target;
+	u8			opt[0];
+} __attribute__((packed));
+
+/*
+ *	Router solicitation message
+ */
+struct rs_msg {
+	struct icmp6_hdr	icmph;
+	u8			opt[0];
+} __attribute__((packed));
+
+/*
+ *	Router advertisement message
+ */
+struct ra_msg {
+	struct icmp6_hdr	icmph;
+	__be32			reachable_time;
+	__be32			retrans_timer;
+	u8			opt[0];
+} __attribute__((packed));
+
+/*
+ *	Prefix information option (in router advertisements)
+ */
+struct nd_opt_prefix_info {
+	u8		type;
+	u8		len;		/* in units of 8 bytes */
+	u8		prefix_len;
+	u8		flags;
+	__be32		valid_lifetime;
+	__be32		preferred_lifetime;
+	__be32		reserved;
+	struct in6_addr	prefix;
+} __attribute__((packed));
+
+/* Source/target link-layer address option, padded to 8 bytes */
+#define ND_OPT_LL_ADDR_SIZE	8
+
+extern struct in6_addr net_ip6;		/* Our global IPv6 address */
+extern struct in6_addr net_link_local_ip6;	/* Our link-local address */
+extern u32 net_prefix_length;		/* Our prefix length (0 = unknown) */
+extern struct in6_addr net_gateway6;	/* Our gateway's IPv6 address */
+extern struct in6_addr net_server_ip6;	/* Server IPv6 address */
+extern struct in6_addr net_ping_ip6;	/* The address to ping */
+#ifdef CONFIG_IPV6
+extern bool net_use_ip6;		/* Use IPv6 for the next transfer */
+#else
+#define net_use_ip6		false
+#endif
+
+/* Solicited-node multicast prefix, ff02::1:ff00:0/104 */
+#define IP6_SNMA_PREFIX_LEN	104
+
+static inline bool ip6_is_unspecified(const struct in6_addr *addr)
+{
+	return !(addr->s6_addr32[0] | addr->s6_addr32[1] |
+		 addr->s6_addr32[2] | addr->s6_addr32[3]);
+}
+
+static inline bool ip6_is_our_addr(const struct in6_addr *addr)
+{
+	return !memcmp(addr, &net_link_local_ip6, IN6ADDRSZ) ||
+	       !memcmp(addr, &net_ip6, IN6ADDRSZ);
+}
+
+static inline bool ip6_is_link_local(const struct in6_addr *addr)
+{
+	return addr->s6_addr[0] == 0xfe && (addr->s6_addr[1] & 0xc0) == 0x80;
+}
+
+static inline bool ip6_is_multicast(const struct in6_addr *addr)
+{
+	return addr->s6_addr[0] == 0xff;
+}
+
+/*
+ * Copy an IPv6 address, which need not be aligned. Use this rather than
+ * taking the address of one inside a (packed) packet header.
+ */
+static inline void net_copy_ip6(void *to, const void *from)
+{
+	memcpy(to, from, IN6ADDRSZ);
+}
+
+/**
+ * An incoming UDP over IPv6 packet handler, the IPv6 form of rxhand_f
+ * @param pkt    pointer to the application packet
+ * @param dport  destination UDP port
+ * @param sip    source IPv6 address
+ * @param sport  source UDP port
+ * @param len    packet length
+ */
+typedef void rxhand6_f(uchar *pkt, unsigned dport,
+		       const struct in6_addr *sip, unsigned sport,
+		       unsigned len);
+
+/**
+ * string_to_ip6() - Convert a text IPv6 address into binary form
+ *
+ * Accepts the usual forms including "::" for a run of zero groups. An
+ * optional "/prefix" suffix is parsed into @prefix_len if not NULL.
+ *
+ * @s:		String to convert
+ * @addr:	Returns the address
+ * @prefix_len:	Returns the prefix length, 0 if none given (may be NULL)
+ * @return 0 if OK, -EINVAL if @s is not a valid address
+ */
+int string_to_ip6(const char *s, struct in6_addr *addr, u32 *prefix_len);
+
+/**
+ * ip6_make_lladdr() - Build the link-local address for a MAC address
+ *
+ * @lladdr:	Returns the fe80::/64 address with the EUI-64 interface ID
+ * @enetaddr:	Ethernet MAC address
+ */
+void ip6_make_lladdr(struct in6_addr *lladdr, const u8 enetaddr[ARP_HLEN]);
+
+/**
+ * ip6_make_snma() - Build the solicited-node multicast address of an address
+ *
+ * @mcast:	Returns ff02::1:ffXX:XXXX
+ * @addr:	Address to solicit
+ */
+void ip6_make_snma(struct in6_addr *mcast, const struct in6_addr *addr);
+
+/**
+ * ip6_make_mult_ethdstaddr() - Get the Ethernet address of a multicast group
+ *
+ * @enetaddr:	Returns 33:33:XX:XX:XX:XX
+ * @mcast:	IPv6 multicast address
+ */
+void ip6_make_mult_ethdstaddr(u8 enetaddr[ARP_HLEN],
+			      const struct in6_addr *mcast);
+
+/**
+ * ip6_addr_in_subnet() - Check whether two addresses share a prefix
+ *
+ * @our:	Our address
+ * @neigh:	Address to check
+ * @prefix_len:	Prefix length in bits
+ * @return true if the first @prefix_len bits match
+ */
+bool ip6_addr_in_subnet(const struct in6_addr *our,
+			const struct in6_addr *neigh, u32 prefix_len);
+
+/**
+ * net_ip6_checksum() - Compute an upper layer checksum over IPv6
+ *
+ * The sum covers the IPv6 pseudo-header and the payload. When run over a
+ * received packet, including its checksum field, the result is 0 if the
+ * checksum is correct.
+ *
+ * @saddr:	Source address
+ * @daddr:	Destination address
+ * @len:	Length of the payload
+ * @proto:	Upper layer protocol (next header)
+ * @payload:	Upper layer header and data
+ * @return checksum in network byte order
+ */
+__be16 net_ip6_checksum(const struct in6_addr *saddr,
+			const struct in6_addr *daddr, u16 len, u8 proto,
+			const void *payload);
+
+/**
+ * net_ip6_src_for() - Pick the source address to reach a destination
+ *
+ * @dest:	Destination address
+ * @return our global address if we have one and @dest is not link-local,
+ *	else our link-local address
+ */
+const struct in6_addr *net_ip6_src_for(const struct in6_addr *dest);
+
+/**
+ * net_set_ip6_header() - Fill in an IPv6 header
+ *
+ * @pkt:	Where the header goes
+ * @src:	Source address
+ * @dest:	Destination address
+ * @nextheader:	Upper layer protocol
+ * @hop_limit:	Hop limit
+ * @payload_len: Length of the data following the header
+ */
+void net_set_ip6_header(uchar *pkt, const struct in6_addr *src,
+			const struct in6_addr *dest, u8 nextheader,
+			u8 hop_limit, int payload_len);
+
+/**
+ * net_send_ip6_packet() - Send the IPv6 packet prepared in net_tx_packet
+ *
+ * The IPv6 header and payload must already be in place after room for the
+ * Ethernet header. If @ether is unknown (all zeros) the neighbor cache is
+ * consulted and, on a miss, a neighbor solicitation is sent and the packet
+ * waits for the answer, much like ARP does for IPv4. @ether is then updated
+ * with the resolved address for use by later packets.
+ *
+ * @ether:	Destination MAC address, all zeros if not known yet
+ * @dest:	Destination IPv6 address
+ * @len:	Length of the IPv6 header and payload
+ * @return 0 if sent, 1 if waiting for neighbor discovery
+ */
+int net_send_ip6_packet(uchar *ether, const struct in6_addr *dest, int len);
+
+/**
+ * net_send_udp_packet6() - Send a UDP packet over IPv6
+ *
+ * The payload must be in place at net_tx_packet + net_eth_hdr_size() +
+ * IP6_UDP_HDR_SIZE.
+ *
+ * @ether:	Destination MAC address, all zeros if not known yet
+ * @dest:	Destination IPv6 address
+ * @dport:	Destination UDP port
+ * @sport:	Source UDP port
+ * @len:	Length of the UDP payload
+ * @return 0 if sent, 1 if waiting for neighbor discovery
+ */
+int net_send_udp_packet6(uchar *ether, const struct in6_addr *dest, int dport,
+			 int sport, int len);
+
+/**
+ * net_ip6_handler() - Process a received IPv6 packet
+ *
+ * @et:		Ethernet header of the packet
+ * @ip6:	IPv6 header of the packet
+ * @len:	Length of the packet from the IPv6 header on
+ */
+void net_ip6_handler(struct ethernet_hdr *et, struct ip6_hdr *ip6, int len);
+
+/**
+ * net_set_udp6_handler() - Set the handler for UDP packets received over IPv6
+ *
+ * UDP over IPv6 is not passed to the IPv4 handler set with
+ * net_set_udp_handler(). Packets are dropped while no handler is set.
+ *
+ * @f:		Handler, or NULL for none
+ */
+void net_set_udp6_handler(rxhand6_f *f);
+
+/* Set up our link-local address and neighbor discovery for a new net_loop */
+void net_ip6_init(void);
+
+#ifdef CONFIG_CMD_PING6
+void ping6_start(void);
+void ping6_receive(struct ethernet_hdr *et, struct ip6_hdr *ip6, int len);
+#endif
+
+#endif /* __NET6_H__ */
@@ -64,6 +64,7 @@
 #define  SDHCI_CARD_STATE_STABLE	BIT(17)
 #define  SDHCI_CARD_DETECT_PIN_LEVEL	BIT(18)
 #define  SDHCI_WRITE_PROTECT	BIT(19)
+#define  SDHCI_DATA_LVL_MASK	0x00f00000
 
 #define SDHCI_HOST_CONTROL	0x28
 #define  SDHCI_CTRL_LED		BIT(0)
@@ -145,7 +146,17 @@
 
 #define SDHCI_ACMD12_ERR	0x3C
 
-/* 3E-3F reserved */
+#define SDHCI_HOST_CONTROL2	0x3E
+#define  SDHCI_CTRL_UHS_MASK	0x0007
+#define   SDHCI_CTRL_UHS_SDR12	0x0000
+#define   SDHCI_CTRL_UHS_SDR25	0x0001
+#define   SDHCI_CTRL_UHS_SDR50	0x0002
+#define   SDHCI_CTRL_UHS_SDR104	0x0003
+#define   SDHCI_CTRL_UHS_DDR50	0x0004
+#define   SDHCI_CTRL_HS400	0x0005 /* Non-standard */
+#define  SDHCI_CTRL_VDD_180	0x0008
+#define  SDHCI_CTRL_EXEC_TUNING	0x0040
+#define  SDHCI_CTRL_TUNED_CLK	0x0080
 
 #define SDHCI_CAPABILITIES	0x40
 #define  SDHCI_TIMEOUT_CLK_MASK	0x0000003F
@@ -167,6 +178,10 @@
 #define  SDHCI_CAN_64BIT	BIT(28)
 
 #define SDHCI_CAPABILITIES_1	0x44
+#define  SDHCI_SUPPORT_SDR50	0x00000001
+#define  SDHCI_SUPPORT_SDR104	0x00000002
+#define  SDHCI_SUPPORT_DDR50	0x00000004
+#define  SDHCI_USE_SDR50_TUNING	0x00002000
 #define  SDHCI_CLOCK_MUL_MASK	0x00FF0000
 #define  SDHCI_CLOCK_MUL_SHIFT	16
 
@@ -182,6 +197,7 @@
 /* 55-57 reserved */
 
 #define SDHCI_ADMA_ADDRESS	0x58
+#define SDHCI_ADMA_ADDRESS_HI	0x5C
 
 /* 60-FB reserved */
 
@@ -224,6 +240,39 @@ struct sdhci_host;
  */
 #define SDHCI_DEFAULT_BOUNDARY_SIZE	(512 * 1024)
 #define SDHCI_DEFAULT_BOUNDARY_ARG	(7)
+
+/*
+ * ADMA2 descriptor, see section 1.13 of the SD Host Controller Simplified
+ * Specification Version 3.00. 32-bit descriptors end after addr_lo.
+ */
+struct sdhci_adma_desc {
+	u8	attr;
+	u8	reserved;
+	__le16	len;
+	__le32	addr_lo;
+	__le32	addr_hi;
+} __packed;
+
+#define ADMA_DESC_ATTR_VALID		BIT(0)
+#define ADMA_DESC_ATTR_END		BIT(1)
+#define ADMA_DESC_ATTR_INT		BIT(2)
+#define ADMA_DESC_ATTR_ACT_MASK		(3 << 4)
+#define ADMA_DESC_TRANSFER_DATA		(2 << 4)
+
+#define ADMA_DESC_LEN_32		8
+#define ADMA_DESC_LEN_64		12
+/* ADMA2 addresses must be 32-bit aligned */
+#define ADMA_ADDR_ALIGN			4
+/* Largest length of one descriptor that keeps the next address aligned */
+#define ADMA_MAX_LEN			65532
+/* The block count register limits one transfer to this many blocks */
+#define SDHCI_ADMA_MAX_BLOCKS		65535
+/* One descriptor per ADMA_MAX_LEN, plus one for an unaligned head */
+#define ADMA_TABLE_NUM_ENTRIES	\
+	(DIV_ROUND_UP(SDHCI_ADMA_MAX_BLOCKS * MMC_MAX_BLOCK_LEN, ADMA_MAX_LEN) + 1)
+#define ADMA_TABLE_SZ	\
+	ALIGN(ADMA_TABLE_NUM_ENTRIES * ADMA_DESC_LEN_64, ARCH_DMA_MINALIGN)
+
 struct sdhci_ops {
 #ifdef CONFIG_MMC_SDHCI_IO_ACCESSORS
 	u32	(*read_l)(struct sdhci_host *host, int reg);
@@ -259,6 +308,13 @@ struct sdhci_host {
 	uint	voltages;
 
 	struct mmc_config cfg;
+	unsigned int flags;
+#define USE_SDMA	BIT(0)
+#define USE_ADMA	BIT(1)
+#define USE_ADMA64	BIT(2)
+	void *adma_desc_table;	/* ADMA2 descriptors, ADMA_TABLE_SZ bytes */
+	u8 *adma_align;		/* Holds the unaligned head of a buffer */
+	int adma_head;		/* Bytes of the current transfer in adma_align */
 };
 
 #ifdef CONFIG_MMC_SDHCI_IO_ACCESSORS
@@ -29,6 +29,7 @@
 #define SPI_RX_SLOW	BIT(11)			/* receive with 1 wire slow */
 #define SPI_RX_DUAL	BIT(12)			/* receive with 2 wires */
 #define SPI_RX_QUAD	BIT(13)			/* receive with 4 wires */
+#define SPI_RX_DTR	BIT(14)			/* receive on both edges */
 
 /* Header byte that marks the start of the message */
 #define SPI_PREAMBLE_END_BYTE	0xec
@@ -114,6 +115,45 @@ struct spi_slave {
 #define SPI_XFER_MMAP_END	BIT(3)	/* Memory Mapped End */
 };
 
+/**
+ * struct spi_flash_read_op - A SPI flash read command
+ *
+ * This describes how a read command goes out on the bus, so that a controller
+ * can run it without knowing about the command set of the flash.
+ *
+ * @opcode:	Read command
+ * @addr_len:	Number of address bytes
+ * @dummy:	Number of dummy clock cycles after the address, including any
+ *		mode bits (which are sent as 0)
+ * @cmd_width:	Number of wires used for the command (1, 2 or 4)
+ * @addr_width:	Number of wires used for the address and dummy cycles
+ * @data_width:	Number of wires used for the data
+ * @dtr:	true if the address and data are sent on both clock edges
+ */
+struct spi_flash_read_op {
+	u8 opcode;
+	u8 addr_len;
+	u8 dummy;
+	u8 cmd_width;
+	u8 addr_width;
+	u8 data_width;
+	bool dtr;
+};
+
+/**
+ * spi_flash_read_dummy_bytes() - Get the number of dummy bytes for a read
+ *
+ * When a read command is sent as a byte stream, this many bytes follow the
+ * address to make up the dummy cycles.
+ *
+ * @op:		Read command
+ * @return number of dummy bytes
+ */
+static inline int spi_flash_read_dummy_bytes(const struct spi_flash_read_op *op)
+{
+	return op->dummy * op->addr_width * (op->dtr ? 2 : 1) / 8;
+}
+
 /**
  * Initialization, must be called once on start up.
  *
@@ -464,6 +504,26 @@ struct dm_spi_ops {
 	 *	   is invalid, other -ve value on error
 	 */
 	int (*cs_info)(struct udevice *bus, uint cs, struct spi_cs_info *info);
+
+	/**
+	 * Read from a SPI flash without programmed I/O (optional)
+	 *
+	 * Controllers with a direct-mapped flash window or a DMA engine
+	 * provide this, so that large flash ranges can be read at the full
+	 * bus rate. The bus is claimed by the caller. Since @op gives the
+	 * number of wires for each phase, this is also the only way to use
+	 * read commands which send the address on several wires.
+	 *
+	 * @dev:	The SPI slave (the flash)
+	 * @op:		Read command to use
+	 * @offset:	Flash address to read from
+	 * @len:	Number of bytes to read
+	 * @buf:	Buffer to read into
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*flash_read)(struct udevice *dev,
+			  const struct spi_flash_read_op *op, u32 offset,
+			  size_t len, void *buf);
 };
 
 struct dm_spi_emul_ops {
@@ -651,6 +711,30 @@ void dm_spi_release_bus(struct udevice *dev);
 int dm_spi_xfer(struct udevice *dev, unsigned int bitlen,
 		const void *dout, void *din, unsigned long flags);
 
+/**
+ * dm_spi_can_flash_read() - Check whether a slave's bus has flash_read()
+ *
+ * @dev:	The SPI slave device
+ * @return true if dm_spi_flash_read() can be used
+ */
+bool dm_spi_can_flash_read(struct udevice *dev);
+
+/**
+ * dm_spi_flash_read() - Read from a SPI flash without programmed I/O
+ *
+ * See flash_read() in struct dm_spi_ops. The bus must already be claimed.
+ *
+ * @dev:	The SPI slave device (the flash)
+ * @op:		Read command to use
+ * @offset:	Flash address to read from
+ * @len:	Number of bytes to read
+ * @buf:	Buffer to read into
+ * @return 0 if OK, -EOPNOTSUPP if the bus has no flash_read(), other -ve on
+ *	error
+ */
+int dm_spi_flash_read(struct udevice *dev, const struct spi_flash_read_op *op,
+		      u32 offset, size_t len, void *buf);
+
 /* Access the operations for a SPI device */
 #define spi_get_ops(dev)	((struct dm_spi_ops *)(dev)->driver->ops)
 #define spi_emul_get_ops(dev)	((struct dm_spi_emul_ops *)(dev)->driver->ops)
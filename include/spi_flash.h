@@ -11,6 +11,7 @@
 #define _SPI_FLASH_H_
 
 #include <dm.h>	/* Because we dereference struct udevice here */
+#include <spi.h>
 #include <linux/types.h>
 
 #ifndef CONFIG_SF_DEFAULT_SPEED
@@ -28,6 +29,21 @@
 
 struct spi_slave;
 
+/*
+ * Read modes, named after the number of wires used for the command, address
+ * and data. They are in order of preference, fastest last.
+ */
+enum spi_flash_read_mode {
+	SPI_FLASH_READ_1_1_1,
+	SPI_FLASH_READ_1_1_2,
+	SPI_FLASH_READ_1_2_2,
+	SPI_FLASH_READ_1_1_4,
+	SPI_FLASH_READ_1_4_4,
+	SPI_FLASH_READ_1_4_4_DTR,
+
+	SPI_FLASH_READ_MODES,
+};
+
 /**
  * struct spi_flash - SPI flash structure
  *
@@ -48,6 +64,9 @@ struct spi_slave;
  * @read_cmd:		Read cmd - Array Fast, Extn read and quad read.
  * @write_cmd:		Write cmd - page and quad program.
  * @dummy_byte:		Dummy cycles for read operation.
+ * @read_modes:		Read modes usable on this bus, one bit per mode
+ * @read_mode:		Read mode in use
+ * @read_ops:		Read command for each supported read mode
  * @memory_map:		Address of read-only SPI flash access
  * @flash_lock:		lock a region of the SPI Flash
  * @flash_unlock:	unlock a region of the SPI Flash
@@ -83,6 +102,9 @@ struct spi_flash {
 	u8 read_cmd;
 	u8 write_cmd;
 	u8 dummy_byte;
+	u16 read_modes;
+	u8 read_mode;
+	struct spi_flash_read_op read_ops[SPI_FLASH_READ_MODES];
 
 	void *memory_map;
 
@@ -186,7 +208,7 @@ static inline int spi_flash_erase(struct spi_flash *flash, u32 offset,
 struct sandbox_state;
 
 int sandbox_sf_bind_emul(struct sandbox_state *state, int busnum, int cs,
-			 struct udevice *bus, int of_offset, const char *spec);
+			 struct udevice *bus, ofnode node, const char *spec);
 
 void sandbox_sf_unbind_emul(struct sandbox_state *state, int busnum, int cs);
 
@@ -227,6 +249,18 @@ static inline int spi_flash_erase(struct spi_flash *flash, u32 offset,
 }
 #endif
 
+/**
+ * spi_flash_set_read_mode() - Select the read mode to use
+ *
+ * This is normally chosen at probe time as the fastest mode supported by
+ * both the flash and the SPI bus, but may be changed, e.g. for testing.
+ *
+ * @flash:	SPI flash
+ * @mode:	Read mode (enum spi_flash_read_mode)
+ * @return 0 if OK, -EINVAL if the mode is not supported
+ */
+int spi_flash_set_read_mode(struct spi_flash *flash, int mode);
+
 static inline int spi_flash_protect(struct spi_flash *flash, u32 ofs, u32 len,
 					bool prot)
 {
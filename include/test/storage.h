@@ -0,0 +1,117 @@
+/*
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __TEST_STORAGE_H__
+#define __TEST_STORAGE_H__
+
+#include <blk.h>
+#include <test/test.h>
+
+/* Declare a new storage test */
+#define STORAGE_TEST(_name, _flags)	UNIT_TEST(_name, _flags, storage_test)
+
+/**
+ * struct ut_ram_blk - RAM-backed storage for tests
+ *
+ * @data:	Contents, from block 0
+ * @blksz:	Block size in bytes
+ * @blocks:	Number of blocks
+ * @reads:	Number of reads
+ * @writes:	Number of writes
+ * @erases:	Number of erases
+ * @erase_blk:	First block of the last erase
+ * @erase_cnt:	Number of blocks in the last erase
+ * @dev:	Block device reading and writing @data, NULL if none
+ */
+struct ut_ram_blk {
+	u8 *data;
+	ulong blksz;
+	lbaint_t blocks;
+	int reads;
+	int writes;
+	int erases;
+	lbaint_t erase_blk;
+	lbaint_t erase_cnt;
+	struct udevice *dev;
+};
+
+/**
+ * ut_ram_blk_init() - allocate RAM-backed storage
+ *
+ * @rb:		Storage to set up
+ * @blksz:	Block size in bytes
+ * @blocks:	Number of blocks
+ * @val:	Byte to fill the storage with
+ * @return 0 if OK, -ENOMEM if there is not enough memory
+ */
+int ut_ram_blk_init(struct ut_ram_blk *rb, ulong blksz, lbaint_t blocks,
+		    int val);
+
+/**
+ * ut_ram_blk_free() - free RAM-backed storage and its block device, if any
+ *
+ * @rb:		Storage to free
+ */
+void ut_ram_blk_free(struct ut_ram_blk *rb);
+
+/**
+ * ut_ram_blk_ptr() - get a pointer to a block of the storage
+ *
+ * @rb:		Storage
+ * @blk:	Block number
+ * @return pointer to the block's contents
+ */
+static inline u8 *ut_ram_blk_ptr(struct ut_ram_blk *rb, lbaint_t blk)
+{
+	return rb->data + blk * rb->blksz;
+}
+
+/**
+ * ut_ram_blk_read() - read blocks from the storage
+ *
+ * @rb:		Storage
+ * @start:	First block to read
+ * @blkcnt:	Number of blocks
+ * @buffer:	Returns the contents
+ * @return number of blocks read, 0 if the range is not inside the storage
+ */
+ulong ut_ram_blk_read(struct ut_ram_blk *rb, lbaint_t start, lbaint_t blkcnt,
+		      void *buffer);
+
+/**
+ * ut_ram_blk_write() - write blocks to the storage
+ *
+ * @rb:		Storage
+ * @start:	First block to write
+ * @blkcnt:	Number of blocks
+ * @buffer:	New contents
+ * @return number of blocks written, 0 if the range is not inside the storage
+ */
+ulong ut_ram_blk_write(struct ut_ram_blk *rb, lbaint_t start,
+		       lbaint_t blkcnt, const void *buffer);
+
+/**
+ * ut_ram_blk_erase() - erase blocks of the storage
+ *
+ * @rb:		Storage
+ * @start:	First block to erase
+ * @blkcnt:	Number of blocks
+ * @val:	Byte which erased storage reads as
+ * @return number of blocks erased, 0 if the range is not inside the storage
+ */
+ulong ut_ram_blk_erase(struct ut_ram_blk *rb, lbaint_t start,
+		       lbaint_t blkcnt, int val);
+
+/**
+ * ut_ram_blk_bind() - add a block device which reads and writes the storage
+ *
+ * The device is removed by ut_ram_blk_free().
+ *
+ * @rb:		Storage
+ * @descp:	Returns the block device's descriptor
+ * @return 0 if OK, -ve on error
+ */
+int ut_ram_blk_bind(struct ut_ram_blk *rb, struct blk_desc **descp);
+
+#endif /* __TEST_STORAGE_H__ */
@@ -0,0 +1,127 @@
+/*
+ * Block-level delta updates
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef _UPDATE_DELTA_H_
+#define _UPDATE_DELTA_H_
+
+#include <part.h>
+#include <u-boot/sha256.h>
+
+/*
+ * A delta turns the contents of a source partition into a new image in a
+ * target partition, as in A/B updates where the running slot is the
+ * source. It is a header followed by operations, each of which produces a
+ * range of target blocks, optionally from a range of source blocks. Only
+ * the blocks which changed need to be carried in the delta.
+ *
+ * All fields are little-endian. Operations are applied in order and may
+ * be at most CONFIG_UPDATE_DELTA_BUF_SIZE bytes long. The source range is
+ * checked against its hash before it is used and the result against its
+ * hash before it is written, so a delta made for another source or a
+ * corrupted one writes nothing wrong.
+ *
+ * The source partition is never written, so an update which is cut short
+ * can carry on from any operation. Progress is kept in the environment.
+ */
+
+#define UPDATE_DELTA_MAGIC	0x544c4455	/* "UDLT" */
+#define UPDATE_DELTA_VERSION	1
+
+/* Environment variable holding the progress of an update */
+#define UPDATE_DELTA_PROGRESS_ENV	"delta_progress"
+
+/**
+ * struct update_delta_header - Header at the start of a delta
+ *
+ * @magic:	UPDATE_DELTA_MAGIC
+ * @version:	UPDATE_DELTA_VERSION
+ * @block_size:	Size of the blocks used by the operations, in bytes. This
+ *		must be a multiple of the block size of the devices.
+ * @op_count:	Number of operations which follow
+ * @src_blocks:	Size of the source needed, in blocks
+ * @dst_blocks:	Size of the new image, in blocks
+ */
+struct update_delta_header {
+	__le32 magic;
+	__le32 version;
+	__le32 block_size;
+	__le32 op_count;
+	__le32 src_blocks;
+	__le32 dst_blocks;
+};
+
+enum update_delta_op_type {
+	DELTA_OP_COPY = 1,	/* copy source blocks */
+	DELTA_OP_DIFF,		/* source blocks with differences added */
+	DELTA_OP_DATA,		/* new data */
+	DELTA_OP_ZERO,		/* zeroes */
+};
+
+/**
+ * struct update_delta_op - An operation producing a range of target blocks
+ *
+ * The operation is followed by @data_len bytes of data. For DELTA_OP_DATA
+ * this is the new contents of the blocks. For DELTA_OP_DIFF it is a list
+ * of runs, each a __le32 offset from the end of the previous run, a
+ * __le32 length and that many bytes to add to the source bytes, as in
+ * bsdiff. Bytes outside the runs are copied from the source unchanged.
+ *
+ * @type:	Operation type (enum update_delta_op_type)
+ * @blocks:	Number of blocks produced
+ * @src_blk:	First source block (DELTA_OP_COPY and DELTA_OP_DIFF)
+ * @dst_blk:	First target block
+ * @data_len:	Number of data bytes following the operation
+ * @src_hash:	SHA256 of the source blocks used, zero if none
+ * @dst_hash:	SHA256 of the blocks produced
+ */
+struct update_delta_op {
+	__le32 type;
+	__le32 blocks;
+	__le32 src_blk;
+	__le32 dst_blk;
+	__le32 data_len;
+	u8 src_hash[SHA256_SUM_LEN];
+	u8 dst_hash[SHA256_SUM_LEN];
+};
+
+/**
+ * update_delta_apply() - Apply a delta from one partition to another
+ *
+ * If UPDATE_DELTA_PROGRESS_ENV records progress through this same delta,
+ * the update carries on from there. The variable is updated and the
+ * environment saved every CONFIG_UPDATE_DELTA_SAVE_INTERVAL operations,
+ * and removed when the update is complete.
+ *
+ * @delta:	Delta in memory
+ * @size:	Size of delta in bytes
+ * @src_desc:	Device holding the source partition
+ * @src:	Source partition, which is only read
+ * @dst_desc:	Device holding the target partition
+ * @dst:	Target partition
+ * @return 0 if OK, -EINVAL if the delta is not valid or does not fit,
+ *	-EILSEQ if the source does not match the delta or the result does
+ *	not match its hash, -EIO on a device error, -ENOMEM if out of memory
+ */
+int update_delta_apply(const void *delta, size_t size,
+		       struct blk_desc *src_desc, disk_partition_t *src,
+		       struct blk_desc *dst_desc, disk_partition_t *dst);
+
+/**
+ * update_delta_fit() - Apply a delta held in a FIT
+ *
+ * The image is checked against its hashes in the FIT first.
+ *
+ * @addr:	Address of the FIT
+ * @name:	Name of the image holding the delta
+ * @ifname:	Interface name of the device, e.g. "mmc"
+ * @src_str:	Source device and partition, e.g. "0:2"
+ * @dst_str:	Target device and partition, e.g. "0:3"
+ * @return 0 if OK, -ve on error
+ */
+int update_delta_fit(ulong addr, const char *name, const char *ifname,
+		     const char *src_str, const char *dst_str);
+
+#endif
@@ -279,6 +279,118 @@ int usb_string(struct usb_device *dev, int index, char *buf, size_t size);
 int usb_set_interface(struct usb_device *dev, int interface, int alternate);
 int usb_get_port_status(struct usb_device *dev, int port, void *data);
 
+/**
+ * struct usb_bulk_req - a bulk transfer which can be queued
+ *
+ * Several of these may be queued on the same or different endpoints with
+ * usb_submit_bulk(). Those on one endpoint complete in the order they were
+ * submitted. The request and its buffer must stay in place until it
+ * completes or is cancelled.
+ *
+ * On an endpoint set up with usb_alloc_streams() each request goes on a
+ * stream. The device picks which stream to move data on next, so requests
+ * on different streams may complete in any order.
+ *
+ * @pipe:	Bulk pipe to use
+ * @stream:	Stream ID, or 0 if the endpoint does not use streams
+ * @buffer:	Data buffer, which should be DMA-aligned
+ * @length:	Number of bytes to transfer
+ * @actual:	Number of bytes transferred, once complete
+ * @status:	0 if OK, -EPIPE if the endpoint stalled, other -ve on error,
+ *		-EINPROGRESS until complete
+ * @done:	true once complete
+ */
+struct usb_bulk_req {
+	unsigned long pipe;
+	unsigned int stream;
+	void *buffer;
+	int length;
+	int actual;
+	int status;
+	bool done;
+};
+
+/**
+ * usb_submit_bulk() - queue a bulk transfer
+ *
+ * With a host controller which cannot queue transfers this does nothing
+ * and the transfer is run by usb_wait_bulk() instead.
+ *
+ * @dev:	USB device
+ * @req:	Request to queue, with @pipe, @stream, @buffer and @length set
+ *		up
+ * @return 0 if OK, -EBUSY if the endpoint's queue is full, other -ve on
+ *	error
+ */
+int usb_submit_bulk(struct usb_device *dev, struct usb_bulk_req *req);
+
+/**
+ * usb_poll_bulk() - complete any queued bulk transfers which have finished
+ *
+ * This does not wait. The controller's completions are all handled in one
+ * go, for all its devices.
+ *
+ * @dev:	USB device
+ * @return number of transfers completed, -ve on error
+ */
+int usb_poll_bulk(struct usb_device *dev);
+
+/**
+ * usb_wait_bulk() - wait for a queued bulk transfer to complete
+ *
+ * If it times out, all transfers queued on the pipe are cancelled.
+ *
+ * @dev:	USB device
+ * @req:	Request to wait for
+ * @timeout:	Timeout in milliseconds
+ * @return @req->status, or -ETIMEDOUT
+ */
+int usb_wait_bulk(struct usb_device *dev, struct usb_bulk_req *req,
+		  int timeout);
+
+/**
+ * usb_cancel_bulk() - cancel the bulk transfers queued on a pipe
+ *
+ * Cancelled requests complete with -ECANCELED.
+ *
+ * @dev:	USB device
+ * @pipe:	Pipe to cancel transfers on
+ * @return 0 if OK, -ve on error
+ */
+int usb_cancel_bulk(struct usb_device *dev, unsigned long pipe);
+
+/**
+ * usb_bulk_req_sync() - run a bulk request synchronously
+ *
+ * This is for host controllers which cannot queue transfers.
+ *
+ * @dev:	USB device
+ * @req:	Request to run
+ * @timeout:	Timeout in milliseconds
+ * @return @req->status
+ */
+int usb_bulk_req_sync(struct usb_device *dev, struct usb_bulk_req *req,
+		      int timeout);
+
+/**
+ * usb_alloc_streams() - set up bulk streams on some endpoints
+ *
+ * USB 3.0 bulk endpoints can carry several streams, each with its own
+ * queue of transfers. The streams stay set up until the device is
+ * configured again. No transfers may be queued on the endpoints while
+ * this is done.
+ *
+ * @dev:	SuperSpeed USB device
+ * @pipes:	Bulk pipes to set up
+ * @num_pipes:	Number of entries in @pipes
+ * @num_streams: Number of streams wanted on each endpoint
+ * @return number of streams set up on each endpoint, using stream IDs 1 to
+ *	this, which may be fewer than @num_streams; -ENOSYS if the host
+ *	controller does not support streams, other -ve on error
+ */
+int usb_alloc_streams(struct usb_device *dev, unsigned long *pipes,
+		      int num_pipes, int num_streams);
+
 /* big endian -> little endian conversion */
 /* some CPUs are already little endian e.g. the ARM920T */
 #define __swap_16(x) \
@@ -786,6 +898,46 @@ struct dm_usb_ops {
 	 * in a USB transfer. USB class driver needs to be aware of this.
 	 */
 	int (*get_max_xfer_size)(struct udevice *bus, size_t *size);
+
+	/**
+	 * submit_bulk() - Queue a bulk transfer
+	 *
+	 * Queue the transfer and return without waiting for it. If this is
+	 * NULL, queued transfers are run one at a time by usb_wait_bulk()
+	 * using bulk().
+	 *
+	 * @req: Request to queue, see struct usb_bulk_req
+	 * @return 0 if OK, -EBUSY if no more can be queued on the endpoint
+	 */
+	int (*submit_bulk)(struct udevice *bus, struct usb_device *udev,
+			   struct usb_bulk_req *req);
+
+	/**
+	 * reap_bulk() - Complete any queued bulk transfers which have finished
+	 *
+	 * This should handle all completions which are ready, for any
+	 * device, and not wait for more.
+	 *
+	 * @return number of transfers completed, -ve on error
+	 */
+	int (*reap_bulk)(struct udevice *bus, struct usb_device *udev);
+
+	/**
+	 * cancel_bulk() - Cancel the bulk transfers queued on a pipe
+	 *
+	 * Each cancelled request is completed with -ECANCELED.
+	 */
+	int (*cancel_bulk)(struct udevice *bus, struct usb_device *udev,
+			   unsigned long pipe);
+
+	/**
+	 * alloc_streams() - Set up bulk streams on some endpoints
+	 *
+	 * See usb_alloc_streams() for details.
+	 */
+	int (*alloc_streams)(struct udevice *bus, struct usb_device *udev,
+			     unsigned long *pipes, int num_pipes,
+			     int num_streams);
 };
 
 #define usb_get_ops(dev)	((struct dm_usb_ops *)(dev)->driver->ops)
@@ -1021,6 +1173,22 @@ int usb_emul_control(struct udevice *emul, struct usb_device *udev,
 int usb_emul_bulk(struct udevice *emul, struct usb_device *udev,
 		  unsigned long pipe, void *buffer, int length);
 
+/**
+ * usb_emul_bulk_req() - Run a queued bulk request on an emulator
+ *
+ * Requests on a stream are passed to the emulator's submit_bulk() method,
+ * which runs them straight away. It returns -EAGAIN if the device is not
+ * ready to move data on that stream yet. Other requests go to bulk().
+ *
+ * @emul:	Emulator device
+ * @udev:	USB device (which the emulator is causing to appear)
+ * @req:	Request to run
+ * @return number of bytes transferred, -EAGAIN to try again later, other
+ *	-ve on error
+ */
+int usb_emul_bulk_req(struct udevice *emul, struct usb_device *udev,
+		      struct usb_bulk_req *req);
+
 /**
  * usb_emul_int() - Send an interrupt packet to an emulator
  *
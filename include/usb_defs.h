@@ -46,6 +46,7 @@
 #define US_PR_CB               1		/* Control/Bulk w/o interrupt */
 #define US_PR_CBI              0		/* Control/Bulk/Interrupt */
 #define US_PR_BULK             0x50		/* bulk only */
+#define US_PR_UAS              0x62		/* USB Attached SCSI */
 
 /* USB types */
 #define USB_TYPE_STANDARD   (0x00 << 5)
@@ -363,4 +364,85 @@ struct umass_bbb_csw {
 #define US_BBB_RESET		0xff
 #define US_BBB_GET_MAX_LUN	0xfe
 
+/*
+ * UAS (USB Attached SCSI)
+ */
+
+/* Pipe usage descriptor, which follows each endpoint of a UAS interface */
+#define USB_DT_PIPE_USAGE	0x24
+struct usb_pipe_usage_descriptor {
+	__u8		bLength;
+	__u8		bDescriptorType;
+	__u8		bPipeID;
+#	define UAS_PIPE_CMD		1
+#	define UAS_PIPE_STATUS		2
+#	define UAS_PIPE_DATA_IN		3
+#	define UAS_PIPE_DATA_OUT	4
+	__u8		Reserved;
+} __packed;
+
+/* Information unit IDs */
+#define UAS_IU_COMMAND		0x01
+#define UAS_IU_SENSE		0x03
+#define UAS_IU_RESPONSE		0x04
+#define UAS_IU_TASK_MGMT	0x05
+#define UAS_IU_READ_READY	0x06
+#define UAS_IU_WRITE_READY	0x07
+
+/* Command IU, sent on the command pipe */
+struct uas_cmd_iu {
+	__u8		iu_id;
+	__u8		rsvd1;
+	__be16		tag;
+	__u8		prio_attr;
+	__u8		rsvd5;
+	__u8		len;		/* additional CDB length, unused */
+	__u8		rsvd7;
+	__u8		lun[8];
+	__u8		cdb[16];
+} __packed;
+
+/* Task management IU, sent on the command pipe */
+struct uas_task_mgmt_iu {
+	__u8		iu_id;
+	__u8		rsvd1;
+	__be16		tag;
+	__u8		function;
+#	define UAS_TMF_ABORT_TASK_SET		0x02
+#	define UAS_TMF_LOGICAL_UNIT_RESET	0x08
+	__u8		rsvd5;
+	__be16		task_tag;
+	__u8		lun[8];
+} __packed;
+
+/* Response IU, ending a task management function on the status pipe */
+struct uas_response_iu {
+	__u8		iu_id;
+	__u8		rsvd1;
+	__be16		tag;
+	__u8		add_response_info[3];
+	__u8		response_code;
+#	define UAS_RC_TMF_COMPLETE		0x00
+#	define UAS_RC_TMF_SUCCEEDED		0x08
+} __packed;
+
+/* Sense IU, ending a command on the status pipe */
+struct uas_sense_iu {
+	__u8		iu_id;
+	__u8		rsvd1;
+	__be16		tag;
+	__be16		status_qual;
+	__u8		status;		/* SCSI status, 0 if good */
+	__u8		rsvd7[7];
+	__be16		len;		/* length of the sense data */
+	__u8		sense[96];
+} __packed;
+
+/* READ READY, WRITE READY and response IUs all start like this */
+struct uas_iu_header {
+	__u8		iu_id;
+	__u8		rsvd1;
+	__be16		tag;
+} __packed;
+
 #endif /*_USB_DEFS_H_ */
@@ -19,14 +19,20 @@
 #define ETH_DATA_LEN	1500		/* Max. octets in payload	 */
 #define ETH_FRAME_LEN	PKTSIZE_ALIGN	/* Max. octets in frame sans FCS */
 
+/* Number of receive buffers, each with a bulk transfer queued */
+#define USB_ETHER_RX_REQS	2
+
 /* TODO(sjg@chromium.org): Remove @pusb_dev when all boards use CONFIG_DM_ETH */
 struct ueth_data {
 	/* eth info */
 #ifdef CONFIG_DM_ETH
-	uint8_t *rxbuf;
+	uint8_t *rxbuf;			/* All the receive buffers */
 	int rxsize;
 	int rxlen;			/* Total bytes available in rxbuf */
 	int rxptr;			/* Current position in rxbuf */
+	struct usb_bulk_req rx_req[USB_ETHER_RX_REQS];
+	unsigned int rx_queued;		/* Bit for each queued rx_req */
+	int rx_cur;			/* rx_req holding the current data */
 #else
 	struct eth_device eth_dev;	/* used with eth_register */
 	/* driver private */
@@ -61,6 +67,8 @@ int usb_ether_register(struct udevice *dev, struct ueth_data *ueth, int rxsize);
 /**
  * usb_ether_deregister() - deregister a USB ethernet device
  *
+ * This cancels any queued receive transfers and frees the receive buffers.
+ *
  * @ueth:	USB Ethernet device
  * @return 0
  */
@@ -78,6 +86,17 @@ int usb_ether_deregister(struct ueth_data *ueth);
  */
 int usb_ether_receive(struct ueth_data *ueth, int rxsize);
 
+/**
+ * usb_ether_stop_rx() - cancel the receive transfers still queued
+ *
+ * Call this when the device is stopped, so that the controller does not
+ * write to the receive buffers after they are freed or reused. Any data not
+ * yet processed is dropped.
+ *
+ * @ueth:	USB Ethernet device
+ */
+void usb_ether_stop_rx(struct ueth_data *ueth);
+
 /**
  * usb_ether_get_rx_bytes() - obtain bytes from the internal packet buffer
  *
@@ -373,14 +373,21 @@ static inline int a_ilog(struct bch_control *bch, unsigned int x)
 
 /*
  * compute 2t syndromes of ecc polynomial, i.e. ecc(a^j) for j=1..2t
+ *
+ * Odd syndromes are computed one ecc byte at a time: syn_tab gives the log
+ * of the value of all 8 bits of a byte, which is then scaled by the power
+ * of a matching the byte position.
  */
 static void compute_syndromes(struct bch_control *bch, uint32_t *ecc,
 			      unsigned int *syn)
 {
-	int i, j, s;
-	unsigned int m;
+	int i, j, k, s;
+	unsigned int m, v, e, step, l;
 	uint32_t poly;
+	const uint16_t *tab;
 	const int t = GF_T(bch);
+	const int words = DIV_ROUND_UP(bch->ecc_bits, 32);
+	const unsigned int pad = 32*words-bch->ecc_bits;
 
 	s = bch->ecc_bits;
 
@@ -388,20 +395,25 @@ static void compute_syndromes(struct bch_control *bch, uint32_t *ecc,
 	m = ((unsigned int)s) & 31;
 	if (m)
 		ecc[s/32] &= ~((1u << (32-m))-1);
-	memset(syn, 0, 2*t*sizeof(*syn));
 
 	/* compute v(a^j) for j=1 .. 2t-1 */
-	do {
-		poly = *ecc++;
-		s -= 32;
-		while (poly) {
-			i = deg(poly);
-			for (j = 0; j < 2*t; j += 2)
-				syn[j] ^= a_pow(bch, (j+1)*(i+s));
-
-			poly ^= (1 << i);
+	for (j = 0; j < 2*t; j += 2) {
+		tab = bch->syn_tab+(j/2)*256;
+		step = modulo(bch, 8*(j+1));
+		/* bit 0 of the last word has degree -pad */
+		e = GF_N(bch)-modulo(bch, (j+1)*pad);
+		v = 0;
+		for (i = words-1; i >= 0; i--) {
+			poly = ecc[i];
+			for (k = 0; k < 32; k += 8) {
+				l = tab[(poly >> k) & 0xff];
+				if (l < GF_N(bch))
+					v ^= bch->a_pow_tab[mod_s(bch, l+e)];
+				e = mod_s(bch, e+step);
+			}
 		}
-	} while (s > 0);
+		syn[j] = v;
+	}
 
 	/* v(a^(2j)) = v(a^j)^2 */
 	for (j = 0; j < t; j++)
@@ -1112,6 +1124,30 @@ static int build_gf_tables(struct bch_control *bch, unsigned int poly)
 	return 0;
 }
 
+/*
+ * compute byte lookup tables for syndrome computation: entry b of table j
+ * is the log of the sum of a^((2j+1)*i) over the bits i set in b, or n if
+ * that sum is zero
+ */
+static void build_syn_tables(struct bch_control *bch)
+{
+	int i, j, b;
+	uint16_t *tab;
+	const int t = GF_T(bch);
+
+	for (j = 0; j < t; j++) {
+		tab = bch->syn_tab+j*256;
+		tab[0] = 0;
+		for (b = 1; b < 256; b++) {
+			i = deg(b & -b);
+			tab[b] = tab[b & (b-1)] ^ a_pow(bch, (2*j+1)*i);
+		}
+		/* convert to log representation */
+		for (b = 0; b < 256; b++)
+			tab[b] = tab[b] ? a_log(bch, tab[b]) : GF_N(bch);
+	}
+}
+
 /*
  * compute generator polynomial remainder tables for fast encoding
  */
@@ -1342,6 +1378,7 @@ struct bch_control *init_bch(int m, int t, unsigned int prim_poly)
 	bch->ecc_buf2  = bch_alloc(words*sizeof(*bch->ecc_buf2), &err);
 	bch->xi_tab    = bch_alloc(m*sizeof(*bch->xi_tab), &err);
 	bch->syn       = bch_alloc(2*t*sizeof(*bch->syn), &err);
+	bch->syn_tab   = bch_alloc(t*256*sizeof(*bch->syn_tab), &err);
 	bch->cache     = bch_alloc(2*t*sizeof(*bch->cache), &err);
 	bch->elp       = bch_alloc((t+1)*sizeof(struct gf_poly_deg1), &err);
 
@@ -1355,6 +1392,8 @@ struct bch_control *init_bch(int m, int t, unsigned int prim_poly)
 	if (err)
 		goto fail;
 
+	build_syn_tables(bch);
+
 	/* use generator polynomial for computing encoding tables */
 	genpoly = compute_generator_polynomial(bch);
 	if (genpoly == NULL)
@@ -1390,6 +1429,7 @@ void free_bch(struct bch_control *bch)
 		kfree(bch->ecc_buf2);
 		kfree(bch->xi_tab);
 		kfree(bch->syn);
+		kfree(bch->syn_tab);
 		kfree(bch->cache);
 		kfree(bch->elp);
 
@@ -81,6 +81,17 @@ int gunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp)
 }
 
 #ifdef CONFIG_CMD_UNZIP
+/* Time gzwrite() started, for reporting the throughput */
+static ulong gzwrite_start;
+
+/* Average rate of uncompressed data since gzwrite() started, in KiB/s */
+static ulong gzwrite_rate(u64 bytes)
+{
+	ulong ms = get_timer(gzwrite_start);
+
+	return ms ? lldiv(bytes * 1000, ms) >> 10 : 0;
+}
+
 __weak
 void gzwrite_progress_init(u64 expectedsize)
 {
@@ -93,7 +104,8 @@ void gzwrite_progress(int iteration,
 		     u64 total_bytes)
 {
 	if (0 == (iteration & 3))
-		printf("%llu/%llu\r", bytes_written, total_bytes);
+		printf("%llu/%llu, %lu KiB/s\r", bytes_written, total_bytes,
+		       gzwrite_rate(bytes_written));
 }
 
 __weak
@@ -104,8 +116,8 @@ void gzwrite_progress_finish(int returnval,
 			     u32 calculated_crc)
 {
 	if (0 == returnval) {
-		printf("\n\t%llu bytes, crc 0x%08x\n",
-		       total_bytes, calculated_crc);
+		printf("\n\t%llu bytes, crc 0x%08x, %lu KiB/s\n",
+		       total_bytes, calculated_crc, gzwrite_rate(total_bytes));
 	} else {
 		printf("\n\tuncompressed %llu of %llu\n"
 		       "\tcrcs == 0x%08x/0x%08x\n",
@@ -190,6 +202,7 @@ int gzwrite(unsigned char *src, int len,
 		return -1;
 	}
 
+	gzwrite_start = get_timer(0);
 	gzwrite_progress_init(szexpected);
 
 	s.zalloc = gzalloc;
@@ -245,8 +258,15 @@ int gzwrite(unsigned char *src, int len,
 			blocks_written = blk_dwrite(dev, outblock,
 						    writeblocks, writebuf);
 			outblock += blocks_written;
+			if (blocks_written != writeblocks) {
+				printf("\n%s: write failed at block " LBAFU
+				       "\n", __func__, outblock);
+				r = -1;
+				goto out;
+			}
 			if (ctrlc()) {
 				puts("abort\n");
+				r = -1;
 				goto out;
 			}
 			WATCHDOG_RESET();
@@ -11,6 +11,8 @@
  */
 
 #include <common.h>
+#include <net6.h>
+#include <linux/ctype.h>
 
 struct in_addr string_to_ip(const char *s)
 {
@@ -42,3 +44,71 @@ struct in_addr string_to_ip(const char *s)
 	addr.s_addr = htonl(addr.s_addr);
 	return addr;
 }
+
+#ifdef CONFIG_IPV6
+int string_to_ip6(const char *s, struct in6_addr *addr, u32 *prefix_len)
+{
+	u16 groups[8];
+	int ngroups = 0, gap = -1;
+	const char *p = s;
+	ulong val;
+	char *e;
+	int i;
+
+	if (!s)
+		return -EINVAL;
+
+	if (p[0] == ':' && p[1] == ':') {
+		gap = 0;
+		p += 2;
+	}
+
+	while (*p && *p != '/') {
+		if (ngroups == 8 || !isxdigit(*p))
+			return -EINVAL;
+		val = simple_strtoul(p, &e, 16);
+		if (val > 0xffff || e - p > 4)
+			return -EINVAL;
+		groups[ngroups++] = val;
+		p = e;
+		if (*p != ':')
+			break;
+		if (p[1] == ':') {
+			/* only one "::" is allowed */
+			if (gap >= 0)
+				return -EINVAL;
+			gap = ngroups;
+			p += 2;
+		} else {
+			p++;
+			if (!*p || *p == '/')
+				return -EINVAL;
+		}
+	}
+
+	if (gap < 0 ? ngroups != 8 : ngroups == 8)
+		return -EINVAL;
+
+	if (prefix_len)
+		*prefix_len = 0;
+	if (*p == '/') {
+		val = simple_strtoul(p + 1, &e, 10);
+		if (e == p + 1 || *e || val > 128)
+			return -EINVAL;
+		if (prefix_len)
+			*prefix_len = val;
+	} else if (*p) {
+		return -EINVAL;
+	}
+
+	/* expand the "::" by moving the groups after it to the end */
+	memset(addr, '\0', IN6ADDRSZ);
+	for (i = 0; i < ngroups; i++) {
+		int pos = (gap >= 0 && i >= gap) ? i + 8 - ngroups : i;
+
+		addr->s6_addr16[pos] = htons(groups[i]);
+	}
+
+	return 0;
+}
+#endif
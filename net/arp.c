@@ -9,6 +9,14 @@
  *	SPDX-License-Identifier:	GPL-2.0
  */
 
+/*
+ *	Resolved addresses are kept in a small cache which survives across
+ *	net_loop() calls, so a script running several transfers only pays
+ *	for one ARP round trip per host. Packets to hosts which are still
+ *	being resolved wait in a queue, so that talking to several new hosts
+ *	at once does not drop all but the last packet.
+ */
+
 #include <common.h>
 
 #include "arp.h"
@@ -27,13 +35,35 @@
 # define ARP_TIMEOUT_COUNT	CONFIG_NET_RETRY_COUNT
 #endif
 
-struct in_addr net_arp_wait_packet_ip;
-static struct in_addr net_arp_wait_reply_ip;
-/* MAC address of waiting packet's destination */
-uchar	       *arp_wait_packet_ethaddr;
-int		arp_wait_tx_packet_size;
-ulong		arp_wait_timer_start;
-int		arp_wait_try;
+/* Number of hosts kept in the ARP cache */
+#define ARP_CACHE_SIZE		8
+/* Milliseconds an ARP cache entry stays valid */
+#define ARP_CACHE_TIMEOUT	60000UL
+/* Number of packets which can wait for address resolution at once */
+#define ARP_QUEUE_SIZE		4
+
+struct arp_cache_entry {
+	struct in_addr ip;		/* 0 if the entry is unused */
+	uchar ethaddr[ARP_HLEN];
+	ulong timestamp;
+};
+
+struct arp_wait_entry {
+	uchar packet[PKTSIZE_ALIGN] __aligned(PKTALIGN);
+	int size;			/* 0 if the entry is unused */
+	struct in_addr packet_ip;	/* destination of the packet */
+	struct in_addr reply_ip;	/* the host or gateway we asked for */
+	uchar *ethaddr;			/* where to save the address, or NULL */
+	ulong timer_start;
+	int try;
+};
+
+static struct arp_cache_entry arp_cache[ARP_CACHE_SIZE];
+/* Interface the cached neighbors were seen on */
+static int arp_cache_dev_index = -1;
+static struct arp_wait_entry arp_queue[ARP_QUEUE_SIZE];
+/* The missing gateway has been reported in this net_loop() */
+static bool arp_gateway_warned;
 
 static uchar   *arp_tx_packet;	/* THE ARP transmit packet */
 static uchar	arp_tx_packet_buf[PKTSIZE_ALIGN + PKTALIGN];
@@ -41,14 +71,110 @@ static uchar	arp_tx_packet_buf[PKTSIZE_ALIGN + PKTALIGN];
 void arp_init(void)
 {
 	/* XXX problem with bss workaround */
-	arp_wait_packet_ethaddr = NULL;
-	net_arp_wait_packet_ip.s_addr = 0;
-	net_arp_wait_reply_ip.s_addr = 0;
-	arp_wait_tx_packet_size = 0;
+	memset(arp_cache, '\0', sizeof(arp_cache));
+	arp_cache_dev_index = -1;
+	arp_queue_flush();
 	arp_tx_packet = &arp_tx_packet_buf[0] + (PKTALIGN - 1);
 	arp_tx_packet -= (ulong)arp_tx_packet % PKTALIGN;
 }
 
+void arp_init_loop(void)
+{
+	int index = eth_get_dev_index();
+
+	/* Neighbors seen on one interface say nothing about another one */
+	if (index != arp_cache_dev_index) {
+		memset(arp_cache, '\0', sizeof(arp_cache));
+		arp_cache_dev_index = index;
+	}
+	arp_queue_flush();
+	arp_gateway_warned = false;
+}
+
+void arp_queue_flush(void)
+{
+	int i;
+
+	for (i = 0; i < ARP_QUEUE_SIZE; i++)
+		arp_queue[i].size = 0;
+}
+
+/* The host the packet has to go to first: the destination or a gateway */
+static struct in_addr arp_nexthop(struct in_addr dest)
+{
+	if ((dest.s_addr & net_netmask.s_addr) ==
+	    (net_ip.s_addr & net_netmask.s_addr))
+		return dest;
+	if (net_gateway.s_addr == 0) {
+		/* Every packet to the host comes here, say it only once */
+		if (!arp_gateway_warned)
+			puts("## Warning: gatewayip needed but not set\n");
+		arp_gateway_warned = true;
+		return dest;
+	}
+
+	return net_gateway;
+}
+
+bool arp_cache_lookup(struct in_addr dest, uchar *ethaddr)
+{
+	struct in_addr ip = arp_nexthop(dest);
+	struct arp_cache_entry *ent;
+
+	for (ent = arp_cache; ent < arp_cache + ARP_CACHE_SIZE; ent++) {
+		if (ent->ip.s_addr != ip.s_addr)
+			continue;
+		if (get_timer(ent->timestamp) > ARP_CACHE_TIMEOUT) {
+			ent->ip.s_addr = 0;
+			return false;
+		}
+		memcpy(ethaddr, ent->ethaddr, ARP_HLEN);
+		debug_cond(DEBUG_DEV_PKT, "ARP cache hit for %pI4: %pM\n",
+			   &ip, ethaddr);
+		return true;
+	}
+
+	return false;
+}
+
+static void arp_cache_update(struct in_addr ip, const uchar *ethaddr)
+{
+	struct arp_cache_entry *ent, *victim = NULL;
+
+	if (!ip.s_addr || !is_valid_ethaddr(ethaddr))
+		return;
+
+	/* Reuse the entry for this host, else a free one, else the oldest */
+	for (ent = arp_cache; ent < arp_cache + ARP_CACHE_SIZE; ent++) {
+		if (ent->ip.s_addr == ip.s_addr) {
+			victim = ent;
+			break;
+		}
+		if (victim && !victim->ip.s_addr)
+			continue;
+		if (!victim || !ent->ip.s_addr ||
+		    get_timer(ent->timestamp) > get_timer(victim->timestamp))
+			victim = ent;
+	}
+
+	victim->ip = ip;
+	memcpy(victim->ethaddr, ethaddr, ARP_HLEN);
+	victim->timestamp = get_timer(0);
+}
+
+/* Check whether an earlier queued packet already waits for this host */
+static bool arp_already_asked(struct arp_wait_entry *w)
+{
+	struct arp_wait_entry *prev;
+
+	for (prev = arp_queue; prev < w; prev++) {
+		if (prev->size && prev->reply_ip.s_addr == w->reply_ip.s_addr)
+			return true;
+	}
+
+	return false;
+}
+
 void arp_raw_request(struct in_addr source_ip, const uchar *target_ethaddr,
 	struct in_addr target_ip)
 {
@@ -56,7 +182,7 @@ void arp_raw_request(struct in_addr source_ip, const uchar *target_ethaddr,
 	struct arp_hdr *arp;
 	int eth_hdr_size;
 
-	debug_cond(DEBUG_DEV_PKT, "ARP broadcast %d\n", arp_wait_try);
+	debug_cond(DEBUG_DEV_PKT, "ARP broadcast for %pI4\n", &target_ip);
 
 	pkt = arp_tx_packet;
 
@@ -79,46 +205,101 @@ void arp_raw_request(struct in_addr source_ip, const uchar *target_ethaddr,
 	net_send_packet(arp_tx_packet, eth_hdr_size + ARP_HDR_SIZE);
 }
 
-void arp_request(void)
+void arp_queue_packet(struct in_addr dest, uchar *ethaddr, uchar *pkt,
+		      int len)
 {
-	if ((net_arp_wait_packet_ip.s_addr & net_netmask.s_addr) !=
-	    (net_ip.s_addr & net_netmask.s_addr)) {
-		if (net_gateway.s_addr == 0) {
-			puts("## Warning: gatewayip needed but not set\n");
-			net_arp_wait_reply_ip = net_arp_wait_packet_ip;
-		} else {
-			net_arp_wait_reply_ip = net_gateway;
+	struct arp_wait_entry *w, *victim = arp_queue;
+
+	/* Use a free entry, else drop the packet waiting the longest */
+	for (w = arp_queue; w < arp_queue + ARP_QUEUE_SIZE; w++) {
+		if (!w->size) {
+			victim = w;
+			break;
 		}
-	} else {
-		net_arp_wait_reply_ip = net_arp_wait_packet_ip;
+		if (w->timer_start - victim->timer_start > LONG_MAX)
+			victim = w;
 	}
-
-	arp_raw_request(net_ip, net_null_ethaddr, net_arp_wait_reply_ip);
+	w = victim;
+	if (w->size)
+		debug("ARP queue full, dropping packet for %pI4\n",
+		      &w->packet_ip);
+
+	memcpy(w->packet, pkt, len);
+	w->size = len;
+	w->packet_ip = dest;
+	w->reply_ip = arp_nexthop(dest);
+	w->ethaddr = ethaddr;
+	w->try = 1;
+	w->timer_start = get_timer(0);
+
+	if (!arp_already_asked(w))
+		arp_raw_request(net_ip, net_null_ethaddr, w->reply_ip);
 }
 
 int arp_timeout_check(void)
 {
+	struct arp_wait_entry *w;
+	int pending = 0;
 	ulong t;
 
-	if (!net_arp_wait_packet_ip.s_addr)
-		return 0;
-
 	t = get_timer(0);
 
-	/* check for arp timeout */
-	if ((t - arp_wait_timer_start) > ARP_TIMEOUT) {
-		arp_wait_try++;
+	for (w = arp_queue; w < arp_queue + ARP_QUEUE_SIZE; w++) {
+		if (!w->size)
+			continue;
+		pending = 1;
+
+		/* check for arp timeout */
+		if ((t - w->timer_start) <= ARP_TIMEOUT)
+			continue;
+		w->try++;
 
-		if (arp_wait_try >= ARP_TIMEOUT_COUNT) {
+		if (w->try >= ARP_TIMEOUT_COUNT) {
 			puts("\nARP Retry count exceeded; starting again\n");
-			arp_wait_try = 0;
+			arp_queue_flush();
 			net_set_state(NETLOOP_FAIL);
-		} else {
-			arp_wait_timer_start = t;
-			arp_request();
+			break;
+		}
+		w->timer_start = t;
+		if (!arp_already_asked(w))
+			arp_raw_request(net_ip, net_null_ethaddr, w->reply_ip);
+	}
+
+	return pending;
+}
+
+/* Send the packets which waited for the host that just replied */
+static bool arp_queue_resolved(struct in_addr ip, const uchar *ethaddr)
+{
+	struct arp_wait_entry *w;
+	bool found = false;
+
+	for (w = arp_queue; w < arp_queue + ARP_QUEUE_SIZE; w++) {
+		if (!w->size || w->reply_ip.s_addr != ip.s_addr)
+			continue;
+
+#ifdef CONFIG_KEEP_SERVERADDR
+		if (net_server_ip.s_addr == w->packet_ip.s_addr) {
+			char buf[20];
+
+			sprintf(buf, "%pM", ethaddr);
+			env_set("serveraddr", buf);
 		}
+#endif
+
+		/* save address for later use */
+		if (w->ethaddr)
+			memcpy(w->ethaddr, ethaddr, ARP_HLEN);
+
+		/* set the mac address in the packet's header and send it */
+		memcpy(((struct ethernet_hdr *)w->packet)->et_dest, ethaddr,
+		       ARP_HLEN);
+		net_send_packet(w->packet, w->size);
+		w->size = 0;
+		found = true;
 	}
-	return 1;
+
+	return found;
 }
 
 void arp_receive(struct ethernet_hdr *et, struct ip_udp_hdr *ip, int len)
@@ -158,6 +339,10 @@ void arp_receive(struct ethernet_hdr *et, struct ip_udp_hdr *ip, int len)
 	if (net_read_ip(&arp->ar_tpa).s_addr != net_ip.s_addr)
 		return;
 
+	/* Whoever talks to us will most likely be talked to next */
+	reply_ip_addr = net_read_ip(&arp->ar_spa);
+	arp_cache_update(reply_ip_addr, &arp->ar_sha);
+
 	switch (ntohs(arp->ar_op)) {
 	case ARPOP_REQUEST:
 		/* reply with our IP address */
@@ -186,44 +371,13 @@ void arp_receive(struct ethernet_hdr *et, struct ip_udp_hdr *ip, int len)
 		return;
 
 	case ARPOP_REPLY:		/* arp reply */
-		/* are we waiting for a reply */
-		if (!net_arp_wait_packet_ip.s_addr)
-			break;
-
-#ifdef CONFIG_KEEP_SERVERADDR
-		if (net_server_ip.s_addr == net_arp_wait_packet_ip.s_addr) {
-			char buf[20];
-			sprintf(buf, "%pM", &arp->ar_sha);
-			env_set("serveraddr", buf);
-		}
-#endif
-
-		reply_ip_addr = net_read_ip(&arp->ar_spa);
-
-		/* matched waiting packet's address */
-		if (reply_ip_addr.s_addr == net_arp_wait_reply_ip.s_addr) {
+		/* send the packets waiting for this address, if any */
+		if (arp_queue_resolved(reply_ip_addr, &arp->ar_sha)) {
 			debug_cond(DEBUG_DEV_PKT,
 				   "Got ARP REPLY, set eth addr (%pM)\n",
 				   arp->ar_data);
-
-			/* save address for later use */
-			if (arp_wait_packet_ethaddr != NULL)
-				memcpy(arp_wait_packet_ethaddr,
-				       &arp->ar_sha, ARP_HLEN);
-
 			net_get_arp_handler()((uchar *)arp, 0, reply_ip_addr,
 					      0, len);
-
-			/* set the mac address in the waiting packet's header
-			   and transmit it */
-			memcpy(((struct ethernet_hdr *)net_tx_packet)->et_dest,
-			       &arp->ar_sha, ARP_HLEN);
-			net_send_packet(net_tx_packet, arp_wait_tx_packet_size);
-
-			/* no arp request pending now */
-			net_arp_wait_packet_ip.s_addr = 0;
-			arp_wait_tx_packet_size = 0;
-			arp_wait_packet_ethaddr = NULL;
 		}
 		return;
 	default:
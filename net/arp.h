@@ -14,15 +14,36 @@
 
 #include <common.h>
 
-extern struct in_addr net_arp_wait_packet_ip;
-/* MAC address of waiting packet's destination */
-extern uchar *arp_wait_packet_ethaddr;
-extern int arp_wait_tx_packet_size;
-extern ulong arp_wait_timer_start;
-extern int arp_wait_try;
-
 void arp_init(void);
-void arp_request(void);
+/* Reset the per-net_loop() state, the cache is kept */
+void arp_init_loop(void);
+
+/**
+ * arp_cache_lookup() - Look up the address to send a packet to
+ *
+ * @dest:	Destination IP address; the gateway is looked up instead if
+ *		@dest is not on our subnet
+ * @ethaddr:	Returns the MAC address if found
+ * @return true if found and not expired
+ */
+bool arp_cache_lookup(struct in_addr dest, uchar *ethaddr);
+
+/**
+ * arp_queue_packet() - Hold a packet until its destination is resolved
+ *
+ * The packet is copied, so the caller may reuse its buffer straight away.
+ * An ARP request goes out unless one is already pending for the same host.
+ * If the queue is full, the packet waiting the longest is dropped.
+ *
+ * @dest:	Destination IP address
+ * @ethaddr:	Where to save the resolved MAC address, or NULL
+ * @pkt:	The packet, including its Ethernet header
+ * @len:	Length of the packet
+ */
+void arp_queue_packet(struct in_addr dest, uchar *ethaddr, uchar *pkt,
+		      int len);
+/* Drop all packets waiting for address resolution */
+void arp_queue_flush(void);
 void arp_raw_request(struct in_addr source_ip, const uchar *targetEther,
 	struct in_addr target_ip);
 int arp_timeout_check(void);
@@ -0,0 +1,450 @@
+/*
+ * Multicast/broadcast image distribution
+ *
+ * One device streams an image to a multicast group (or as broadcast) and any
+ * number of receivers pick it up at the same time. Every group of data blocks
+ * is followed by an XOR parity block so that a receiver can rebuild one lost
+ * block per group on its own. The stream is repeated a configurable number
+ * of times and receivers simply wait for the blocks still missing from their
+ * bitmap, so there is no per-receiver retransmission.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <lmb.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <net.h>
+#include <net/mdist.h>
+#include <linux/bitops.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Milliseconds between two bursts of sent packets */
+#define SEND_INTERVAL		1
+/* Number of packets sent per burst */
+#define SEND_BURST		16
+/* Give up receiving after this many milliseconds without a packet */
+#define RECV_TIMEOUT		10000UL
+/* Print a hash each time this many blocks have been received */
+#define HASH_BLOCKS		64
+
+ulong mdist_send_addr;
+ulong mdist_send_size;
+int mdist_rounds = 3;
+struct in_addr mdist_group_ip;
+
+/* Sender state */
+static uchar mdist_group_ethaddr[ARP_HLEN];
+static uint send_index;
+static int send_round;
+
+/* Receiver state, set up from the first packet received */
+static ulong *mdist_bitmap;
+/* Parity of each group which was missing several blocks when it came */
+static uchar **mdist_parity;
+static ulong mdist_file_size;
+static uint mdist_block_size;
+static uint mdist_group_size;
+static uint mdist_blocks;
+static uint mdist_groups;
+static uint mdist_received;
+static uint mdist_recovered;
+
+static inline bool is_multicast(struct in_addr ip)
+{
+	return (ntohl(ip.s_addr) & 0xf0000000) == 0xe0000000;
+}
+
+static uint block_len(uint blk, ulong size, uint block_size)
+{
+	return min_t(ulong, block_size, size - (ulong)blk * block_size);
+}
+
+static void xor_block(uchar *dst, const uchar *src, uint len)
+{
+	while (len--)
+		*dst++ ^= *src++;
+}
+
+int mdist_fill_packet(uchar *pkt, ulong addr, ulong size, int block_size,
+		      int group_size, uint index)
+{
+	struct mdist_hdr *hdr = (struct mdist_hdr *)pkt;
+	uchar *payload = pkt + sizeof(*hdr);
+	uint blocks = DIV_ROUND_UP(size, block_size);
+	uint group = index / (group_size + 1);
+	uint slot = index % (group_size + 1);
+	uint first = group * group_size;
+	uint seq, blk, len;
+	void *buf;
+
+	if (first >= blocks)
+		return -ENOENT;
+
+	if (slot < group_size) {
+		seq = first + slot;
+		if (seq >= blocks)
+			return 0;
+		len = block_len(seq, size, block_size);
+		buf = map_sysmem(addr + (ulong)seq * block_size, len);
+		memcpy(payload, buf, len);
+		unmap_sysmem(buf);
+		hdr->type = htons(MDIST_DATA);
+	} else {
+		/* Shorter blocks count as zero-padded */
+		seq = group;
+		len = block_len(first, size, block_size);
+		memset(payload, '\0', len);
+		for (blk = first; blk < first + group_size && blk < blocks;
+		     blk++) {
+			uint blen = block_len(blk, size, block_size);
+
+			buf = map_sysmem(addr + (ulong)blk * block_size, blen);
+			xor_block(payload, buf, blen);
+			unmap_sysmem(buf);
+		}
+		hdr->type = htons(MDIST_PARITY);
+	}
+
+	hdr->magic = htonl(MDIST_MAGIC);
+	hdr->group_size = htons(group_size);
+	hdr->seq = htonl(seq);
+	hdr->file_size = htonl(size);
+	hdr->block_size = htons(block_size);
+	hdr->reserved = 0;
+
+	return sizeof(*hdr) + len;
+}
+
+static void mdist_send_burst(void)
+{
+	uchar *pkt;
+	int i, len;
+
+	for (i = 0; i < SEND_BURST; i++) {
+		pkt = net_tx_packet + net_eth_hdr_size() + IP_UDP_HDR_SIZE;
+		len = mdist_fill_packet(pkt, mdist_send_addr, mdist_send_size,
+					MDIST_BLOCK_SIZE_MAX, MDIST_GROUP_SIZE,
+					send_index++);
+		if (len == -ENOENT) {
+			putc('#');
+			send_index = 0;
+			if (++send_round >= mdist_rounds) {
+				puts("\ndone\n");
+				net_set_state(NETLOOP_SUCCESS);
+				return;
+			}
+			continue;
+		}
+		if (len)
+			net_send_udp_packet(mdist_group_ethaddr,
+					    mdist_group_ip, MDIST_PORT,
+					    MDIST_PORT, len);
+	}
+
+	net_set_timeout_handler(SEND_INTERVAL, mdist_send_burst);
+}
+
+void mdist_send_start(void)
+{
+	u32 ip = ntohl(mdist_group_ip.s_addr);
+
+	printf("Using %s device\n", eth_get_name());
+	printf("Sending %lu bytes from 0x%lx to %pI4, %d rounds\n",
+	       mdist_send_size, mdist_send_addr, &mdist_group_ip,
+	       mdist_rounds);
+
+	/* Map the group address onto its Ethernet multicast address */
+	if (is_multicast(mdist_group_ip)) {
+		mdist_group_ethaddr[0] = 0x01;
+		mdist_group_ethaddr[1] = 0x00;
+		mdist_group_ethaddr[2] = 0x5e;
+		mdist_group_ethaddr[3] = (ip >> 16) & 0x7f;
+		mdist_group_ethaddr[4] = (ip >> 8) & 0xff;
+		mdist_group_ethaddr[5] = ip & 0xff;
+	} else {
+		memcpy(mdist_group_ethaddr, net_bcast_ethaddr, ARP_HLEN);
+	}
+
+	send_index = 0;
+	send_round = 0;
+	net_set_udp_handler(NULL);
+	net_set_timeout_handler(SEND_INTERVAL, mdist_send_burst);
+}
+
+static inline bool mdist_have(uint blk)
+{
+	return mdist_bitmap[BIT_WORD(blk)] & BIT_MASK(blk);
+}
+
+static void mdist_recv_cleanup(void)
+{
+	uint group;
+
+#ifdef CONFIG_MCAST_TFTP
+	if (net_mcast_addr.s_addr)
+		eth_mcast_join(net_mcast_addr, 0);
+	net_mcast_addr.s_addr = 0;
+#endif
+	if (mdist_parity) {
+		for (group = 0; group < mdist_groups; group++)
+			free(mdist_parity[group]);
+		free(mdist_parity);
+		mdist_parity = NULL;
+	}
+	free(mdist_bitmap);
+	mdist_bitmap = NULL;
+}
+
+/* Check that the image fits in DRAM at load_addr, clear of U-Boot */
+static bool mdist_load_area_ok(ulong size)
+{
+#ifdef CONFIG_LMB
+	phys_addr_t start = load_addr, end = start + size;
+	struct lmb_property *rgn;
+	bool in_memory = false;
+	struct lmb lmb;
+	int i;
+
+	if (end < start)
+		return false;
+
+	lmb_init(&lmb);
+#ifdef CONFIG_NR_DRAM_BANKS
+	for (i = 0; i < CONFIG_NR_DRAM_BANKS; i++)
+		lmb_add(&lmb, gd->bd->bi_dram[i].start,
+			gd->bd->bi_dram[i].size);
+#else
+	lmb_add(&lmb, CONFIG_SYS_SDRAM_BASE, gd->ram_size);
+#endif
+	arch_lmb_reserve(&lmb);
+	board_lmb_reserve(&lmb);
+
+	for (i = 0; i < lmb.memory.cnt; i++) {
+		rgn = &lmb.memory.region[i];
+		if (start >= rgn->base && end <= rgn->base + rgn->size)
+			in_memory = true;
+	}
+	for (i = 0; i < lmb.reserved.cnt; i++) {
+		rgn = &lmb.reserved.region[i];
+		if (rgn->size && start < rgn->base + rgn->size &&
+		    rgn->base < end)
+			return false;
+	}
+
+	return in_memory;
+#else
+	return load_addr + size >= load_addr;
+#endif
+}
+
+static int mdist_recv_setup(struct mdist_hdr *hdr)
+{
+	mdist_file_size = ntohl(hdr->file_size);
+	mdist_block_size = ntohs(hdr->block_size);
+	mdist_group_size = ntohs(hdr->group_size);
+	if (!mdist_file_size || !mdist_group_size || !mdist_block_size ||
+	    mdist_block_size > MDIST_BLOCK_SIZE_MAX)
+		return -EINVAL;
+	if (!mdist_load_area_ok(mdist_file_size)) {
+		printf("\n%lu bytes do not fit at load address 0x%lx\n",
+		       mdist_file_size, load_addr);
+		net_set_state(NETLOOP_FAIL);
+		return -E2BIG;
+	}
+
+	mdist_blocks = DIV_ROUND_UP(mdist_file_size, mdist_block_size);
+	mdist_groups = DIV_ROUND_UP(mdist_blocks, mdist_group_size);
+	mdist_bitmap = calloc(DIV_ROUND_UP(mdist_blocks, BITS_PER_LONG),
+			      sizeof(ulong));
+	mdist_parity = calloc(mdist_groups, sizeof(*mdist_parity));
+	if (!mdist_bitmap || !mdist_parity) {
+		mdist_recv_cleanup();
+		return -ENOMEM;
+	}
+	mdist_received = 0;
+	mdist_recovered = 0;
+	printf("Receiving %lu bytes\n", mdist_file_size);
+
+	return 0;
+}
+
+static void mdist_store(uint blk, const uchar *data)
+{
+	uint len = block_len(blk, mdist_file_size, mdist_block_size);
+	void *buf;
+
+	buf = map_sysmem(load_addr + (ulong)blk * mdist_block_size, len);
+	memcpy(buf, data, len);
+	unmap_sysmem(buf);
+	__set_bit(blk, mdist_bitmap);
+	if (++mdist_received % HASH_BLOCKS == 0)
+		putc('#');
+}
+
+/* Count the blocks missing from a group, returning the last in @missingp */
+static uint mdist_missing(uint group, uint *missingp)
+{
+	uint first = group * mdist_group_size;
+	uint last = min(first + mdist_group_size, mdist_blocks);
+	uint blk, count = 0;
+
+	for (blk = first; blk < last; blk++) {
+		if (!mdist_have(blk)) {
+			*missingp = blk;
+			count++;
+		}
+	}
+
+	return count;
+}
+
+/* Rebuild the one block missing from a group */
+static void mdist_repair(uint group, uint missing, const uchar *parity)
+{
+	static uchar block[MDIST_BLOCK_SIZE_MAX];
+	uint first = group * mdist_group_size;
+	uint last = min(first + mdist_group_size, mdist_blocks);
+	uint len = block_len(first, mdist_file_size, mdist_block_size);
+	uint blk;
+	void *buf;
+
+	memcpy(block, parity, len);
+	for (blk = first; blk < last; blk++) {
+		uint blen = block_len(blk, mdist_file_size, mdist_block_size);
+
+		if (blk == missing)
+			continue;
+		buf = map_sysmem(load_addr + (ulong)blk * mdist_block_size,
+				 blen);
+		xor_block(block, buf, blen);
+		unmap_sysmem(buf);
+	}
+	mdist_store(missing, block);
+	mdist_recovered++;
+}
+
+/*
+ * Use a group's parity once only one of its blocks is missing. Until then
+ * keep a copy, so that the data blocks of later rounds can complete the
+ * group without waiting for its parity to come round again.
+ */
+static void mdist_parity_rx(uint group, const uchar *parity, uint len)
+{
+	uint missing;
+
+	if (group >= mdist_groups ||
+	    len != block_len(group * mdist_group_size, mdist_file_size,
+			     mdist_block_size))
+		return;
+
+	switch (mdist_missing(group, &missing)) {
+	case 0:
+		return;
+	case 1:
+		mdist_repair(group, missing, parity);
+		return;
+	}
+
+	if (!mdist_parity[group]) {
+		/* Without memory for it, wait for the parity to come again */
+		mdist_parity[group] = malloc(len);
+		if (mdist_parity[group])
+			memcpy(mdist_parity[group], parity, len);
+	}
+}
+
+/* A data block of @group arrived, see if the group's kept parity helps */
+static void mdist_group_update(uint group)
+{
+	uint missing;
+
+	if (!mdist_parity[group])
+		return;
+
+	switch (mdist_missing(group, &missing)) {
+	case 1:
+		mdist_repair(group, missing, mdist_parity[group]);
+		/* fall through */
+	case 0:
+		free(mdist_parity[group]);
+		mdist_parity[group] = NULL;
+		break;
+	}
+}
+
+static void mdist_recv_timeout(void)
+{
+	if (mdist_bitmap)
+		printf("\nTimeout: missing %u of %u blocks\n",
+		       mdist_blocks - mdist_received, mdist_blocks);
+	else
+		puts("\nTimeout: no image distribution seen\n");
+	mdist_recv_cleanup();
+	net_set_state(NETLOOP_FAIL);
+}
+
+static void mdist_handler(uchar *pkt, unsigned dest, struct in_addr sip,
+			  unsigned src, unsigned len)
+{
+	struct mdist_hdr *hdr = (struct mdist_hdr *)pkt;
+	uchar *payload = pkt + sizeof(*hdr);
+	uint seq;
+
+	if (dest != MDIST_PORT || len < sizeof(*hdr) ||
+	    ntohl(hdr->magic) != MDIST_MAGIC)
+		return;
+	if (!mdist_bitmap && mdist_recv_setup(hdr))
+		return;
+
+	/* Ignore packets from a different stream */
+	if (ntohl(hdr->file_size) != mdist_file_size ||
+	    ntohs(hdr->block_size) != mdist_block_size ||
+	    ntohs(hdr->group_size) != mdist_group_size)
+		return;
+
+	net_set_timeout_handler(RECV_TIMEOUT, mdist_recv_timeout);
+	len -= sizeof(*hdr);
+	seq = ntohl(hdr->seq);
+
+	switch (ntohs(hdr->type)) {
+	case MDIST_DATA:
+		if (seq < mdist_blocks && !mdist_have(seq) &&
+		    len == block_len(seq, mdist_file_size, mdist_block_size)) {
+			mdist_store(seq, payload);
+			mdist_group_update(seq / mdist_group_size);
+		}
+		break;
+	case MDIST_PARITY:
+		mdist_parity_rx(seq, payload, len);
+		break;
+	}
+
+	if (mdist_received == mdist_blocks) {
+		printf("\ndone, %u of %u blocks recovered from parity\n",
+		       mdist_recovered, mdist_blocks);
+		net_boot_file_size = mdist_file_size;
+		mdist_recv_cleanup();
+		net_set_state(NETLOOP_SUCCESS);
+	}
+}
+
+void mdist_recv_start(void)
+{
+	printf("Using %s device\n", eth_get_name());
+	printf("Listening on %pI4 port %d, load address 0x%lx\n",
+	       &mdist_group_ip, MDIST_PORT, load_addr);
+
+	mdist_recv_cleanup();
+#ifdef CONFIG_MCAST_TFTP
+	if (is_multicast(mdist_group_ip)) {
+		net_mcast_addr = mdist_group_ip;
+		eth_mcast_join(net_mcast_addr, 1);
+	}
+#endif
+	net_set_udp_handler(mdist_handler);
+	net_set_timeout_handler(RECV_TIMEOUT, mdist_recv_timeout);
+}
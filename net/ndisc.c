@@ -0,0 +1,392 @@
+/*
+ * IPv6 neighbor discovery
+ *
+ * Neighbor solicitation/advertisement replaces ARP for IPv6. Resolved
+ * neighbors are kept in a small direct-mapped cache which survives across
+ * net_loop() calls, so a lookup costs a hash and a compare. Router
+ * advertisements carrying an autonomous prefix configure our global address
+ * (stateless autoconfiguration) when none has been set.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <net6.h>
+#include "ndisc.h"
+
+#ifndef CONFIG_ARP_TIMEOUT
+/* Milliseconds before soliciting again */
+# define NDISC_TIMEOUT		5000UL
+#else
+# define NDISC_TIMEOUT		CONFIG_ARP_TIMEOUT
+#endif
+
+#ifndef CONFIG_NET_RETRY_COUNT
+# define NDISC_TIMEOUT_COUNT	5	/* # of timeouts before giving up */
+#else
+# define NDISC_TIMEOUT_COUNT	CONFIG_NET_RETRY_COUNT
+#endif
+
+/* Number of cache slots, must be a power of two */
+#define NDISC_CACHE_SIZE	16
+/* Milliseconds a cache entry stays valid */
+#define NDISC_CACHE_TIMEOUT	300000UL
+
+struct nd_cache_entry {
+	struct in6_addr ip6;
+	u8 enetaddr[ARP_HLEN];
+	ulong timestamp;
+	bool valid;
+};
+
+static struct nd_cache_entry nd_cache[NDISC_CACHE_SIZE];
+
+struct in6_addr net_nd_sol_packet_ip6;
+/* Who we expect the advertisement from (the target or our gateway) */
+static struct in6_addr net_nd_rep_packet_ip6;
+uchar *net_nd_packet_mac;
+int net_nd_tx_packet_size;
+ulong net_nd_timer_start;
+int net_nd_try;
+
+/* Milliseconds between two router solicitations */
+#define NDISC_RS_INTERVAL	1000UL
+/* Router solicitations sent before giving up */
+#define NDISC_RS_COUNT		3
+
+/* Set while the SLAAC protocol waits for a router advertisement */
+static bool ndisc_slaac_active;
+static int ndisc_rs_try;
+
+static uchar *nd_tx_packet;	/* The ND transmit packet */
+static uchar nd_tx_packet_buf[PKTSIZE_ALIGN + PKTALIGN];
+
+static struct nd_cache_entry *ndisc_slot(const struct in6_addr *ip6)
+{
+	/* The low bits of the interface ID are the best spread */
+	uint hash = ip6->s6_addr[15] ^ ip6->s6_addr[14] ^ ip6->s6_addr[13];
+
+	return &nd_cache[hash & (NDISC_CACHE_SIZE - 1)];
+}
+
+bool ndisc_lookup(const struct in6_addr *ip6, u8 enetaddr[ARP_HLEN])
+{
+	struct nd_cache_entry *ent = ndisc_slot(ip6);
+
+	if (!ent->valid || memcmp(&ent->ip6, ip6, IN6ADDRSZ))
+		return false;
+	if (get_timer(ent->timestamp) > NDISC_CACHE_TIMEOUT) {
+		ent->valid = false;
+		return false;
+	}
+	memcpy(enetaddr, ent->enetaddr, ARP_HLEN);
+
+	return true;
+}
+
+static void ndisc_update(const struct in6_addr *ip6, const u8 *enetaddr)
+{
+	struct nd_cache_entry *ent = ndisc_slot(ip6);
+
+	memcpy(&ent->ip6, ip6, IN6ADDRSZ);
+	memcpy(ent->enetaddr, enetaddr, ARP_HLEN);
+	ent->timestamp = get_timer(0);
+	ent->valid = true;
+}
+
+void ndisc_init(void)
+{
+	memset(nd_cache, '\0', sizeof(nd_cache));
+	memset(&net_nd_rep_packet_ip6, '\0', IN6ADDRSZ);
+	nd_tx_packet = &nd_tx_packet_buf[0] + (PKTALIGN - 1);
+	nd_tx_packet -= (ulong)nd_tx_packet % PKTALIGN;
+}
+
+void ndisc_init_loop(void)
+{
+	/* Drop a solicitation left over from an aborted loop */
+	memset(&net_nd_sol_packet_ip6, '\0', IN6ADDRSZ);
+	net_nd_packet_mac = NULL;
+	net_nd_tx_packet_size = 0;
+	ndisc_slaac_active = false;
+}
+
+/* Append a link-layer address option, return its size */
+static int ndisc_add_ll_option(u8 *opt, u8 type)
+{
+	opt[0] = type;
+	opt[1] = ND_OPT_LL_ADDR_SIZE / 8;
+	memcpy(&opt[2], net_ethaddr, ARP_HLEN);
+
+	return ND_OPT_LL_ADDR_SIZE;
+}
+
+/* Finish the ICMPv6 message at nd_tx_packet and send it */
+static void ndisc_send(const struct in6_addr *src, const struct in6_addr *dest,
+		       const u8 *enetaddr, int icmp_len)
+{
+	uchar *pkt;
+	struct icmp6_hdr *icmp;
+	int eth_hdr_size;
+
+	eth_hdr_size = net_set_ether(nd_tx_packet, enetaddr, PROT_IPV6);
+	pkt = nd_tx_packet + eth_hdr_size;
+	icmp = (struct icmp6_hdr *)(pkt + IP6_HDR_SIZE);
+
+	net_set_ip6_header(pkt, src, dest, IPPROTO_ICMPV6, IP6_ND_HOP_LIMIT,
+			   icmp_len);
+	icmp->icmp6_cksum = 0;
+	icmp->icmp6_cksum = net_ip6_checksum(src, dest, icmp_len,
+					     IPPROTO_ICMPV6, icmp);
+	net_send_packet(nd_tx_packet, eth_hdr_size + IP6_HDR_SIZE + icmp_len);
+}
+
+static struct nd_msg *ndisc_msg(void)
+{
+	return (struct nd_msg *)(nd_tx_packet + net_eth_hdr_size() +
+				 IP6_HDR_SIZE);
+}
+
+const struct in6_addr *ndisc_nexthop(const struct in6_addr *dest)
+{
+	if (ip6_is_link_local(dest) ||
+	    (net_prefix_length &&
+	     ip6_addr_in_subnet(&net_ip6, dest, net_prefix_length)) ||
+	    ip6_is_unspecified(&net_gateway6))
+		return dest;
+
+	return &net_gateway6;
+}
+
+void ndisc_request(void)
+{
+	struct in6_addr dest;
+	u8 enetaddr[ARP_HLEN];
+	struct nd_msg *msg;
+
+	net_nd_rep_packet_ip6 = *ndisc_nexthop(&net_nd_sol_packet_ip6);
+
+	debug_cond(DEBUG_DEV_PKT, "NS for %pI6 (try %d)\n",
+		   &net_nd_rep_packet_ip6, net_nd_try);
+
+	ip6_make_snma(&dest, &net_nd_rep_packet_ip6);
+	ip6_make_mult_ethdstaddr(enetaddr, &dest);
+
+	msg = ndisc_msg();
+	memset(&msg->icmph, '\0', ICMP6_HDR_SIZE);
+	msg->icmph.icmp6_type = ICMPV6_NEIGHBOR_SOLICIT;
+	msg->target = net_nd_rep_packet_ip6;
+	ndisc_send(net_ip6_src_for(&net_nd_rep_packet_ip6), &dest, enetaddr,
+		   sizeof(*msg) +
+		   ndisc_add_ll_option(msg->opt, ND_OPT_SOURCE_LL_ADDR));
+}
+
+void ndisc_send_rs(void)
+{
+	struct in6_addr dest;
+	u8 enetaddr[ARP_HLEN];
+	struct rs_msg *msg;
+
+	/* All-routers multicast group ff02::2 */
+	memset(&dest, '\0', IN6ADDRSZ);
+	dest.s6_addr[0] = 0xff;
+	dest.s6_addr[1] = 0x02;
+	dest.s6_addr[15] = 0x02;
+	ip6_make_mult_ethdstaddr(enetaddr, &dest);
+
+	msg = (struct rs_msg *)ndisc_msg();
+	memset(&msg->icmph, '\0', ICMP6_HDR_SIZE);
+	msg->icmph.icmp6_type = ICMPV6_ROUTER_SOLICIT;
+	ndisc_send(&net_link_local_ip6, &dest, enetaddr, sizeof(*msg) +
+		   ndisc_add_ll_option(msg->opt, ND_OPT_SOURCE_LL_ADDR));
+}
+
+static void ndisc_rs_timeout(void)
+{
+	if (++ndisc_rs_try > NDISC_RS_COUNT) {
+		puts("\nNo router advertisement with an autonomous prefix\n");
+		ndisc_slaac_active = false;
+		net_set_state(NETLOOP_FAIL);
+		return;
+	}
+	ndisc_send_rs();
+	net_set_timeout_handler(NDISC_RS_INTERVAL, ndisc_rs_timeout);
+}
+
+void ndisc_slaac_start(void)
+{
+	printf("Using %s device\n", eth_get_name());
+
+	/* Forget the old address so that the advertisement replaces it */
+	memset(&net_ip6, '\0', IN6ADDRSZ);
+	net_prefix_length = 0;
+	memset(&net_gateway6, '\0', IN6ADDRSZ);
+
+	ndisc_slaac_active = true;
+	ndisc_rs_try = 0;
+	ndisc_rs_timeout();
+}
+
+int ndisc_timeout_check(void)
+{
+	ulong t;
+
+	if (ip6_is_unspecified(&net_nd_sol_packet_ip6))
+		return 0;
+
+	t = get_timer(0);
+
+	/* check for NDISC timeout */
+	if ((t - net_nd_timer_start) > NDISC_TIMEOUT) {
+		net_nd_try++;
+
+		if (net_nd_try >= NDISC_TIMEOUT_COUNT) {
+			puts("\nNDISC Retry count exceeded; starting again\n");
+			net_nd_try = 0;
+			net_set_state(NETLOOP_FAIL);
+		} else {
+			net_nd_timer_start = t;
+			ndisc_request();
+		}
+	}
+	return 1;
+}
+
+/* Find a link-layer address option of the given type */
+static const u8 *ndisc_find_ll_option(const u8 *opt, int len, u8 type)
+{
+	while (len >= 2 && opt[1] && opt[1] * 8 <= len) {
+		if (opt[0] == type && opt[1] * 8 >= 2 + ARP_HLEN)
+			return &opt[2];
+		len -= opt[1] * 8;
+		opt += opt[1] * 8;
+	}
+
+	return NULL;
+}
+
+static void ndisc_send_na(const struct in6_addr *dest, const u8 *enetaddr,
+			  const struct in6_addr *target)
+{
+	struct nd_msg *msg = ndisc_msg();
+
+	memset(&msg->icmph, '\0', ICMP6_HDR_SIZE);
+	msg->icmph.icmp6_type = ICMPV6_NEIGHBOR_ADVERT;
+	msg->icmph.icmp6_dataun.na.flags = htonl(ND_NA_FLAG_SOLICITED |
+						 ND_NA_FLAG_OVERRIDE);
+	msg->target = *target;
+	ndisc_send(target, dest, enetaddr, sizeof(*msg) +
+		   ndisc_add_ll_option(msg->opt, ND_OPT_TARGET_LL_ADDR));
+}
+
+/* Configure our address from an autonomous prefix (SLAAC) */
+static void ndisc_process_ra(const struct in6_addr *router,
+			     struct ra_msg *ra, int len)
+{
+	const u8 *opt = ra->opt;
+	struct nd_opt_prefix_info *pi;
+
+	len -= sizeof(*ra);
+	while (len >= 2 && opt[1] && opt[1] * 8 <= len) {
+		pi = (struct nd_opt_prefix_info *)opt;
+		if (opt[0] == ND_OPT_PREFIX_INFO && opt[1] * 8 >= sizeof(*pi) &&
+		    (pi->flags & ND_PREFIX_FLAG_AUTO) && pi->prefix_len == 64 &&
+		    pi->valid_lifetime && ip6_is_unspecified(&net_ip6)) {
+			/* prefix + our link-local interface ID */
+			memcpy(&net_ip6, &pi->prefix, 8);
+			memcpy(&net_ip6.s6_addr[8],
+			       &net_link_local_ip6.s6_addr[8], 8);
+			net_prefix_length = pi->prefix_len;
+			printf("IPv6 address %pI6/%d from router %pI6\n",
+			       &net_ip6, net_prefix_length, router);
+		}
+		len -= opt[1] * 8;
+		opt += opt[1] * 8;
+	}
+
+	if (ra->icmph.icmp6_dataun.ra.router_lifetime &&
+	    ip6_is_unspecified(&net_gateway6))
+		net_gateway6 = *router;
+
+	if (ndisc_slaac_active && !ip6_is_unspecified(&net_ip6)) {
+		ndisc_slaac_active = false;
+		net_set_state(NETLOOP_SUCCESS);
+	}
+}
+
+void ndisc_receive(struct ethernet_hdr *et, struct ip6_hdr *ip6, int len)
+{
+	struct icmp6_hdr *icmp = (struct icmp6_hdr *)(ip6 + 1);
+	struct nd_msg *ndm = (struct nd_msg *)icmp;
+	struct in6_addr saddr, target;
+	const u8 *enetaddr;
+	int opt_len;
+
+	/* Neighbor discovery messages never cross a router */
+	if (ip6->hop_limit != IP6_ND_HOP_LIMIT)
+		return;
+
+	len -= IP6_HDR_SIZE;
+	opt_len = len - sizeof(*ndm);
+	net_copy_ip6(&saddr, &ip6->saddr);
+
+	switch (icmp->icmp6_type) {
+	case ICMPV6_NEIGHBOR_SOLICIT:
+		if (opt_len < 0)
+			break;
+		net_copy_ip6(&target, &ndm->target);
+		if (!ip6_is_our_addr(&target))
+			break;
+		debug_cond(DEBUG_DEV_PKT, "Got NS for %pI6\n", &target);
+		enetaddr = ndisc_find_ll_option(ndm->opt, opt_len,
+						ND_OPT_SOURCE_LL_ADDR);
+		if (!enetaddr)
+			enetaddr = et->et_src;
+		/* Duplicate address detection probes are not answered */
+		if (ip6_is_unspecified(&saddr))
+			break;
+		ndisc_update(&saddr, enetaddr);
+		ndisc_send_na(&saddr, enetaddr, &target);
+		break;
+
+	case ICMPV6_NEIGHBOR_ADVERT:
+		if (opt_len < 0)
+			break;
+		net_copy_ip6(&target, &ndm->target);
+		enetaddr = ndisc_find_ll_option(ndm->opt, opt_len,
+						ND_OPT_TARGET_LL_ADDR);
+		if (!enetaddr)
+			enetaddr = et->et_src;
+		ndisc_update(&target, enetaddr);
+
+		/* are we waiting for this advertisement? */
+		if (ip6_is_unspecified(&net_nd_sol_packet_ip6) ||
+		    memcmp(&target, &net_nd_rep_packet_ip6, IN6ADDRSZ))
+			break;
+
+		debug_cond(DEBUG_DEV_PKT, "Got NA, set eth addr (%pM)\n",
+			   enetaddr);
+
+		/* save address for later use */
+		if (net_nd_packet_mac)
+			memcpy(net_nd_packet_mac, enetaddr, ARP_HLEN);
+
+		/* set the mac address in the waiting packet and send it */
+		memcpy(((struct ethernet_hdr *)net_tx_packet)->et_dest,
+		       enetaddr, ARP_HLEN);
+		net_send_packet(net_tx_packet, net_nd_tx_packet_size);
+
+		/* no solicitation pending now */
+		memset(&net_nd_sol_packet_ip6, '\0', IN6ADDRSZ);
+		net_nd_tx_packet_size = 0;
+		net_nd_packet_mac = NULL;
+		break;
+
+	case ICMPV6_ROUTER_ADVERT:
+		if (len < sizeof(struct ra_msg))
+			break;
+		debug_cond(DEBUG_DEV_PKT, "Got RA from %pI6\n", &saddr);
+		ndisc_process_ra(&saddr, (struct ra_msg *)icmp, len);
+		break;
+	}
+}
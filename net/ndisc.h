@@ -0,0 +1,57 @@
+/*
+ * IPv6 neighbor discovery
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __NDISC_H__
+#define __NDISC_H__
+
+#include <common.h>
+#include <net6.h>
+
+/* Address we are soliciting for the waiting packet (0 = none) */
+extern struct in6_addr net_nd_sol_packet_ip6;
+/* MAC address of waiting packet's destination */
+extern uchar *net_nd_packet_mac;
+extern int net_nd_tx_packet_size;
+extern ulong net_nd_timer_start;
+extern int net_nd_try;
+
+void ndisc_init(void);
+/* Reset the per-net_loop() state, the cache is kept */
+void ndisc_init_loop(void);
+
+/**
+ * ndisc_lookup() - Look up a neighbor in the cache
+ *
+ * @ip6:	Address of the neighbor
+ * @enetaddr:	Returns its MAC address if found
+ * @return true if found and not expired
+ */
+bool ndisc_lookup(const struct in6_addr *ip6, u8 enetaddr[ARP_HLEN]);
+
+/**
+ * ndisc_nexthop() - Get the neighbor which packets to an address go to
+ *
+ * @dest:	Destination address
+ * @return @dest itself if it is on-link, else our gateway
+ */
+const struct in6_addr *ndisc_nexthop(const struct in6_addr *dest);
+
+/* Send a neighbor solicitation for net_nd_sol_packet_ip6 */
+void ndisc_request(void);
+/* Send a router solicitation to all routers */
+void ndisc_send_rs(void);
+/**
+ * ndisc_slaac_start() - Start stateless address autoconfiguration
+ *
+ * Sends router solicitations until a router advertisement with an
+ * autonomous /64 prefix sets net_ip6 (and net_gateway6).
+ */
+void ndisc_slaac_start(void);
+/* Retry or give up a pending solicitation, 1 if one is pending */
+int ndisc_timeout_check(void);
+void ndisc_receive(struct ethernet_hdr *et, struct ip6_hdr *ip6, int len);
+
+#endif /* __NDISC_H__ */
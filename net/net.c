@@ -87,6 +87,8 @@
 #include <environment.h>
 #include <errno.h>
 #include <net.h>
+#include <net/mdist.h>
+#include <net6.h>
 #include <net/tftp.h>
 #if defined(CONFIG_LED_STATUS)
 #include <miiphy.h>
@@ -101,6 +103,9 @@
 #include "dns.h"
 #endif
 #include "link_local.h"
+#ifdef CONFIG_IPV6
+#include "ndisc.h"
+#endif
 #include "nfs.h"
 #include "ping.h"
 #include "rarp.h"
@@ -204,6 +209,57 @@ static int net_try_count;
 
 int __maybe_unused net_busy_flag;
 
+#ifdef CONFIG_NET_RX_ZEROCOPY
+/* Largest frame header we can save in front of a zero-copy payload */
+#define RX_DEST_HDR_MAX		64
+
+/* Where the next in-order payload belongs (NULL if not armed) */
+static uchar *rx_dest;
+static int rx_dest_len;
+static int rx_dest_hdr_len;
+/* Frame buffer handed out to the driver, and what it overlays */
+static uchar *rx_dest_claimed;
+static int rx_dest_claimed_hdr_len;
+static uchar rx_dest_save[RX_DEST_HDR_MAX];
+
+void net_rx_dest_set(void *dest, int len, int hdr_len)
+{
+	if (len <= 0 || hdr_len <= 0 || hdr_len > RX_DEST_HDR_MAX)
+		dest = NULL;
+	rx_dest = dest;
+	rx_dest_len = len;
+	rx_dest_hdr_len = hdr_len;
+}
+
+uchar *net_rx_dest_claim(int *maxlenp)
+{
+	if (!rx_dest || rx_dest_claimed)
+		return NULL;
+
+	/* The frame headers will overwrite whatever precedes the payload */
+	rx_dest_claimed = rx_dest - rx_dest_hdr_len;
+	rx_dest_claimed_hdr_len = rx_dest_hdr_len;
+	memcpy(rx_dest_save, rx_dest_claimed, rx_dest_claimed_hdr_len);
+	*maxlenp = rx_dest_hdr_len + rx_dest_len;
+
+	return rx_dest_claimed;
+}
+
+/*
+ * A claim only covers the frame the driver is passing up. Drop it after each
+ * frame, whatever was received into it, so that a buffer claimed for one
+ * payload position can never receive a later frame over data stored since.
+ */
+static void net_rx_dest_release(void)
+{
+	if (!rx_dest_claimed)
+		return;
+
+	memcpy(rx_dest_claimed, rx_dest_save, rx_dest_claimed_hdr_len);
+	rx_dest_claimed = NULL;
+}
+#endif
+
 /**********************************************************************/
 
 static int on_bootfile(const char *name, const char *value, enum env_op op,
@@ -344,6 +400,10 @@ static void net_init_loop(void)
 {
 	if (eth_get_dev())
 		memcpy(net_ethaddr, eth_get_ethaddr(), 6);
+	arp_init_loop();
+#ifdef CONFIG_IPV6
+	net_ip6_init();
+#endif
 
 	return;
 }
@@ -351,6 +411,9 @@ static void net_init_loop(void)
 static void net_clear_handlers(void)
 {
 	net_set_udp_handler(NULL);
+#ifdef CONFIG_IPV6
+	net_set_udp6_handler(NULL);
+#endif
 	net_set_arp_handler(NULL);
 	net_set_timeout_handler(0, NULL);
 }
@@ -377,6 +440,9 @@ void net_init(void)
 				(i + 1) * PKTSIZE_ALIGN;
 		}
 		arp_init();
+#ifdef CONFIG_IPV6
+		ndisc_init();
+#endif
 		net_clear_handlers();
 
 		/* Only need to setup buffer pointers once. */
@@ -479,6 +545,16 @@ restart:
 			ping_start();
 			break;
 #endif
+#if defined(CONFIG_CMD_PING6)
+		case PING6:
+			ping6_start();
+			break;
+#endif
+#ifdef CONFIG_IPV6
+		case SLAAC:
+			ndisc_slaac_start();
+			break;
+#endif
 #if defined(CONFIG_CMD_NFS)
 		case NFS:
 			nfs_start();
@@ -508,6 +584,19 @@ restart:
 		case LINKLOCAL:
 			link_local_start();
 			break;
+#endif
+#if defined(CONFIG_CMD_MDIST)
+		case MDISTSEND:
+			mdist_send_start();
+			break;
+		case MDISTRECV:
+			mdist_recv_start();
+			break;
+#endif
+#if defined(CONFIG_CMD_PXE_PARALLEL)
+		case TFTPPROBE:
+			tftp_probe_start();
+			break;
 #endif
 		default:
 			break;
@@ -544,6 +633,10 @@ restart:
 #endif
 		if (arp_timeout_check() > 0)
 			time_start = get_timer(0);
+#ifdef CONFIG_IPV6
+		if (ndisc_timeout_check() > 0)
+			time_start = get_timer(0);
+#endif
 
 		/*
 		 *	Check the ethernet for a new packet.  The ethernet
@@ -558,7 +651,7 @@ restart:
 		 */
 		if (ctrlc()) {
 			/* cancel any ARP that may not have completed */
-			net_arp_wait_packet_ip.s_addr = 0;
+			arp_queue_flush();
 
 			net_cleanup_loop();
 			eth_halt();
@@ -646,6 +739,10 @@ done:
 #ifdef CONFIG_USB_KEYBOARD
 	net_busy_flag = 0;
 #endif
+#ifdef CONFIG_NET_RX_ZEROCOPY
+	net_rx_dest_set(NULL, 0, 0);
+	net_rx_dest_release();
+#endif
 #ifdef CONFIG_CMD_TFTPPUT
 	/* Clear out the handlers */
 	net_set_udp_handler(NULL);
@@ -795,6 +892,9 @@ int net_send_udp_packet(uchar *ether, struct in_addr dest, int dport, int sport,
 	/* if broadcast, make the ether address a broadcast and don't do ARP */
 	if (dest.s_addr == 0xFFFFFFFF)
 		ether = (uchar *)net_bcast_ethaddr;
+	/* else the address may be known from an earlier net_loop() */
+	else if (memcmp(ether, net_null_ethaddr, 6) == 0)
+		arp_cache_lookup(dest, ether);
 
 	pkt = (uchar *)net_tx_packet;
 
@@ -807,17 +907,9 @@ int net_send_udp_packet(uchar *ether, struct in_addr dest, int dport, int sport,
 	if (memcmp(ether, net_null_ethaddr, 6) == 0) {
 		debug_cond(DEBUG_DEV_PKT, "sending ARP for %pI4\n", &dest);
 
-		/* save the ip and eth addr for the packet to send after arp */
-		net_arp_wait_packet_ip = dest;
-		arp_wait_packet_ethaddr = ether;
-
-		/* size of the waiting packet */
-		arp_wait_tx_packet_size = pkt_hdr_size + payload_len;
-
-		/* and do the ARP request */
-		arp_wait_try = 1;
-		arp_wait_timer_start = get_timer(0);
-		arp_request();
+		/* the packet is sent once the ARP reply fills in ether */
+		arp_queue_packet(dest, ether, net_tx_packet,
+				 pkt_hdr_size + payload_len);
 		return 1;	/* waiting */
 	} else {
 		debug_cond(DEBUG_DEV_PKT, "sending UDP to %pI4/%pM\n",
@@ -1026,7 +1118,7 @@ static void receive_icmp(struct ip_udp_hdr *ip, int len,
 	}
 }
 
-void net_process_received_packet(uchar *in_packet, int len)
+static void net_process_packet(uchar *in_packet, int len)
 {
 	struct ethernet_hdr *et;
 	struct ip_udp_hdr *ip;
@@ -1132,6 +1224,12 @@ void net_process_received_packet(uchar *in_packet, int len)
 		arp_receive(et, ip, len);
 		break;
 
+#ifdef CONFIG_IPV6
+	case PROT_IPV6:
+		net_ip6_handler(et, (struct ip6_hdr *)ip, len);
+		break;
+#endif
+
 #ifdef CONFIG_CMD_RARP
 	case PROT_RARP:
 		rarp_receive(ip, len);
@@ -1277,8 +1375,29 @@ void net_process_received_packet(uchar *in_packet, int len)
 	}
 }
 
+void net_process_received_packet(uchar *in_packet, int len)
+{
+	net_process_packet(in_packet, len);
+#ifdef CONFIG_NET_RX_ZEROCOPY
+	net_rx_dest_release();
+#endif
+}
+
 /**********************************************************************/
 
+#ifdef CONFIG_IPV6
+/* Sending beyond the local link needs a global address */
+static int net_check_prereq6(const struct in6_addr *dest)
+{
+	if (!ip6_is_link_local(dest) && ip6_is_unspecified(&net_ip6)) {
+		puts("*** ERROR: `ip6addr' not set\n");
+		return 1;
+	}
+
+	return 0;
+}
+#endif
+
 static int net_check_prereq(enum proto_t protocol)
 {
 	switch (protocol) {
@@ -1291,6 +1410,16 @@ static int net_check_prereq(enum proto_t protocol)
 		}
 		goto common;
 #endif
+#if defined(CONFIG_CMD_PING6)
+	case PING6:
+		if (ip6_is_unspecified(&net_ping_ip6)) {
+			puts("*** ERROR: ping address not given\n");
+			return 1;
+		}
+		if (net_check_prereq6(&net_ping_ip6))
+			return 1;
+		goto ethaddr;
+#endif
 #if defined(CONFIG_CMD_SNTP)
 	case SNTP:
 		if (net_ntp_server.s_addr == 0) {
@@ -1313,6 +1442,18 @@ static int net_check_prereq(enum proto_t protocol)
 		/* Fall through */
 	case TFTPGET:
 	case TFTPPUT:
+	case TFTPPROBE:
+#ifdef CONFIG_IPV6
+		if (net_use_ip6) {
+			if (ip6_is_unspecified(&net_server_ip6)) {
+				puts("*** ERROR: `serverip6' not set\n");
+				return 1;
+			}
+			if (net_check_prereq6(&net_server_ip6))
+				return 1;
+			goto ethaddr;
+		}
+#endif
 		if (net_server_ip.s_addr == 0) {
 			puts("*** ERROR: `serverip' not set\n");
 			return 1;
@@ -1325,12 +1466,18 @@ common:
 
 	case NETCONS:
 	case TFTPSRV:
+	case MDISTSEND:
+	case MDISTRECV:
 		if (net_ip.s_addr == 0) {
 			puts("*** ERROR: `ipaddr' not set\n");
 			return 1;
 		}
 		/* Fall through */
 
+#ifdef CONFIG_IPV6
+	case SLAAC:
+ethaddr:
+#endif
 #ifdef CONFIG_CMD_RARP
 	case RARP:
 #endif
@@ -0,0 +1,340 @@
+/*
+ * IPv6 support for the network stack
+ *
+ * Received IPv6 packets are handed over from net_process_received_packet().
+ * UDP payloads go to the handler set with net_set_udp6_handler(), which is
+ * given the IPv6 source address; protocols such as TFTP send with
+ * net_send_udp_packet6().
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <environment.h>
+#include <net.h>
+#include <net6.h>
+#include "ndisc.h"
+
+/* Our global IPv6 address (all zeros = unknown) */
+struct in6_addr net_ip6;
+/* Our link-local address, derived from our MAC address */
+struct in6_addr net_link_local_ip6;
+/* Prefix length of our global address */
+u32 net_prefix_length;
+/* Our gateway's IPv6 address */
+struct in6_addr net_gateway6;
+/* Server IPv6 address */
+struct in6_addr net_server_ip6;
+/* Use IPv6 rather than IPv4 for the next transfer */
+bool net_use_ip6;
+/* Current UDP over IPv6 RX packet handler */
+static rxhand6_f *udp6_packet_handler;
+
+static int on_ip6addr(const char *name, const char *value, enum env_op op,
+	int flags)
+{
+	if (flags & H_PROGRAMMATIC)
+		return 0;
+
+	if (op == env_op_delete) {
+		memset(&net_ip6, '\0', IN6ADDRSZ);
+		net_prefix_length = 0;
+		return 0;
+	}
+
+	return string_to_ip6(value, &net_ip6, &net_prefix_length);
+}
+U_BOOT_ENV_CALLBACK(ip6addr, on_ip6addr);
+
+static int on_gatewayip6(const char *name, const char *value, enum env_op op,
+	int flags)
+{
+	if (flags & H_PROGRAMMATIC)
+		return 0;
+
+	if (op == env_op_delete) {
+		memset(&net_gateway6, '\0', IN6ADDRSZ);
+		return 0;
+	}
+
+	return string_to_ip6(value, &net_gateway6, NULL);
+}
+U_BOOT_ENV_CALLBACK(gatewayip6, on_gatewayip6);
+
+static int on_serverip6(const char *name, const char *value, enum env_op op,
+	int flags)
+{
+	if (flags & H_PROGRAMMATIC)
+		return 0;
+
+	if (op == env_op_delete) {
+		memset(&net_server_ip6, '\0', IN6ADDRSZ);
+		return 0;
+	}
+
+	return string_to_ip6(value, &net_server_ip6, NULL);
+}
+U_BOOT_ENV_CALLBACK(serverip6, on_serverip6);
+
+void ip6_make_lladdr(struct in6_addr *lladdr, const u8 enetaddr[ARP_HLEN])
+{
+	memset(lladdr, '\0', IN6ADDRSZ);
+	lladdr->s6_addr[0] = 0xfe;
+	lladdr->s6_addr[1] = 0x80;
+	/* EUI-64 with the universal/local bit flipped */
+	lladdr->s6_addr[8] = enetaddr[0] ^ 0x02;
+	lladdr->s6_addr[9] = enetaddr[1];
+	lladdr->s6_addr[10] = enetaddr[2];
+	lladdr->s6_addr[11] = 0xff;
+	lladdr->s6_addr[12] = 0xfe;
+	lladdr->s6_addr[13] = enetaddr[3];
+	lladdr->s6_addr[14] = enetaddr[4];
+	lladdr->s6_addr[15] = enetaddr[5];
+}
+
+void ip6_make_snma(struct in6_addr *mcast, const struct in6_addr *addr)
+{
+	memset(mcast, '\0', IN6ADDRSZ);
+	mcast->s6_addr[0] = 0xff;
+	mcast->s6_addr[1] = 0x02;
+	mcast->s6_addr[11] = 0x01;
+	mcast->s6_addr[12] = 0xff;
+	mcast->s6_addr[13] = addr->s6_addr[13];
+	mcast->s6_addr[14] = addr->s6_addr[14];
+	mcast->s6_addr[15] = addr->s6_addr[15];
+}
+
+void ip6_make_mult_ethdstaddr(u8 enetaddr[ARP_HLEN],
+			      const struct in6_addr *mcast)
+{
+	enetaddr[0] = 0x33;
+	enetaddr[1] = 0x33;
+	memcpy(&enetaddr[2], &mcast->s6_addr[12], 4);
+}
+
+bool ip6_addr_in_subnet(const struct in6_addr *our,
+			const struct in6_addr *neigh, u32 prefix_len)
+{
+	u32 bytes = prefix_len / 8;
+	u8 mask;
+
+	if (prefix_len > 128 || memcmp(our, neigh, bytes))
+		return false;
+	if (!(prefix_len % 8))
+		return true;
+	mask = 0xff << (8 - prefix_len % 8);
+
+	return !((our->s6_addr[bytes] ^ neigh->s6_addr[bytes]) & mask);
+}
+
+__be16 net_ip6_checksum(const struct in6_addr *saddr,
+			const struct in6_addr *daddr, u16 len, u8 proto,
+			const void *payload)
+{
+	const u8 *p = payload;
+	u32 sum = len + proto;
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		sum += ntohs(saddr->s6_addr16[i]);
+		sum += ntohs(daddr->s6_addr16[i]);
+	}
+	while (len > 1) {
+		sum += (p[0] << 8) | p[1];
+		p += 2;
+		len -= 2;
+	}
+	if (len)
+		sum += p[0] << 8;
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+
+	return htons(~sum & 0xffff);
+}
+
+const struct in6_addr *net_ip6_src_for(const struct in6_addr *dest)
+{
+	/* Link-scope multicast counts as link-local */
+	if (ip6_is_unspecified(&net_ip6) || ip6_is_link_local(dest) ||
+	    (ip6_is_multicast(dest) && (dest->s6_addr[1] & 0x0f) == 0x02))
+		return &net_link_local_ip6;
+
+	return &net_ip6;
+}
+
+void net_set_ip6_header(uchar *pkt, const struct in6_addr *src,
+			const struct in6_addr *dest, u8 nextheader,
+			u8 hop_limit, int payload_len)
+{
+	struct ip6_hdr *ip6 = (struct ip6_hdr *)pkt;
+
+	ip6->ip6_flow = htonl(IP6_VERSION << 28);
+	ip6->payload_len = htons(payload_len);
+	ip6->nexthdr = nextheader;
+	ip6->hop_limit = hop_limit;
+	ip6->saddr = *src;
+	ip6->daddr = *dest;
+}
+
+int net_send_ip6_packet(uchar *ether, const struct in6_addr *dest, int len)
+{
+	u8 mcast_ethaddr[ARP_HLEN];
+	int eth_hdr_size;
+
+	if (ip6_is_multicast(dest)) {
+		ip6_make_mult_ethdstaddr(mcast_ethaddr, dest);
+		ether = mcast_ethaddr;
+	} else if (!memcmp(ether, net_null_ethaddr, ARP_HLEN) &&
+		   !ndisc_lookup(ndisc_nexthop(dest), ether)) {
+		debug_cond(DEBUG_DEV_PKT, "sending NS for %pI6\n", dest);
+
+		/* save the ip and eth addr for the packet to send after NA */
+		eth_hdr_size = net_set_ether(net_tx_packet, ether, PROT_IPV6);
+		net_nd_sol_packet_ip6 = *dest;
+		net_nd_packet_mac = ether;
+
+		/* size of the waiting packet */
+		net_nd_tx_packet_size = eth_hdr_size + len;
+
+		/* and do the neighbor solicitation */
+		net_nd_try = 1;
+		net_nd_timer_start = get_timer(0);
+		ndisc_request();
+		return 1;	/* waiting */
+	}
+
+	eth_hdr_size = net_set_ether(net_tx_packet, ether, PROT_IPV6);
+	debug_cond(DEBUG_DEV_PKT, "sending IPv6 to %pI6/%pM\n", dest, ether);
+	net_send_packet(net_tx_packet, eth_hdr_size + len);
+
+	return 0;	/* transmitted */
+}
+
+int net_send_udp_packet6(uchar *ether, const struct in6_addr *dest, int dport,
+			 int sport, int len)
+{
+	uchar *pkt = net_tx_packet + net_eth_hdr_size();
+	struct udp_hdr *udp = (struct udp_hdr *)(pkt + IP6_HDR_SIZE);
+	const struct in6_addr *src = net_ip6_src_for(dest);
+
+	len += sizeof(struct udp_hdr);
+	udp->udp_src = htons(sport);
+	udp->udp_dst = htons(dport);
+	udp->udp_len = htons(len);
+	udp->udp_xsum = 0;
+	udp->udp_xsum = net_ip6_checksum(src, dest, len, IPPROTO_UDP, udp);
+	/* A zero checksum is not allowed with IPv6 */
+	if (!udp->udp_xsum)
+		udp->udp_xsum = 0xffff;
+	net_set_ip6_header(pkt, src, dest, IPPROTO_UDP, IP6_HOP_LIMIT, len);
+
+	return net_send_ip6_packet(ether, dest, IP6_HDR_SIZE + len);
+}
+
+void net_set_udp6_handler(rxhand6_f *f)
+{
+	udp6_packet_handler = f;
+}
+
+static void net_ip6_echo_reply(struct ethernet_hdr *et, struct ip6_hdr *ip6,
+			       const struct in6_addr *sender, int len)
+{
+	struct icmp6_hdr *icmp = (struct icmp6_hdr *)(ip6 + 1);
+	const struct in6_addr *src = net_ip6_src_for(sender);
+	int eth_hdr_size;
+
+	/* Turn the request around in place */
+	eth_hdr_size = net_update_ether(et, et->et_src, PROT_IPV6);
+	net_copy_ip6(&ip6->daddr, sender);
+	net_copy_ip6(&ip6->saddr, src);
+	ip6->hop_limit = IP6_HOP_LIMIT;
+	icmp->icmp6_type = ICMPV6_ECHO_REPLY;
+	icmp->icmp6_cksum = 0;
+	icmp->icmp6_cksum = net_ip6_checksum(src, sender, len, IPPROTO_ICMPV6,
+					     icmp);
+	net_send_packet((uchar *)et, eth_hdr_size + IP6_HDR_SIZE + len);
+}
+
+void net_ip6_handler(struct ethernet_hdr *et, struct ip6_hdr *ip6, int len)
+{
+	struct in6_addr saddr, daddr;
+	struct icmp6_hdr *icmp;
+	struct udp_hdr *udp;
+	int plen;
+
+	debug_cond(DEBUG_NET_PKT, "Got IPv6\n");
+
+	if (len < IP6_HDR_SIZE ||
+	    (ntohl(ip6->ip6_flow) >> 28) != IP6_VERSION)
+		return;
+	plen = ntohs(ip6->payload_len);
+	if (plen > len - IP6_HDR_SIZE)
+		return;
+
+	/* The header need not be aligned, so work on copies of the addresses */
+	net_copy_ip6(&saddr, &ip6->saddr);
+	net_copy_ip6(&daddr, &ip6->daddr);
+
+	/* If it is not for us, ignore it; the MAC filter handles multicast */
+	if (!ip6_is_our_addr(&daddr) && !ip6_is_multicast(&daddr))
+		return;
+
+	switch (ip6->nexthdr) {
+	case IPPROTO_ICMPV6:
+		icmp = (struct icmp6_hdr *)(ip6 + 1);
+		if (plen < ICMP6_HDR_SIZE ||
+		    net_ip6_checksum(&saddr, &daddr, plen, IPPROTO_ICMPV6,
+				     icmp))
+			return;
+
+		switch (icmp->icmp6_type) {
+		case ICMPV6_ECHO_REQUEST:
+			if (ip6_is_our_addr(&daddr))
+				net_ip6_echo_reply(et, ip6, &saddr, plen);
+			break;
+#ifdef CONFIG_CMD_PING6
+		case ICMPV6_ECHO_REPLY:
+			ping6_receive(et, ip6, IP6_HDR_SIZE + plen);
+			break;
+#endif
+		case ICMPV6_NEIGHBOR_SOLICIT:
+		case ICMPV6_NEIGHBOR_ADVERT:
+		case ICMPV6_ROUTER_ADVERT:
+			ndisc_receive(et, ip6, IP6_HDR_SIZE + plen);
+			break;
+		}
+		break;
+
+	case IPPROTO_UDP:
+		udp = (struct udp_hdr *)(ip6 + 1);
+		if (plen < sizeof(struct udp_hdr) ||
+		    ntohs(udp->udp_len) < sizeof(struct udp_hdr) ||
+		    ntohs(udp->udp_len) > plen)
+			return;
+#ifdef CONFIG_UDP_CHECKSUM
+		if (net_ip6_checksum(&saddr, &daddr, ntohs(udp->udp_len),
+				     IPPROTO_UDP, udp)) {
+			printf(" UDP wrong checksum %04x\n",
+			       ntohs(udp->udp_xsum));
+			return;
+		}
+#endif
+		debug_cond(DEBUG_DEV_PKT,
+			   "received UDP (to=%pI6, from=%pI6, len=%d)\n",
+			   &daddr, &saddr, plen);
+
+		if (udp6_packet_handler)
+			udp6_packet_handler((uchar *)(udp + 1),
+					    ntohs(udp->udp_dst), &saddr,
+					    ntohs(udp->udp_src),
+					    ntohs(udp->udp_len) -
+					    sizeof(struct udp_hdr));
+		break;
+	}
+}
+
+void net_ip6_init(void)
+{
+	ip6_make_lladdr(&net_link_local_ip6, net_ethaddr);
+	ndisc_init_loop();
+}
@@ -41,27 +41,28 @@ static void set_icmp_header(uchar *pkt, struct in_addr dest)
 
 static int ping_send(void)
 {
+	uchar ethaddr[ARP_HLEN];
 	uchar *pkt;
 	int eth_hdr_size;
 
-	/* XXX always send arp request */
+	if (!arp_cache_lookup(net_ping_ip, ethaddr))
+		memcpy(ethaddr, net_null_ethaddr, ARP_HLEN);
 
-	debug_cond(DEBUG_DEV_PKT, "sending ARP for %pI4\n", &net_ping_ip);
-
-	net_arp_wait_packet_ip = net_ping_ip;
-
-	eth_hdr_size = net_set_ether(net_tx_packet, net_null_ethaddr, PROT_IP);
+	eth_hdr_size = net_set_ether(net_tx_packet, ethaddr, PROT_IP);
 	pkt = (uchar *)net_tx_packet + eth_hdr_size;
 
 	set_icmp_header(pkt, net_ping_ip);
 
-	/* size of the waiting packet */
-	arp_wait_tx_packet_size = eth_hdr_size + IP_ICMP_HDR_SIZE;
+	if (memcmp(ethaddr, net_null_ethaddr, ARP_HLEN)) {
+		net_send_packet(net_tx_packet, eth_hdr_size + IP_ICMP_HDR_SIZE);
+		return 0;	/* transmitted */
+	}
+
+	debug_cond(DEBUG_DEV_PKT, "sending ARP for %pI4\n", &net_ping_ip);
 
 	/* and do the ARP request */
-	arp_wait_try = 1;
-	arp_wait_timer_start = get_timer(0);
-	arp_request();
+	arp_queue_packet(net_ping_ip, NULL, net_tx_packet,
+			 eth_hdr_size + IP_ICMP_HDR_SIZE);
 	return 1;	/* waiting */
 }
 
@@ -0,0 +1,70 @@
+/*
+ * ICMPv6 echo (ping6)
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <net.h>
+#include <net6.h>
+
+/* Identifier of our echo requests, so that replies to others are ignored */
+#define PING6_ID		0x7562
+
+static ushort ping6_seq_number;
+/* Filled in by neighbor discovery while the request waits */
+static uchar ping6_ethaddr[ARP_HLEN];
+
+/* The address to ping */
+struct in6_addr net_ping_ip6;
+
+static int ping6_send(void)
+{
+	uchar *pkt = net_tx_packet + net_eth_hdr_size();
+	struct icmp6_hdr *icmp = (struct icmp6_hdr *)(pkt + IP6_HDR_SIZE);
+	const struct in6_addr *src = net_ip6_src_for(&net_ping_ip6);
+
+	icmp->icmp6_type = ICMPV6_ECHO_REQUEST;
+	icmp->icmp6_code = 0;
+	icmp->icmp6_cksum = 0;
+	icmp->icmp6_dataun.echo.id = htons(PING6_ID);
+	icmp->icmp6_dataun.echo.sequence = htons(ping6_seq_number++);
+	icmp->icmp6_cksum = net_ip6_checksum(src, &net_ping_ip6,
+					     ICMP6_HDR_SIZE, IPPROTO_ICMPV6,
+					     icmp);
+	net_set_ip6_header(pkt, src, &net_ping_ip6, IPPROTO_ICMPV6,
+			   IP6_HOP_LIMIT, ICMP6_HDR_SIZE);
+
+	memcpy(ping6_ethaddr, net_null_ethaddr, ARP_HLEN);
+	return net_send_ip6_packet(ping6_ethaddr, &net_ping_ip6,
+				   IP6_HDR_SIZE + ICMP6_HDR_SIZE);
+}
+
+static void ping6_timeout_handler(void)
+{
+	eth_halt();
+	net_set_state(NETLOOP_FAIL);	/* we did not get the reply */
+}
+
+void ping6_start(void)
+{
+	printf("Using %s device\n", eth_get_name());
+	net_set_timeout_handler(10000UL, ping6_timeout_handler);
+
+	ping6_send();
+}
+
+void ping6_receive(struct ethernet_hdr *et, struct ip6_hdr *ip6, int len)
+{
+	struct icmp6_hdr *icmp = (struct icmp6_hdr *)(ip6 + 1);
+
+	/* Only a reply to the request we sent last counts */
+	if (len < IP6_HDR_SIZE + ICMP6_HDR_SIZE ||
+	    memcmp(&ip6->saddr, &net_ping_ip6, IN6ADDRSZ) ||
+	    ntohs(icmp->icmp6_dataun.echo.id) != PING6_ID ||
+	    ntohs(icmp->icmp6_dataun.echo.sequence) !=
+			(ushort)(ping6_seq_number - 1))
+		return;
+
+	net_set_state(NETLOOP_SUCCESS);
+}
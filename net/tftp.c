@@ -12,6 +12,7 @@
 #include <mapmem.h>
 #include <net.h>
 #include <net/tftp.h>
+#include <net6.h>
 #include "bootp.h"
 #ifdef CONFIG_SYS_DIRECT_FLASH_TFTP
 #include <flash.h>
@@ -67,6 +68,9 @@ enum {
 };
 
 static struct in_addr tftp_remote_ip;
+#ifdef CONFIG_IPV6
+static struct in6_addr tftp_remote_ip6;
+#endif
 /* The UDP port at their end */
 static int	tftp_remote_port;
 /* The UDP port at our end */
@@ -162,8 +166,40 @@ static void mcast_cleanup(void)
 	tftp_mcast_ending_block = -1;
 }
 
+#else
+#define tftp_mcast_active	0
 #endif	/* CONFIG_MCAST_TFTP */
 
+static inline int tftp_udp_hdr_size(void)
+{
+	return net_use_ip6 ? IP6_UDP_HDR_SIZE : IP_UDP_HDR_SIZE;
+}
+
+#ifdef CONFIG_NET_RX_ZEROCOPY
+/*
+ * Tell the network core where the next in-order data block belongs, so that
+ * a capable driver can receive its payload there directly. This needs the
+ * size of the file: a short frame is padded on the wire, and receiving the
+ * padding of the last block in place would write past the end of the file.
+ */
+static void tftp_expect_block(int block)
+{
+#ifdef CONFIG_TFTP_TSIZE
+	ulong offset = block * tftp_block_size + tftp_block_wrap_offset;
+	int hdr_len = net_eth_hdr_size() + tftp_udp_hdr_size() + 4;
+	ulong len;
+
+	if (tftp_tsize && offset < tftp_tsize) {
+		len = min_t(ulong, tftp_block_size, tftp_tsize - offset);
+		net_rx_dest_set(map_sysmem(load_addr + offset, len), len,
+				hdr_len);
+		return;
+	}
+#endif
+	net_rx_dest_set(NULL, 0, 0);
+}
+#endif
+
 static inline void store_block(int block, uchar *src, unsigned len)
 {
 	ulong offset = block * tftp_block_size + tftp_block_wrap_offset;
@@ -193,8 +229,21 @@ static inline void store_block(int block, uchar *src, unsigned len)
 	{
 		void *ptr = map_sysmem(load_addr + offset, len);
 
+#ifdef CONFIG_NET_RX_ZEROCOPY
+		/* The payload may already have been received in place */
+		if (ptr != src)
+			memmove(ptr, src, len);
+#else
 		memcpy(ptr, src, len);
+#endif
 		unmap_sysmem(ptr);
+#ifdef CONFIG_NET_RX_ZEROCOPY
+		/* Expect the following block unless this was the last one */
+		if (!tftp_mcast_active && len == tftp_block_size)
+			tftp_expect_block(block + 1);
+		else
+			net_rx_dest_set(NULL, 0, 0);
+#endif
 	}
 #ifdef CONFIG_MCAST_TFTP
 	if (tftp_mcast_active)
@@ -342,7 +391,7 @@ static void tftp_send(void)
 	 *	We will always be sending some sort of packet, so
 	 *	cobble together the packet headers now.
 	 */
-	pkt = net_tx_packet + net_eth_hdr_size() + IP_UDP_HDR_SIZE;
+	pkt = net_tx_packet + net_eth_hdr_size() + tftp_udp_hdr_size();
 
 	switch (tftp_state) {
 	case STATE_SEND_RRQ:
@@ -441,6 +490,13 @@ static void tftp_send(void)
 		break;
 	}
 
+#ifdef CONFIG_IPV6
+	if (net_use_ip6) {
+		net_send_udp_packet6(net_server_ethaddr, &tftp_remote_ip6,
+				     tftp_remote_port, tftp_our_port, len);
+		return;
+	}
+#endif
 	net_send_udp_packet(net_server_ethaddr, tftp_remote_ip,
 			    tftp_remote_port, tftp_our_port, len);
 }
@@ -683,6 +739,20 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 }
 
 
+#ifdef CONFIG_IPV6
+static void tftp_handler6(uchar *pkt, unsigned dest,
+			  const struct in6_addr *sip, unsigned src,
+			  unsigned len)
+{
+	/* Only the server we asked may answer */
+	if (memcmp(sip, &tftp_remote_ip6, IN6ADDRSZ))
+		return;
+
+	/* The IPv4 address is only used by the TFTP server, not over IPv6 */
+	tftp_handler(pkt, dest, tftp_remote_ip, src, len);
+}
+#endif
+
 static void tftp_timeout_handler(void)
 {
 	if (++timeout_count > timeout_count_max) {
@@ -695,21 +765,15 @@ static void tftp_timeout_handler(void)
 	}
 }
 
-
-void tftp_start(enum proto_t protocol)
-{
 #if CONFIG_NET_TFTP_VARS
+/*
+ * Allow the user to choose the TFTP timeout.
+ * TFTP protocol has a minimal timeout of 1 second.
+ */
+static void tftp_env_timeouts(void)
+{
 	char *ep;             /* Environment pointer */
 
-	/*
-	 * Allow the user to choose TFTP blocksize and timeout.
-	 * TFTP protocol has a minimal timeout of 1 second.
-	 */
-
-	ep = env_get("tftpblocksize");
-	if (ep != NULL)
-		tftp_block_size_option = simple_strtol(ep, NULL, 10);
-
 	ep = env_get("tftptimeout");
 	if (ep != NULL)
 		timeout_ms = simple_strtol(ep, NULL, 10);
@@ -729,12 +793,30 @@ void tftp_start(enum proto_t protocol)
 		       tftp_timeout_count_max);
 		tftp_timeout_count_max = 0;
 	}
+}
+#endif
+
+void tftp_start(enum proto_t protocol)
+{
+	const char *direction = "from";
+#if CONFIG_NET_TFTP_VARS
+	char *ep;             /* Environment pointer */
+
+	/* Allow the user to choose TFTP blocksize and timeout */
+	ep = env_get("tftpblocksize");
+	if (ep != NULL)
+		tftp_block_size_option = simple_strtol(ep, NULL, 10);
+
+	tftp_env_timeouts();
 #endif
 
 	debug("TFTP blocksize = %i, timeout = %ld ms\n",
 	      tftp_block_size_option, timeout_ms);
 
 	tftp_remote_ip = net_server_ip;
+#ifdef CONFIG_IPV6
+	tftp_remote_ip6 = net_server_ip6;
+#endif
 	if (net_boot_file_name[0] == '\0') {
 		sprintf(default_filename, "%02X%02X%02X%02X.img",
 			net_ip.s_addr & 0xFF,
@@ -750,6 +832,9 @@ void tftp_start(enum proto_t protocol)
 	} else {
 		char *p = strchr(net_boot_file_name, ':');
 
+		/* An IPv6 server always comes from serverip6 */
+		if (net_use_ip6)
+			p = NULL;
 		if (p == NULL) {
 			strncpy(tftp_filename, net_boot_file_name, MAX_LEN);
 			tftp_filename[MAX_LEN - 1] = 0;
@@ -761,16 +846,22 @@ void tftp_start(enum proto_t protocol)
 	}
 
 	printf("Using %s device\n", eth_get_name());
-	printf("TFTP %s server %pI4; our IP address is %pI4",
 #ifdef CONFIG_CMD_TFTPPUT
-	       protocol == TFTPPUT ? "to" : "from",
-#else
-	       "from",
+	if (protocol == TFTPPUT)
+		direction = "to";
 #endif
-	       &tftp_remote_ip, &net_ip);
+	printf("TFTP %s server ", direction);
+#ifdef CONFIG_IPV6
+	if (net_use_ip6)
+		printf("%pI6; our IPv6 address is %pI6", &tftp_remote_ip6,
+		       net_ip6_src_for(&tftp_remote_ip6));
+	else
+#endif
+		printf("%pI4; our IP address is %pI4", &tftp_remote_ip,
+		       &net_ip);
 
 	/* Check if we need to send across this subnet */
-	if (net_gateway.s_addr && net_netmask.s_addr) {
+	if (!net_use_ip6 && net_gateway.s_addr && net_netmask.s_addr) {
 		struct in_addr our_net;
 		struct in_addr remote_net;
 
@@ -815,6 +906,13 @@ void tftp_start(enum proto_t protocol)
 
 	net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
 	net_set_udp_handler(tftp_handler);
+#ifdef CONFIG_IPV6
+	if (net_use_ip6)
+		net_set_udp6_handler(tftp_handler6);
+#endif
+#ifdef CONFIG_NET_RX_ZEROCOPY
+	net_rx_dest_set(NULL, 0, 0);
+#endif
 #ifdef CONFIG_CMD_TFTPPUT
 	net_set_icmp_handler(icmp_handler);
 #endif
@@ -882,6 +980,194 @@ void tftp_start_server(void)
 }
 #endif /* CONFIG_CMD_TFTPSRV */
 
+#ifdef CONFIG_CMD_PXE_PARALLEL
+/*
+ * Ask for a list of files at once, each read request going out from its own
+ * source port, to find the first one in the list that the server has. Only
+ * the first data packet of each file is waited for; the transfer is then
+ * cut short with an error packet and the file found is fetched as usual.
+ */
+const char *tftp_probe_names[TFTP_PROBE_MAX];
+int tftp_probe_count;
+int tftp_probe_found;
+
+enum {
+	PROBE_PENDING,
+	PROBE_MISSING,
+	PROBE_FOUND,
+};
+
+static u8 probe_state[TFTP_PROBE_MAX];
+static int probe_port;		/* Source port of the first request */
+static int probe_next;		/* Next request to send */
+
+static int probe_send_rrq(int i)
+{
+	uchar *pkt = net_tx_packet + net_eth_hdr_size() + IP_UDP_HDR_SIZE;
+	uchar *xp = pkt;
+	__be16 *s = (__be16 *)pkt;
+
+	*s++ = htons(TFTP_RRQ);
+	pkt = (uchar *)s;
+	strcpy((char *)pkt, tftp_probe_names[i]);
+	pkt += strlen(tftp_probe_names[i]) + 1;
+	strcpy((char *)pkt, "octet");
+	pkt += 5 /*strlen("octet")*/ + 1;
+
+	return net_send_udp_packet(net_server_ethaddr, net_server_ip,
+				   tftp_remote_port, probe_port + i, pkt - xp);
+}
+
+/*
+ * Send the requests still unanswered. This stops when the server's MAC
+ * address must be looked up first, the rest follow once ARP is done.
+ */
+static void probe_send(void)
+{
+	for (; probe_next < tftp_probe_count; probe_next++) {
+		if (probe_state[probe_next] != PROBE_PENDING)
+			continue;
+		if (probe_send_rrq(probe_next) == 1) {
+			probe_next++;
+			return;
+		}
+	}
+}
+
+static void probe_arp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
+			      unsigned src, unsigned len)
+{
+	probe_send();
+}
+
+/* Finish once every file before the first one found is known missing */
+static void probe_check(void)
+{
+	int i;
+
+	for (i = 0; i < tftp_probe_count; i++) {
+		switch (probe_state[i]) {
+		case PROBE_MISSING:
+			continue;
+		case PROBE_FOUND:
+			tftp_probe_found = i;
+			printf("Found '%s'\n", tftp_probe_names[i]);
+			net_set_state(NETLOOP_SUCCESS);
+			return;
+		default:
+			return;
+		}
+	}
+
+	puts("None of the files found\n");
+	net_set_state(NETLOOP_FAIL);
+}
+
+static void probe_timeout_handler(void)
+{
+	int i;
+
+	if (++timeout_count > timeout_count_max) {
+		/* Treat the files never answered for as missing */
+		for (i = 0; i < tftp_probe_count; i++)
+			if (probe_state[i] == PROBE_PENDING)
+				probe_state[i] = PROBE_MISSING;
+		probe_check();
+		return;
+	}
+
+	puts("T ");
+	net_set_timeout_handler(timeout_ms, probe_timeout_handler);
+	probe_next = 0;
+	probe_send();
+}
+
+static void probe_handler(uchar *pkt, unsigned dest, struct in_addr sip,
+			  unsigned src, unsigned len)
+{
+	__be16 *s = (__be16 *)pkt;
+	uchar *xp;
+	int i = dest - probe_port;
+
+	/* Replies can still arrive after the file wanted was found */
+	if (i < 0 || i >= tftp_probe_count || len < 2 ||
+	    probe_state[i] != PROBE_PENDING || tftp_probe_found >= 0)
+		return;
+
+	switch (ntohs(*s)) {
+	case TFTP_ERROR:
+		debug("Not found: %s\n", tftp_probe_names[i]);
+		probe_state[i] = PROBE_MISSING;
+		break;
+	case TFTP_DATA:
+	case TFTP_OACK:
+		probe_state[i] = PROBE_FOUND;
+
+		/* The file is fetched later, stop sending it now */
+		xp = net_tx_packet + net_eth_hdr_size() + IP_UDP_HDR_SIZE;
+		s = (__be16 *)xp;
+		*s++ = htons(TFTP_ERROR);
+		*s++ = htons(TFTP_ERR_UNDEFINED);
+		pkt = (uchar *)s;
+		strcpy((char *)pkt, "Probe only");
+		pkt += 10 /*strlen("Probe only")*/ + 1;
+		net_send_udp_packet(net_server_ethaddr, sip, src, dest,
+				    pkt - xp);
+		break;
+	default:
+		return;
+	}
+
+	probe_check();
+}
+
+void tftp_probe_start(void)
+{
+	int i;
+#ifdef CONFIG_TFTP_PORT
+	char *ep;
+#endif
+
+	printf("Using %s device\n", eth_get_name());
+	printf("TFTP from server %pI4; our IP address is %pI4\n",
+	       &net_server_ip, &net_ip);
+	printf("Looking for %d files at once\n", tftp_probe_count);
+
+#if CONFIG_NET_TFTP_VARS
+	tftp_env_timeouts();
+#endif
+
+	tftp_remote_port = WELL_KNOWN_PORT;
+	probe_port = 1024 + (get_timer(0) % (3072 - TFTP_PROBE_MAX));
+#ifdef CONFIG_TFTP_PORT
+	ep = env_get("tftpdstp");
+	if (ep != NULL)
+		tftp_remote_port = simple_strtol(ep, NULL, 10);
+#endif
+
+	for (i = 0; i < tftp_probe_count; i++)
+		probe_state[i] = PROBE_PENDING;
+	tftp_probe_found = -1;
+	probe_next = 0;
+	timeout_count = 0;
+	timeout_count_max = tftp_timeout_count_max;
+
+	net_set_timeout_handler(timeout_ms, probe_timeout_handler);
+	net_set_udp_handler(probe_handler);
+	net_set_arp_handler(probe_arp_handler);
+#ifdef CONFIG_NET_RX_ZEROCOPY
+	net_rx_dest_set(NULL, 0, 0);
+#endif
+
+	/* zero out server ether in case the server ip has changed */
+	memset(net_server_ethaddr, 0, 6);
+	if (!tftp_probe_count)
+		probe_check();
+	else
+		probe_send();
+}
+#endif /* CONFIG_CMD_PXE_PARALLEL */
+
 #ifdef CONFIG_MCAST_TFTP
 /*
  * Credits: atftp project.
@@ -0,0 +1,162 @@
+/*
+ * Tests for the ECC engine uclass
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <ecc_engine.h>
+#include <malloc.h>
+#include <dm/test.h>
+#include <test/ut.h>
+
+#define ECC_TEST_PAGE_SIZE	4096
+#define ECC_TEST_MAX_ECC	64
+#define ECC_TEST_MAX_BITS	32
+
+/* Flip @count different bits in @data of @len bytes */
+static void ecc_test_flip(u8 *data, unsigned int len, int count,
+			  unsigned int *seed)
+{
+	unsigned int bits[ECC_TEST_MAX_BITS];
+	int i, j;
+
+	for (i = 0; i < count; i++) {
+		do {
+			bits[i] = rand_r(seed) % (len * 8);
+			for (j = 0; j < i; j++) {
+				if (bits[j] == bits[i])
+					break;
+			}
+		} while (j < i);
+		data[bits[i] >> 3] ^= 1 << (bits[i] & 7);
+	}
+}
+
+/* Test finding engines and correcting errors */
+static int dm_test_ecc_engine_base(struct unit_test_state *uts)
+{
+	struct ecc_engine_uc_priv *uc_priv;
+	u8 read_ecc[ECC_TEST_MAX_ECC], calc_ecc[ECC_TEST_MAX_ECC];
+	u8 data[512], orig[512];
+	struct udevice *dev;
+	unsigned int seed = 1;
+	unsigned int i;
+
+	ut_assertok(ecc_engine_find(512, 4, &dev));
+	uc_priv = dev_get_uclass_priv(dev);
+	ut_asserteq(4, uc_priv->strength);
+	ut_asserteq(7, uc_priv->bytes);
+
+	ut_assertok(ecc_engine_find(512, 6, &dev));
+	uc_priv = dev_get_uclass_priv(dev);
+	ut_asserteq(8, uc_priv->strength);
+	ut_asserteq(13, uc_priv->bytes);
+	ut_asserteq(-ENODEV, ecc_engine_find(1024, 32, &dev));
+
+	for (i = 0; i < sizeof(orig); i++)
+		orig[i] = rand_r(&seed);
+	ut_assertok(ecc_engine_calculate(dev, orig, read_ecc));
+
+	/* Nothing to correct */
+	memcpy(data, orig, sizeof(data));
+	ut_assertok(ecc_engine_calculate(dev, data, calc_ecc));
+	ut_asserteq(0, ecc_engine_correct(dev, data, read_ecc, calc_ecc));
+	ut_assertok(memcmp(orig, data, sizeof(data)));
+
+	/* As many errors as the strength allows, some of them in the ECC */
+	memcpy(data, orig, sizeof(data));
+	ecc_test_flip(data, sizeof(data), 6, &seed);
+	ecc_test_flip(read_ecc, uc_priv->bytes - 1, 2, &seed);
+	ut_assertok(ecc_engine_calculate(dev, data, calc_ecc));
+	ut_asserteq(8, ecc_engine_correct(dev, data, read_ecc, calc_ecc));
+	ut_assertok(memcmp(orig, data, sizeof(data)));
+
+	/* One error too many */
+	ut_assertok(ecc_engine_calculate(dev, orig, read_ecc));
+	memcpy(data, orig, sizeof(data));
+	ecc_test_flip(data, sizeof(data), 9, &seed);
+	ut_assertok(ecc_engine_calculate(dev, data, calc_ecc));
+	ut_asserteq(-EBADMSG, ecc_engine_correct(dev, data, read_ecc,
+						 calc_ecc));
+
+	/* An erased step is a valid codeword */
+	memset(data, 0xff, sizeof(data));
+	memset(read_ecc, 0xff, uc_priv->bytes);
+	ut_assertok(ecc_engine_calculate(dev, data, calc_ecc));
+	ut_assertok(memcmp(read_ecc, calc_ecc, uc_priv->bytes));
+	ut_asserteq(0, ecc_engine_correct(dev, data, read_ecc, calc_ecc));
+
+	return 0;
+}
+DM_TEST(dm_test_ecc_engine_base, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/*
+ * Measure how many pages per second each engine can decode when every step
+ * has as many errors as it can correct
+ */
+static int dm_test_ecc_engine_bench(struct unit_test_state *uts)
+{
+	const int pages = 16;
+	struct ecc_engine_uc_priv *uc_priv;
+	u8 calc_ecc[ECC_TEST_MAX_ECC];
+	u8 *data, *orig, *read_ecc;
+	struct udevice *dev;
+	unsigned int steps, i;
+	unsigned int seed = 1;
+	ulong start, us;
+	int page;
+
+	data = malloc(ECC_TEST_PAGE_SIZE);
+	orig = malloc(ECC_TEST_PAGE_SIZE);
+	read_ecc = malloc(ECC_TEST_PAGE_SIZE / 512 * ECC_TEST_MAX_ECC);
+	ut_assertnonnull(data);
+	ut_assertnonnull(orig);
+	ut_assertnonnull(read_ecc);
+	for (i = 0; i < ECC_TEST_PAGE_SIZE; i++)
+		orig[i] = rand_r(&seed);
+
+	for (uclass_first_device(UCLASS_ECC_ENGINE, &dev); dev;
+	     uclass_next_device(&dev)) {
+		uc_priv = dev_get_uclass_priv(dev);
+		steps = ECC_TEST_PAGE_SIZE / uc_priv->step_size;
+		for (i = 0; i < steps; i++)
+			ut_assertok(ecc_engine_calculate(dev,
+					orig + i * uc_priv->step_size,
+					read_ecc + i * uc_priv->bytes));
+
+		us = 0;
+		for (page = 0; page < pages; page++) {
+			memcpy(data, orig, ECC_TEST_PAGE_SIZE);
+			for (i = 0; i < steps; i++)
+				ecc_test_flip(data + i * uc_priv->step_size,
+					      uc_priv->step_size,
+					      uc_priv->strength, &seed);
+
+			start = timer_get_us();
+			for (i = 0; i < steps; i++) {
+				u8 *step = data + i * uc_priv->step_size;
+
+				ut_assertok(ecc_engine_calculate(dev, step,
+								 calc_ecc));
+				ut_asserteq(uc_priv->strength,
+					    ecc_engine_correct(dev, step,
+						read_ecc + i * uc_priv->bytes,
+						calc_ecc));
+			}
+			us += timer_get_us() - start;
+			ut_assertok(memcmp(orig, data, ECC_TEST_PAGE_SIZE));
+		}
+		printf("%s: %u bits/%u bytes: %lu pages/s\n", dev->name,
+		       uc_priv->strength, uc_priv->step_size,
+		       us ? pages * 1000000UL / us : 0);
+	}
+
+	free(read_ecc);
+	free(orig);
+	free(data);
+
+	return 0;
+}
+DM_TEST(dm_test_ecc_engine_bench, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
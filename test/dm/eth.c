@@ -8,10 +8,16 @@
  */
 
 #include <common.h>
+#include <command.h>
+#include <console.h>
 #include <dm.h>
 #include <fdtdec.h>
 #include <malloc.h>
+#include <mapmem.h>
+#include <membuff.h>
 #include <net.h>
+#include <net/mdist.h>
+#include <net6.h>
 #include <dm/test.h>
 #include <dm/device-internal.h>
 #include <dm/uclass-internal.h>
@@ -42,6 +48,459 @@ static int dm_test_eth(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_eth, DM_TESTF_SCAN_FDT);
 
+#ifdef CONFIG_NET_RX_ZEROCOPY
+static int dm_test_eth_rx_in_place(struct unit_test_state *uts)
+{
+	uchar buf[256];
+	uchar *dest = buf + 128;
+	int i;
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = i;
+
+	/* Ask for the IP header of each frame to land at dest */
+	net_rx_dest_set(dest, sizeof(buf) - 128, ETHER_HDR_SIZE);
+	net_ping_ip = string_to_ip("1.1.2.2");
+	env_set("ethact", "eth@10002000");
+	ut_assertok(net_loop(PING));
+
+	/* The last frame (the ping reply) was received in place */
+	ut_asserteq(0x45, dest[0]);
+
+	/* and whatever its Ethernet header overlaid has been put back */
+	for (i = 0; i < 128; i++)
+		ut_asserteq(i, buf[i]);
+
+	return 0;
+}
+DM_TEST(dm_test_eth_rx_in_place, DM_TESTF_SCAN_FDT);
+
+/* A claim does not outlive the next frame, even one from another buffer */
+static int dm_test_eth_rx_claim_per_frame(struct unit_test_state *uts)
+{
+	uchar frame[ETHER_HDR_SIZE + ARP_HDR_SIZE];
+	uchar buf[256];
+	uchar *dest = buf + 128;
+	uchar *claimed;
+	int i, maxlen;
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = i;
+
+	net_rx_dest_set(dest, sizeof(buf) - 128, ETHER_HDR_SIZE);
+	claimed = net_rx_dest_claim(&maxlen);
+	ut_asserteq_ptr(dest - ETHER_HDR_SIZE, claimed);
+	ut_asserteq_ptr(NULL, net_rx_dest_claim(&maxlen));
+	memset(claimed, '\xff', ETHER_HDR_SIZE);
+
+	/* An unrelated frame from the driver's own buffer */
+	memset(frame, '\0', sizeof(frame));
+	net_set_ether(frame, net_bcast_ethaddr, PROT_ARP);
+	net_process_received_packet(frame, sizeof(frame));
+
+	/* The claim is gone and what it overlaid is back */
+	for (i = 0; i < 128; i++)
+		ut_asserteq(i, buf[i]);
+	ut_asserteq_ptr(claimed, net_rx_dest_claim(&maxlen));
+	net_process_received_packet(claimed, ETHER_HDR_SIZE);
+	net_rx_dest_set(NULL, 0, 0);
+
+	return 0;
+}
+DM_TEST(dm_test_eth_rx_claim_per_frame, DM_TESTF_SCAN_FDT);
+
+static int _dm_test_eth_tftp_in_place(struct unit_test_state *uts)
+{
+	/* Ending with a full block, then with a block shorter than padding */
+	const int sizes[] = { 1024, 1029 };
+	const ulong addr = 0x100000;
+	static u8 data[1029];
+	u8 *buf;
+	int i, j;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i * 7 + (i >> 8);
+	buf = map_sysmem(addr, 0x1000);
+	env_set("ethact", "eth@10002000");
+	net_server_ip = string_to_ip("1.1.2.2");
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		sandbox_eth_tftp_reset();
+		ut_assertok(sandbox_eth_tftp_add("img", data, sizes[i]));
+		memset(buf, 0xaa, 0x1000);
+		ut_assertok(run_command("tftpboot 100000 img", 0));
+		ut_asserteq(sizes[i], env_get_hex("filesize", 0));
+		ut_assertok(memcmp(data, buf, sizes[i]));
+
+		/* Nothing was received past the end of the file */
+		for (j = sizes[i]; j < 0x1000; j++)
+			ut_asserteq(0xaa, buf[j]);
+	}
+	unmap_sysmem(buf);
+
+	return 0;
+}
+
+static int dm_test_eth_tftp_in_place(struct unit_test_state *uts)
+{
+	struct in_addr old_server_ip = net_server_ip;
+	int ret;
+
+	ret = _dm_test_eth_tftp_in_place(uts);
+
+	/* Restore the fake host */
+	net_server_ip = old_server_ip;
+	sandbox_eth_tftp_reset();
+
+	return ret;
+}
+DM_TEST(dm_test_eth_tftp_in_place, DM_TESTF_SCAN_FDT);
+#endif
+
+#ifdef CONFIG_CMD_MDIST
+/* Send one round of a distribution stream, dropping the listed packets */
+static int mdist_feed_round(struct unit_test_state *uts, ulong addr,
+			    ulong size, const uint *drop, int drop_count)
+{
+	uchar frame[PKTSIZE_ALIGN];
+	uchar *pkt = frame + ETHER_HDR_SIZE + IP_UDP_HDR_SIZE;
+	struct in_addr bcast = { .s_addr = 0xffffffff };
+	uint index;
+	int i, len;
+
+	for (index = 0; ; index++) {
+		len = mdist_fill_packet(pkt, addr, size, MDIST_BLOCK_SIZE_MAX,
+					MDIST_GROUP_SIZE, index);
+		if (len == -ENOENT)
+			break;
+		/* Full packets must fit in the MTU without fragmenting */
+		ut_assert(IP_UDP_HDR_SIZE + len <= 1500);
+		for (i = 0; i < drop_count; i++) {
+			if (drop[i] == index)
+				len = 0;
+		}
+		if (!len)
+			continue;
+		net_set_ether(frame, net_bcast_ethaddr, PROT_IP);
+		net_set_udp_header(frame + ETHER_HDR_SIZE, bcast, MDIST_PORT,
+				   MDIST_PORT, len);
+		net_process_received_packet(frame, ETHER_HDR_SIZE +
+					    IP_UDP_HDR_SIZE + len);
+	}
+
+	return 0;
+}
+
+static int dm_test_eth_mdist(struct unit_test_state *uts)
+{
+	/* 14 blocks, the first group of 8 and a short second group */
+	const ulong size = 20000;
+	const ulong src_addr = 0x100000;
+	const ulong dst_addr = 0x200000;
+	/* Two losses in group 0 cannot be repaired, one in group 1 can */
+	const uint drop1[] = { 2, 4, 12 };
+	/*
+	 * The second round loses block 2 and group 0's parity again, so block
+	 * 2 can only come from the parity kept from the first round
+	 */
+	const uint drop2[] = { 2, 8 };
+	struct in_addr old_ip = net_ip;
+	uchar *src, *dst;
+	int i;
+
+	src = map_sysmem(src_addr, size);
+	dst = map_sysmem(dst_addr, size);
+	for (i = 0; i < size; i++)
+		src[i] = i * 7 + (i >> 8);
+	memset(dst, '\0', size);
+
+	net_ip = string_to_ip("1.1.2.3");
+	load_addr = dst_addr;
+	mdist_group_ip.s_addr = 0xffffffff;
+	net_set_state(NETLOOP_CONTINUE);
+	mdist_recv_start();
+
+	ut_assertok(mdist_feed_round(uts, src_addr, size, drop1,
+				     ARRAY_SIZE(drop1)));
+	ut_asserteq(NETLOOP_CONTINUE, net_state);
+
+	ut_assertok(mdist_feed_round(uts, src_addr, size, drop2,
+				     ARRAY_SIZE(drop2)));
+	ut_asserteq(NETLOOP_SUCCESS, net_state);
+	ut_asserteq(size, net_boot_file_size);
+	ut_assertok(memcmp(src, dst, size));
+
+	net_set_udp_handler(NULL);
+	net_set_timeout_handler(0, NULL);
+	net_ip = old_ip;
+	unmap_sysmem(dst);
+	unmap_sysmem(src);
+
+	return 0;
+}
+DM_TEST(dm_test_eth_mdist, DM_TESTF_SCAN_FDT);
+
+/* An image which does not fit at the load address must be refused */
+static int dm_test_eth_mdist_too_big(struct unit_test_state *uts)
+{
+	const ulong size = 20000;
+	const ulong src_addr = 0x100000;
+	struct in_addr old_ip = net_ip;
+	ulong old_load_addr = load_addr;
+
+	net_ip = string_to_ip("1.1.2.3");
+	load_addr = gd->ram_size - size / 2;
+	mdist_group_ip.s_addr = 0xffffffff;
+	net_set_state(NETLOOP_CONTINUE);
+	mdist_recv_start();
+
+	ut_assertok(mdist_feed_round(uts, src_addr, size, NULL, 0));
+	ut_asserteq(NETLOOP_FAIL, net_state);
+
+	net_set_udp_handler(NULL);
+	net_set_timeout_handler(0, NULL);
+	net_ip = old_ip;
+	load_addr = old_load_addr;
+
+	return 0;
+}
+DM_TEST(dm_test_eth_mdist_too_big, DM_TESTF_SCAN_FDT);
+#endif
+
+#ifdef CONFIG_CMD_PING6
+static int dm_test_eth_ping6(struct unit_test_state *uts)
+{
+	struct in6_addr addr;
+	u32 prefix_len;
+
+	ut_assertok(string_to_ip6("2001:db8::10/64", &addr, &prefix_len));
+	ut_asserteq(64, prefix_len);
+	ut_asserteq(htons(0x2001), addr.s6_addr16[0]);
+	ut_asserteq(htons(0x10), addr.s6_addr16[7]);
+	ut_asserteq(-EINVAL, string_to_ip6("1::2::3", &addr, NULL));
+	ut_asserteq(-EINVAL, string_to_ip6("1:2:3", &addr, NULL));
+
+	/* A link-local address needs no configuration */
+	env_set("ethact", "eth@10002000");
+	ut_assertok(string_to_ip6("fe80::1", &net_ping_ip6, NULL));
+	ut_assertok(net_loop(PING6));
+
+	/* A global one needs our own address first */
+	memset(&net_ip6, '\0', sizeof(net_ip6));
+	ut_assertok(string_to_ip6("2001:db8::1", &net_ping_ip6, NULL));
+	ut_asserteq(-ENODEV, net_loop(PING6));
+	ut_assertok(string_to_ip6("2001:db8::10/64", &net_ip6,
+				  &net_prefix_length));
+	ut_assertok(net_loop(PING6));
+	/* Again, with the neighbor already cached */
+	ut_assertok(net_loop(PING6));
+	memset(&net_ip6, '\0', sizeof(net_ip6));
+	net_prefix_length = 0;
+
+	return 0;
+}
+DM_TEST(dm_test_eth_ping6, DM_TESTF_SCAN_FDT);
+#endif
+
+#ifdef CONFIG_IPV6
+static int _dm_test_eth_tftp6(struct unit_test_state *uts)
+{
+	static u8 data[1000];
+	u8 *buf;
+	int i;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i * 3 + (i >> 8);
+	sandbox_eth_tftp_reset();
+	ut_assertok(sandbox_eth_tftp_add("img6", data, sizeof(data)));
+
+	env_set("ethact", "eth@10002000");
+	ut_assertok(string_to_ip6("2001:db8::10/64", &net_ip6,
+				  &net_prefix_length));
+	ut_assertok(string_to_ip6("2001:db8::1", &net_server_ip6, NULL));
+
+	buf = map_sysmem(0x100000, sizeof(data));
+	memset(buf, '\0', sizeof(data));
+	ut_assertok(run_command("tftpboot6 100000 img6", 0));
+	ut_asserteq(sizeof(data), env_get_hex("filesize", 0));
+	ut_assertok(memcmp(data, buf, sizeof(data)));
+	ut_asserteq(1, sandbox_eth_tftp_requests("img6"));
+	unmap_sysmem(buf);
+
+	return 0;
+}
+
+static int dm_test_eth_tftp6(struct unit_test_state *uts)
+{
+	int ret;
+
+	ret = _dm_test_eth_tftp6(uts);
+
+	memset(&net_ip6, '\0', sizeof(net_ip6));
+	net_prefix_length = 0;
+	memset(&net_server_ip6, '\0', sizeof(net_server_ip6));
+	sandbox_eth_tftp_reset();
+
+	return ret;
+}
+DM_TEST(dm_test_eth_tftp6, DM_TESTF_SCAN_FDT);
+
+static int _dm_test_eth_slaac(struct unit_test_state *uts)
+{
+	struct in6_addr expect;
+	char str[64];
+
+	env_set("ethact", "eth@10002000");
+	ut_assertok(run_command("slaac", 0));
+
+	/* The fake host advertises 2001:db8:1::/64 */
+	ut_assertok(string_to_ip6("2001:db8:1::", &expect, NULL));
+	memcpy(&expect.s6_addr[8], &net_link_local_ip6.s6_addr[8], 8);
+	ut_assertok(memcmp(&expect, &net_ip6, sizeof(expect)));
+	ut_asserteq(64, net_prefix_length);
+	sprintf(str, "%pI6/64", &expect);
+	ut_asserteq_str(str, env_get("ip6addr"));
+
+	/* and is our gateway */
+	ut_assert(ip6_is_link_local(&net_gateway6));
+	ut_assertnonnull(env_get("gatewayip6"));
+
+	return 0;
+}
+
+static int dm_test_eth_slaac(struct unit_test_state *uts)
+{
+	int ret;
+
+	ret = _dm_test_eth_slaac(uts);
+
+	env_set("ip6addr", NULL);
+	env_set("gatewayip6", NULL);
+	memset(&net_ip6, '\0', sizeof(net_ip6));
+	net_prefix_length = 0;
+	memset(&net_gateway6, '\0', sizeof(net_gateway6));
+
+	return ret;
+}
+DM_TEST(dm_test_eth_slaac, DM_TESTF_SCAN_FDT);
+#endif
+
+#ifdef CONFIG_CMD_PXE
+static int _dm_test_eth_pxe(struct unit_test_state *uts)
+{
+	const char *cfg = "include pxelinux.cfg/extra\n";
+	const char *extra = "timeout 10\n";
+	const char *cfg_name = "pxelinux.cfg/0102";
+	const char *extra_name = "pxelinux.cfg/extra";
+	const ulong addr = 0x100000;
+	char *buf;
+
+	buf = map_sysmem(addr, 0x1000);
+	env_set("ethact", "eth@10002000");
+	net_server_ip = string_to_ip("1.1.2.2");
+	env_set_hex("pxefile_addr_r", addr);
+
+	/* The IP address prefix is more specific than the default */
+	sandbox_eth_tftp_reset();
+	ut_assertok(sandbox_eth_tftp_add("pxelinux.cfg/default", "x", 1));
+	ut_assertok(sandbox_eth_tftp_add(cfg_name, cfg, strlen(cfg)));
+	ut_assertok(sandbox_eth_tftp_add(extra_name, extra, strlen(extra)));
+	memset(buf, '\0', 0x1000);
+	ut_assertok(run_command("pxe get", 0));
+	ut_asserteq_str(cfg, buf);
+	ut_asserteq(1, sandbox_eth_tftp_requests("pxelinux.cfg/default"));
+	ut_asserteq(2, sandbox_eth_tftp_requests(cfg_name));
+
+	/* A server which drops most of a burst of requests */
+	sandbox_eth_tftp_max_pending(1);
+	env_set("tftptimeoutcountmax", "0");
+	sandbox_eth_skip_timeout();
+	memset(buf, '\0', 0x1000);
+	ut_assertok(run_command("pxe get", 0));
+	ut_asserteq_str(cfg, buf);
+	/* The files were then tried in turn, up to the one found */
+	ut_asserteq(1, sandbox_eth_tftp_requests("pxelinux.cfg/default"));
+	ut_asserteq(3, sandbox_eth_tftp_requests(cfg_name));
+
+	/* A menu with includes is never cached: they may have changed */
+	ut_assertok(run_command("pxe boot", 0));
+	ut_asserteq(1, sandbox_eth_tftp_requests(extra_name));
+	ut_assertok(run_command("pxe boot", 0));
+	ut_asserteq(2, sandbox_eth_tftp_requests(extra_name));
+
+	unmap_sysmem(buf);
+
+	return 0;
+}
+
+static int dm_test_eth_pxe(struct unit_test_state *uts)
+{
+	struct in_addr old_server_ip = net_server_ip;
+	int ret;
+
+	ret = _dm_test_eth_pxe(uts);
+
+	/* Restore the env and the fake host */
+	env_set("tftptimeoutcountmax", NULL);
+	env_set("pxefile_addr_r", NULL);
+	net_server_ip = old_server_ip;
+	sandbox_eth_tftp_reset();
+
+	return ret;
+}
+DM_TEST(dm_test_eth_pxe, DM_TESTF_SCAN_FDT);
+#endif
+
+static int dm_test_eth_arp_cache(struct unit_test_state *uts)
+{
+	int requests;
+
+	net_ping_ip = string_to_ip("1.1.2.2");
+	env_set("ethact", "eth@10006000");
+	ut_assertok(net_loop(PING));
+
+	/* The second ping goes out without asking again */
+	requests = sandbox_eth_arp_requests();
+	ut_assertok(net_loop(PING));
+	ut_asserteq(requests, sandbox_eth_arp_requests());
+
+	/* but another interface has to find out for itself */
+	env_set("ethact", "eth@10003000");
+	ut_assertok(net_loop(PING));
+	ut_asserteq(requests + 1, sandbox_eth_arp_requests());
+
+	return 0;
+}
+DM_TEST(dm_test_eth_arp_cache, DM_TESTF_SCAN_FDT);
+
+/* A missing gateway is reported once per net_loop(), not once per packet */
+static int dm_test_eth_no_gateway(struct unit_test_state *uts)
+{
+	struct in_addr old_netmask = net_netmask;
+	struct in_addr old_gateway = net_gateway;
+	char line[80];
+	int warnings = 0;
+
+	net_netmask = string_to_ip("255.255.255.0");
+	net_gateway.s_addr = 0;
+	net_ping_ip = string_to_ip("10.0.0.1");
+	env_set("ethact", "eth@10002000");
+	console_record_reset_enable();
+	ut_assertok(net_loop(PING));
+	gd->flags &= ~GD_FLG_RECORD;
+	net_netmask = old_netmask;
+	net_gateway = old_gateway;
+
+	while (membuff_readline(&gd->console_out, line, sizeof(line), ' ')) {
+		if (strstr(line, "gatewayip needed"))
+			warnings++;
+	}
+	ut_asserteq(1, warnings);
+
+	return 0;
+}
+DM_TEST(dm_test_eth_no_gateway, DM_TESTF_SCAN_FDT);
+
 static int dm_test_eth_alias(struct unit_test_state *uts)
 {
 	net_ping_ip = string_to_ip("1.1.2.2");
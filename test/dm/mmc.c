@@ -6,8 +6,11 @@
 
 #include <common.h>
 #include <dm.h>
+#include <malloc.h>
 #include <mmc.h>
+#include <sdhci.h>
 #include <dm/test.h>
+#include <asm/test.h>
 #include <test/ut.h>
 
 DECLARE_GLOBAL_DATA_PTR;
@@ -44,3 +47,241 @@ static int dm_test_mmc_blk(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_mmc_blk, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Write and read back through an emulated SDHCI controller */
+static int sdhci_check_rw(struct unit_test_state *uts, const char *name,
+			  struct sandbox_sdhci_stats *stats)
+{
+	const int count = 1500;		/* more than one ADMA descriptor */
+	struct blk_desc *dev_desc;
+	struct udevice *dev;
+	struct mmc *mmc;
+	u8 *wbuf, *rbuf;
+	int i;
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_MMC, name, &dev));
+	mmc = mmc_get_mmc_dev(dev);
+	/* Get the card set up and its partitions scanned before counting */
+	ut_assertok(mmc_init(mmc));
+	dev_desc = mmc_get_blk_desc(mmc);
+	ut_assertnonnull(dev_desc);
+	ut_asserteq(512, dev_desc->blksz);
+
+	/* Use buffers which are not 32-bit aligned */
+	wbuf = malloc(count * 512 + 8);
+	rbuf = malloc(count * 512 + 8);
+	ut_assertnonnull(wbuf);
+	ut_assertnonnull(rbuf);
+	for (i = 0; i < count * 512; i++)
+		wbuf[i + 1] = i * 7 + (i >> 9);
+	memset(rbuf, '\0', count * 512 + 8);
+
+	sandbox_sdhci_reset_stats(dev);
+	ut_asserteq(count, blk_dwrite(dev_desc, 10, count, wbuf + 1));
+	ut_asserteq(count, blk_dread(dev_desc, 10, count, rbuf + 3));
+	ut_assertok(memcmp(wbuf + 1, rbuf + 3, count * 512));
+	ut_asserteq(0, rbuf[count * 512 + 3]);
+	sandbox_sdhci_get_stats(dev, stats);
+
+	/* Single blocks too */
+	ut_asserteq(1, blk_dread(dev_desc, 11, 1, rbuf + 2));
+	ut_assertok(memcmp(wbuf + 1 + 512, rbuf + 2, 512));
+
+	free(wbuf);
+	free(rbuf);
+
+	return 0;
+}
+
+static int dm_test_mmc_sdhci_adma(struct unit_test_state *uts)
+{
+	struct sandbox_sdhci_stats stats;
+
+	ut_assertok(sdhci_check_rw(uts, "sdhci-adma", &stats));
+
+	/* Each direction is one command, not a bounce buffer's worth */
+	ut_asserteq(2, stats.adma_cmds);
+	ut_asserteq(2, stats.data_cmds);
+	/* The unaligned head of each buffer takes a descriptor of its own */
+	ut_asserteq(2 * (DIV_ROUND_UP(1500 * 512 - 3, ADMA_MAX_LEN) + 1),
+		    stats.adma_descs);
+
+	ut_assertok(sdhci_check_rw(uts, "sdhci-pio", &stats));
+	ut_asserteq(0, stats.adma_cmds);
+	ut_asserteq(0, stats.sdma_cmds);
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_sdhci_adma, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+static int dm_test_mmc_sdhci_uhs(struct unit_test_state *uts)
+{
+	struct sandbox_sdhci_stats stats;
+	struct udevice *dev;
+	struct mmc *mmc;
+
+	/* An SD card switches to 1.8V and tunes for SDR104 */
+	ut_assertok(uclass_get_device_by_name(UCLASS_MMC, "sdhci-uhs", &dev));
+	mmc = mmc_get_mmc_dev(dev);
+	sandbox_sdhci_reset_stats(dev);
+	ut_assertok(mmc_init(mmc));
+	sandbox_sdhci_get_stats(dev, &stats);
+	ut_asserteq(MMC_SIGNAL_VOLTAGE_180, mmc->signal_voltage);
+	ut_asserteq(MMC_TIMING_UHS_SDR104, mmc->timing);
+	ut_asserteq(SD_SWITCH_FUNC_SDR104, stats.sd_speed);
+	ut_asserteq(4, mmc->bus_width);
+	ut_asserteq(200000000, mmc->clock);
+	ut_assert(stats.tunings > 0);
+	ut_asserteq(SDHCI_CTRL_VDD_180 | SDHCI_CTRL_TUNED_CLK |
+		    SDHCI_CTRL_UHS_SDR104,
+		    sdhci_readw(mmc->priv, SDHCI_HOST_CONTROL2));
+	ut_assertok(sdhci_check_rw(uts, "sdhci-uhs", &stats));
+
+	/* An eMMC tunes in HS200 and then moves on to HS400 */
+	ut_assertok(uclass_get_device_by_name(UCLASS_MMC, "sdhci-emmc", &dev));
+	mmc = mmc_get_mmc_dev(dev);
+	sandbox_sdhci_reset_stats(dev);
+	ut_assertok(mmc_init(mmc));
+	sandbox_sdhci_get_stats(dev, &stats);
+	ut_asserteq(MMC_TIMING_MMC_HS400, mmc->timing);
+	ut_asserteq(8, mmc->bus_width);
+	ut_assert(mmc->ddr_mode);
+	ut_assert(stats.tunings > 0);
+	ut_asserteq(EXT_CSD_TIMING_HS400, stats.hs_timing);
+	ut_asserteq(EXT_CSD_DDR_BUS_WIDTH_8, stats.bus_width);
+	ut_asserteq(SDHCI_CTRL_VDD_180 | SDHCI_CTRL_HS400,
+		    sdhci_readw(mmc->priv, SDHCI_HOST_CONTROL2) &
+		    ~SDHCI_CTRL_TUNED_CLK);
+	ut_assertok(sdhci_check_rw(uts, "sdhci-emmc", &stats));
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_sdhci_uhs, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Test that an SD card which cannot switch to 1.8V is used at 3.3V */
+static int dm_test_mmc_sdhci_uhs_fail(struct unit_test_state *uts)
+{
+	static const int fails[] = {
+		SB_SDHCI_S18_NO_CMD, SB_SDHCI_S18_DAT_LOW
+	};
+	struct sandbox_sdhci_stats stats;
+	struct udevice *dev;
+	struct mmc *mmc;
+	int i;
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_MMC, "sdhci-uhs", &dev));
+	mmc = mmc_get_mmc_dev(dev);
+	for (i = 0; i < ARRAY_SIZE(fails); i++) {
+		sandbox_sdhci_s18_fail(dev, fails[i]);
+		mmc->has_init = 0;
+		mmc->id_cached = false;
+		ut_assertok(mmc_init(mmc));
+		ut_asserteq(MMC_SIGNAL_VOLTAGE_330, mmc->signal_voltage);
+		ut_asserteq(MMC_TIMING_LEGACY, mmc->timing);
+		ut_assert(!mmc->uhs_failed);
+		ut_assert(!mmc->clk_disable);
+		ut_asserteq(0, sdhci_readw(mmc->priv, SDHCI_HOST_CONTROL2) &
+			    SDHCI_CTRL_VDD_180);
+		ut_assertok(sdhci_check_rw(uts, "sdhci-uhs", &stats));
+	}
+
+	/* Once the card behaves, it goes back to UHS-I */
+	sandbox_sdhci_s18_fail(dev, SB_SDHCI_S18_OK);
+	mmc->has_init = 0;
+	mmc->id_cached = false;
+	ut_assertok(mmc_init(mmc));
+	ut_asserteq(MMC_SIGNAL_VOLTAGE_180, mmc->signal_voltage);
+	ut_asserteq(MMC_TIMING_UHS_SDR104, mmc->timing);
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_sdhci_uhs_fail, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+static int dm_test_mmc_sdhci_cmd23(struct unit_test_state *uts)
+{
+	struct sandbox_sdhci_stats stats;
+	struct udevice *dev;
+	struct mmc *mmc;
+
+	/* Multi-block transfers are given their length up front */
+	ut_assertok(sdhci_check_rw(uts, "sdhci-adma", &stats));
+	ut_asserteq(2, stats.set_count_cmds);
+	ut_asserteq(0, stats.stop_cmds);
+
+	/* Writes to an eMMC stay in its cache until flushed */
+	ut_assertok(sdhci_check_rw(uts, "sdhci-emmc", &stats));
+	ut_asserteq(2, stats.set_count_cmds);
+	ut_asserteq(0, stats.stop_cmds);
+	ut_asserteq(0, stats.cache_flushes);
+	ut_assertok(uclass_get_device_by_name(UCLASS_MMC, "sdhci-emmc", &dev));
+	mmc = mmc_get_mmc_dev(dev);
+	ut_assert(mmc->cache_on);
+	ut_assert(mmc->cache_dirty);
+
+	mmc_flush_all_caches();
+	sandbox_sdhci_get_stats(dev, &stats);
+	ut_asserteq(1, stats.cache_flushes);
+	ut_assert(!mmc->cache_dirty);
+
+	/* Reads leave nothing to flush */
+	mmc_flush_all_caches();
+	sandbox_sdhci_get_stats(dev, &stats);
+	ut_asserteq(1, stats.cache_flushes);
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_sdhci_cmd23, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+static int dm_test_mmc_sdhci_rescan(struct unit_test_state *uts)
+{
+	struct sandbox_sdhci_stats stats;
+	struct udevice *dev;
+	struct mmc *mmc;
+	uint clock, timing;
+	int cmds;
+
+	/* A card which is still powering up is left to finish later */
+	ut_assertok(uclass_get_device_by_name(UCLASS_MMC, "sdhci-pio", &dev));
+	mmc = mmc_get_mmc_dev(dev);
+	mmc->has_init = 0;
+	mmc->id_cached = false;
+	sandbox_sdhci_reset_stats(dev);
+	ut_assertok(mmc_start_init(mmc));
+	ut_asserteq(1, mmc->op_cond_pending);
+	ut_assertok(mmc_init(mmc));
+	ut_asserteq(0, mmc->op_cond_pending);
+	sandbox_sdhci_get_stats(dev, &stats);
+	cmds = stats.cmds;
+	clock = mmc->clock;
+
+	/* Rescanning the same card skips finding out its bus speed */
+	mmc->has_init = 0;
+	sandbox_sdhci_reset_stats(dev);
+	ut_assertok(mmc_init(mmc));
+	sandbox_sdhci_get_stats(dev, &stats);
+	ut_assert(stats.cmds < cmds);
+	ut_asserteq(clock, mmc->clock);
+	ut_assertok(sdhci_check_rw(uts, "sdhci-pio", &stats));
+
+	/* and for an eMMC, checking the bus width by reading EXT_CSD */
+	ut_assertok(uclass_get_device_by_name(UCLASS_MMC, "sdhci-emmc", &dev));
+	mmc = mmc_get_mmc_dev(dev);
+	mmc->has_init = 0;
+	mmc->id_cached = false;
+	sandbox_sdhci_reset_stats(dev);
+	ut_assertok(mmc_init(mmc));
+	sandbox_sdhci_get_stats(dev, &stats);
+	ut_assert(stats.ext_csd_reads > 1);
+	timing = mmc->timing;
+
+	mmc->has_init = 0;
+	sandbox_sdhci_reset_stats(dev);
+	ut_assertok(mmc_init(mmc));
+	sandbox_sdhci_get_stats(dev, &stats);
+	ut_asserteq(1, stats.ext_csd_reads);
+	ut_asserteq(timing, mmc->timing);
+	ut_assertok(sdhci_check_rw(uts, "sdhci-emmc", &stats));
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_sdhci_rescan, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
@@ -7,6 +7,7 @@
 #include <common.h>
 #include <dm.h>
 #include <fdtdec.h>
+#include <mapmem.h>
 #include <spi.h>
 #include <spi_flash.h>
 #include <asm/state.h>
@@ -41,3 +42,58 @@ static int dm_test_spi_flash(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_spi_flash, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/*
+ * Test that each read mode reads back what is in the backing file. With -v
+ * this also prints the rate of each mode, though on sandbox that only
+ * measures the emulator.
+ */
+static int dm_test_spi_flash_read_modes(struct unit_test_state *uts)
+{
+	struct spi_flash *flash;
+	struct udevice *dev;
+	const int size = 0x200000;
+	ulong start, rate;
+	u8 *src, *buf;
+	int i, mode;
+
+	/* Fill the flash with a pattern which differs in every page */
+	src = map_sysmem(0, size);
+	for (i = 0; i < size; i++)
+		src[i] = i * 7 + (i >> 8);
+	ut_assertok(run_command("sb save hostfs - 0 spi-quad.bin 200000", 0));
+	ut_assertok(uclass_get_device_by_name(UCLASS_SPI_FLASH,
+					      "spi-quad.bin@0", &dev));
+	flash = dev_get_uclass_priv(dev);
+
+	/* The bus has four wires and flash_read(), but no DTR */
+	ut_asserteq(SPI_FLASH_READ_1_4_4, flash->read_mode);
+	ut_asserteq(0x1f, flash->read_modes);
+	ut_asserteq(-EINVAL, spi_flash_set_read_mode(flash,
+						     SPI_FLASH_READ_1_4_4_DTR));
+
+	buf = malloc(size);
+	ut_assertnonnull(buf);
+	for (mode = 0; mode < SPI_FLASH_READ_MODES; mode++) {
+		if (!(flash->read_modes & BIT(mode)))
+			continue;
+		ut_assertok(spi_flash_set_read_mode(flash, mode));
+		memset(buf, '\0', size);
+		start = timer_get_us();
+		ut_assertok(spi_flash_read_dm(dev, 0, size, buf));
+		start = timer_get_us() - start;
+		ut_assertok(memcmp(src, buf, size));
+
+		/* Bytes per microsecond are MB/s; keep two decimals */
+		rate = start ? (ulong)size * 100 / start : 0;
+		printf("read mode %d: opcode %02x, %lu.%02lu MB/s\n", mode,
+		       flash->read_ops[mode].opcode, rate / 100, rate % 100);
+	}
+	free(buf);
+	unmap_sysmem(src);
+
+	sandbox_sf_unbind_emul(state_get_current(), 1, 0);
+
+	return 0;
+}
+DM_TEST(dm_test_spi_flash_read_modes, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
@@ -7,6 +7,8 @@
 #include <common.h>
 #include <console.h>
 #include <dm.h>
+#include <memalign.h>
+#include <scsi.h>
 #include <usb.h>
 #include <asm/io.h>
 #include <asm/state.h>
@@ -58,6 +60,176 @@ static int dm_test_usb_flash(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_usb_flash, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
 
+/*
+ * Read from a UAS flash stick, with several commands queued. At SuperSpeed
+ * the stick only moves data and status on streams, so this also checks that
+ * those are used.
+ */
+static int check_usb_flash_uas(struct unit_test_state *uts, int devnum,
+			       const char *emul_name, bool superspeed)
+{
+	struct udevice *dev, *emul;
+	struct blk_desc *dev_desc;
+	struct usb_device *udev;
+	char str[10];
+	char *buf;
+	int i;
+
+	state_set_skip_delays(true);
+	ut_assertok(usb_init());
+	ut_assertok(uclass_get_device(UCLASS_MASS_STORAGE, devnum, &dev));
+	snprintf(str, sizeof(str), "%d", devnum);
+	ut_asserteq(devnum, blk_get_device_by_str("usb", str, &dev_desc));
+	ut_assertok(uclass_get_device_by_name(UCLASS_USB_EMUL, emul_name,
+					      &emul));
+	udev = dev_get_parent_priv(dev);
+	ut_asserteq(superspeed ? USB_SPEED_SUPER : USB_SPEED_HIGH,
+		    udev->speed);
+
+	ut_asserteq(512, dev_desc->blksz);
+	buf = malloc(100 * 512);
+	ut_assertnonnull(buf);
+	memset(buf, '\0', 1024);
+	ut_asserteq(2, blk_dread(dev_desc, 0, 2, buf));
+	ut_assertok(strcmp(buf, "this is a UAS test"));
+
+	/* This takes several commands, which the device finishes in reverse */
+	memset(buf, 0xff, 100 * 512);
+	ut_asserteq(100, blk_dread(dev_desc, 0, 100, buf));
+	ut_assertok(strcmp(buf, "this is a UAS test"));
+	for (i = strlen(buf); i < 100 * 512; i++)
+		ut_asserteq(0, buf[i]);
+	ut_assert(sandbox_flash_get_max_queued(emul) > 1);
+
+	/*
+	 * After a transport error the queued commands are aborted. Only the
+	 * blocks before the first unfinished command count as read, and since
+	 * the device runs the newest command first that is none of them.
+	 */
+	sandbox_flash_uas_fail(emul, 3);
+	ut_asserteq(0, blk_dread(dev_desc, 0, 100, buf));
+	ut_asserteq(0, sandbox_flash_get_queued(emul));
+	ut_asserteq(100, blk_dread(dev_desc, 0, 100, buf));
+	free(buf);
+	ut_assertok(usb_stop());
+
+	return 0;
+}
+
+/* Test reading from a flash stick using UAS, at high speed and SuperSpeed */
+static int dm_test_usb_flash_uas(struct unit_test_state *uts)
+{
+	ut_assertok(check_usb_flash_uas(uts, 3, "flash-stick@4", false));
+	ut_assertok(check_usb_flash_uas(uts, 4, "flash-stick@5", true));
+
+	return 0;
+}
+DM_TEST(dm_test_usb_flash_uas, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Test queueing, polling and cancelling bulk transfers */
+static int dm_test_usb_bulk_queue(struct unit_test_state *uts)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(struct umass_bbb_cbw, cbw, 1);
+	ALLOC_CACHE_ALIGN_BUFFER(struct umass_bbb_csw, csw, 1);
+	ALLOC_CACHE_ALIGN_BUFFER(char, buf, 512);
+	struct usb_bulk_req cbw_req, data_req, csw_req, reqs[9];
+	unsigned long pipein, pipeout, bad_pipe;
+	struct blk_desc *dev_desc;
+	struct usb_device *udev;
+	int i;
+
+	state_set_skip_delays(true);
+	ut_assertok(usb_init());
+	ut_assertok(blk_get_device_by_str("usb", "0", &dev_desc));
+	udev = dev_get_parent_priv(dev_get_parent(dev_desc->bdev));
+	pipein = usb_rcvbulkpipe(udev, 2);
+	pipeout = usb_sndbulkpipe(udev, 1);
+
+	/* Queue a whole READ(10) of block 0, which completes in one poll */
+	memset(&cbw_req, '\0', sizeof(cbw_req));
+	memset(&data_req, '\0', sizeof(data_req));
+	memset(&csw_req, '\0', sizeof(csw_req));
+	memset(reqs, '\0', sizeof(reqs));
+	memset(cbw, '\0', sizeof(*cbw));
+	cbw->dCBWSignature = cpu_to_le32(CBWSIGNATURE);
+	cbw->dCBWTag = cpu_to_le32(1);
+	cbw->dCBWDataTransferLength = cpu_to_le32(512);
+	cbw->bCBWFlags = CBWFLAGS_IN;
+	cbw->bCDBLength = 10;
+	cbw->CBWCDB[0] = SCSI_READ10;
+	cbw->CBWCDB[8] = 1;
+	cbw_req.pipe = pipeout;
+	cbw_req.buffer = cbw;
+	cbw_req.length = UMASS_BBB_CBW_SIZE;
+	data_req.pipe = pipein;
+	data_req.buffer = buf;
+	data_req.length = 512;
+	csw_req.pipe = pipein;
+	csw_req.buffer = csw;
+	csw_req.length = UMASS_BBB_CSW_SIZE;
+	memset(buf, '\0', 512);
+	ut_assertok(usb_submit_bulk(udev, &cbw_req));
+	ut_assertok(usb_submit_bulk(udev, &data_req));
+	ut_assertok(usb_submit_bulk(udev, &csw_req));
+	ut_assert(!data_req.done);
+	ut_asserteq(-EINPROGRESS, data_req.status);
+	ut_asserteq(3, usb_poll_bulk(udev));
+	ut_asserteq(0, usb_poll_bulk(udev));
+	ut_assertok(usb_wait_bulk(udev, &cbw_req, 100));
+	ut_assertok(usb_wait_bulk(udev, &data_req, 100));
+	ut_asserteq(512, data_req.actual);
+	ut_assertok(strcmp(buf, "this is a test"));
+	ut_assertok(usb_wait_bulk(udev, &csw_req, 100));
+	ut_asserteq(UMASS_BBB_CSW_SIZE, csw_req.actual);
+	ut_asserteq(CSWSIGNATURE, le32_to_cpu(csw->dCSWSignature));
+	ut_asserteq(1, le32_to_cpu(csw->dCSWTag));
+	ut_asserteq(CSWSTATUS_GOOD, csw->bCSWStatus);
+
+	/* The queue has a limit, and cancelling empties it */
+	for (i = 0; i < ARRAY_SIZE(reqs); i++) {
+		reqs[i].pipe = pipein;
+		reqs[i].buffer = buf;
+		reqs[i].length = 512;
+	}
+	for (i = 0; i < ARRAY_SIZE(reqs) - 1; i++)
+		ut_assertok(usb_submit_bulk(udev, &reqs[i]));
+	ut_asserteq(-EBUSY, usb_submit_bulk(udev, &reqs[i]));
+	ut_assertok(usb_cancel_bulk(udev, pipein));
+	for (i = 0; i < ARRAY_SIZE(reqs) - 1; i++) {
+		ut_assert(reqs[i].done);
+		ut_asserteq(-ECANCELED, usb_wait_bulk(udev, &reqs[i], 100));
+	}
+	ut_asserteq(0, usb_poll_bulk(udev));
+
+	/*
+	 * A failed transfer fails those queued behind it on the same pipe,
+	 * but not those on other pipes. No device has address 127.
+	 */
+	bad_pipe = pipein | (0x7f << 8);
+	reqs[0].pipe = bad_pipe;
+	reqs[1].pipe = bad_pipe;
+	cbw->dCBWTag = cpu_to_le32(2);
+	memset(buf, '\0', 512);
+	ut_assertok(usb_submit_bulk(udev, &reqs[0]));
+	ut_assertok(usb_submit_bulk(udev, &reqs[1]));
+	ut_assertok(usb_submit_bulk(udev, &cbw_req));
+	ut_assertok(usb_submit_bulk(udev, &data_req));
+	ut_assertok(usb_submit_bulk(udev, &csw_req));
+	ut_asserteq(5, usb_poll_bulk(udev));
+	ut_asserteq(-ENOENT, usb_wait_bulk(udev, &reqs[0], 100));
+	ut_asserteq(-ECANCELED, usb_wait_bulk(udev, &reqs[1], 100));
+	ut_assertok(usb_wait_bulk(udev, &data_req, 100));
+	ut_assertok(strcmp(buf, "this is a test"));
+	ut_assertok(usb_wait_bulk(udev, &csw_req, 100));
+	ut_asserteq(2, le32_to_cpu(csw->dCSWTag));
+	ut_asserteq(CSWSTATUS_GOOD, csw->bCSWStatus);
+
+	ut_assertok(usb_stop());
+
+	return 0;
+}
+DM_TEST(dm_test_usb_bulk_queue, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
 /* test that we can handle multiple storage devices */
 static int dm_test_usb_multi(struct unit_test_state *uts)
 {
@@ -68,6 +240,8 @@ static int dm_test_usb_multi(struct unit_test_state *uts)
 	ut_assertok(uclass_get_device(UCLASS_MASS_STORAGE, 0, &dev));
 	ut_assertok(uclass_get_device(UCLASS_MASS_STORAGE, 1, &dev));
 	ut_assertok(uclass_get_device(UCLASS_MASS_STORAGE, 2, &dev));
+	ut_assertok(uclass_get_device(UCLASS_MASS_STORAGE, 3, &dev));
+	ut_assertok(uclass_get_device(UCLASS_MASS_STORAGE, 4, &dev));
 	ut_assertok(usb_stop());
 
 	return 0;
@@ -110,7 +284,9 @@ static int dm_test_usb_stop(struct unit_test_state *uts)
 	ut_assertok(uclass_get_device(UCLASS_MASS_STORAGE, 0, &dev));
 	ut_assertok(uclass_get_device(UCLASS_MASS_STORAGE, 1, &dev));
 	ut_assertok(uclass_get_device(UCLASS_MASS_STORAGE, 2, &dev));
-	ut_asserteq(6, count_usb_devices());
+	ut_assertok(uclass_get_device(UCLASS_MASS_STORAGE, 3, &dev));
+	ut_assertok(uclass_get_device(UCLASS_MASS_STORAGE, 4, &dev));
+	ut_asserteq(8, count_usb_devices());
 	ut_assertok(usb_stop());
 	ut_asserteq(0, count_usb_devices());
 
@@ -0,0 +1,61 @@
+/*
+ * Tests for crc32()
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <test/lib.h>
+#include <test/ut.h>
+#include <u-boot/crc.h>
+
+#define CRC32_TEST_SIZE		1024
+
+/* The CRC of the standard check string */
+static int lib_test_crc32_check(struct unit_test_state *uts)
+{
+	ut_asserteq(0xcbf43926, crc32(0, (const uchar *)"123456789", 9));
+	ut_asserteq(0, crc32(0, NULL, 0));
+
+	return 0;
+}
+LIB_TEST(lib_test_crc32_check, 0);
+
+/*
+ * Test that whole buffers, which can take the word-at-a-time and
+ * slice-by-8 paths, give the same CRC as going one byte at a time, for
+ * all alignments and many lengths
+ */
+static int lib_test_crc32_bytewise(struct unit_test_state *uts)
+{
+	uint seed = 1, start, len, i;
+	u32 crc, ref;
+	uchar *buf;
+
+	buf = malloc(CRC32_TEST_SIZE + 8);
+	ut_assertnonnull(buf);
+	for (i = 0; i < CRC32_TEST_SIZE + 8; i++)
+		buf[i] = rand_r(&seed);
+
+	for (start = 0; start < 8; start++) {
+		/* Every short length, then a spread of longer ones */
+		for (len = 0; len <= CRC32_TEST_SIZE;
+		     len += len < 40 ? 1 : 37) {
+			ref = 0;
+			for (i = 0; i < len; i++)
+				ref = crc32(ref, buf + start + i, 1);
+			crc = crc32(0, buf + start, len);
+			ut_asserteq(ref, crc);
+
+			/* And when continued from a previous CRC */
+			crc = crc32(0, buf + start, len / 3);
+			crc = crc32(crc, buf + start + len / 3, len - len / 3);
+			ut_asserteq(ref, crc);
+		}
+	}
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_test_crc32_bytewise, 0);
@@ -0,0 +1,42 @@
+/*
+ * Unit tests for writing to storage
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <test/storage.h>
+#include <test/suites.h>
+#include <test/ut.h>
+
+int do_ut_storage(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	struct unit_test *tests = ll_entry_start(struct unit_test,
+						 storage_test);
+	const int n_ents = ll_entry_count(struct unit_test, storage_test);
+	struct unit_test_state uts = { .fail_count = 0 };
+	struct unit_test *test;
+
+	if (argc == 1)
+		printf("Running %d storage tests\n", n_ents);
+
+	for (test = tests; test < tests + n_ents; test++) {
+		const char *name = test->name;
+
+		/* All tests have this prefix */
+		if (!strncmp(name, "storage_test_", 13))
+			name += 13;
+		if (argc > 1 && strcmp(argv[1], name))
+			continue;
+		printf("Test: %s\n", test->name);
+
+		uts.start = mallinfo();
+
+		test->func(&uts);
+	}
+
+	printf("Failures: %d\n", uts.fail_count);
+
+	return uts.fail_count ? CMD_RET_FAILURE : 0;
+}
@@ -0,0 +1,168 @@
+/*
+ * Tests for writing DFU downloads to the medium
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <dfu.h>
+#include <malloc.h>
+#include <test/storage.h>
+#include <test/ut.h>
+
+#define DFU_TEST_BUFSIZ		4096
+#define DFU_TEST_BLKSZ		512
+#define DFU_TEST_SIZE		(5 * DFU_TEST_BUFSIZ + 300)
+#define DFU_TEST_SLICE		1024
+
+/**
+ * struct dfu_test - A RAM-backed DFU entity
+ *
+ * @dfu:	Entity, set up to write to @rb
+ * @rb:		Medium, with one-byte blocks
+ * @written:	Bytes written to it so far, always from offset 0 up
+ * @max_write:	Largest write
+ * @flushes:	Number of calls to flush_medium()
+ * @flush_written: Value of @written at the last flush
+ * @fail_at:	Fail the write covering this offset, if not -1
+ * @out_of_order: Number of writes not following the one before
+ */
+struct dfu_test {
+	struct dfu_entity dfu;
+	struct ut_ram_blk rb;
+	long written;
+	long max_write;
+	int flushes;
+	long flush_written;
+	long fail_at;
+	int out_of_order;
+};
+
+static int dfu_test_write(struct dfu_entity *dfu, u64 offset, void *buf,
+			  long *len)
+{
+	struct dfu_test *dt = container_of(dfu, struct dfu_test, dfu);
+
+	if (offset != dt->written)
+		dt->out_of_order++;
+	if (dt->fail_at >= (long)offset && dt->fail_at < offset + *len)
+		return -EIO;
+	if (ut_ram_blk_write(&dt->rb, offset, *len, buf) != *len)
+		return -ENOSPC;
+	dt->written = offset + *len;
+	dt->max_write = max(dt->max_write, *len);
+
+	return 0;
+}
+
+static int dfu_test_flush(struct dfu_entity *dfu)
+{
+	struct dfu_test *dt = container_of(dfu, struct dfu_test, dfu);
+
+	dt->flushes++;
+	dt->flush_written = dt->written;
+
+	return 0;
+}
+
+/* Set up a new entity, keeping the medium */
+static void dfu_test_init(struct dfu_test *dt)
+{
+	memset(&dt->dfu, '\0', sizeof(dt->dfu));
+	strcpy(dt->dfu.name, "test");
+	dt->dfu.write_medium = dfu_test_write;
+	dt->dfu.flush_medium = dfu_test_flush;
+	dt->dfu.write_slice = DFU_TEST_SLICE;
+	dt->rb.writes = 0;
+	dt->written = 0;
+	dt->max_write = 0;
+	dt->flushes = 0;
+	dt->flush_written = 0;
+	dt->fail_at = -1;
+	dt->out_of_order = 0;
+}
+
+/*
+ * Send @img as the host would, with a varying number of background steps
+ * between the blocks, then flush it
+ */
+static int dfu_test_download(struct dfu_test *dt, const u8 *img, uint *seed)
+{
+	int seq = 0, ret;
+	uint pos, n, i;
+
+	for (pos = 0; pos < DFU_TEST_SIZE; pos += n) {
+		n = min_t(uint, DFU_TEST_SIZE - pos, DFU_TEST_BLKSZ);
+		ret = dfu_write(&dt->dfu, (void *)img + pos, n, seq++);
+		if (ret)
+			return ret;
+		for (i = rand_r(seed) % 4; i > 0; i--)
+			dfu_write_background();
+	}
+	ret = dfu_write(&dt->dfu, NULL, 0, seq);
+	if (ret)
+		return ret;
+
+	return dfu_flush(&dt->dfu, NULL, 0, seq);
+}
+
+/* Test that a download reaches the medium in order before the flush */
+static int storage_test_dfu_write(struct unit_test_state *uts)
+{
+	struct dfu_test *dt;
+	uint seed = 1;
+	u8 *img, *blk;
+	int i;
+
+	dt = calloc(1, sizeof(*dt));
+	img = malloc(DFU_TEST_SIZE);
+	ut_assertnonnull(dt);
+	ut_assertnonnull(img);
+	ut_assertok(ut_ram_blk_init(&dt->rb, 1, DFU_TEST_SIZE, 0));
+	for (i = 0; i < DFU_TEST_SIZE; i++)
+		img[i] = i * 7 + (i >> 9);
+	env_set_ulong("dfu_bufsiz", DFU_TEST_BUFSIZ);
+	dfu_free_buf();
+
+	for (i = 0; i < 4; i++) {
+		dfu_test_init(dt);
+		ut_assertok(dfu_test_download(dt, img, &seed));
+		ut_assertok(memcmp(img, dt->rb.data, DFU_TEST_SIZE));
+		ut_asserteq(0, dt->out_of_order);
+		ut_asserteq(1, dt->flushes);
+		ut_asserteq(DFU_TEST_SIZE, dt->flush_written);
+	}
+
+	/* Only a buffer written in the background is sliced */
+	if (IS_ENABLED(CONFIG_DFU_DOUBLE_BUFFER)) {
+		dfu_test_init(dt);
+		for (i = 0; i < DFU_TEST_BUFSIZ / DFU_TEST_BLKSZ; i++) {
+			blk = img + i * DFU_TEST_BLKSZ;
+			ut_assertok(dfu_write(&dt->dfu, blk, DFU_TEST_BLKSZ,
+					      i));
+		}
+		ut_asserteq(0, dt->rb.writes);
+		dfu_write_background();
+		ut_asserteq(1, dt->rb.writes);
+		ut_asserteq(DFU_TEST_SLICE, dt->max_write);
+		ut_assertok(dfu_flush(&dt->dfu, NULL, 0, i));
+		ut_asserteq(DFU_TEST_BUFSIZ, dt->flush_written);
+		ut_asserteq(0, dt->out_of_order);
+	}
+
+	/* A failed write is reported, and nothing is flushed */
+	dfu_test_init(dt);
+	dt->fail_at = DFU_TEST_BUFSIZ + 10;
+	ut_assert(dfu_test_download(dt, img, &seed));
+	ut_asserteq(0, dt->flushes);
+	ut_asserteq(0, dt->out_of_order);
+
+	dfu_free_buf();
+	env_set("dfu_bufsiz", NULL);
+	free(img);
+	ut_ram_blk_free(&dt->rb);
+	free(dt);
+
+	return 0;
+}
+STORAGE_TEST(storage_test_dfu_write, 0);
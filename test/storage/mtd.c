@@ -0,0 +1,207 @@
+/*
+ * Tests for MTD reads skipping bad blocks and the MTD read cache
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <linux/mtd/mtd.h>
+#include <linux/mtd/nand.h>
+#include <test/storage.h>
+#include <test/ut.h>
+
+#define TEST_PAGE_SIZE		512
+#define TEST_BLOCK_SIZE		(4 * TEST_PAGE_SIZE)
+#define TEST_BLOCKS		8
+
+/* A RAM-backed flash with some bad blocks, addressed in bytes */
+static struct ut_ram_blk test_flash;
+static uint test_bad_blocks;
+static int test_read_ret;
+
+static int test_mtd_read(struct mtd_info *mtd, loff_t from, size_t len,
+			 size_t *retlen, u_char *buf)
+{
+	*retlen = ut_ram_blk_read(&test_flash, from, len, buf);
+
+	return test_read_ret;
+}
+
+static int test_mtd_write(struct mtd_info *mtd, loff_t to, size_t len,
+			  size_t *retlen, const u_char *buf)
+{
+	*retlen = ut_ram_blk_write(&test_flash, to, len, buf);
+
+	return 0;
+}
+
+static int test_mtd_block_isbad(struct mtd_info *mtd, loff_t ofs)
+{
+	return !!(test_bad_blocks & BIT(ofs / TEST_BLOCK_SIZE));
+}
+
+static int test_mtd_init(struct mtd_info *mtd)
+{
+	int i, ret;
+
+	ret = ut_ram_blk_init(&test_flash, 1, TEST_BLOCKS * TEST_BLOCK_SIZE,
+			      0);
+	if (ret)
+		return ret;
+	memset(mtd, '\0', sizeof(*mtd));
+	mtd->type = MTD_NANDFLASH;
+	mtd->flags = MTD_WRITEABLE;
+	mtd->size = TEST_BLOCKS * TEST_BLOCK_SIZE;
+	mtd->erasesize = TEST_BLOCK_SIZE;
+	mtd->writesize = TEST_PAGE_SIZE;
+	mtd->_read = test_mtd_read;
+	mtd->_write = test_mtd_write;
+	mtd->_block_isbad = test_mtd_block_isbad;
+
+	for (i = 0; i < mtd->size; i++)
+		test_flash.data[i] = i / TEST_BLOCK_SIZE + i;
+	test_bad_blocks = 0;
+	test_read_ret = 0;
+
+	return 0;
+}
+
+/* Test reading around bad blocks */
+static int storage_test_mtd_read_skip_bad(struct unit_test_state *uts)
+{
+	u8 buf[3 * TEST_BLOCK_SIZE];
+	struct mtd_info mtd;
+	size_t len;
+
+	ut_assertok(test_mtd_init(&mtd));
+	mtd_read_cache_invalidate();
+	test_bad_blocks = BIT(1) | BIT(2) | BIT(7);
+
+	/* Blocks 1 and 2 are skipped, reading carries on in block 3 */
+	ut_assertok(mtd_read_skip_bad(&mtd, TEST_PAGE_SIZE, 2 * TEST_BLOCK_SIZE,
+				      mtd.size, &len, buf));
+	ut_asserteq(2 * TEST_BLOCK_SIZE, len);
+	ut_assertok(memcmp(buf, test_flash.data + TEST_PAGE_SIZE,
+			   TEST_BLOCK_SIZE - TEST_PAGE_SIZE));
+	ut_assertok(memcmp(buf + TEST_BLOCK_SIZE - TEST_PAGE_SIZE,
+			   test_flash.data + 3 * TEST_BLOCK_SIZE,
+			   TEST_BLOCK_SIZE + TEST_PAGE_SIZE));
+
+	/* The bad blocks count towards the limit */
+	ut_asserteq(-EFBIG, mtd_read_skip_bad(&mtd, 0, 2 * TEST_BLOCK_SIZE,
+					      3 * TEST_BLOCK_SIZE, &len, buf));
+	ut_asserteq(TEST_BLOCK_SIZE, len);
+
+	/* Not enough good blocks before the end */
+	ut_asserteq(-EINVAL, mtd_read_skip_bad(&mtd, 5 * TEST_BLOCK_SIZE,
+					       2 * TEST_BLOCK_SIZE + 1,
+					       mtd.size, &len, buf));
+	ut_ram_blk_free(&test_flash);
+
+	return 0;
+}
+STORAGE_TEST(storage_test_mtd_read_skip_bad, 0);
+
+#ifdef CONFIG_MTD_READ_CACHE
+/* Test that small reads are served from the cache until a write */
+static int storage_test_mtd_read_cache(struct unit_test_state *uts)
+{
+	struct mtd_read_cache_stats before, after;
+	u8 buf[TEST_PAGE_SIZE], data[16];
+	struct mtd_info mtd;
+	size_t len;
+
+	ut_assertok(test_mtd_init(&mtd));
+	mtd_read_cache_invalidate();
+	mtd_read_cache_get_stats(&before);
+
+	/* The first small read fetches the whole page */
+	ut_assertok(mtd_read(&mtd, TEST_PAGE_SIZE + 100, 16, &len, buf));
+	ut_asserteq(16, len);
+	ut_assertok(memcmp(buf, test_flash.data + TEST_PAGE_SIZE + 100, 16));
+	ut_asserteq(1, test_flash.reads);
+
+	/* Further reads from that page do not touch the flash */
+	ut_assertok(mtd_read(&mtd, TEST_PAGE_SIZE + 300, 16, &len, buf));
+	ut_assertok(memcmp(buf, test_flash.data + TEST_PAGE_SIZE + 300, 16));
+	ut_asserteq(1, test_flash.reads);
+
+	/* Whole pages and reads across pages bypass the cache */
+	ut_assertok(mtd_read(&mtd, 0, TEST_PAGE_SIZE, &len, buf));
+	ut_assertok(mtd_read(&mtd, TEST_PAGE_SIZE - 8, 16, &len, buf));
+	ut_asserteq(3, test_flash.reads);
+
+	mtd_read_cache_get_stats(&after);
+	ut_asserteq(1, after.hits - before.hits);
+	ut_asserteq(1, after.misses - before.misses);
+
+	/* A write empties the cache so the new data is seen */
+	memset(data, 0x5a, sizeof(data));
+	ut_assertok(mtd_write(&mtd, TEST_PAGE_SIZE + 300, sizeof(data), &len,
+			      data));
+	ut_assertok(mtd_read(&mtd, TEST_PAGE_SIZE + 300, 16, &len, buf));
+	ut_assertok(memcmp(buf, data, sizeof(data)));
+	ut_asserteq(4, test_flash.reads);
+
+	mtd_read_cache_get_stats(&after);
+	ut_asserteq(1, after.flushes - before.flushes);
+	ut_asserteq(2, after.misses - before.misses);
+
+	/* An uncorrectable page still returns its data, and is not kept */
+	test_read_ret = -EBADMSG;
+	memset(buf, '\0', sizeof(buf));
+	ut_asserteq(-EBADMSG, mtd_read(&mtd, 2 * TEST_PAGE_SIZE + 40, 16, &len,
+				       buf));
+	ut_asserteq(16, len);
+	ut_assertok(memcmp(buf, test_flash.data + 2 * TEST_PAGE_SIZE + 40, 16));
+	ut_asserteq(-EBADMSG, mtd_read(&mtd, 2 * TEST_PAGE_SIZE + 40, 16, &len,
+				       buf));
+	ut_asserteq(8, test_flash.reads);
+
+	/* Do not leave pages of this device behind */
+	mtd_read_cache_invalidate();
+	ut_ram_blk_free(&test_flash);
+
+	return 0;
+}
+STORAGE_TEST(storage_test_mtd_read_cache, 0);
+#endif
+
+/* Test packing of the NAND bad block cache, four blocks to a byte */
+static int storage_test_mtd_nand_bbc(struct unit_test_state *uts)
+{
+	uint8_t cache[3];
+	int block;
+
+	memset(cache, '\0', sizeof(cache));
+	for (block = 0; block < 12; block++)
+		ut_asserteq(NAND_BBC_UNKNOWN, nand_bbc_get(cache, block));
+
+	/* Setting an entry leaves its neighbours in the byte alone */
+	nand_bbc_put(cache, 5, NAND_BBC_BAD);
+	ut_asserteq(0x08, cache[1]);
+	nand_bbc_put(cache, 4, NAND_BBC_GOOD);
+	nand_bbc_put(cache, 7, NAND_BBC_GOOD);
+	ut_asserteq(0x49, cache[1]);
+	ut_asserteq(NAND_BBC_GOOD, nand_bbc_get(cache, 4));
+	ut_asserteq(NAND_BBC_BAD, nand_bbc_get(cache, 5));
+	ut_asserteq(NAND_BBC_UNKNOWN, nand_bbc_get(cache, 6));
+	ut_asserteq(NAND_BBC_GOOD, nand_bbc_get(cache, 7));
+	ut_asserteq(0, cache[0]);
+	ut_asserteq(0, cache[2]);
+
+	/* An entry can be overwritten and invalidated */
+	nand_bbc_put(cache, 5, NAND_BBC_GOOD);
+	ut_asserteq(NAND_BBC_GOOD, nand_bbc_get(cache, 5));
+	nand_bbc_put(cache, 5, NAND_BBC_UNKNOWN);
+	ut_asserteq(NAND_BBC_UNKNOWN, nand_bbc_get(cache, 5));
+	ut_asserteq(0x41, cache[1]);
+
+	/* The last block of a byte uses the top bits */
+	nand_bbc_put(cache, 11, NAND_BBC_BAD);
+	ut_asserteq(0x80, cache[2]);
+	ut_asserteq(NAND_BBC_BAD, nand_bbc_get(cache, 11));
+
+	return 0;
+}
+STORAGE_TEST(storage_test_mtd_nand_bbc, 0);
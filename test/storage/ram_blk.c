@@ -0,0 +1,143 @@
+/*
+ * RAM-backed storage for storage tests
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <dm.h>
+#include <malloc.h>
+#include <test/storage.h>
+#include <dm/device-internal.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+static bool ut_ram_blk_range_ok(struct ut_ram_blk *rb, lbaint_t start,
+				lbaint_t blkcnt)
+{
+	return start <= rb->blocks && blkcnt <= rb->blocks - start;
+}
+
+int ut_ram_blk_init(struct ut_ram_blk *rb, ulong blksz, lbaint_t blocks,
+		    int val)
+{
+	memset(rb, '\0', sizeof(*rb));
+	rb->data = malloc(blksz * blocks);
+	if (!rb->data)
+		return -ENOMEM;
+	memset(rb->data, val, blksz * blocks);
+	rb->blksz = blksz;
+	rb->blocks = blocks;
+
+	return 0;
+}
+
+void ut_ram_blk_free(struct ut_ram_blk *rb)
+{
+#ifdef CONFIG_BLK
+	if (rb->dev) {
+		struct blk_desc *desc = dev_get_uclass_platdata(rb->dev);
+
+		blkcache_invalidate(desc->if_type, desc->devnum);
+		device_remove(rb->dev, DM_REMOVE_NORMAL);
+		device_unbind(rb->dev);
+		rb->dev = NULL;
+	}
+#endif
+	free(rb->data);
+	rb->data = NULL;
+}
+
+ulong ut_ram_blk_read(struct ut_ram_blk *rb, lbaint_t start, lbaint_t blkcnt,
+		      void *buffer)
+{
+	if (!ut_ram_blk_range_ok(rb, start, blkcnt))
+		return 0;
+	rb->reads++;
+	memcpy(buffer, ut_ram_blk_ptr(rb, start), blkcnt * rb->blksz);
+
+	return blkcnt;
+}
+
+ulong ut_ram_blk_write(struct ut_ram_blk *rb, lbaint_t start,
+		       lbaint_t blkcnt, const void *buffer)
+{
+	if (!ut_ram_blk_range_ok(rb, start, blkcnt))
+		return 0;
+	rb->writes++;
+	memcpy(ut_ram_blk_ptr(rb, start), buffer, blkcnt * rb->blksz);
+
+	return blkcnt;
+}
+
+ulong ut_ram_blk_erase(struct ut_ram_blk *rb, lbaint_t start,
+		       lbaint_t blkcnt, int val)
+{
+	if (!ut_ram_blk_range_ok(rb, start, blkcnt))
+		return 0;
+	rb->erases++;
+	rb->erase_blk = start;
+	rb->erase_cnt = blkcnt;
+	memset(ut_ram_blk_ptr(rb, start), val, blkcnt * rb->blksz);
+
+	return blkcnt;
+}
+
+#ifdef CONFIG_BLK
+/* Private data of the block device: the storage it reads and writes */
+struct ut_ram_blk_priv {
+	struct ut_ram_blk *rb;
+};
+
+static ulong ut_ram_blk_dev_read(struct udevice *dev, lbaint_t start,
+				 lbaint_t blkcnt, void *buffer)
+{
+	struct ut_ram_blk_priv *priv = dev_get_priv(dev);
+
+	return ut_ram_blk_read(priv->rb, start, blkcnt, buffer);
+}
+
+static ulong ut_ram_blk_dev_write(struct udevice *dev, lbaint_t start,
+				  lbaint_t blkcnt, const void *buffer)
+{
+	struct ut_ram_blk_priv *priv = dev_get_priv(dev);
+
+	return ut_ram_blk_write(priv->rb, start, blkcnt, buffer);
+}
+
+int ut_ram_blk_bind(struct ut_ram_blk *rb, struct blk_desc **descp)
+{
+	struct ut_ram_blk_priv *priv;
+	int ret;
+
+	ret = blk_create_device(gd->dm_root, "ut_ram_blk", "ut_ram_blk",
+				IF_TYPE_HOST, -1, rb->blksz, rb->blocks,
+				&rb->dev);
+	if (ret)
+		return ret;
+	ret = device_probe(rb->dev);
+	if (ret) {
+		device_unbind(rb->dev);
+		rb->dev = NULL;
+		return ret;
+	}
+	priv = dev_get_priv(rb->dev);
+	priv->rb = rb;
+	*descp = dev_get_uclass_platdata(rb->dev);
+
+	return 0;
+}
+
+static const struct blk_ops ut_ram_blk_ops = {
+	.read	= ut_ram_blk_dev_read,
+	.write	= ut_ram_blk_dev_write,
+};
+
+U_BOOT_DRIVER(ut_ram_blk) = {
+	.name		= "ut_ram_blk",
+	.id		= UCLASS_BLK,
+	.ops		= &ut_ram_blk_ops,
+	.priv_auto_alloc_size	= sizeof(struct ut_ram_blk_priv),
+};
+#endif
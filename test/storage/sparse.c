@@ -0,0 +1,296 @@
+/*
+ * Tests for writing Android sparse images
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <image-sparse.h>
+#include <malloc.h>
+#include <test/storage.h>
+#include <test/ut.h>
+
+#define SPARSE_TEST_BLKSZ	512
+#define SPARSE_TEST_START	16
+#define SPARSE_TEST_BLOCKS	256
+#define SPARSE_TEST_ERASE_GRP	8
+#define SPARSE_TEST_SIZE	\
+	((SPARSE_TEST_START + SPARSE_TEST_BLOCKS) * SPARSE_TEST_BLKSZ)
+/* Blocks of the sparse images, two storage blocks each */
+#define SPARSE_TEST_IMG_BLKSZ	1024
+#define SPARSE_TEST_MAX_IMG	(64 * 1024)
+
+/**
+ * struct sparse_test - RAM-backed storage and an image being built
+ *
+ * @rb:		Storage
+ * @img:	Image being built
+ * @len:	Bytes of it so far
+ */
+struct sparse_test {
+	struct ut_ram_blk rb;
+	u8 img[SPARSE_TEST_MAX_IMG];
+	uint len;
+};
+
+static lbaint_t sparse_test_write(struct sparse_storage *info, lbaint_t blk,
+				  lbaint_t blkcnt, const void *buffer)
+{
+	struct sparse_test *st = info->priv;
+
+	return ut_ram_blk_write(&st->rb, blk, blkcnt, buffer);
+}
+
+static lbaint_t sparse_test_reserve(struct sparse_storage *info,
+				    lbaint_t blk, lbaint_t blkcnt)
+{
+	return blkcnt;
+}
+
+static lbaint_t sparse_test_erase(struct sparse_storage *info, lbaint_t blk,
+				  lbaint_t blkcnt)
+{
+	struct sparse_test *st = info->priv;
+
+	return ut_ram_blk_erase(&st->rb, blk, blkcnt, 0);
+}
+
+/* Set up @info to write to the storage, which is filled with 0x77 */
+static void sparse_test_init(struct sparse_test *st,
+			     struct sparse_storage *info, bool erase)
+{
+	memset(st->rb.data, 0x77, SPARSE_TEST_SIZE);
+	st->rb.writes = 0;
+	st->rb.erases = 0;
+	memset(info, '\0', sizeof(*info));
+	info->blksz = SPARSE_TEST_BLKSZ;
+	info->start = SPARSE_TEST_START;
+	info->size = SPARSE_TEST_BLOCKS;
+	info->priv = st;
+	info->write = sparse_test_write;
+	info->reserve = sparse_test_reserve;
+	if (erase) {
+		info->erase = sparse_test_erase;
+		info->erase_grp = SPARSE_TEST_ERASE_GRP;
+		info->erased_val = 0;
+	}
+}
+
+static void sparse_test_start_img(struct sparse_test *st)
+{
+	sparse_header_t *hdr = (void *)st->img;
+
+	memset(hdr, '\0', sizeof(*hdr));
+	hdr->magic = SPARSE_HEADER_MAGIC;
+	hdr->major_version = 1;
+	hdr->file_hdr_sz = sizeof(*hdr);
+	hdr->chunk_hdr_sz = sizeof(chunk_header_t);
+	hdr->blk_sz = SPARSE_TEST_IMG_BLKSZ;
+	st->len = sizeof(*hdr);
+}
+
+/* Add a chunk of @blocks image blocks, followed by @len bytes of @data */
+static void sparse_test_chunk(struct sparse_test *st, uint type, uint blocks,
+			      const void *data, uint len)
+{
+	sparse_header_t *hdr = (void *)st->img;
+	chunk_header_t chunk;
+
+	chunk.chunk_type = type;
+	chunk.reserved1 = 0;
+	chunk.chunk_sz = blocks;
+	chunk.total_sz = sizeof(chunk) + len;
+	memcpy(st->img + st->len, &chunk, sizeof(chunk));
+	memcpy(st->img + st->len + sizeof(chunk), data, len);
+	st->len += sizeof(chunk) + len;
+	hdr->total_blks += blocks;
+	hdr->total_chunks++;
+}
+
+/* Write the image in pieces of at most @max bytes, or in one go if 0 */
+static int sparse_test_write_img(struct sparse_test *st,
+				 struct sparse_storage *info, uint max,
+				 uint *seed)
+{
+	struct sparse_stream ss;
+	uint pos, n;
+
+	if (sparse_stream_start(&ss, info))
+		return -ENOMEM;
+	for (pos = 0; pos < st->len; pos += n) {
+		n = st->len - pos;
+		if (max)
+			n = min(n, rand_r(seed) % max + 1);
+		sparse_stream_write(&ss, st->img + pos, n);
+	}
+
+	return sparse_stream_finish(&ss, "test");
+}
+
+static u8 *sparse_test_blk(struct sparse_test *st, uint img_blk)
+{
+	return ut_ram_blk_ptr(&st->rb, SPARSE_TEST_START) +
+		img_blk * SPARSE_TEST_IMG_BLKSZ;
+}
+
+static struct sparse_test *sparse_test_alloc(void)
+{
+	struct sparse_test *st;
+
+	st = calloc(1, sizeof(*st));
+	if (!st)
+		return NULL;
+	if (ut_ram_blk_init(&st->rb, SPARSE_TEST_BLKSZ,
+			    SPARSE_TEST_START + SPARSE_TEST_BLOCKS, 0x77)) {
+		free(st);
+		return NULL;
+	}
+
+	return st;
+}
+
+static void sparse_test_free(struct sparse_test *st)
+{
+	ut_ram_blk_free(&st->rb);
+	free(st);
+}
+
+/* Test that fills are erased where possible and don't-care is skipped */
+static int storage_test_sparse_erase(struct unit_test_state *uts)
+{
+	struct sparse_storage info;
+	struct sparse_test *st;
+	u8 raw[3 * SPARSE_TEST_IMG_BLKSZ];
+	u32 zero = 0, fill = 0xdeadbeef;
+	uint seed = 1;
+	uint i;
+
+	st = sparse_test_alloc();
+	ut_assertnonnull(st);
+	for (i = 0; i < sizeof(raw); i++)
+		raw[i] = i * 7 + (i >> 9);
+
+	sparse_test_start_img(st);
+	sparse_test_chunk(st, CHUNK_TYPE_RAW, 3, raw, sizeof(raw));
+	sparse_test_chunk(st, CHUNK_TYPE_FILL, 20, &zero, sizeof(zero));
+	sparse_test_chunk(st, CHUNK_TYPE_FILL, 2, &fill, sizeof(fill));
+	sparse_test_chunk(st, CHUNK_TYPE_DONT_CARE, 5, NULL, 0);
+	sparse_test_chunk(st, CHUNK_TYPE_CRC32, 0, &zero, sizeof(zero));
+	sparse_test_chunk(st, CHUNK_TYPE_RAW, 1, raw, SPARSE_TEST_IMG_BLKSZ);
+
+	sparse_test_init(st, &info, true);
+	ut_assertok(sparse_test_write_img(st, &info, 0, &seed));
+
+	/*
+	 * The zero fill covers storage blocks 22-61. The whole erase groups
+	 * in it are erased and the rest is written.
+	 */
+	ut_asserteq(1, st->rb.erases);
+	ut_asserteq(24, st->rb.erase_blk);
+	ut_asserteq(32, st->rb.erase_cnt);
+
+	ut_assertok(memcmp(sparse_test_blk(st, 0), raw, sizeof(raw)));
+	for (i = 0; i < 20 * SPARSE_TEST_IMG_BLKSZ; i++)
+		ut_asserteq(0, sparse_test_blk(st, 3)[i]);
+	for (i = 0; i < 2 * SPARSE_TEST_IMG_BLKSZ; i += 4)
+		ut_asserteq(fill, *(u32 *)(sparse_test_blk(st, 23) + i));
+	for (i = 0; i < 5 * SPARSE_TEST_IMG_BLKSZ; i++)
+		ut_asserteq(0x77, sparse_test_blk(st, 25)[i]);
+	ut_assertok(memcmp(sparse_test_blk(st, 30), raw,
+			   SPARSE_TEST_IMG_BLKSZ));
+	ut_asserteq(0x77, *sparse_test_blk(st, 31));
+	ut_asserteq(0x77, sparse_test_blk(st, 0)[-1]);
+
+	/* Without an erase callback the fill is written */
+	sparse_test_init(st, &info, false);
+	ut_assertok(sparse_test_write_img(st, &info, 0, &seed));
+	for (i = 0; i < 20 * SPARSE_TEST_IMG_BLKSZ; i++)
+		ut_asserteq(0, sparse_test_blk(st, 3)[i]);
+
+	/*
+	 * An image split by the host: each piece marks what the others
+	 * write as don't-care, which must not be erased
+	 */
+	sparse_test_init(st, &info, true);
+	sparse_test_start_img(st);
+	sparse_test_chunk(st, CHUNK_TYPE_RAW, 3, raw, sizeof(raw));
+	sparse_test_chunk(st, CHUNK_TYPE_DONT_CARE, 40, NULL, 0);
+	ut_assertok(sparse_test_write_img(st, &info, 0, &seed));
+
+	sparse_test_start_img(st);
+	sparse_test_chunk(st, CHUNK_TYPE_DONT_CARE, 3, NULL, 0);
+	sparse_test_chunk(st, CHUNK_TYPE_FILL, 40, &zero, sizeof(zero));
+	ut_assertok(sparse_test_write_img(st, &info, 0, &seed));
+	ut_asserteq(1, st->rb.erases);
+	ut_assertok(memcmp(sparse_test_blk(st, 0), raw, sizeof(raw)));
+	for (i = 0; i < 40 * SPARSE_TEST_IMG_BLKSZ; i++)
+		ut_asserteq(0, sparse_test_blk(st, 3)[i]);
+
+	sparse_test_free(st);
+
+	return 0;
+}
+STORAGE_TEST(storage_test_sparse_erase, 0);
+
+/* Test that an image gives the same result however it is split up */
+static int storage_test_sparse_stream(struct unit_test_state *uts)
+{
+	const uint maxes[] = { 1, 3, 30, 700, 5000 };
+	const uint raw_lens[] = { 5000, 20 };
+	struct sparse_storage info;
+	struct sparse_test *st;
+	u8 raw[3 * SPARSE_TEST_IMG_BLKSZ];
+	u32 zero = 0, fill = 0xdeadbeef;
+	uint seed = 1;
+	uint i, j, k, end;
+	u8 *ref;
+
+	st = sparse_test_alloc();
+	ref = malloc(SPARSE_TEST_SIZE);
+	ut_assertnonnull(st);
+	ut_assertnonnull(ref);
+	for (i = 0; i < sizeof(raw); i++)
+		raw[i] = i * 7 + (i >> 9);
+
+	/* A sparse image, written in one go for reference */
+	sparse_test_start_img(st);
+	sparse_test_chunk(st, CHUNK_TYPE_RAW, 3, raw, sizeof(raw));
+	sparse_test_chunk(st, CHUNK_TYPE_FILL, 20, &zero, sizeof(zero));
+	sparse_test_chunk(st, CHUNK_TYPE_DONT_CARE, 5, NULL, 0);
+	sparse_test_chunk(st, CHUNK_TYPE_FILL, 2, &fill, sizeof(fill));
+	sparse_test_chunk(st, CHUNK_TYPE_CRC32, 0, &zero, sizeof(zero));
+	sparse_test_chunk(st, CHUNK_TYPE_RAW, 1, raw, SPARSE_TEST_IMG_BLKSZ);
+	sparse_test_init(st, &info, true);
+	ut_assertok(sparse_test_write_img(st, &info, 0, &seed));
+	memcpy(ref, st->rb.data, SPARSE_TEST_SIZE);
+
+	for (i = 0; i < ARRAY_SIZE(maxes); i++) {
+		sparse_test_init(st, &info, true);
+		ut_assertok(sparse_test_write_img(st, &info, maxes[i], &seed));
+		ut_assertok(memcmp(ref, st->rb.data, SPARSE_TEST_SIZE));
+	}
+
+	/* Raw images, including one shorter than a sparse header */
+	for (j = 0; j < ARRAY_SIZE(raw_lens); j++) {
+		memcpy(st->img, raw, raw_lens[j]);
+		st->len = raw_lens[j];
+		for (i = 0; i < ARRAY_SIZE(maxes); i++) {
+			sparse_test_init(st, &info, true);
+			ut_assertok(sparse_test_write_img(st, &info, maxes[i],
+							  &seed));
+			ut_assertok(memcmp(sparse_test_blk(st, 0), raw,
+					   raw_lens[j]));
+			/* The last block is padded out */
+			end = ALIGN(raw_lens[j], SPARSE_TEST_BLKSZ);
+			for (k = raw_lens[j]; k < end; k++)
+				ut_asserteq(0, sparse_test_blk(st, 0)[k]);
+			ut_asserteq(0x77, sparse_test_blk(st, 0)[end]);
+		}
+	}
+
+	free(ref);
+	sparse_test_free(st);
+
+	return 0;
+}
+STORAGE_TEST(storage_test_sparse_stream, 0);
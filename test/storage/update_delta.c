@@ -0,0 +1,200 @@
+/*
+ * Tests for block-level delta updates
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <update_delta.h>
+#include <test/storage.h>
+#include <test/ut.h>
+#include <asm/unaligned.h>
+#include <u-boot/crc.h>
+
+#define DELTA_TEST_BLOCK_SIZE	1024
+#define DELTA_TEST_BLOCKS	16
+#define DELTA_TEST_SIZE		(DELTA_TEST_BLOCKS * DELTA_TEST_BLOCK_SIZE)
+
+/**
+ * struct delta_test - A delta being built
+ *
+ * @buf:	Delta
+ * @len:	Bytes of it so far
+ * @src:	Contents of the source partition, on the storage
+ * @dst:	Expected contents of the target partition
+ */
+struct delta_test {
+	u8 *buf;
+	uint len;
+	u8 *src;
+	u8 *dst;
+};
+
+/* Add an operation producing @blocks blocks at @dst_blk of dt->dst */
+static void delta_test_op(struct delta_test *dt, uint type, uint blocks,
+			  uint src_blk, uint dst_blk, const void *data,
+			  uint data_len)
+{
+	struct update_delta_header *hdr = (void *)dt->buf;
+	struct update_delta_op op;
+	uint bytes = blocks * DELTA_TEST_BLOCK_SIZE;
+
+	memset(&op, '\0', sizeof(op));
+	op.type = cpu_to_le32(type);
+	op.blocks = cpu_to_le32(blocks);
+	op.src_blk = cpu_to_le32(src_blk);
+	op.dst_blk = cpu_to_le32(dst_blk);
+	op.data_len = cpu_to_le32(data_len);
+	if (type == DELTA_OP_COPY || type == DELTA_OP_DIFF)
+		sha256_csum_wd(dt->src + src_blk * DELTA_TEST_BLOCK_SIZE,
+			       bytes, op.src_hash, CHUNKSZ_SHA256);
+	sha256_csum_wd(dt->dst + dst_blk * DELTA_TEST_BLOCK_SIZE, bytes,
+		       op.dst_hash, CHUNKSZ_SHA256);
+
+	memcpy(dt->buf + dt->len, &op, sizeof(op));
+	memcpy(dt->buf + dt->len + sizeof(op), data, data_len);
+	dt->len += sizeof(op) + data_len;
+	hdr->op_count = cpu_to_le32(le32_to_cpu(hdr->op_count) + 1);
+}
+
+/*
+ * Build a delta from dt->src which uses each type of operation, setting
+ * up dt->dst to match
+ */
+static void delta_test_build(struct delta_test *dt)
+{
+	struct update_delta_header *hdr = (void *)dt->buf;
+	u8 diff[2 * 8 + 4 + 2];
+	uint i;
+
+	memset(hdr, '\0', sizeof(*hdr));
+	hdr->magic = cpu_to_le32(UPDATE_DELTA_MAGIC);
+	hdr->version = cpu_to_le32(UPDATE_DELTA_VERSION);
+	hdr->block_size = cpu_to_le32(DELTA_TEST_BLOCK_SIZE);
+	hdr->src_blocks = cpu_to_le32(DELTA_TEST_BLOCKS);
+	hdr->dst_blocks = cpu_to_le32(DELTA_TEST_BLOCKS);
+	dt->len = sizeof(*hdr);
+
+	/* Blocks 0-3 come from source blocks 8-11 */
+	memcpy(dt->dst, dt->src + 8 * DELTA_TEST_BLOCK_SIZE,
+	       4 * DELTA_TEST_BLOCK_SIZE);
+	delta_test_op(dt, DELTA_OP_COPY, 4, 8, 0, NULL, 0);
+
+	/* Blocks 4-7 are source blocks 4-7 with a few bytes changed */
+	memcpy(dt->dst + 4 * DELTA_TEST_BLOCK_SIZE,
+	       dt->src + 4 * DELTA_TEST_BLOCK_SIZE, 4 * DELTA_TEST_BLOCK_SIZE);
+	put_unaligned_le32(10, diff);
+	put_unaligned_le32(4, diff + 4);
+	put_unaligned_le32(0x01020304, diff + 8);
+	put_unaligned_le32(3000, diff + 12);
+	put_unaligned_le32(2, diff + 16);
+	diff[20] = 0xff;
+	diff[21] = 0x80;
+	for (i = 0; i < 4; i++)
+		dt->dst[4 * DELTA_TEST_BLOCK_SIZE + 10 + i] += diff[8 + i];
+	dt->dst[4 * DELTA_TEST_BLOCK_SIZE + 3014] += 0xff;
+	dt->dst[4 * DELTA_TEST_BLOCK_SIZE + 3015] += 0x80;
+	delta_test_op(dt, DELTA_OP_DIFF, 4, 4, 4, diff, sizeof(diff));
+
+	/* Blocks 8-9 are new */
+	for (i = 0; i < 2 * DELTA_TEST_BLOCK_SIZE; i++)
+		dt->dst[8 * DELTA_TEST_BLOCK_SIZE + i] = i * 3;
+	delta_test_op(dt, DELTA_OP_DATA, 2, 0, 8,
+		      dt->dst + 8 * DELTA_TEST_BLOCK_SIZE,
+		      2 * DELTA_TEST_BLOCK_SIZE);
+
+	/* The rest is empty */
+	memset(dt->dst + 10 * DELTA_TEST_BLOCK_SIZE, '\0',
+	       6 * DELTA_TEST_BLOCK_SIZE);
+	delta_test_op(dt, DELTA_OP_ZERO, 6, 0, 10, NULL, 0);
+}
+
+/* Test applying a delta between two partitions of a block device */
+static int storage_test_update_delta(struct unit_test_state *uts)
+{
+	disk_partition_t src, dst;
+	struct blk_desc *desc;
+	struct delta_test dt;
+	struct ut_ram_blk rb;
+	char val[20];
+	u8 *dst_data;
+	uint i;
+
+	ut_assertok(ut_ram_blk_init(&rb, 512, 256, 0));
+	ut_assertok(ut_ram_blk_bind(&rb, &desc));
+
+	memset(&src, '\0', sizeof(src));
+	src.start = 64;
+	src.size = DELTA_TEST_SIZE / 512;
+	src.blksz = 512;
+	dst = src;
+	dst.start = 128;
+	dst_data = ut_ram_blk_ptr(&rb, dst.start);
+
+	dt.buf = malloc(DELTA_TEST_SIZE);
+	dt.dst = malloc(DELTA_TEST_SIZE);
+	ut_assertnonnull(dt.buf);
+	ut_assertnonnull(dt.dst);
+
+	dt.src = ut_ram_blk_ptr(&rb, src.start);
+	for (i = 0; i < DELTA_TEST_SIZE; i++)
+		dt.src[i] = i * 7 + (i >> 10);
+	delta_test_build(&dt);
+	env_set(UPDATE_DELTA_PROGRESS_ENV, NULL);
+
+	ut_assertok(update_delta_apply(dt.buf, dt.len, desc, &src, desc,
+				       &dst));
+	ut_assertok(memcmp(dt.dst, dst_data, DELTA_TEST_SIZE));
+	ut_asserteq_ptr(NULL, env_get(UPDATE_DELTA_PROGRESS_ENV));
+
+	/* An interrupted update carries on from the recorded operation */
+	memset(dst_data, 0xaa, DELTA_TEST_SIZE);
+	snprintf(val, sizeof(val), "%08x:2", crc32(0, dt.buf, dt.len));
+	env_set(UPDATE_DELTA_PROGRESS_ENV, val);
+	ut_assertok(update_delta_apply(dt.buf, dt.len, desc, &src, desc,
+				       &dst));
+	for (i = 0; i < 8 * DELTA_TEST_BLOCK_SIZE; i++)
+		ut_asserteq(0xaa, dst_data[i]);
+	ut_assertok(memcmp(dt.dst + 8 * DELTA_TEST_BLOCK_SIZE,
+			   dst_data + 8 * DELTA_TEST_BLOCK_SIZE,
+			   8 * DELTA_TEST_BLOCK_SIZE));
+
+	/* Progress through another delta is ignored */
+	snprintf(val, sizeof(val), "%08x:2", ~crc32(0, dt.buf, dt.len));
+	env_set(UPDATE_DELTA_PROGRESS_ENV, val);
+	ut_assertok(update_delta_apply(dt.buf, dt.len, desc, &src, desc,
+				       &dst));
+	ut_assertok(memcmp(dt.dst, dst_data, DELTA_TEST_SIZE));
+
+	/*
+	 * A delta for another source writes nothing, even when the mismatch
+	 * is only in the source of a later operation
+	 */
+	memset(dst_data, 0xaa, DELTA_TEST_SIZE);
+	rb.writes = 0;
+	dt.src[5 * DELTA_TEST_BLOCK_SIZE] ^= 1;
+	ut_asserteq(-EILSEQ, update_delta_apply(dt.buf, dt.len, desc, &src,
+						desc, &dst));
+	ut_asserteq(0, rb.writes);
+	for (i = 0; i < DELTA_TEST_SIZE; i++)
+		ut_asserteq(0xaa, dst_data[i]);
+
+	/* Operations must stay inside the partitions */
+	ut_asserteq(-EINVAL, update_delta_apply(dt.buf, dt.len - 1, desc,
+						&src, desc, &dst));
+	dst.size--;
+	ut_asserteq(-EINVAL, update_delta_apply(dt.buf, dt.len, desc, &src,
+						desc, &dst));
+	dst.size++;
+	dst.start = src.start + 1;
+	ut_asserteq(-EINVAL, update_delta_apply(dt.buf, dt.len, desc, &src,
+						desc, &dst));
+
+	free(dt.dst);
+	free(dt.buf);
+	ut_ram_blk_free(&rb);
+
+	return 0;
+}
+STORAGE_TEST(storage_test_update_delta, 0);